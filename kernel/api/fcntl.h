@@ -52,5 +52,14 @@
 #define F_GETLK 6
 #define F_SETLK 7
 #define F_SETLKW 8
+#define F_SETPIPE_SZ 1031
+#define F_GETPIPE_SZ 1032
 
-#define FD_CLOEXEC 1
\ No newline at end of file
+#define FD_CLOEXEC 1
+
+#define POSIX_FADV_NORMAL 0
+#define POSIX_FADV_RANDOM 1
+#define POSIX_FADV_SEQUENTIAL 2
+#define POSIX_FADV_WILLNEED 3
+#define POSIX_FADV_DONTNEED 4
+#define POSIX_FADV_NOREUSE 5
\ No newline at end of file
@@ -15,4 +15,6 @@
 #define TIOCGWINSZ	10
 #define TIOCNOTTY	11
 #define TIOSGFX		12
-#define TIOSNOGFX	13
\ No newline at end of file
+#define TIOSNOGFX	13
+#define FIOGETPIPESZ	14
+#define FIOSETPIPESZ	15
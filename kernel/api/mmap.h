@@ -19,6 +19,7 @@
 #define MAP_FILE		0x0
 #define MAP_FIXED		0x4
 #define MAP_GROWSDOWN	0x8
+#define MAP_POPULATE	0x10
 
 #define MAP_FAILED ((void*) -1)
 
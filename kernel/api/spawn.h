@@ -0,0 +1,50 @@
+/* SPDX-License-Identifier: GPL-3.0-or-later */
+/* Copyright © 2016-2023 Byteduck */
+
+#pragma once
+
+#include "types.h"
+
+// posix_spawnattr_t flags
+#define POSIX_SPAWN_SETPGROUP	0x1
+#define POSIX_SPAWN_SETSID		0x2
+
+// posix_spawn_file_action types
+#define SPAWN_FILE_ACTION_OPEN	0
+#define SPAWN_FILE_ACTION_CLOSE	1
+#define SPAWN_FILE_ACTION_DUP2	2
+
+// The most file actions that posix_spawn will accept
+#define SPAWN_MAX_FILE_ACTIONS	256
+
+__DECL_BEGIN
+
+struct posix_spawn_file_action {
+	int type;
+	int fd; //The fd to open, close, or duplicate onto
+	int src_fd; //The fd to duplicate, for SPAWN_FILE_ACTION_DUP2
+	int flags;
+	mode_t mode;
+	const char* path;
+};
+
+typedef struct {
+	struct posix_spawn_file_action* actions;
+	int num_actions;
+	int capacity;
+} posix_spawn_file_actions_t;
+
+typedef struct {
+	short flags;
+	pid_t pgroup;
+} posix_spawnattr_t;
+
+struct posix_spawn_args {
+	const char* path;
+	char* const* argv;
+	char* const* envp;
+	const posix_spawn_file_actions_t* file_actions;
+	const posix_spawnattr_t* attr;
+};
+
+__DECL_END
@@ -0,0 +1,8 @@
+/* SPDX-License-Identifier: GPL-3.0-or-later */
+/* Copyright © 2016-2023 Byteduck */
+
+#pragma once
+
+// The size of a userspace thread's stack. Stacks are mapped aligned to their size, so the bottom of the current thread's
+// stack can be found by rounding the stack pointer down.
+#define THREAD_STACK_SIZE 1048576 //1024KiB
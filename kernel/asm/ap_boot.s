@@ -0,0 +1,94 @@
+; The trampoline that application processors start executing after receiving a startup IPI.
+; ap_boot_start -> ap_boot_end is copied to AP_BOOT_PADDR by CPU::start_aps and runs from there in real mode, so it can
+; only use addresses relative to AP_BOOT_PADDR until it jumps to the kernel.
+
+[extern BootPageDirectory]
+[extern ap_main]
+
+[global ap_boot_start]
+[global ap_boot_end]
+[global ap_boot_cr3]
+[global ap_boot_stack]
+
+AP_BOOT_PADDR equ 0x8000
+KERNEL_VIRTUAL_BASE equ 0xC0000000
+
+%define TRAMPOLINE_ADDR(label) (AP_BOOT_PADDR + (label - ap_boot_start))
+
+section .data
+
+;Set by CPU::start_aps before starting each AP
+ap_boot_cr3:
+    dd 0
+ap_boot_stack:
+    dd 0
+
+section .text
+
+[bits 16]
+ap_boot_start:
+    cli
+    cld
+    xor ax, ax
+    mov ds, ax
+
+    ;Load a temporary flat GDT and enter protected mode
+    o32 lgdt [TRAMPOLINE_ADDR(ap_boot_gdtr)]
+    mov eax, cr0
+    or eax, 0x1
+    mov cr0, eax
+    jmp dword 0x08:TRAMPOLINE_ADDR(ap_boot_pmode)
+
+[bits 32]
+ap_boot_pmode:
+    mov ax, 0x10
+    mov ds, ax
+    mov es, ax
+    mov fs, ax
+    mov gs, ax
+    mov ss, ax
+
+    ;Turn on paging with the boot page directory, which maps both us and the kernel
+    mov ecx, (BootPageDirectory - KERNEL_VIRTUAL_BASE)
+    mov cr3, ecx
+    mov ecx, cr0
+    or ecx, 0x80010000
+    mov cr0, ecx
+
+    ;Check for SSE
+    mov eax, 0x1
+    cpuid
+    test edx, 1<<25
+    jz ap_no_sse
+
+    ;Turn on SSE
+    mov eax, cr0
+    and ax, 0xFFFB
+    or ax, 0x2
+    mov cr0, eax
+    mov eax, cr4
+    or ax, 3 << 9
+    mov cr4, eax
+    ap_no_sse:
+
+    lea ecx, [ap_boot_hh]
+    jmp ecx
+
+align 8
+ap_boot_gdt:
+    dq 0x0000000000000000 ;Null
+    dq 0x00CF9A000000FFFF ;Code
+    dq 0x00CF92000000FFFF ;Data
+ap_boot_gdtr:
+    dw ap_boot_gdtr - ap_boot_gdt - 1
+    dd TRAMPOLINE_ADDR(ap_boot_gdt)
+ap_boot_end:
+
+;Now we're running in the higher half, so switch to the kernel's page directory and the stack we were given
+ap_boot_hh:
+    mov ecx, [ap_boot_cr3]
+    mov cr3, ecx
+    mov esp, [ap_boot_stack]
+    xor ebp, ebp
+    call ap_main
+    jmp $
@@ -58,7 +58,7 @@ ISR_CODE 3  ;Generated by CPU: Breakpoint
 ISR_CODE 4  ;Generated by CPU: Detected Overflow
 ISR_CODE 5  ;Generated by CPU: Out of Bounds
 ISR_CODE 6  ;Generated by CPU: Invalid Opcode
-ISR_CODE 7  ;Generated by CPU: No Coprocessor
+ISR_NOCODE 7 ;Generated by CPU: No Coprocessor
 ISR_CODE 8  ;Generated by CPU: Double Fault
 ISR_CODE 9  ;Generated by CPU: Coprocessor Segment Overrun
 ISR_CODE 10 ;Generated by CPU: Bad TSS
@@ -176,6 +176,12 @@ irq_common:
     add esp, 8
     iret
 
+global apic_spurious
+
+;Spurious interrupts from the local APIC don't need an EOI
+apic_spurious:
+    iret
+
 global _iret
 _iret:
 	iret
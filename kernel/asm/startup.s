@@ -1,6 +1,8 @@
 [bits 32]
 [global start]
 [global load_gdt]
+[global BootPageDirectory]
+[global IdentityPageTable]
 [extern kmain]
 
 global flagss
@@ -20,13 +20,127 @@
 #include <kernel/memory/PageDirectory.h>
 #include <kernel/kstd/cstring.h>
 #include <kernel/memory/MemoryManager.h>
+#include <kernel/memory/InodeVMObject.h>
+#include <kernel/tasking/TaskManager.h>
+#include <kernel/tasking/Thread.h>
+#include <kernel/tasking/WaitQueue.h>
 #include "DiskDevice.h"
 #include "kernel/kstd/KLog.h"
 
 size_t DiskDevice::s_used_cache_memory = 0;
+Atomic<size_t> DiskDevice::s_dirty_regions = 0;
 kstd::vector<DiskDevice*> DiskDevice::s_disk_devices;
 SpinLock DiskDevice::s_disk_devices_lock;
 
+static WaitQueue s_flusher_queue;
+static bool s_flush_requested = false;
+
+struct PrefetchRequest {
+	DiskDevice* device;
+	size_t block;
+	size_t count;
+};
+
+// A ring of prefetch requests waiting for the readahead thread. Only touched in critical sections.
+static PrefetchRequest s_prefetch_requests[BLOCK_CACHE_MAX_QUEUED_PREFETCHES];
+static size_t s_prefetch_head = 0;
+static size_t s_num_prefetches = 0;
+static WaitQueue s_readahead_queue;
+
+/**
+ * Blocks the flusher until either the flush interval passes or a disk has too many dirty cache regions.
+ */
+class FlusherBlocker: public Blocker {
+public:
+	FlusherBlocker(): m_end_time(Time::now() + Time(BLOCK_CACHE_FLUSH_INTERVAL_SECS, 0)) {
+		set_timeout(m_end_time);
+	}
+
+	bool is_ready() override {
+		return s_flush_requested || Time::now() >= m_end_time;
+	}
+
+	bool can_be_interrupted() override {
+		return false;
+	}
+
+protected:
+	void on_block() override {
+		s_flusher_queue.add(m_entry, *this);
+	}
+
+	void on_unblock() override {
+		WaitQueue::remove(m_entry);
+	}
+
+private:
+	Time m_end_time;
+	WaitQueue::Entry m_entry;
+};
+
+void kflusher_entry() {
+	while(true) {
+		FlusherBlocker blocker;
+		TaskManager::current_thread()->block(blocker);
+
+		// If we were woken up because of too many dirty regions, write back everything instead of just what's expired
+		bool requested;
+		{
+			TaskManager::ScopedCritical critical;
+			requested = s_flush_requested;
+			s_flush_requested = false;
+		}
+		DiskDevice::flush_all(!requested);
+	}
+}
+
+/**
+ * Blocks the readahead thread until there's a prefetch request for it.
+ */
+class ReadaheadBlocker: public Blocker {
+public:
+	bool is_ready() override {
+		return s_num_prefetches;
+	}
+
+	bool can_be_interrupted() override {
+		return false;
+	}
+
+protected:
+	void on_block() override {
+		s_readahead_queue.add(m_entry, *this);
+	}
+
+	void on_unblock() override {
+		WaitQueue::remove(m_entry);
+	}
+
+private:
+	WaitQueue::Entry m_entry;
+};
+
+void kreadahead_entry() {
+	while(true) {
+		ReadaheadBlocker blocker;
+		TaskManager::current_thread()->block(blocker);
+
+		PrefetchRequest request;
+		{
+			TaskManager::ScopedCritical critical;
+			if(!s_num_prefetches)
+				continue;
+			request = s_prefetch_requests[s_prefetch_head];
+			s_prefetch_head = (s_prefetch_head + 1) % BLOCK_CACHE_MAX_QUEUED_PREFETCHES;
+			s_num_prefetches--;
+		}
+
+		auto res = request.device->populate_cache(request.block, request.count);
+		if(res.is_error())
+			KLog::warn("DiskDevice", "Error %d prefetching blocks of disk %d,%d!", res.code(), request.device->major(), request.device->minor());
+	}
+}
+
 DiskDevice::DiskDevice(unsigned int major, unsigned int minor): BlockDevice(major, minor) {
 	s_disk_devices.push_back(this);
 }
@@ -39,6 +153,16 @@ DiskDevice::~DiskDevice() {
 			break;
 		}
 	}
+
+	// Drop any prefetches that are still waiting for us
+	TaskManager::ScopedCritical critical;
+	size_t num_kept = 0;
+	for(size_t i = 0; i < s_num_prefetches; i++) {
+		auto& request = s_prefetch_requests[(s_prefetch_head + i) % BLOCK_CACHE_MAX_QUEUED_PREFETCHES];
+		if(request.device != this)
+			s_prefetch_requests[(s_prefetch_head + num_kept++) % BLOCK_CACHE_MAX_QUEUED_PREFETCHES] = request;
+	}
+	s_num_prefetches = num_kept;
 };
 
 Result DiskDevice::read_blocks(uint32_t start_block, uint32_t count, uint8_t* buffer) {
@@ -56,24 +180,407 @@ Result DiskDevice::read_blocks(uint32_t start_block, uint32_t count, uint8_t* bu
 
 Result DiskDevice::write_blocks(uint32_t start_block, uint32_t count, const uint8_t* buffer) {
 	kstd::Arc<BlockCacheRegion> cache_region;
+	size_t num_dirty = 0;
 	for(size_t i = 0; i < count; i++) {
 		size_t block = start_block + i;
 		if(!cache_region || !cache_region->has_block(block))
 			cache_region = get_cache_region(block);
 		LOCK(cache_region->lock);
 		cache_region->last_used = Time::now();
-		cache_region->dirty = true;
 		memcpy(cache_region->block_data(block), buffer + i * block_size(), block_size());
+		num_dirty = mark_dirty(cache_region);
 	}
 
-	//TODO: Flush cached writes to disk periodically instead of on every write
-	return write_uncached_blocks(start_block, count, buffer);
+	// The writes will be flushed to the disk by the flusher later, unless we have too many dirty regions
+	if(num_dirty >= BLOCK_CACHE_DIRTY_HIGH_WATER) {
+		TaskManager::ScopedCritical critical;
+		s_flush_requested = true;
+		s_flusher_queue.wake_all();
+	}
+
+	return Result(SUCCESS);
+}
+
+Result DiskDevice::sync() {
+	return flush(false);
+}
+
+void DiskDevice::prefetch(size_t offset, size_t count) {
+	if(!count)
+		return;
+	size_t first_block = offset / block_size();
+	size_t last_block = (offset + count - 1) / block_size();
+
+	TaskManager::ScopedCritical critical;
+	if(s_num_prefetches >= BLOCK_CACHE_MAX_QUEUED_PREFETCHES)
+		return;
+	s_prefetch_requests[(s_prefetch_head + s_num_prefetches) % BLOCK_CACHE_MAX_QUEUED_PREFETCHES] = {this, first_block, last_block - first_block + 1};
+	s_num_prefetches++;
+	s_readahead_queue.wake_all();
+}
+
+Result DiskDevice::read_direct(FileDescriptor& fd, size_t offset, size_t count, uint8_t* buffer) {
+	if(offset % block_size() || count % block_size())
+		return BlockDevice::read_direct(fd, offset, count, buffer);
+
+	size_t first_block = offset / block_size();
+	size_t end_block = first_block + count / block_size();
+	size_t block = first_block;
+	while(block < end_block) {
+		// Find out whether this block is cached, or how many blocks after it aren't
+		kstd::Arc<BlockCacheRegion> region;
+		size_t run_end = block;
+		{
+			LOCK(_cache_lock);
+			while(run_end < end_block && !_cache_regions.contains(block_cache_region_start(run_end)))
+				run_end = min(block_cache_region_start(run_end) + blocks_per_cache_region(), end_block);
+			if(run_end == block)
+				region = _cache_regions.get(block_cache_region_start(block)).value();
+		}
+
+		if(!region) {
+			auto res = read_uncached_blocks(block, run_end - block, buffer + (block - first_block) * block_size());
+			if(res.is_error())
+				return res;
+			block = run_end;
+			continue;
+		}
+
+		// Cached blocks may be newer than what's on the disk, so they have to be copied from the cache
+		size_t region_end = region->start_block + region->num_blocks();
+		size_t num_blocks = min(region_end, end_block) - block;
+		{
+			LOCK(region->lock);
+			region->last_used = Time::now();
+			memcpy(buffer + (block - first_block) * block_size(), region->block_data(block), num_blocks * block_size());
+		}
+
+		// Drop the region if we read all of it and it's clean. Its lock is only tried since the usual order is the
+		// other way around.
+		if(region->start_block >= first_block && region_end <= end_block) {
+			LOCK(_cache_lock);
+			if(region->lock.try_acquire()) {
+				if(!region->dirty && _cache_regions.contains(region->start_block)) {
+					_cache_regions.erase(region->start_block);
+					s_used_cache_memory -= PAGE_SIZE;
+				}
+				region->lock.release();
+			}
+		}
+		block += num_blocks;
+	}
+
+	return Result(SUCCESS);
 }
 
 size_t DiskDevice::used_cache_memory() {
 	return s_used_cache_memory;
 }
 
+size_t DiskDevice::dirty_cache_memory() {
+	return s_dirty_regions.load() * PAGE_SIZE;
+}
+
+kstd::LRUCacheStats DiskDevice::cache_stats() {
+	kstd::LRUCacheStats stats;
+	LOCK(s_disk_devices_lock);
+	for(size_t i = 0; i < s_disk_devices.size(); i++) {
+		LOCK_N(s_disk_devices[i]->_cache_lock, device_lock);
+		stats += s_disk_devices[i]->_cache_regions.stats();
+	}
+	return stats;
+}
+
+Result DiskDevice::sync_all() {
+	flush_all(false);
+	return Result(SUCCESS);
+}
+
+void DiskDevice::flush_all(bool expired_only) {
+	// Don't hold the device lock while flushing, since that would block anything trying to free cache memory
+	kstd::vector<DiskDevice*> devices;
+	{
+		LOCK(s_disk_devices_lock);
+		devices = s_disk_devices;
+	}
+
+	for(size_t i = 0; i < devices.size(); i++) {
+		auto res = devices[i]->flush(expired_only);
+		if(res.is_error())
+			KLog::err("DiskDevice", "Error %d flushing disk %d,%d!", res.code(), devices[i]->major(), devices[i]->minor());
+	}
+}
+
+Result DiskDevice::flush(bool expired_only) {
+	LOCK(_flush_lock);
+
+	// Take the regions to write out of the dirty list. They're kept in order of their start block.
+	kstd::vector<kstd::Arc<BlockCacheRegion>> regions;
+	{
+		LOCK(_dirty_lock);
+		if(_dirty_regions.empty())
+			return Result(SUCCESS);
+		auto expire_time = Time::now() - Time(BLOCK_CACHE_DIRTY_EXPIRE_SECS, 0);
+		for(auto& entry : _dirty_regions) {
+			if(!expired_only || entry.second->dirty_since <= expire_time)
+				regions.push_back(entry.second);
+		}
+		for(size_t i = 0; i < regions.size(); i++)
+			_dirty_regions.erase(regions[i]->start_block);
+	}
+
+	if(regions.empty())
+		return Result(SUCCESS);
+
+	Result result = Result(SUCCESS);
+	size_t i = 0;
+	while(i < regions.size()) {
+		// Write a run of regions with contiguous blocks straight from their pages with one request. They stay locked
+		// until it's done so that nothing changes them while they're being written.
+		size_t run_start = i;
+		DiskRequest request(DiskRequest::WRITE, regions[i]->start_block, 0);
+		Result res = Result(SUCCESS);
+		while(i < regions.size() && i - run_start < BLOCK_CACHE_MAX_WRITE_REGIONS && regions[i]->start_block == request.block + request.count) {
+			auto& region = regions[i];
+			region->lock.acquire();
+			if(region->dirty) {
+				region->dirty = false;
+				s_dirty_regions.sub(1);
+			}
+			if(!res.is_error())
+				res = request.add_buffer((uint8_t*) region->region->start(), PAGE_SIZE);
+			request.count += region->num_blocks();
+			i++;
+		}
+
+		if(!res.is_error())
+			res = perform(request);
+		for(size_t j = run_start; j < i; j++) {
+			// Put the regions back on the dirty list if the write failed so that they'll be retried later
+			if(res.is_error())
+				mark_dirty(regions[j]);
+			regions[j]->lock.release();
+		}
+		if(res.is_error())
+			result = res;
+	}
+
+	return result;
+}
+
+Result DiskDevice::flush_region(const kstd::Arc<BlockCacheRegion>& region) {
+	LOCK(region->lock);
+	if(!region->dirty)
+		return Result(SUCCESS);
+	region->dirty = false;
+	s_dirty_regions.sub(1);
+	{
+		LOCK(_dirty_lock);
+		_dirty_regions.erase(region->start_block);
+	}
+	return write_uncached_blocks(region->start_block, region->num_blocks(), (uint8_t*) region->region->start());
+}
+
+Result DiskDevice::populate_cache(size_t block, size_t count) {
+	Result result = Result(SUCCESS);
+	size_t region_start = block_cache_region_start(block);
+	size_t end_block = block + count;
+	while(region_start < end_block) {
+		// Make (and lock) cache regions for a run of blocks that aren't cached yet. Anything that tries to use them
+		// before we're done reading will wait on their locks.
+		kstd::vector<kstd::Arc<BlockCacheRegion>> regions;
+		{
+			LOCK(_cache_lock);
+			while(region_start < end_block && _cache_regions.contains(region_start))
+				region_start += blocks_per_cache_region();
+			while(region_start < end_block && regions.size() < BLOCK_CACHE_MAX_READ_REGIONS && !_cache_regions.contains(region_start)) {
+				auto reg = kstd::Arc<BlockCacheRegion>::make(region_start, block_size());
+				s_used_cache_memory += PAGE_SIZE;
+				reg->lock.acquire();
+				_cache_regions.insert(region_start, reg);
+				regions.push_back(reg);
+				region_start += blocks_per_cache_region();
+			}
+		}
+
+		if(regions.empty())
+			break;
+
+		// Read the whole run straight into the regions' pages at once, falling back to reading each region by itself if
+		// that doesn't work out
+		DiskRequest request(DiskRequest::READ, regions[0]->start_block, regions.size() * blocks_per_cache_region());
+		Result res = Result(SUCCESS);
+		for(size_t i = 0; i < regions.size() && !res.is_error(); i++)
+			res = request.add_buffer((uint8_t*) regions[i]->region->start(), PAGE_SIZE);
+		if(!res.is_error())
+			res = perform(request);
+		if(res.is_error())
+			result = res;
+		for(size_t i = 0; i < regions.size(); i++) {
+			auto& region = regions[i];
+			if(res.is_error())
+				read_uncached_blocks(region->start_block, blocks_per_cache_region(), (uint8_t*) region->region->start());
+			region->lock.release();
+		}
+	}
+
+	return result;
+}
+
+bool DiskDevice::uses_request_queue() {
+	return false;
+}
+
+size_t DiskDevice::max_request_blocks() {
+	return PAGE_SIZE / block_size();
+}
+
+void DiskDevice::start_request(DiskRequest& request, size_t count) {
+	complete_request(Result(-EIO));
+}
+
+void DiskDevice::complete_request(Result result) {
+	auto* request = _active_request;
+	_active_request = nullptr;
+	while(request) {
+		// The waiting thread may free the request as soon as it's marked ready
+		auto* next = request->next;
+		request->next = nullptr;
+		request->result = result;
+		request->blocker.set_ready(true);
+		request = next;
+	}
+	dispatch_request();
+}
+
+Result DiskDevice::transfer(DiskRequest::Direction direction, size_t block, size_t count, uint8_t* buffer) {
+	DiskRequest request(direction, block, count);
+	auto res = request.add_buffer(buffer, count * block_size());
+	if(res.is_error())
+		return res;
+	return perform(request);
+}
+
+Result DiskDevice::perform(DiskRequest& request) {
+	if(!request.count)
+		return Result(SUCCESS);
+
+	if(!uses_request_queue()) {
+		size_t block = request.block;
+		for(size_t i = 0; i < request.segments.size(); i++) {
+			auto& segment = request.segments[i];
+			size_t count = segment.size / block_size();
+			auto res = request.direction == DiskRequest::READ
+					? read_uncached_blocks(block, count, segment.buffer)
+					: write_uncached_blocks(block, count, segment.buffer);
+			if(res.is_error())
+				return res;
+			block += count;
+		}
+		return Result(SUCCESS);
+	}
+
+	// Split the request into pieces that the device can handle with one command each
+	kstd::vector<kstd::Arc<DiskRequest>> split;
+	kstd::vector<DiskRequest*> pieces;
+	if(request.count <= max_request_blocks()) {
+		pieces.push_back(&request);
+	} else {
+		size_t max_bytes = max_request_blocks() * block_size();
+		size_t block = request.block;
+		size_t piece_bytes = max_bytes;
+		for(size_t i = 0; i < request.segments.size(); i++) {
+			auto segment = request.segments[i];
+			while(segment.size) {
+				if(piece_bytes == max_bytes) {
+					split.push_back(kstd::Arc<DiskRequest>::make(request.direction, block, max_request_blocks()));
+					block += max_request_blocks();
+					piece_bytes = 0;
+				}
+				size_t size = min(segment.size, max_bytes - piece_bytes);
+				split[split.size() - 1]->segments.push_back({segment.buffer, segment.paddr, size});
+				segment.buffer += size;
+				segment.paddr += size;
+				segment.size -= size;
+				piece_bytes += size;
+			}
+		}
+		split[split.size() - 1]->count = piece_bytes / block_size();
+		for(size_t i = 0; i < split.size(); i++)
+			pieces.push_back(split[i].get());
+	}
+
+	{
+		TaskManager::ScopedCritical critical;
+		for(size_t i = 0; i < pieces.size(); i++)
+			enqueue_request(*pieces[i]);
+		if(!_active_request)
+			dispatch_request();
+	}
+
+	Result result = Result(SUCCESS);
+	for(size_t i = 0; i < pieces.size(); i++) {
+		TaskManager::current_thread()->block(pieces[i]->blocker);
+		if(pieces[i]->result.is_error())
+			result = pieces[i]->result;
+	}
+	return result;
+}
+
+void DiskDevice::enqueue_request(DiskRequest& request) {
+	// Requests are kept in the order the head will reach them while sweeping towards higher blocks: first the ones
+	// at or after the end of the last command, then the ones before it starting over from the lowest block (C-LOOK).
+	// Requests for the same block stay in the order they were submitted.
+	auto sweep = [&](DiskRequest* req) {
+		return req->block >= _queue_position ? 0 : 1;
+	};
+	DiskRequest** link = &_request_queue;
+	while(*link) {
+		auto* other = *link;
+		if(sweep(other) > sweep(&request) || (sweep(other) == sweep(&request) && other->block > request.block))
+			break;
+		link = &other->next;
+	}
+	request.next = *link;
+	*link = &request;
+}
+
+void DiskDevice::dispatch_request() {
+	auto* request = _request_queue;
+	if(!request || _active_request)
+		return;
+
+	// Merge the requests that continue where this one leaves off into the same command
+	_request_queue = request->next;
+	auto* last = request;
+	size_t count = request->count;
+	while(_request_queue) {
+		auto* next = _request_queue;
+		if(next->direction != request->direction || next->block != request->block + count || count + next->count > max_request_blocks())
+			break;
+		_request_queue = next->next;
+		last->next = next;
+		last = next;
+		count += next->count;
+	}
+	last->next = nullptr;
+
+	_active_request = request;
+	_queue_position = request->block + count;
+	start_request(*request, count);
+}
+
+size_t DiskDevice::mark_dirty(const kstd::Arc<BlockCacheRegion>& region) {
+	LOCK(_dirty_lock);
+	if(!region->dirty) {
+		region->dirty = true;
+		region->dirty_since = Time::now();
+		s_dirty_regions.add(1);
+		_dirty_regions.insert({region->start_block, region});
+	}
+	return _dirty_regions.size();
+}
+
 size_t DiskDevice::free_pages(size_t num_pages) {
 	size_t num_freed = 0;
 	LOCK(s_disk_devices_lock);
@@ -98,12 +605,19 @@ size_t DiskDevice::free_pages(size_t num_pages) {
 			}
 		}
 
+		// The page caches of inodes share the LRU with the block caches, so free a page from them if one is older
+		if(InodeVMObject::lru_time() < lru_time && InodeVMObject::free_lru_page()) {
+			num_freed++;
+			continue;
+		}
+
 		if(!lru_region)
 			break;
 
 		// Flush it if necessary
-		if(lru_region->dirty)
-			lru_device->write_uncached_blocks(lru_region->start_block, lru_region->num_blocks(), (uint8_t*) lru_region->region->start());
+		auto res = lru_device->flush_region(lru_region);
+		if(res.is_error())
+			KLog::err("DiskDevice", "Error %d flushing evicted cache region!", res.code());
 
 		// Free it
 		num_freed += lru_region->region->size() / PAGE_SIZE;
@@ -150,3 +664,25 @@ DiskDevice::BlockCacheRegion::BlockCacheRegion(size_t start_block, size_t block_
 		region(MemoryManager::inst().alloc_kernel_region(PAGE_SIZE)), block_size(block_size), start_block(start_block) {}
 
 DiskDevice::BlockCacheRegion::~BlockCacheRegion() = default;
+
+Result DiskRequest::add_buffer(uint8_t* buffer, size_t size) {
+	while(size) {
+		auto paddr = MM.kernel_page_directory.get_physaddr(buffer);
+		if(paddr == (size_t) -1)
+			return Result(-EFAULT);
+		size_t chunk = min(size, PAGE_SIZE - ((size_t) buffer % PAGE_SIZE));
+		if(!segments.empty()) {
+			auto& last = segments[segments.size() - 1];
+			if(last.paddr + last.size == paddr && last.buffer + last.size == buffer) {
+				last.size += chunk;
+				buffer += chunk;
+				size -= chunk;
+				continue;
+			}
+		}
+		segments.push_back({buffer, paddr, chunk});
+		buffer += chunk;
+		size -= chunk;
+	}
+	return Result(SUCCESS);
+}
@@ -21,8 +21,66 @@
 
 #include <kernel/time/Time.h>
 #include <kernel/memory/MemoryManager.h>
+#include <kernel/tasking/BooleanBlocker.h>
 #include "BlockDevice.h"
 #include "../kstd/LRUCache.h"
+#include "../kstd/map.hpp"
+
+// How long a cache region can be dirty before the flusher writes it back to the disk
+#define BLOCK_CACHE_DIRTY_EXPIRE_SECS 5
+// How often the flusher checks for expired dirty cache regions
+#define BLOCK_CACHE_FLUSH_INTERVAL_SECS 1
+// How many dirty cache regions a single disk can have before the flusher is woken up to write them all back
+#define BLOCK_CACHE_DIRTY_HIGH_WATER 256
+// The largest number of contiguous cache regions that will be written to the disk with a single write
+#define BLOCK_CACHE_MAX_WRITE_REGIONS 16
+// The largest number of contiguous cache regions that will be read from the disk with a single read when prefetching
+#define BLOCK_CACHE_MAX_READ_REGIONS 64
+// How many prefetch requests can be waiting for the readahead thread before new ones are dropped
+#define BLOCK_CACHE_MAX_QUEUED_PREFETCHES 32
+
+void kflusher_entry();
+void kreadahead_entry();
+
+/**
+ * A request to transfer a run of contiguous blocks between a disk and memory. The memory is kept as a list of
+ * physically contiguous segments, so that devices can DMA straight into it and so that requests for adjacent blocks can
+ * be merged into a single command by the request queue.
+ */
+class DiskRequest {
+public:
+	enum Direction { READ, WRITE };
+
+	struct Segment {
+		uint8_t* buffer;
+		PhysicalAddress paddr;
+		size_t size;
+	};
+
+	DiskRequest(Direction direction, size_t block, size_t count): direction(direction), block(block), count(count) {}
+
+	/**
+	 * Adds a piece of kernel memory to the end of the request, merging it with the last segment if they're physically
+	 * contiguous.
+	 * @param buffer The memory to add. It must be mapped and stay mapped until the request is done.
+	 * @param size The size of the memory in bytes.
+	 */
+	Result add_buffer(uint8_t* buffer, size_t size);
+
+	/** The next request merged into the same command as this one, if any. **/
+	DiskRequest* merged_next() const { return next; }
+
+	Direction direction;
+	size_t block;
+	size_t count;
+	kstd::vector<Segment> segments;
+	Result result = Result(SUCCESS);
+	UninterruptibleBooleanBlocker blocker;
+
+private:
+	friend class DiskDevice;
+	DiskRequest* next = nullptr; ///< The next request in the queue, or the next one in the same command once dispatched.
+};
 
 class DiskDevice: public BlockDevice {
 public:
@@ -35,11 +93,58 @@ public:
 	virtual Result read_uncached_blocks(uint32_t block, uint32_t count, uint8_t *buffer) = 0;
 	virtual Result write_uncached_blocks(uint32_t block, uint32_t count, const uint8_t *buffer) = 0;
 
+	/** Writes all of the dirty cached blocks of this disk back to it. **/
+	Result sync() override;
+	/** Queues the blocks in a byte range of the disk to be read into the cache by the readahead thread. **/
+	void prefetch(size_t offset, size_t count) override;
+	/**
+	 * Reads blocks straight from the disk into a buffer, except for ones that are already cached. Regions of the
+	 * cache that the read completely covers are dropped afterwards if they're clean, since whatever is reading them
+	 * is going to cache the data itself.
+	 */
+	Result read_direct(FileDescriptor& fd, size_t offset, size_t count, uint8_t* buffer) override;
+
 	static size_t used_cache_memory();
+	static size_t dirty_cache_memory();
+	/** Returns the combined statistics of the block caches of every disk. **/
+	static kstd::LRUCacheStats cache_stats();
 	/** Tries to free a number of pages from the cache. Returns the number of pages that could be freed. **/
 	static size_t free_pages(size_t num_pages);
+	/** Writes all of the dirty cached blocks of every disk back to them. **/
+	static Result sync_all();
+
+protected:
+	/** Whether transfers to this device go through the request queue and start_request(). **/
+	virtual bool uses_request_queue();
+	/** The largest number of blocks that will be given to start_request() at once. **/
+	virtual size_t max_request_blocks();
+	/**
+	 * Starts a command made of one or more merged requests. This is called in a critical section, often from the
+	 * device's interrupt handler when the last command completes, so it must not block. Once the command is done, the
+	 * device must call complete_request().
+	 * @param request The first request in the command. The others follow it through DiskRequest::merged_next(), and
+	 *                together they cover a contiguous run of blocks starting at request.block.
+	 * @param count The total number of blocks in the command.
+	 */
+	virtual void start_request(DiskRequest& request, size_t count);
+	/**
+	 * Wakes up everything waiting on the requests in the active command and starts the next one. Must be called in a
+	 * critical section, usually from the device's interrupt handler.
+	 */
+	void complete_request(Result result);
+	/** Transfers blocks to or from a kernel buffer through the request queue and waits for it to finish. **/
+	Result transfer(DiskRequest::Direction direction, size_t block, size_t count, uint8_t* buffer);
+	/**
+	 * Performs a request and waits for it to finish. It's split into pieces no larger than max_request_blocks() which
+	 * are all queued at once. If the device doesn't use the request queue, each segment is transferred with
+	 * read_uncached_blocks() or write_uncached_blocks() instead, so segments must be a multiple of the block size.
+	 */
+	Result perform(DiskRequest& request);
 
 private:
+	friend void kflusher_entry();
+	friend void kreadahead_entry();
+
 	class BlockCacheRegion {
 	public:
 		explicit BlockCacheRegion(size_t start_block, size_t block_size);
@@ -53,13 +158,33 @@ private:
 		size_t block_size;
 		size_t start_block;
 		Time last_used = Time::now();
+		Time dirty_since;
 		bool dirty = false;
 		SpinLock lock;
 	};
 
+	/**
+	 * Writes dirty cache regions back to the disk, coalescing regions with contiguous blocks into single writes.
+	 * @param expired_only If true, only regions that have been dirty for longer than BLOCK_CACHE_DIRTY_EXPIRE_SECS will
+	 *                     be written.
+	 */
+	Result flush(bool expired_only);
+	/** Writes a single cache region back to the disk if it's dirty. Used when evicting it from the cache. **/
+	Result flush_region(const kstd::Arc<BlockCacheRegion>& region);
+	/** Marks a cache region as dirty. Its lock must be held. Returns the number of dirty regions on this disk. **/
+	size_t mark_dirty(const kstd::Arc<BlockCacheRegion>& region);
+	static void flush_all(bool expired_only);
+	/** Reads any of the given blocks that aren't cached into the cache, using as few reads as possible. **/
+	Result populate_cache(size_t block, size_t count);
+	/** Inserts a request into the queue in elevator order. Must be called in a critical section. **/
+	void enqueue_request(DiskRequest& request);
+	/** Starts the next command from the queue, merging adjacent requests into it. Must be called in a critical section. **/
+	void dispatch_request();
+
 	// Static
 	static SpinLock s_disk_devices_lock;
 	static size_t s_used_cache_memory;
+	static Atomic<size_t> s_dirty_regions;
 	static kstd::vector<DiskDevice*> s_disk_devices;
 
 	kstd::LRUCache<size_t, kstd::Arc<BlockCacheRegion>> _cache_regions;
@@ -67,5 +192,18 @@ private:
 	inline size_t blocks_per_cache_region() { return PAGE_SIZE / block_size(); }
 	inline size_t block_cache_region_start(size_t block) { return block - (block % blocks_per_cache_region()); }
 	SpinLock _cache_lock;
+
+	// Dirty cache regions keyed by their start block, so that runs of contiguous regions can be found for flushing.
+	// When both are needed, a region's lock must be acquired before _dirty_lock.
+	kstd::map<size_t, kstd::Arc<BlockCacheRegion>> _dirty_regions;
+	SpinLock _dirty_lock;
+	// Serializes flushes of this disk
+	SpinLock _flush_lock;
+
+	// Requests waiting to be started, in the order the disk head will reach them, and the command in progress. These
+	// are touched from interrupt handlers, so they're only accessed in critical sections.
+	DiskRequest* _request_queue = nullptr;
+	DiskRequest* _active_request = nullptr;
+	size_t _queue_position = 0; ///< The block after the end of the last command started.
 };
 
@@ -136,4 +136,5 @@ void KeyboardDevice::set_key_state(uint8_t scancode, bool pressed) {
 	if(_event_buffer.size() == _event_buffer.capacity())
 		_event_buffer.pop_front();
 	_event_buffer.push_back(event);
+	poll_queue().wake_all();
 }
\ No newline at end of file
@@ -138,6 +138,7 @@ void MouseDevice::handle_vmware_bytes() {
 			event_buffer.pop_front();
 		event_buffer.push_back(VMWare::inst().read_mouse_event());
 	}
+	poll_queue().wake_all();
 }
 
 bool MouseDevice::can_read(const FileDescriptor& fd) {
@@ -174,4 +175,5 @@ void MouseDevice::handle_packet() {
 	if(event_buffer.size() == event_buffer.capacity())
 		event_buffer.pop_front();
 	event_buffer.push_back({x, y, z, (uint8_t) (packet_data[0] & 0x7u), false});
+	poll_queue().wake_all();
 }
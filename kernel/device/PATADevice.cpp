@@ -102,9 +102,8 @@ PATADevice::PATADevice(PCI::Address addr, PATADevice::Channel channel, PATADevic
 	PCI::enable_interrupt(addr);
 	if(!use_pio) {
 		PCI::enable_bus_mastering(addr);
-		_prdt_region = MM.alloc_kernel_region(sizeof(PRDT));
+		_prdt_region = MM.alloc_kernel_region(ATA_MAX_PRDT_ENTRIES * sizeof(PRDT));
 		_prdt = (PRDT*) _prdt_region->start();
-		_dma_region = MM.alloc_dma_region(ATA_MAX_SECTORS_AT_ONCE * 512);
 
 		//Reset bus master status register
 		IO::outb(_bus_master_base + ATA_BM_STATUS, IO::inb(_bus_master_base + ATA_BM_STATUS) | 0x4u);
@@ -127,94 +126,46 @@ void PATADevice::wait_ready() {
 		status = IO::inb(_control_base);
 }
 
-Result PATADevice::read_sectors_dma(size_t lba, uint8_t num_sectors, uint8_t *buf) {
-	ASSERT(num_sectors <= ATA_MAX_SECTORS_AT_ONCE);
-	LOCK(_lock);
-
-	if(num_sectors * 512 > _dma_region->object()->physical_page(0).paddr())
-		return Result(-EINVAL);
-	_prdt->addr = _dma_region->object()->physical_page(0).paddr();
-	_prdt->size = num_sectors * 512;
-	_prdt->eot = 0x8000;
-
-	//Select drive and wait 10us
-	IO::outb(_io_base + ATA_DRIVESEL, 0xA0u | (_drive == SLAVE ? 0x8u : 0x0u));
-	IO::wait(10);
-
-	//Stop bus master, write PRDT, clear flags, and set direction to read
-	IO::outb(_bus_master_base, 0);
-	IO::outl(_bus_master_base + ATA_BM_PRDT, _prdt_region->object()->physical_page(0).paddr());
-	IO::outb(_bus_master_base, ATA_BM_READ);
-	IO::outb(_bus_master_base + ATA_BM_STATUS, IO::inb(_bus_master_base + ATA_BM_STATUS) | 0x6u);
-
-	//Access the drive
-	access_drive(ATA_READ_DMA, lba, num_sectors);
-
-	//Wait for DRQ bit and start bus master
-	while(!(IO::inb(_control_base) & ATA_STATUS_DRQ));
-	IO::outb(_bus_master_base, 0x9);
-
-	//Wait for irq
-	TaskManager::current_thread()->block(_blocker);
-	_blocker.set_ready(false);
-	uninstall_irq();
-
-	if(_post_irq_status & ATA_STATUS_ERR) {
-		KLog::err("PATA", "DMA read fail with status 0x%x and busmaster status 0x%x", _post_irq_status, _post_irq_bm_status);
-		return Result(-EIO);
+void PATADevice::start_request(DiskRequest& request, size_t count) {
+	ASSERT(count <= ATA_MAX_SECTORS_AT_ONCE);
+	bool write = request.direction == DiskRequest::WRITE;
+
+	//Fill out the PRDT with the segments of every request in the command, splitting them at 64KiB boundaries
+	size_t num_entries = 0;
+	for(auto* req = &request; req; req = req->merged_next()) {
+		for(size_t i = 0; i < req->segments.size(); i++) {
+			PhysicalAddress paddr = req->segments[i].paddr;
+			size_t size_left = req->segments[i].size;
+			while(size_left) {
+				ASSERT(num_entries < ATA_MAX_PRDT_ENTRIES);
+				size_t size = min(size_left, 0x10000 - (paddr & 0xFFFFu));
+				_prdt[num_entries].addr = paddr;
+				_prdt[num_entries].size = size & 0xFFFFu; //0 means 64KiB
+				_prdt[num_entries].eot = 0;
+				num_entries++;
+				paddr += size;
+				size_left -= size;
+			}
+		}
 	}
-
-	//Copy to buffer
-	memcpy((void *) buf, (void*) _dma_region->start(), 512 * num_sectors);
-
-	//Tell bus master we're done
-	IO::outb(_bus_master_base + ATA_BM_STATUS, IO::inb(_bus_master_base + ATA_BM_STATUS) | 0x6u);
-
-	return Result(SUCCESS);
-}
-
-Result PATADevice::write_sectors_dma(size_t lba, uint8_t num_sectors, const uint8_t *buf) {
-	ASSERT(num_sectors <= ATA_MAX_SECTORS_AT_ONCE);
-	LOCK(_lock);
-
-	if(num_sectors * 512 > _dma_region->size())
-		return Result(-EINVAL);
-	_prdt->addr = _dma_region->object()->physical_page(0).paddr();
-	_prdt->size = num_sectors * 512;
-	_prdt->eot = 0x8000;
-
-	//Copy to buffer
-	memcpy((void*) _dma_region->start(), buf, 512 * num_sectors);
+	_prdt[num_entries - 1].eot = 0x8000;
 
 	//Select drive and wait 10us
 	IO::outb(_io_base + ATA_DRIVESEL, 0xA0u | (_drive == SLAVE ? 0x8u : 0x0u));
 	IO::wait(10);
 
-	//Stop bus master, write PRDT, and clear flags
+	//Stop bus master, write PRDT, clear flags, and set direction
 	IO::outb(_bus_master_base, 0);
 	IO::outl(_bus_master_base + ATA_BM_PRDT, _prdt_region->object()->physical_page(0).paddr());
+	IO::outb(_bus_master_base, write ? 0 : ATA_BM_READ);
 	IO::outb(_bus_master_base + ATA_BM_STATUS, IO::inb(_bus_master_base + ATA_BM_STATUS) | 0x6u);
 
-	access_drive(ATA_WRITE_DMA, lba, num_sectors);
-
-	//Wait for DRQ / not busy and start bus master
-	while(IO::inb(_control_base) & ATA_STATUS_BSY || !(IO::inb(_control_base) & ATA_STATUS_DRQ));
-	IO::outb(_bus_master_base, 0x1);
-
-	//Wait for irq
-	TaskManager::current_thread()->block(_blocker);
-	_blocker.set_ready(false);
-	uninstall_irq();
-
-	if(_post_irq_status & ATA_STATUS_ERR) {
-		KLog::err("PATA", "DMA write fail with status 0x%x and busmaster status 0x%x", _post_irq_status, _post_irq_bm_status);
-		return Result(-EIO);
-	}
-
-	//Tell bus master we're done
-	IO::outb(_bus_master_base + ATA_BM_STATUS, IO::inb(_bus_master_base + ATA_BM_STATUS) | 0x6u);
+	//Access the drive
+	access_drive(write ? ATA_WRITE_DMA : ATA_READ_DMA, request.block, count);
 
-	return Result(SUCCESS);
+	//Start the bus master. It waits for the drive to request the data by itself, so we don't need to poll for DRQ (which
+	//would spin in the IRQ handler when it starts the next request). The IRQ handler will complete the request.
+	IO::outb(_bus_master_base, write ? 0x1 : 0x9);
 }
 
 void PATADevice::write_sectors_pio(uint32_t sector, uint8_t sectors, const uint8_t *buffer) {
@@ -255,7 +206,7 @@ void PATADevice::read_sectors_pio(uint32_t sector, uint8_t sectors, uint8_t *buf
 	uninstall_irq();
 }
 
-void PATADevice::access_drive(uint8_t command, uint32_t lba, uint8_t num_sectors) {
+void PATADevice::access_drive(uint8_t command, uint32_t lba, uint16_t num_sectors) {
 	TaskManager::enter_critical();
 
 	//TODO: Support 48-bit LBA
@@ -266,7 +217,7 @@ void PATADevice::access_drive(uint8_t command, uint32_t lba, uint8_t num_sectors
 	IO::wait(20);
 
 	//Set count and lba
-	IO::outb(_io_base + ATA_SECCNT0, num_sectors);
+	IO::outb(_io_base + ATA_SECCNT0, num_sectors & 0xFFu);
 	IO::outb(_io_base + ATA_LBA0, (lba & 0xFFu));
 	IO::outb(_io_base + ATA_LBA1, (lba & 0xFF00u) >> 8u);
 	IO::outb(_io_base + ATA_LBA2, (lba & 0xFF0000u) >> 16u);
@@ -282,14 +233,7 @@ void PATADevice::access_drive(uint8_t command, uint32_t lba, uint8_t num_sectors
 Result PATADevice::read_uncached_blocks(uint32_t block, uint32_t count, uint8_t *buffer) {
 	if(!_use_pio) {
 		//DMA mode
-		size_t num_chunks = (count + ATA_MAX_SECTORS_AT_ONCE - 1) / ATA_MAX_SECTORS_AT_ONCE;
-		for (size_t i = 0; i < num_chunks; i++) {
-			uint32_t num_sectors = min((size_t) ATA_MAX_SECTORS_AT_ONCE, count);
-			Result res = read_sectors_dma(block + i * ATA_MAX_SECTORS_AT_ONCE, num_sectors, buffer + (512 * i * ATA_MAX_SECTORS_AT_ONCE));
-			if (res.is_error()) return res;
-			count -= num_sectors;
-		}
-		return Result(SUCCESS);
+		return transfer(DiskRequest::READ, block, count, buffer);
 	} else {
 		//PIO mode
 		while(count) {
@@ -305,15 +249,7 @@ Result PATADevice::read_uncached_blocks(uint32_t block, uint32_t count, uint8_t
 Result PATADevice::write_uncached_blocks(uint32_t block, uint32_t count, const uint8_t *buffer) {
 	if(!_use_pio) {
 		//DMA mode
-		size_t num_chunks = (count + ATA_MAX_SECTORS_AT_ONCE - 1) / ATA_MAX_SECTORS_AT_ONCE;
-		for (size_t i = 0; i < num_chunks; i++) {
-			uint32_t num_sectors = min((size_t) ATA_MAX_SECTORS_AT_ONCE, count);
-			Result res = write_sectors_dma(block + i * ATA_MAX_SECTORS_AT_ONCE, num_sectors, buffer + (512 * i * ATA_MAX_SECTORS_AT_ONCE));
-			if(res.is_error())
-				return res;
-			count -= num_sectors;
-		}
-		return Result(SUCCESS);
+		return transfer(DiskRequest::WRITE, block, count, (uint8_t*) buffer);
 	} else {
 		//PIO mode
 		while(count) {
@@ -330,6 +266,14 @@ size_t PATADevice::block_size() {
 	return 512;
 }
 
+bool PATADevice::uses_request_queue() {
+	return !_use_pio;
+}
+
+size_t PATADevice::max_request_blocks() {
+	return ATA_MAX_SECTORS_AT_ONCE;
+}
+
 ssize_t PATADevice::read(FileDescriptor &fd, size_t offset, SafePointer<uint8_t> buffer, size_t count) {
 	size_t first_block = offset / block_size();
 	size_t first_block_start = offset % block_size();
@@ -425,7 +369,22 @@ void PATADevice::handle_irq(Registers *regs) {
 	_post_irq_bm_status = IO::inb(_bus_master_base + ATA_BM_STATUS);
 	if(!(_post_irq_bm_status & 0x4u))
 		return; //Interrupt wasn't for this
-	IO::outb(_bus_master_base + ATA_BM_STATUS, IO::inb(_bus_master_base + ATA_BM_STATUS) | 0x4u);
-	_blocker.set_ready(true);
+	if(_use_pio) {
+		IO::outb(_bus_master_base + ATA_BM_STATUS, IO::inb(_bus_master_base + ATA_BM_STATUS) | 0x4u);
+		_blocker.set_ready(true);
+		TaskManager::yield_if_idle();
+		return;
+	}
+
+	//Stop the bus master, tell it we're done, and complete the request (which will start the next one, if any)
+	IO::outb(_bus_master_base, 0);
+	IO::outb(_bus_master_base + ATA_BM_STATUS, _post_irq_bm_status | 0x6u);
+	Result result = Result(SUCCESS);
+	if((_post_irq_status & ATA_STATUS_ERR) || (_post_irq_bm_status & 0x2u)) {
+		KLog::err("PATA", "DMA transfer fail with status 0x%x and busmaster status 0x%x", _post_irq_status, _post_irq_bm_status);
+		result = Result(-EIO);
+	}
+	uninstall_irq();
+	complete_request(result);
 	TaskManager::yield_if_idle();
 }
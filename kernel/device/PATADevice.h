@@ -28,7 +28,9 @@
 #include <kernel/tasking/SpinLock.h>
 #include <kernel/memory/MemoryManager.h>
 
-#define ATA_MAX_SECTORS_AT_ONCE (PAGE_SIZE / 512)
+// With 28-bit LBA, a sector count of zero means 256 sectors
+#define ATA_MAX_SECTORS_AT_ONCE 256
+#define ATA_MAX_PRDT_ENTRIES (PAGE_SIZE / sizeof(PRDT))
 
 class PATADevice: public IRQHandler, public DiskDevice {
 public:
@@ -41,11 +43,9 @@ public:
 	~PATADevice();
 	uint8_t wait_status(uint8_t flags = ATA_STATUS_BSY);
 	void wait_ready();
-	Result read_sectors_dma(uint32_t sector, uint8_t num_sectors, uint8_t* buf);
-	Result write_sectors_dma(uint32_t sector, uint8_t num_sectors, const uint8_t* buf);
 	void read_sectors_pio(uint32_t sector, uint8_t sectors, uint8_t *buffer);
 	void write_sectors_pio(uint32_t sector, uint8_t sectors, const uint8_t *buffer);
-	void access_drive(uint8_t command, uint32_t lba, uint8_t num_sectors);
+	void access_drive(uint8_t command, uint32_t lba, uint16_t num_sectors);
 
 
 	//BlockDevice
@@ -53,6 +53,11 @@ public:
 	Result write_uncached_blocks(uint32_t block, uint32_t count, const uint8_t *buffer) override;
 	size_t block_size() override;
 
+	//DiskDevice
+	bool uses_request_queue() override;
+	size_t max_request_blocks() override;
+	void start_request(DiskRequest& request, size_t count) override;
+
 	//File
 	ssize_t read(FileDescriptor& fd, size_t offset, SafePointer<uint8_t> buffer, size_t count) override;
 	ssize_t write(FileDescriptor& fd, size_t offset, SafePointer<uint8_t> buffer, size_t count) override;
@@ -78,7 +83,6 @@ private:
 
 	//DMA stuff
 	PRDT* _prdt = nullptr;
-	kstd::Arc<VMRegion> _dma_region;
 	kstd::Arc<VMRegion> _prdt_region;
 
 	//Interrupt stuff
@@ -41,6 +41,18 @@ ssize_t PartitionDevice::write(FileDescriptor& fd, size_t start, SafePointer<uin
 	return _parent->write(fd, start + _offset, buffer, count);
 }
 
+Result PartitionDevice::sync() {
+	return _parent->sync();
+}
+
+void PartitionDevice::prefetch(size_t offset, size_t count) {
+	_parent->prefetch(offset + _offset, count);
+}
+
+Result PartitionDevice::read_direct(FileDescriptor& fd, size_t offset, size_t count, uint8_t* buffer) {
+	return _parent->read_direct(fd, offset + _offset, count, buffer);
+}
+
 size_t PartitionDevice::block_size() {
 	return _parent->block_size();
 }
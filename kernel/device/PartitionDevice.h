@@ -28,6 +28,9 @@ public:
 	Result write_blocks(uint32_t block, uint32_t count, const uint8_t *buffer) override;
 	ssize_t read(FileDescriptor& fd, size_t offset, SafePointer<uint8_t> buffer, size_t count) override;
 	ssize_t write(FileDescriptor& fd, size_t offset, SafePointer<uint8_t> buffer, size_t count) override;
+	Result sync() override;
+	void prefetch(size_t offset, size_t count) override;
+	Result read_direct(FileDescriptor& fd, size_t offset, size_t count, uint8_t* buffer) override;
 	size_t block_size() override;
 	size_t part_offset();
 	kstd::Arc<File> parent();
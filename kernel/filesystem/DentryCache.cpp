@@ -0,0 +1,47 @@
+/* SPDX-License-Identifier: GPL-3.0-or-later */
+/* Copyright © 2016-2023 Byteduck */
+
+#include "DentryCache.h"
+#include "Inode.h"
+#include "Filesystem.h"
+#include <kernel/tasking/SpinLock.h>
+
+kstd::LRUCache<DentryCache::Key, ino_t, DentryCache::KeyHash> DentryCache::s_cache;
+uint32_t DentryCache::s_generation = 0;
+static SpinLock s_lock;
+
+kstd::Optional<ino_t> DentryCache::lookup(Inode& parent, const kstd::string& name) {
+	LOCK(s_lock);
+	return s_cache.get({parent.fs.fsid(), parent.id, name});
+}
+
+void DentryCache::insert(Inode& parent, const kstd::string& name, ino_t id, uint32_t generation) {
+	LOCK(s_lock);
+	if(generation != s_generation)
+		return;
+	if(s_cache.size() >= DENTRY_CACHE_SIZE)
+		s_cache.prune(1);
+	s_cache.insert({parent.fs.fsid(), parent.id, name}, id);
+}
+
+void DentryCache::invalidate(Inode& parent, const kstd::string& name) {
+	LOCK(s_lock);
+	s_generation++;
+	s_cache.erase({parent.fs.fsid(), parent.id, name});
+}
+
+void DentryCache::invalidate_all() {
+	LOCK(s_lock);
+	s_generation++;
+	s_cache.clear();
+}
+
+uint32_t DentryCache::generation() {
+	LOCK(s_lock);
+	return s_generation;
+}
+
+kstd::LRUCacheStats DentryCache::stats() {
+	LOCK(s_lock);
+	return s_cache.stats();
+}
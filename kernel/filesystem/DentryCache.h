@@ -0,0 +1,64 @@
+/* SPDX-License-Identifier: GPL-3.0-or-later */
+/* Copyright © 2016-2023 Byteduck */
+
+#pragma once
+
+#include <kernel/kstd/LRUCache.h>
+#include <kernel/kstd/string.h>
+#include <kernel/kstd/unix_types.h>
+
+#define DENTRY_CACHE_SIZE 1024
+
+class Inode;
+
+/**
+ * A global cache of directory lookups, mapping a name in a directory to the ID of the inode it refers to. Names that
+ * don't exist are cached too (as inode 0), so that repeatedly looking for something that isn't there (like a library in
+ * each of the search paths) doesn't have to scan the directory every time either.
+ *
+ * Only filesystems whose directories are only ever changed through the VFS use the cache (see
+ * Filesystem::dentries_cacheable), since the VFS is what invalidates entries when they change.
+ */
+class DentryCache {
+public:
+	/**
+	 * Looks up a name in a directory.
+	 * @return The ID of the inode the name refers to (or 0 if it's known not to exist), or nullopt if it isn't cached.
+	 */
+	static kstd::Optional<ino_t> lookup(Inode& parent, const kstd::string& name);
+
+	/**
+	 * Caches the result of a lookup.
+	 * @param generation The value of generation() from before the lookup was started. If anything has been invalidated
+	 * since then, the result may be stale and won't be cached.
+	 */
+	static void insert(Inode& parent, const kstd::string& name, ino_t id, uint32_t generation);
+
+	/** Forgets about a name in a directory. Should be called after the entry is created, removed, or changed. **/
+	static void invalidate(Inode& parent, const kstd::string& name);
+	/** Forgets about everything. **/
+	static void invalidate_all();
+
+	static uint32_t generation();
+	static kstd::LRUCacheStats stats();
+
+private:
+	struct Key {
+		uint8_t fsid;
+		ino_t parent;
+		kstd::string name;
+
+		bool operator==(const Key& other) const {
+			return fsid == other.fsid && parent == other.parent && name == other.name;
+		}
+	};
+
+	struct KeyHash {
+		size_t operator()(const Key& key) const {
+			return kstd::hash_int(((uint64_t) key.fsid << 56) ^ key.parent) ^ kstd::hash_bytes(key.name.c_str(), key.name.length());
+		}
+	};
+
+	static kstd::LRUCache<Key, ino_t, KeyHash> s_cache;
+	static uint32_t s_generation;
+};
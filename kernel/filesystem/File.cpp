@@ -85,3 +85,25 @@ bool File::can_write(const FileDescriptor& fd) {
 	return true;
 }
 
+Result File::sync() {
+	//Most files don't cache anything, so there's nothing to write back
+	return Result(SUCCESS);
+}
+
+void File::prefetch(size_t offset, size_t count) {
+
+}
+
+Result File::read_direct(FileDescriptor& fd, size_t offset, size_t count, uint8_t* buffer) {
+	ssize_t nread = read(fd, offset, KernelPointer<uint8_t>(buffer), count);
+	if(nread < 0)
+		return Result(nread);
+	if((size_t) nread != count)
+		return Result(-EIO);
+	return Result(SUCCESS);
+}
+
+WaitQueue& File::poll_queue() {
+	return m_poll_queue;
+}
+
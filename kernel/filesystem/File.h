@@ -22,6 +22,7 @@
 #include <kernel/kstd/Arc.h>
 #include <kernel/Result.hpp>
 #include <kernel/memory/SafePointer.h>
+#include <kernel/tasking/WaitQueue.h>
 
 class FileDescriptor;
 class DirectoryEntry;
@@ -42,8 +43,21 @@ public:
 	virtual void close(FileDescriptor& fd);
 	virtual bool can_read(const FileDescriptor& fd);
 	virtual bool can_write(const FileDescriptor& fd);
+	/// Writes any of the file's data that is cached in memory back to where it's stored. By default, this does nothing.
+	virtual Result sync();
+	/// Hints that a range of the file will be read soon, so that it can be read into memory in the background.
+	virtual void prefetch(size_t offset, size_t count);
+	/// Reads part of the file into a kernel buffer without keeping it in any cache of the file's own. By default, this
+	/// is the same as read().
+	virtual Result read_direct(FileDescriptor& fd, size_t offset, size_t count, uint8_t* buffer);
+
+	/// The queue that is woken up whenever the result of can_read() or can_write() may have changed.
+	virtual WaitQueue& poll_queue();
+
 protected:
 	File();
+
+	WaitQueue m_poll_queue;
 };
 
 
@@ -23,11 +23,23 @@
 #include "Inode.h"
 #include "FileDescriptor.h"
 
-FileBasedFilesystem::FileBasedFilesystem(const kstd::Arc<FileDescriptor>& file): _file(file) {
+kstd::vector<FileBasedFilesystem*> FileBasedFilesystem::s_filesystems;
+SpinLock FileBasedFilesystem::s_filesystems_lock;
 
+FileBasedFilesystem::FileBasedFilesystem(const kstd::Arc<FileDescriptor>& file): _file(file) {
+	LOCK(s_filesystems_lock);
+	s_filesystems.push_back(this);
 }
 
-FileBasedFilesystem::~FileBasedFilesystem() = default;
+FileBasedFilesystem::~FileBasedFilesystem() {
+	LOCK(s_filesystems_lock);
+	for(size_t i = 0; i < s_filesystems.size(); i++) {
+		if(s_filesystems[i] == this) {
+			s_filesystems.erase(i);
+			break;
+		}
+	}
+}
 
 Result FileBasedFilesystem::read_logical_block(size_t block, uint8_t *buffer) {
 	return read_logical_blocks(block, 1, buffer);
@@ -83,12 +95,20 @@ Result FileBasedFilesystem::read_blocks(size_t block, size_t count, uint8_t *buf
 	return Result(SUCCESS);
 }
 
+void FileBasedFilesystem::prefetch_blocks(size_t block, size_t count) {
+	_file->file()->prefetch(block * block_size(), count * block_size());
+}
+
+Result FileBasedFilesystem::read_blocks_direct(size_t block, size_t count, uint8_t* buffer) {
+	return _file->file()->read_direct(*_file, block * block_size(), count * block_size(), buffer);
+}
+
 Result FileBasedFilesystem::write_blocks(size_t block, size_t count, const uint8_t* buffer) {
-	Result res = Result(SUCCESS);
-	for(size_t i = 0; i < count; i++) {
-		res = write_block(block + i, buffer + i * block_size());
-		if(res.is_error()) return Result(res);
-	}
+	ssize_t nwrote = _file->file()->write(*_file, block * block_size(), KernelPointer<const uint8_t>(buffer), count * block_size());
+	if(nwrote < 0)
+		return Result(nwrote);
+	if(nwrote != count * block_size())
+		return Result(-EIO);
 	return Result(SUCCESS);
 }
 
@@ -116,6 +136,21 @@ Result FileBasedFilesystem::zero_block(size_t block) {
 	return Result(SUCCESS);
 }
 
+Result FileBasedFilesystem::zero_blocks(size_t block, size_t count) {
+	//Zero the blocks a chunk at a time so that a long run only takes a few writes, without a huge buffer
+	size_t chunk_blocks = min(count, max(ZERO_CHUNK_SIZE / block_size(), (size_t) 1));
+	kstd::vector<uint8_t> zero_buf(chunk_blocks * block_size(), 0);
+	while(count) {
+		size_t nblocks = min(count, chunk_blocks);
+		Result res = write_blocks(block, nblocks, zero_buf.storage());
+		if(res.is_error())
+			return res;
+		block += nblocks;
+		count -= nblocks;
+	}
+	return Result(SUCCESS);
+}
+
 Result FileBasedFilesystem::truncate_block(size_t block, size_t new_size) {
 	if(new_size >= block_size()) return Result(-EOVERFLOW);
 
@@ -153,6 +188,20 @@ void FileBasedFilesystem::remove_cached_inode(ino_t id) {
 	m_inode_cache.erase(id);
 }
 
+Result FileBasedFilesystem::sync() {
+	return _file->file()->sync();
+}
+
+kstd::LRUCacheStats FileBasedFilesystem::inode_cache_stats() {
+	kstd::LRUCacheStats stats;
+	LOCK(s_filesystems_lock);
+	for(size_t i = 0; i < s_filesystems.size(); i++) {
+		LOCK_N(s_filesystems[i]->m_inode_cache_lock, cache_lock);
+		stats += s_filesystems[i]->m_inode_cache.stats();
+	}
+	return stats;
+}
+
 Inode* FileBasedFilesystem::get_inode_rawptr(ino_t id) {
 	return nullptr;
 }
@@ -25,6 +25,9 @@
 #include <kernel/tasking/SpinLock.h>
 #include <kernel/kstd/vector.hpp>
 
+//The most data zero_blocks() will write at once
+#define ZERO_CHUNK_SIZE 65536
+
 class FileBasedFilesystem: public Filesystem {
 public:
 	explicit FileBasedFilesystem(const kstd::Arc<FileDescriptor>& file);
@@ -43,7 +46,13 @@ public:
 	Result write_block(size_t block, const uint8_t* buffer);
 	Result write_blocks(size_t block, size_t count, const uint8_t* buffer);
 	Result zero_block(size_t block);
+	/** Zeroes a run of blocks, writing as many of them at once as possible. **/
+	Result zero_blocks(size_t block, size_t count);
 	Result truncate_block(size_t block, size_t new_size);
+	/** Hints that a number of blocks will be read soon, so that they can be read into memory in the background. **/
+	void prefetch_blocks(size_t block, size_t count);
+	/** Reads blocks without keeping them in the disk's block cache. Used for data that's cached somewhere else. **/
+	Result read_blocks_direct(size_t block, size_t count, uint8_t* buffer);
 
 	ResultRet<kstd::Arc<Inode>> get_cached_inode(ino_t id);
 	void add_cached_inode(const kstd::Arc<Inode>& inode);
@@ -51,6 +60,10 @@ public:
 
 	virtual Inode* get_inode_rawptr(ino_t id);
 	virtual ResultRet<kstd::Arc<Inode>> get_inode(ino_t id);
+	Result sync() override;
+
+	/** Returns the combined statistics of the inode caches of every file-based filesystem. **/
+	static kstd::LRUCacheStats inode_cache_stats();
 
 protected:
 	void set_block_size(size_t block_size);
@@ -60,6 +73,9 @@ protected:
 	size_t _block_size;
 
 private:
+	static kstd::vector<FileBasedFilesystem*> s_filesystems;
+	static SpinLock s_filesystems_lock;
+
 	kstd::LRUCache<ino_t, kstd::Arc<Inode>> m_inode_cache;
 	SpinLock m_inode_cache_lock;
 };
@@ -29,6 +29,8 @@
 #include <kernel/terminal/PTYControllerDevice.h>
 #include <kernel/tasking/Process.h>
 
+SLAB_CACHE(FileDescriptor)
+
 FileDescriptor::FileDescriptor(const kstd::Arc<File>& file, Process* owner): _file(file), _owner(owner ? owner->pid() : -1) {
 	if(file->is_inode())
 		_inode = kstd::static_pointer_cast<InodeFile>(file)->inode();
@@ -55,6 +57,7 @@ FileDescriptor::FileDescriptor(FileDescriptor& other, Process* new_owner) {
 	_owner = new_owner ? new_owner->pid() : other._owner;
 	_path = other._path;
 	_id = other._id;
+	_advice = other._advice;
 
 	//Increase pipe reader/writer count if applicable
 	if(_file->is_fifo()) {
@@ -199,11 +202,73 @@ ssize_t FileDescriptor::read(SafePointer<uint8_t> buffer, size_t count) {
 	if(!_readable) return -EBADF;
 	LOCK(lock);
 	if(_seek + count < 0) return -EOVERFLOW;
+	if(_can_seek)
+		readahead(offset(), count);
 	int ret = _file->read(*this, offset(), buffer, count);
 	if(_can_seek && ret > 0) _seek += ret;
 	return ret;
 }
 
+void FileDescriptor::readahead(size_t offset, size_t count) {
+	if(_advice == POSIX_FADV_RANDOM)
+		return;
+
+	size_t end = offset + count;
+	bool sequential = offset == _ra_next || _advice == POSIX_FADV_SEQUENTIAL;
+	_ra_next = end;
+	if(!sequential) {
+		_ra_window = 0;
+		_ra_end = 0;
+		return;
+	}
+
+	//Start on the next window once the reader is halfway through the last one, so it's ready by the time they get there
+	if(_ra_end > end + _ra_window / 2)
+		return;
+	if(!_ra_window)
+		_ra_window = _advice == POSIX_FADV_SEQUENTIAL ? READAHEAD_MAX_WINDOW : READAHEAD_MIN_WINDOW;
+	else
+		_ra_window = min(_ra_window * 2, READAHEAD_MAX_WINDOW);
+
+	size_t start = max(end, _ra_end);
+	_ra_end = start + _ra_window;
+	_file->prefetch(start, _ra_window);
+}
+
+Result FileDescriptor::advise(off_t offset, off_t length, int advice) {
+	if(offset < 0 || length < 0) return Result(-EINVAL);
+	if(_file->is_fifo()) return Result(-ESPIPE);
+
+	switch(advice) {
+		case POSIX_FADV_NORMAL:
+		case POSIX_FADV_RANDOM:
+		case POSIX_FADV_SEQUENTIAL: {
+			LOCK(lock);
+			_advice = advice;
+			_ra_window = 0;
+			_ra_end = 0;
+			return Result(SUCCESS);
+		}
+
+		case POSIX_FADV_WILLNEED: {
+			//A length of zero means everything after the offset
+			size_t count = length;
+			if(!count && _inode)
+				count = _inode->metadata().size - min((size_t) offset, _inode->metadata().size);
+			_file->prefetch(offset, count);
+			return Result(SUCCESS);
+		}
+
+		case POSIX_FADV_DONTNEED:
+		case POSIX_FADV_NOREUSE:
+			//Nothing we can do with these yet
+			return Result(SUCCESS);
+
+		default:
+			return Result(-EINVAL);
+	}
+}
+
 size_t FileDescriptor::offset() const {
 	return _seek;
 }
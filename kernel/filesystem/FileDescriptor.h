@@ -25,12 +25,18 @@
 #include <kernel/kstd/unix_types.h>
 #include "File.h"
 #include <kernel/memory/SafePointer.h>
+#include <kernel/memory/SlabCache.h>
+
+// The smallest and largest amounts of data that will be read ahead of sequential reads
+#define READAHEAD_MIN_WINDOW 0x4000
+#define READAHEAD_MAX_WINDOW 0x40000
 
 class DirectoryEntry;
 class Device;
 class InodeMetadata;
 class Inode;
 class FileDescriptor {
+	SLAB_ALLOCATED
 public:
 	explicit FileDescriptor(const kstd::Arc<File>& file, Process* owner = nullptr);
 	FileDescriptor(FileDescriptor& other, Process* new_owner = nullptr);
@@ -61,6 +67,8 @@ public:
 	ssize_t write(SafePointer<uint8_t> buffer, size_t count);
 	size_t offset() const;
 	int ioctl(unsigned request, SafePointer<void*> argp);
+	/** Handles a hint (one of POSIX_FADV_*) about how a range of the file is going to be accessed. **/
+	Result advise(off_t offset, off_t length, int advice);
 
 	void set_fifo_reader();
 	void set_fifo_writer();
@@ -82,6 +90,13 @@ private:
 	off_t _seek {0};
 	bool _is_fifo_writer = false;
 
+	// Readahead state. Reads that pick up where the last one left off grow the window that's read ahead of them.
+	void readahead(size_t offset, size_t count);
+	int _advice = POSIX_FADV_NORMAL;
+	size_t _ra_next = 0; ///< Where the next read will start if it's sequential.
+	size_t _ra_end = 0; ///< The end of what has been read ahead so far.
+	size_t _ra_window = 0;
+
 	SpinLock lock;
 };
 
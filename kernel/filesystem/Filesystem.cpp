@@ -37,4 +37,12 @@ ino_t Filesystem::root_inode_id() {
 
 uint8_t Filesystem::fsid() {
 	return _fsid;
+}
+
+Result Filesystem::sync() {
+	return Result(SUCCESS);
+}
+
+bool Filesystem::dentries_cacheable() {
+	return false;
 }
\ No newline at end of file
@@ -32,6 +32,11 @@ public:
 	virtual ResultRet<kstd::Arc<Inode>> get_inode(ino_t id);
 	virtual ino_t root_inode_id();
 	virtual uint8_t fsid();
+	/// Writes all of the filesystem's cached data back to its storage.
+	virtual Result sync();
+	/// Whether lookups in this filesystem's directories can be kept in the DentryCache. This should only be true if its
+	/// directories are only ever changed through the VFS.
+	virtual bool dentries_cacheable();
 
 protected:
 	uint8_t _fsid;
@@ -20,6 +20,7 @@
 #include "Inode.h"
 #include "Filesystem.h"
 #include "VFS.h"
+#include "DentryCache.h"
 #include <kernel/kstd/string.h>
 #include "../memory/InodeVMObject.h"
 
@@ -33,9 +34,23 @@ Inode::~Inode() {
 ResultRet<kstd::Arc<Inode>> Inode::find(const kstd::string& name) {
 	if(metadata().exists() && !metadata().is_directory())
 		return Result(-EISDIR);
-	ino_t id  = find_id(name);
-	if(id != 0) {
-		auto ret = fs.get_inode(id);
+
+	ino_t child_id;
+	if(fs.dentries_cacheable()) {
+		auto cached = DentryCache::lookup(*this, name);
+		if(cached) {
+			child_id = cached.value();
+		} else {
+			auto generation = DentryCache::generation();
+			child_id = find_id(name);
+			DentryCache::insert(*this, name, child_id, generation);
+		}
+	} else {
+		child_id = find_id(name);
+	}
+
+	if(child_id != 0) {
+		auto ret = fs.get_inode(child_id);
 		return ret;
 	}
 	return Result(-ENOENT);
@@ -78,16 +93,32 @@ bool Inode::can_write(const FileDescriptor& fd) {
 	return true;
 }
 
+WaitQueue& Inode::poll_queue() {
+	return m_poll_queue;
+}
+
+void Inode::prefetch(size_t start, size_t length) {
+
+}
+
+ssize_t Inode::read_uncached(size_t start, size_t length, uint8_t* buffer) {
+	return read(start, length, KernelPointer<uint8_t>(buffer), nullptr);
+}
+
 kstd::Arc<InodeVMObject> Inode::shared_vm_object() {
 	LOCK(m_vmobject_lock);
 
-	kstd::Arc<InodeVMObject> ret;
-	if(!m_shared_vm_object) {
+	// The page cache can drop the last reference to the object at any time, so we have to lock it before checking it
+	auto ret = m_shared_vm_object.lock();
+	if(!ret) {
 		ret = InodeVMObject::make_for_inode(self(), InodeVMObject::Type::Shared);
 		m_shared_vm_object = ret;
-	} else {
-		ret = m_shared_vm_object.lock();
 	}
 
 	return ret;
 }
+
+kstd::Arc<InodeVMObject> Inode::cached_vm_object() {
+	LOCK(m_vmobject_lock);
+	return m_shared_vm_object.lock();
+}
@@ -23,6 +23,7 @@
 #include <kernel/kstd/Arc.h>
 #include <kernel/Result.hpp>
 #include <kernel/tasking/SpinLock.h>
+#include <kernel/tasking/WaitQueue.h>
 #include "InodeMetadata.h"
 #include <kernel/memory/SafePointer.h>
 #include <kernel/kstd/string.h>
@@ -46,6 +47,9 @@ public:
 	virtual ResultRet<kstd::Arc<Inode>> find(const kstd::string& name);
 	virtual ino_t find_id(const kstd::string& name) = 0;
 	virtual ssize_t read(size_t start, size_t length, SafePointer<uint8_t> buffer, FileDescriptor* fd) = 0;
+	/// Reads part of the inode's data into a kernel buffer for the page cache, bypassing any caches the inode's read()
+	/// would go through. By default, this just calls read().
+	virtual ssize_t read_uncached(size_t start, size_t length, uint8_t* buffer);
 	virtual ssize_t read_dir_entry(size_t start, SafePointer<DirectoryEntry> buffer, FileDescriptor* fd) = 0;
 	virtual ssize_t write(size_t start, size_t length, SafePointer<uint8_t> buffer, FileDescriptor* fd) = 0;
 	virtual Result add_entry(const kstd::string& name, Inode& inode) = 0;
@@ -59,15 +63,22 @@ public:
 	virtual void close(FileDescriptor& fd) = 0;
 	virtual bool can_read(const FileDescriptor& fd);
 	virtual bool can_write(const FileDescriptor& fd);
+	virtual WaitQueue& poll_queue();
+	/// Hints that a range of the inode's data will be read soon, so that it can be read into memory in the background.
+	virtual void prefetch(size_t start, size_t length);
 
 	virtual InodeMetadata metadata();
 
+	/// Gets the inode's shared VMObject, which is also its page cache, creating it if it doesn't exist.
 	kstd::Arc<InodeVMObject> shared_vm_object();
+	/// Gets the inode's shared VMObject if it exists.
+	kstd::Arc<InodeVMObject> cached_vm_object();
 
 protected:
 	InodeMetadata _metadata;
 	SpinLock lock, m_vmobject_lock;
 	kstd::Weak<InodeVMObject> m_shared_vm_object;
+	WaitQueue m_poll_queue;
 	bool _exists = true;
 };
 
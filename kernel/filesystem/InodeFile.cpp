@@ -19,6 +19,7 @@
 
 #include "InodeFile.h"
 #include "Inode.h"
+#include "Filesystem.h"
 
 InodeFile::InodeFile(kstd::Arc<Inode> inode): _inode(inode) {
 }
@@ -62,3 +63,15 @@ bool InodeFile::can_write(const FileDescriptor& fd) {
 	return _inode->can_write(fd);
 }
 
+Result InodeFile::sync() {
+	return _inode->fs.sync();
+}
+
+void InodeFile::prefetch(size_t offset, size_t count) {
+	_inode->prefetch(offset, count);
+}
+
+WaitQueue& InodeFile::poll_queue() {
+	return _inode->poll_queue();
+}
+
@@ -35,6 +35,9 @@ public:
 	void close(FileDescriptor& fd) override;
 	virtual bool can_read(const FileDescriptor& fd) override;
 	virtual bool can_write(const FileDescriptor& fd) override;
+	Result sync() override;
+	void prefetch(size_t offset, size_t count) override;
+	WaitQueue& poll_queue() override;
 
 private:
 	kstd::Arc<Inode> _inode;
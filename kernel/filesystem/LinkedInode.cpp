@@ -22,6 +22,8 @@
 #include <kernel/User.h>
 #include "LinkedInode.h"
 
+SLAB_CACHE(LinkedInode)
+
 LinkedInode::LinkedInode(const kstd::Arc<Inode>& inode, const kstd::string& name, const kstd::Arc<LinkedInode>& parent):
 	_inode(inode), _parent(parent), _name(name) {}
 
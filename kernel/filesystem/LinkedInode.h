@@ -20,9 +20,11 @@
 #pragma once
 
 #include <kernel/kstd/string.h>
+#include <kernel/memory/SlabCache.h>
 #include "Inode.h"
 
 class LinkedInode {
+	SLAB_ALLOCATED
 public:
 	LinkedInode(const kstd::Arc<Inode>& inode, const kstd::string& name, const kstd::Arc<LinkedInode>& parent);
 	~LinkedInode();
@@ -21,8 +21,9 @@
 #include <kernel/tasking/Signal.h>
 #include <kernel/tasking/TaskManager.h>
 #include <kernel/filesystem/FileDescriptor.h>
+#include <kernel/api/ioctl.h>
 
-Pipe::Pipe(): _queue(PIPE_SIZE) {}
+Pipe::Pipe(): _buffer(PIPE_DEFAULT_SIZE) {}
 
 Pipe::~Pipe() = default;
 
@@ -36,6 +37,9 @@ void Pipe::add_writer() {
 
 void Pipe::remove_reader() {
 	_readers--;
+	if(!_readers) {
+		_write_blocker.set_ready(true);
+	}
 }
 
 void Pipe::remove_writer() {
@@ -45,42 +49,55 @@ void Pipe::remove_writer() {
 	}
 }
 
-ssize_t Pipe::read(FileDescriptor& fd, size_t offset, SafePointer<uint8_t> buffer, size_t count) {
-	if(!_writers && _queue.empty()) return 0;
-	if(!_blocker.is_ready())
-		TaskManager::current_thread()->block(_blocker);
-	if(_blocker.was_interrupted())
-		return -EINTR;
-	LOCK(_lock);
-	if(count > _queue.size())
-		count = _queue.size();
-	for(size_t i = 0; i < count; i++)
-		buffer.set(i, _queue.pop_front());
-	if(_queue.empty() && _writers)
-		_blocker.set_ready(false);
-	return count;
+ssize_t Pipe::splice_from(FileDescriptor& fd, FileDescriptor& source, size_t count) {
+	return do_write(fd, count, [&](uint8_t* dest, size_t max) {
+		return source.read(KernelPointer<uint8_t>(dest), max);
+	});
 }
 
-ssize_t Pipe::write(FileDescriptor& fd, size_t offset, SafePointer<uint8_t> buffer, size_t count) {
-	//TODO: Block writes bigger than available space
-	if(_readers == 0) {
-		TaskManager::current_process()->kill(SIGPIPE);
-		return -EPIPE;
-	}
+ssize_t Pipe::splice_to(FileDescriptor& fd, FileDescriptor& dest, size_t count) {
+	return do_read(fd, count, [&](const uint8_t* src, size_t max) {
+		return dest.write(KernelPointer<uint8_t>((uint8_t*) src), max);
+	});
+}
 
-	LOCK(_lock);
+ssize_t Pipe::read(FileDescriptor& fd, size_t offset, SafePointer<uint8_t> buffer, size_t count) {
+	size_t nread = 0;
+	return do_read(fd, count, [&](const uint8_t* src, size_t max) {
+		buffer.write(src, nread, max);
+		nread += max;
+		return (ssize_t) max;
+	});
+}
 
+ssize_t Pipe::write(FileDescriptor& fd, size_t offset, SafePointer<uint8_t> buffer, size_t count) {
 	size_t nwrote = 0;
-	bool flag = true;
-	while(nwrote < count && flag) {
-		flag = _queue.push_back(buffer.get(nwrote));
-		nwrote++;
-	}
-
-	if(nwrote)
-		_blocker.set_ready(true);
+	return do_write(fd, count, [&](uint8_t* dest, size_t max) {
+		buffer.read(dest, nwrote, max);
+		nwrote += max;
+		return (ssize_t) max;
+	});
+}
 
-	return nwrote;
+int Pipe::ioctl(unsigned request, SafePointer<void*> argp) {
+	switch(request) {
+		case FIOGETPIPESZ:
+			return (int) _buffer.capacity();
+		case FIOSETPIPESZ: {
+			auto size = (size_t) argp.raw();
+			if(!size || size > PIPE_MAX_SIZE)
+				return -EINVAL;
+			size = ((size + PAGE_SIZE - 1) / PAGE_SIZE) * PAGE_SIZE;
+			LOCK(_lock);
+			auto res = _buffer.resize(size);
+			if(res.is_error())
+				return res.code();
+			_write_blocker.set_ready(true);
+			return (int) _buffer.capacity();
+		}
+		default:
+			return -EINVAL;
+	}
 }
 
 bool Pipe::is_fifo() {
@@ -88,5 +105,69 @@ bool Pipe::is_fifo() {
 }
 
 bool Pipe::can_read(const FileDescriptor& fd) {
-	return !_queue.empty() && !fd.is_fifo_writer();
+	return !_buffer.empty() && !fd.is_fifo_writer();
+}
+
+bool Pipe::can_write(const FileDescriptor& fd) {
+	return !_buffer.full() && fd.is_fifo_writer();
+}
+
+template<typename F>
+ssize_t Pipe::do_read(FileDescriptor& fd, size_t count, F&& consumer) {
+	if(!_writers && _buffer.empty())
+		return 0;
+	if(!_blocker.is_ready()) {
+		if(fd.nonblock())
+			return -EAGAIN;
+		TaskManager::current_thread()->block(_blocker);
+	}
+	if(_blocker.was_interrupted())
+		return -EINTR;
+
+	LOCK(_lock);
+	auto nread = _buffer.drain(count, consumer);
+	if(_buffer.empty() && _writers)
+		_blocker.set_ready(false);
+	if(nread > 0) {
+		_write_blocker.set_ready(true);
+		poll_queue().wake_all();
+	}
+	return nread;
+}
+
+template<typename F>
+ssize_t Pipe::do_write(FileDescriptor& fd, size_t count, F&& producer) {
+	size_t nwrote = 0;
+	while(true) {
+		if(_readers == 0) {
+			TaskManager::current_process()->kill(SIGPIPE);
+			return nwrote ? (ssize_t) nwrote : -EPIPE;
+		}
+
+		{
+			LOCK(_lock);
+			auto res = _buffer.fill(count - nwrote, producer);
+			if(res < 0)
+				return nwrote ? (ssize_t) nwrote : res;
+			nwrote += res;
+			if(res) {
+				_blocker.set_ready(true);
+				poll_queue().wake_all();
+			}
+
+			// Stop if we're done, or if the producer ran out of data before the pipe filled up
+			if(nwrote == count || !_buffer.full())
+				break;
+			if(fd.nonblock())
+				return nwrote ? (ssize_t) nwrote : -EAGAIN;
+			_write_blocker.set_ready(false);
+		}
+
+		// Wait for the reader to make room for the rest
+		TaskManager::current_thread()->block(_write_blocker);
+		if(_write_blocker.was_interrupted())
+			return nwrote ? (ssize_t) nwrote : -EINTR;
+	}
+
+	return nwrote;
 }
@@ -20,11 +20,13 @@
 #pragma once
 
 #include <kernel/memory/MemoryManager.h>
+#include <kernel/memory/RingBuffer.h>
 #include <kernel/filesystem/File.h>
-#include <kernel/kstd/circular_queue.hpp>
 #include <kernel/tasking/SpinLock.h>
+#include <kernel/tasking/BooleanBlocker.h>
 
-#define PIPE_SIZE PAGE_SIZE
+#define PIPE_DEFAULT_SIZE (16 * PAGE_SIZE)
+#define PIPE_MAX_SIZE (256 * PAGE_SIZE)
 
 class Pipe: public File {
 public:
@@ -37,18 +39,43 @@ public:
 	void remove_reader();
 	void remove_writer();
 
+	/**
+	 * Moves data from a file into the pipe without copying it through userspace.
+	 * @param fd The file descriptor of the pipe being written to.
+	 * @param source The file to read from, starting at its current offset.
+	 * @param count The maximum number of bytes to move.
+	 * @return The number of bytes moved, or a negative error.
+	 */
+	ssize_t splice_from(FileDescriptor& fd, FileDescriptor& source, size_t count);
+
+	/**
+	 * Moves data from the pipe into a file without copying it through userspace.
+	 * @param fd The file descriptor of the pipe being read from.
+	 * @param dest The file to write to, starting at its current offset.
+	 * @param count The maximum number of bytes to move.
+	 * @return The number of bytes moved, or a negative error.
+	 */
+	ssize_t splice_to(FileDescriptor& fd, FileDescriptor& dest, size_t count);
+
 	//File
 	ssize_t read(FileDescriptor& fd, size_t offset, SafePointer<uint8_t> buffer, size_t count) override;
 	ssize_t write(FileDescriptor& fd, size_t offset, SafePointer<uint8_t> buffer, size_t count) override;
+	int ioctl(unsigned request, SafePointer<void*> argp) override;
 	bool is_fifo() override;
 	bool can_read(const FileDescriptor& fd) override;
+	bool can_write(const FileDescriptor& fd) override;
 
 private:
-	kstd::circular_queue<uint8_t> _queue;
+	template<typename F>
+	ssize_t do_read(FileDescriptor& fd, size_t count, F&& consumer);
+	template<typename F>
+	ssize_t do_write(FileDescriptor& fd, size_t count, F&& producer);
+
+	RingBuffer _buffer;
 	size_t _readers = 0;
 	size_t _writers = 0;
 	BooleanBlocker _blocker;
+	BooleanBlocker _write_blocker;
 	SpinLock _lock;
 };
 
-
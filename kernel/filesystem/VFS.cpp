@@ -27,6 +27,7 @@
 #include <kernel/device/Device.h>
 #include <kernel/User.h>
 #include "InodeFile.h"
+#include "DentryCache.h"
 #include "kernel/tasking/TaskManager.h"
 
 VFS* VFS::instance;
@@ -199,6 +200,7 @@ ResultRet<kstd::Arc<FileDescriptor>> VFS::create(const kstd::string& path, int o
 
 	//Create the entry
 	auto child_or_err = parent->inode()->create_entry(path_base(path), mode, user.euid, user.egid);
+	DentryCache::invalidate(*parent->inode(), path_base(path));
 	if(child_or_err.is_error()) return child_or_err.result();
 
 	//Return a file descriptor to the new file
@@ -221,7 +223,9 @@ Result VFS::unlink(const kstd::string &path, const User& user, const kstd::Arc<L
 
 	//Unlink
 	if(resolv.value()->inode()->metadata().is_directory()) return Result(-EISDIR);
-	return parent->inode()->remove_entry(path_base(path));
+	auto res = parent->inode()->remove_entry(path_base(path));
+	DentryCache::invalidate(*parent->inode(), path_base(path));
+	return res;
 }
 
 Result VFS::link(const kstd::string& file, const kstd::string& link_name, const User& user, const kstd::Arc<LinkedInode>& base) {
@@ -245,7 +249,9 @@ Result VFS::link(const kstd::string& file, const kstd::string& link_name, const
 	if(old_file->inode()->fs.fsid() != new_file_parent->inode()->fs.fsid()) return Result(-EXDEV);
 
 	//Add the entry and return the result
-	return new_file_parent->inode()->add_entry(path_base(link_name), *old_file->inode());
+	auto res = new_file_parent->inode()->add_entry(path_base(link_name), *old_file->inode());
+	DentryCache::invalidate(*new_file_parent->inode(), path_base(link_name));
+	return res;
 }
 
 Result VFS::symlink(const kstd::string& file, const kstd::string& link_name, const User& user, const kstd::Arc<LinkedInode>& base) {
@@ -266,6 +272,7 @@ Result VFS::symlink(const kstd::string& file, const kstd::string& link_name, con
 
 	//Create the symlink file
 	auto symlink_res = new_file_parent->inode()->create_entry(path_base(link_name), MODE_SYMLINK | 0777u, user.euid, user.egid);
+	DentryCache::invalidate(*new_file_parent->inode(), path_base(link_name));
 	if(symlink_res.is_error()) return symlink_res.result();
 
 	//Write the symlink data
@@ -311,7 +318,10 @@ Result VFS::rmdir(kstd::string path, const User& user, const kstd::Arc<LinkedIno
 	if(!resolv.value()->inode()->metadata().is_directory()) return Result(-ENOTDIR);
 	if(!resolv.value()->inode()->metadata().can_write(user)) return Result(-EACCES);
 
-	return parent->inode()->remove_entry(path_base(path));
+	//Lookups inside of the directory are cached by its inode ID, which may be reused, so forget about everything
+	auto res = parent->inode()->remove_entry(path_base(path));
+	DentryCache::invalidate_all();
+	return res;
 }
 
 Result VFS::mkdir(kstd::string path, mode_t mode, const User& user, const kstd::Arc<LinkedInode> &base) {
@@ -332,6 +342,7 @@ Result VFS::mkdir(kstd::string path, mode_t mode, const User& user, const kstd::
 	//Make the directory
 	mode |= (unsigned) MODE_DIRECTORY;
 	auto res = parent->inode()->create_entry(path_base(path), mode, user.euid, user.egid);
+	DentryCache::invalidate(*parent->inode(), path_base(path));
 	if(res.is_error()) return res.result();
 
 	return Result(SUCCESS);
@@ -409,6 +420,7 @@ Result VFS::mount(Filesystem* fs, const kstd::Arc<LinkedInode>& mountpoint) {
 	}
 
 	mounts.push_back(Mount(fs, mountpoint));
+	DentryCache::invalidate_all();
 	return Result(SUCCESS);
 }
 
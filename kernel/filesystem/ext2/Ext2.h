@@ -42,6 +42,12 @@
 #define EXT2_APPEND_ONLY 0x20
 #define EXT2_DUMP_EXCLUDE 0x40
 #define EXT2_JOURNAL_FILE 0x40000
+#define EXT4_EXTENTS 0x80000 //The inode's blocks are mapped by an extent tree instead of block pointers
+
+//required (incompatible) features
+#define EXT2_INCOMPAT_FILETYPE 0x2
+#define EXT4_INCOMPAT_EXTENTS 0x40
+#define EXT2_SUPPORTED_INCOMPAT (EXT2_INCOMPAT_FILETYPE | EXT4_INCOMPAT_EXTENTS)
 
 #define EXT2_FT_UNKNOWN	0
 #define EXT2_FT_REG_FILE 1
@@ -116,3 +122,31 @@ typedef struct __attribute__((packed)) ext2_directory {
 	uint8_t name_length;
 	uint8_t type;
 } ext2_directory;
+
+//ext4 extent trees
+#define EXT4_EXTENT_MAGIC 0xF30A
+#define EXT4_EXTENT_MAX_LENGTH 32768 //Extents with lengths past this are uninitialized (unwritten) ones
+#define EXT4_EXTENT_MAX_DEPTH 5
+#define EXT4_EXTENT_ROOT_ENTRIES 4 //The number of entries that fit in the root node, which is stored in the inode
+
+typedef struct __attribute__((packed)) ext4_extent_header {
+	uint16_t magic;
+	uint16_t entries;
+	uint16_t max;
+	uint16_t depth; //0 for leaf nodes
+	uint32_t generation;
+} ext4_extent_header;
+
+typedef struct __attribute__((packed)) ext4_extent {
+	uint32_t block; //The first block in the file
+	uint16_t length;
+	uint16_t start_hi;
+	uint32_t start_lo;
+} ext4_extent;
+
+typedef struct __attribute__((packed)) ext4_extent_index {
+	uint32_t block; //The first block in the file the child node covers
+	uint32_t leaf_lo;
+	uint16_t leaf_hi;
+	uint16_t unused;
+} ext4_extent_index;
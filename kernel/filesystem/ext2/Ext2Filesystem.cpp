@@ -48,6 +48,9 @@ void Ext2Filesystem::init() {
 	inodes_per_block = block_size()/superblock.inode_size;
 	block_pointers_per_block = block_size() / sizeof(uint32_t);
 	block_groups = new Ext2BlockGroup*[num_block_groups] {nullptr};
+
+	if(superblock.version_major >= 1 && (superblock.required_features & ~EXT2_SUPPORTED_INCOMPAT))
+		KLog::warn("ext2", "Filesystem uses unsupported required features 0x%x, things may break!", superblock.required_features & ~EXT2_SUPPORTED_INCOMPAT);
 }
 
 bool Ext2Filesystem::probe(FileDescriptor& file){
@@ -132,7 +135,7 @@ ResultRet<kstd::Arc<Ext2Inode>> Ext2Filesystem::allocate_inode(mode_t mode, uid_
 	uint32_t num_blocks = (size + block_size() - 1) / block_size();
 	kstd::vector<uint32_t> blocks(0);
 	if(num_blocks) {
-		auto blocks_or_err = allocate_blocks(num_blocks);
+		auto blocks_or_err = allocate_blocks(num_blocks, true, group.first_block());
 		if (blocks_or_err.is_error()) return blocks_or_err.result();
 		blocks = blocks_or_err.value();
 	}
@@ -145,6 +148,12 @@ ResultRet<kstd::Arc<Ext2Inode>> Ext2Filesystem::allocate_inode(mode_t mode, uid_
 	raw.hard_links = IS_DIR(mode) ? 1 : 0;
 	raw.uid = uid;
 	raw.gid = gid;
+	if((superblock.required_features & EXT4_INCOMPAT_EXTENTS) && (IS_SIMPLE_FILE(mode) || IS_DIR(mode))) {
+		//New files and directories get an (empty) extent tree on filesystems that support them
+		ext4_extent_header header = {EXT4_EXTENT_MAGIC, 0, EXT4_EXTENT_ROOT_ENTRIES, 0, 0};
+		raw.flags |= EXT4_EXTENTS;
+		memcpy((uint8_t*) raw.block_pointers, &header, sizeof(header));
+	}
 	//TODO: times
 	auto inode = kstd::make_shared<Ext2Inode>(*this, ino, raw, blocks, parent);
 
@@ -205,6 +214,10 @@ Result Ext2Filesystem::free_inode(Ext2Inode& ino) {
 	return Result(SUCCESS);
 }
 
+bool Ext2Filesystem::dentries_cacheable() {
+	return true;
+}
+
 char *Ext2Filesystem::name() {
 	return "EXT2";
 }
@@ -236,43 +249,82 @@ Result Ext2Filesystem::write_block_group_raw(uint32_t block_group, const ext2_bl
 	return write_successful;
 }
 
-ResultRet<kstd::vector<uint32_t>> Ext2Filesystem::allocate_blocks_in_group(Ext2BlockGroup* group, uint32_t num_blocks, bool zero_out) {
+ResultRet<kstd::vector<uint32_t>> Ext2Filesystem::allocate_blocks_in_group(Ext2BlockGroup* group, uint32_t num_blocks, bool zero_out, uint32_t goal) {
 	if(group->free_blocks < num_blocks) return Result(-ENOSPC);
 	if(num_blocks == 0) return kstd::vector<uint32_t>(0);
 
 	LOCK(ext2lock);
-	uint8_t block_buf[block_size()];
+	uint32_t bitmap[block_size() / sizeof(uint32_t)];
 
-	Result res = read_block(group->block_bitmap_block, block_buf);
+	Result res = read_block(group->block_bitmap_block, (uint8_t*) bitmap);
 	if(res.is_error()) {
 		KLog::err("ext2", "Error %d reading block bitmap for group %d", res.code(), group->num);
 		return res;
 	}
 
+	//The bitmap is scanned a word (32 blocks) at a time, so full stretches of the group are skipped quickly
+	uint32_t num_words = (superblock.blocks_per_group + 31) / 32;
+	if(goal >= superblock.blocks_per_group)
+		goal = 0;
+
+	//If the goal is taken, rather than filling in whatever hole comes next, start at the next completely free word so
+	//that the blocks we hand out (and any that get appended after them) stay contiguous
+	if(bitmap[goal / 32] & (1u << (goal % 32))) {
+		for(uint32_t n = 1; n < num_words; n++) {
+			uint32_t wi = (goal / 32 + n) % num_words;
+			if(!bitmap[wi] && (wi + 1) * 32 <= superblock.blocks_per_group) {
+				goal = wi * 32;
+				break;
+			}
+		}
+	}
 
-	uint32_t num_allocated = 0;
+	//Hand out free blocks in order starting from the goal, wrapping around to the start of the group. The goal's word
+	//is visited twice: first for the blocks at or after the goal, and last for the ones before it.
 	kstd::vector<uint32_t> ret;
 	ret.reserve(num_blocks);
-
-	for(size_t bi = 0; bi < superblock.blocks_per_group; bi++) {
-		if(!get_bitmap_bit(block_buf, bi)) {
-			set_bitmap_bit(block_buf, bi, true);
+	for(uint32_t n = 0; n <= num_words && ret.size() < num_blocks; n++) {
+		uint32_t wi = (goal / 32 + n) % num_words;
+		uint32_t free = ~bitmap[wi];
+		if(n == 0)
+			free &= ~0u << (goal % 32);
+		else if(n == num_words)
+			free &= ~(~0u << (goal % 32));
+
+		while(free && ret.size() < num_blocks) {
+			uint32_t bit = __builtin_ctz(free);
+			free &= free - 1;
+			uint32_t bi = wi * 32 + bit;
+			if(bi >= superblock.blocks_per_group)
+				break;
+			bitmap[wi] |= 1u << bit;
 			ret.push_back(bi + group->first_block());
-			if(zero_out) zero_block(bi + group->first_block());
-			group->free_blocks--;
-			superblock.free_blocks--;
-			if(++num_allocated == num_blocks) break;
 		}
 	}
 
-	if(num_allocated != num_blocks) {
+	group->free_blocks -= ret.size();
+	superblock.free_blocks -= ret.size();
+	if(ret.size() != num_blocks) {
 		KLog::warn("ext2", "Free block count in block group %d was incorrect!", group->num);
 		group->free_blocks = 0;
 	}
 
+	//Zero out each contiguous run of the new blocks at once
+	if(zero_out) {
+		size_t run_start = 0;
+		for(size_t i = 1; i <= ret.size(); i++) {
+			if(i < ret.size() && ret[i] == ret[i - 1] + 1)
+				continue;
+			res = zero_blocks(ret[run_start], i - run_start);
+			if(res.is_error())
+				KLog::err("ext2", "Error %d zeroing out newly allocated blocks in block group %d!", res.code(), group->num);
+			run_start = i;
+		}
+	}
+
 	write_superblock();
 	group->write();
-	res = write_block(group->block_bitmap_block, block_buf);
+	res = write_block(group->block_bitmap_block, (uint8_t*) bitmap);
 	if(res.is_error()) {
 		KLog::err("ext2", "Error writing block bitmap for block group %d!", group->num);
 		return res;
@@ -281,18 +333,23 @@ ResultRet<kstd::vector<uint32_t>> Ext2Filesystem::allocate_blocks_in_group(Ext2B
 	return kstd::move(ret);
 }
 
-ResultRet<kstd::vector<uint32_t>> Ext2Filesystem::allocate_blocks(uint32_t num_blocks, bool zero_out) {
+ResultRet<kstd::vector<uint32_t>> Ext2Filesystem::allocate_blocks(uint32_t num_blocks, bool zero_out, uint32_t goal) {
 	LOCK(ext2lock);
 	if(num_blocks == 0) {
 		KLog::warn("ext2", "Tried to allocate zero ext2 blocks!");
 		return Result(-EINVAL);
 	}
 
-	//First, find a block group that can fit all the blocks, or at least the most spacious block group
+	//First, find a block group that can fit all the blocks, or at least the most spacious block group. The search
+	//starts at the group the goal is in, so that blocks end up as close to the goal as possible.
+	uint32_t goal_group = goal ? block_group_of(goal) : 0;
+	if(goal_group >= num_block_groups)
+		goal_group = goal = 0;
 	Ext2BlockGroup* target_bg = nullptr;
 	Ext2BlockGroup* most_spacious_bg = nullptr;
 
-	for(uint32_t bgi = 0; bgi < num_block_groups; bgi++) {
+	for(uint32_t n = 0; n < num_block_groups; n++) {
+		uint32_t bgi = (goal_group + n) % num_block_groups;
 		Ext2BlockGroup *bg = get_block_group(bgi);
 		if (!bg) {
 			KLog::err("ext2", "Error getting block group %d!", bgi);
@@ -307,7 +364,8 @@ ResultRet<kstd::vector<uint32_t>> Ext2Filesystem::allocate_blocks(uint32_t num_b
 
 	if(target_bg) {
 		//We found a block group that will house all of the blocks we need to allocate
-		return kstd::move(allocate_blocks_in_group(target_bg, num_blocks, zero_out));
+		uint32_t goal_index = (goal && target_bg->num == goal_group) ? goal - target_bg->first_block() : 0;
+		return kstd::move(allocate_blocks_in_group(target_bg, num_blocks, zero_out, goal_index));
 	} else {
 		//If we couldn't find one bg to fit all the blocks, allocate the blocks in multiple groups
 		kstd::vector<uint32_t> ret;
@@ -336,41 +394,65 @@ ResultRet<kstd::vector<uint32_t>> Ext2Filesystem::allocate_blocks(uint32_t num_b
 	}
 }
 
-uint32_t Ext2Filesystem::allocate_block(bool zero_out) {
-	auto ret_or_err = allocate_blocks(1, zero_out);
+uint32_t Ext2Filesystem::allocate_block(bool zero_out, uint32_t goal) {
+	auto ret_or_err = allocate_blocks(1, zero_out, goal);
 	if(ret_or_err.is_error()) return 0;
 	if(ret_or_err.value().empty()) return 0;
 	return ret_or_err.value().at(0);
 }
 
 void Ext2Filesystem::free_block(uint32_t block) {
-	LOCK(ext2lock);
+	free_blocks(block, 1);
+}
 
-	if(block == 0) {
-		KLog::warn("ext2", "Tried to free ext2 block 0!");
-		return;
+void Ext2Filesystem::free_blocks(kstd::vector<uint32_t>& blocks) {
+	//Free each run of contiguous blocks together, so that each bitmap is only read and written once per run
+	size_t run_start = 0;
+	for(size_t i = 1; i <= blocks.size(); i++) {
+		if(i < blocks.size() && blocks[i] == blocks[i - 1] + 1)
+			continue;
+		free_blocks(blocks[run_start], i - run_start);
+		run_start = i;
 	}
+}
 
-	uint32_t group_index = (block - 1) / superblock.blocks_per_group;
-	Ext2BlockGroup* bg = get_block_group(group_index);
-	if(!bg) {
-		KLog::err("ext2", "Error getting block group %d!", group_index);
+void Ext2Filesystem::free_blocks(uint32_t first_block, uint32_t count) {
+	LOCK(ext2lock);
+
+	if(first_block == 0) {
+		KLog::warn("ext2", "Tried to free ext2 block 0!");
 		return;
 	}
 
-	//Update blockgroup
 	uint8_t block_buf[block_size()];
-	read_block(bg->block_bitmap_block, block_buf);
-	set_bitmap_bit(block_buf, block - bg->first_block(), false);
-	write_block(bg->block_bitmap_block, block_buf);
-	bg->free_blocks++;
+	while(count) {
+		uint32_t group_index = block_group_of(first_block);
+		Ext2BlockGroup* bg = get_block_group(group_index);
+		if(!bg) {
+			KLog::err("ext2", "Error getting block group %d!", group_index);
+			return;
+		}
 
-	//Update superblock
-	superblock.free_blocks++;
+		//Update blockgroup
+		uint32_t index = first_block - bg->first_block();
+		uint32_t run_length = min(count, superblock.blocks_per_group - index);
+		read_block(bg->block_bitmap_block, block_buf);
+		for(uint32_t i = 0; i < run_length; i++)
+			set_bitmap_bit(block_buf, index + i, false);
+		write_block(bg->block_bitmap_block, block_buf);
+		bg->free_blocks += run_length;
+		bg->write();
+
+		//Update superblock
+		superblock.free_blocks += run_length;
+		first_block += run_length;
+		count -= run_length;
+	}
+	write_superblock();
 }
 
-void Ext2Filesystem::free_blocks(kstd::vector<uint32_t>& blocks) {
-	for(size_t i = 0; i < blocks.size(); i++) free_block(blocks[i]);
+uint32_t Ext2Filesystem::block_group_of(uint32_t block) {
+	return (block - (block_size() == 1024 ? 1 : 0)) / superblock.blocks_per_group;
 }
 
 Ext2BlockGroup *Ext2Filesystem::get_block_group(uint32_t block_group) {
@@ -38,6 +38,7 @@ public:
 	ino_t root_inode_id() override;
 	char* name() override;
 	Inode * get_inode_rawptr(ino_t id) override;
+	bool dentries_cacheable() override;
 
 	//Reading/writing
 	ResultRet<kstd::Arc<Ext2Inode>> allocate_inode(mode_t mode, uid_t uid, gid_t gid, size_t size, ino_t parent);
@@ -46,12 +47,22 @@ public:
 	void write_superblock();
 
 	//Block stuff
-	ResultRet<kstd::vector<uint32_t>> allocate_blocks_in_group(Ext2BlockGroup* group, uint32_t num_blocks, bool zero_out);
-	ResultRet<kstd::vector<uint32_t>> allocate_blocks(uint32_t num_blocks, bool zero_out = true);
-	uint32_t allocate_block(bool zero_out = true);
+	/**
+	 * Allocates blocks in a block group, handing out free blocks in order starting from the goal.
+	 * @param goal The index (within the group) of the block we'd like to get first.
+	 */
+	ResultRet<kstd::vector<uint32_t>> allocate_blocks_in_group(Ext2BlockGroup* group, uint32_t num_blocks, bool zero_out, uint32_t goal = 0);
+	/**
+	 * Allocates blocks, preferring the block group containing the goal block and blocks right after it.
+	 * @param goal The block we'd like to get first (usually the one after the last block of the file), or 0 for none.
+	 */
+	ResultRet<kstd::vector<uint32_t>> allocate_blocks(uint32_t num_blocks, bool zero_out = true, uint32_t goal = 0);
+	uint32_t allocate_block(bool zero_out = true, uint32_t goal = 0);
 
 	void free_block(uint32_t block);
 	void free_blocks(kstd::vector<uint32_t>& blocks);
+	void free_blocks(uint32_t first_block, uint32_t count);
+	uint32_t block_group_of(uint32_t block);
 	Ext2BlockGroup* get_block_group(uint32_t block_group);
 	Result read_block_group_raw(uint32_t block_group, ext2_block_group_descriptor* buffer);
 	Result write_block_group_raw(uint32_t block_group, const ext2_block_group_descriptor* buffer);
@@ -22,7 +22,9 @@
 #include "Ext2BlockGroup.h"
 #include "Ext2Filesystem.h"
 #include <kernel/filesystem/DirectoryEntry.h>
+#include <kernel/filesystem/FileDescriptor.h>
 #include <kernel/kstd/KLog.h>
+#include <kernel/memory/InodeVMObject.h>
 
 Ext2Inode::Ext2Inode(Ext2Filesystem& filesystem, ino_t id): Inode(filesystem, id) {
 	//Get the block group
@@ -38,14 +40,16 @@ Ext2Inode::Ext2Inode(Ext2Filesystem& filesystem, ino_t id): Inode(filesystem, id
 	memcpy(&raw, inodeRaw, sizeof(Ext2Inode::Raw));
 
 	create_metadata();
-
-	//Read block pointers
-	if(!_metadata.is_device())
-		read_block_pointers();
 }
 
-Ext2Inode::Ext2Inode(Ext2Filesystem& filesystem, ino_t i, const Raw &raw, kstd::vector<uint32_t>& block_pointers, ino_t parent): Inode(filesystem, i), block_pointers(block_pointers), raw(raw) {
+Ext2Inode::Ext2Inode(Ext2Filesystem& filesystem, ino_t i, const Raw &raw, kstd::vector<uint32_t>& blocks, ino_t parent): Inode(filesystem, i), raw(raw) {
 	create_metadata();
+	for(size_t block_index = 0; block_index < blocks.size(); block_index++) {
+		Result res = set_block_pointer(block_index, blocks[block_index]);
+		if(res.is_error())
+			KLog::err("ext2", "Error %d setting block pointers of new inode %d", res.code(), i);
+	}
+	this->raw.logical_blocks += blocks.size() * ext2fs().sectors_per_block;
 	if(IS_DIR(raw.mode)) {
 		kstd::vector<DirectoryEntry> entries;
 		entries.reserve(2);
@@ -59,6 +63,7 @@ Ext2Inode::Ext2Inode(Ext2Filesystem& filesystem, ino_t i, const Raw &raw, kstd::
 }
 
 Ext2Inode::~Ext2Inode() {
+	release_preallocation();
 	if(_dirty && exists())
 		write_to_disk();
 }
@@ -85,35 +90,96 @@ size_t Ext2Inode::num_blocks() {
 }
 
 uint32_t Ext2Inode::get_block_pointer(uint32_t block_index) {
-	if(block_index >= block_pointers.size()) return 0;
-	return block_pointers[block_index];
+	if(block_index >= num_blocks()) return 0;
+	LOCK(lock);
+	if(uses_extents())
+		return get_extent_block(block_index);
+
+	//Sequential accesses will usually land in a run we've already seen
+	for(auto& extent : _extents) {
+		if(block_index - extent.index < extent.length)
+			return extent.block + (block_index - extent.index);
+	}
+
+	uint32_t offsets[3];
+	int depth = block_path(block_index, offsets);
+	if(depth < 0) return 0;
+	if(depth == 0) {
+		uint32_t direct_pointers[12];
+		memcpy(direct_pointers, raw.block_pointers, sizeof(direct_pointers));
+		cache_extent(block_index, direct_pointers, offsets[0], 12);
+		return direct_pointers[offsets[0]];
+	}
+
+	//Walk down the pointer blocks
+	uint32_t block = root_pointer(depth);
+	kstd::Arc<IndirectBlock> indirect;
+	for(int level = 0; level < depth; level++) {
+		if(!block) return 0;
+		auto indirect_or_err = get_indirect_block(block);
+		if(indirect_or_err.is_error()) return 0;
+		indirect = indirect_or_err.value();
+		block = indirect->pointers[offsets[level]];
+	}
+
+	cache_extent(block_index, indirect->pointers.storage(), offsets[depth - 1], indirect->pointers.size());
+	return block;
 }
 
-bool Ext2Inode::set_block_pointer(uint32_t block_index, uint32_t block) {
+Result Ext2Inode::set_block_pointer(uint32_t block_index, uint32_t block) {
 	LOCK(lock);
+	if(uses_extents())
+		return set_extent_block(block_index, block);
 
-	if(block_index == 0 && block_pointers.empty()) {
-		block_pointers.push_back(block);
-		_dirty = true;
-		return true;
-	} else if(block_index < block_pointers.size()) {
-		block_pointers[block_index] = block;
-		_dirty = true;
-		return true;
-	} else if(block_index == block_pointers.size()) {
-		block_pointers.push_back(block);
-		_dirty = true;
-		return true;
-	} else return false;
-}
+	uint32_t offsets[3];
+	int depth = block_path(block_index, offsets);
+	if(depth < 0) return Result(-EFBIG);
 
-kstd::vector<uint32_t>& Ext2Inode::get_block_pointers() {
-	return block_pointers;
+	invalidate_extents();
+	_dirty = true;
+	if(depth == 0) {
+		raw.block_pointers[offsets[0]] = block;
+		return Result(SUCCESS);
+	}
+
+	//Walk down the pointer blocks, allocating any that are missing along the way
+	kstd::Arc<IndirectBlock> indirect;
+	for(int level = 0; level < depth; level++) {
+		uint32_t next = level ? indirect->pointers[offsets[level - 1]] : root_pointer(depth);
+		if(next) {
+			auto indirect_or_err = get_indirect_block(next);
+			if(indirect_or_err.is_error()) return indirect_or_err.result();
+			indirect = indirect_or_err.value();
+		} else {
+			//There's no need to allocate pointer blocks just to point to nothing
+			if(!block) return Result(SUCCESS);
+			uint32_t new_block = ext2fs().allocate_block(false, block);
+			if(!new_block) return Result(-ENOSPC);
+			raw.logical_blocks += ext2fs().sectors_per_block;
+
+			//The parent is marked dirty before caching the new block, in case that evicts it
+			if(level) {
+				indirect->pointers[offsets[level - 1]] = new_block;
+				indirect->dirty = true;
+			} else {
+				set_root_pointer(depth, new_block);
+			}
+			indirect = kstd::make_shared<IndirectBlock>(new_block, ext2fs().block_pointers_per_block);
+			indirect->dirty = true;
+			cache_indirect_block(indirect);
+		}
+	}
+
+	indirect->pointers[offsets[depth - 1]] = block;
+	indirect->dirty = true;
+	return Result(SUCCESS);
 }
 
 void Ext2Inode::free_all_blocks() {
-	ext2fs().free_blocks(block_pointers);
-	ext2fs().free_blocks(pointer_blocks);
+	LOCK(lock);
+	release_preallocation();
+	if(_metadata.is_device() || (_metadata.is_symlink() && _metadata.size < 60)) return;
+	free_blocks_from(0);
 }
 
 ssize_t Ext2Inode::read(size_t start, size_t length, SafePointer<uint8_t> buffer, FileDescriptor* fd) {
@@ -124,6 +190,12 @@ ssize_t Ext2Inode::read(size_t start, size_t length, SafePointer<uint8_t> buffer
 	if(!exists())
 		return -ENOENT; //Inode was deleted
 
+	//Regular files are read through the page cache, which reads them in with read_uncached()
+	if(_metadata.is_simple_file()) {
+		if(start + length > _metadata.size) length = _metadata.size - start;
+		return shared_vm_object()->read(start, length, buffer);
+	}
+
 	LOCK(lock);
 
 	//Symlinks less than 60 characters use the block pointers to store their data
@@ -166,6 +238,43 @@ ssize_t Ext2Inode::read(size_t start, size_t length, SafePointer<uint8_t> buffer
 	return length;
 }
 
+ssize_t Ext2Inode::read_uncached(size_t start, size_t length, uint8_t* buffer) {
+	if(!_metadata.is_simple_file())
+		return Inode::read_uncached(start, length, buffer);
+	if(!exists())
+		return -ENOENT;
+
+	LOCK(lock);
+	if(start >= _metadata.size)
+		return 0;
+	if(start + length > _metadata.size)
+		length = _metadata.size - start;
+
+	//The page cache only asks for whole blocks, so read runs of blocks that are contiguous on the disk straight into
+	//the buffer with one read each. Holes read as zeroes.
+	size_t block_size = ext2fs().block_size();
+	ASSERT(start % block_size == 0);
+	size_t first_block = start / block_size;
+	size_t num_blocks = (length + block_size - 1) / block_size;
+	size_t i = 0;
+	while(i < num_blocks) {
+		uint32_t block = get_block_pointer(first_block + i);
+		if(!block) {
+			memset(buffer + i * block_size, 0, block_size);
+			i++;
+			continue;
+		}
+		size_t run_length = 1;
+		while(i + run_length < num_blocks && get_block_pointer(first_block + i + run_length) == block + run_length)
+			run_length++;
+		auto res = ext2fs().read_blocks_direct(block, run_length, buffer + i * block_size);
+		if(res.is_error())
+			return res.code();
+		i += run_length;
+	}
+	return length;
+}
+
 ssize_t Ext2Inode::write(size_t start, size_t length, SafePointer<uint8_t> buf, FileDescriptor* fd) {
 	if(_metadata.is_device()) return 0;
 	if(length == 0) return 0;
@@ -173,6 +282,12 @@ ssize_t Ext2Inode::write(size_t start, size_t length, SafePointer<uint8_t> buf,
 
 	LOCK(lock);
 
+	//Any pages of the file in the page cache are updated along with the disk. Programs run straight out of the page
+	//cache, so a file that's being run can't be written to.
+	auto page_cache = _metadata.is_simple_file() ? cached_vm_object() : kstd::Arc<InodeVMObject>();
+	if(page_cache && page_cache->text_busy())
+		return -ETXTBSY;
+
 	//If it's a symlink and less than 60 characters, use the block pointers to store the link
 	if(_metadata.is_symlink() && max(_metadata.size, start + length) < 60) {
 		buf.read(((uint8_t*)raw.block_pointers) + start, length);
@@ -223,6 +338,8 @@ ssize_t Ext2Inode::write(size_t start, size_t length, SafePointer<uint8_t> buf,
 
 		//Write the block to disk/cache
 		ext2fs().write_block(block, block_buf);
+		if(page_cache)
+			page_cache->write_cached(block_index * ext2fs().block_size(), block_buf, ext2fs().block_size());
 		block_index++;
 	}
 
@@ -263,18 +380,22 @@ ino_t Ext2Inode::find_id(const kstd::string& find_name) {
 	LOCK(lock);
 	ino_t ret = 0;
 	auto* buf = static_cast<uint8_t *>(kmalloc(ext2fs().block_size()));
-	for(size_t i = 0; i < num_blocks(); i++) {
+	for(size_t i = 0; i < num_blocks() && !ret; i++) {
 		uint32_t block = get_block_pointer(i);
 		ext2fs().read_block(block, buf);
 		auto* dir = reinterpret_cast<ext2_directory*>(buf);
 		uint32_t add = 0;
-		char name_buf[257];
-		while(dir->inode != 0 && add < ext2fs().block_size()) {
-			memcpy(name_buf, &dir->type+1, dir->name_length);
-			name_buf[dir->name_length] = '\0';
-			if(find_name == name_buf){
-				ret = dir->inode;
-				break;
+		while(dir->inode != 0 && dir->size && add < ext2fs().block_size()) {
+			//Only compare the names if their lengths match
+			if(dir->name_length == find_name.length()) {
+				auto* name = (char*) (&dir->type + 1);
+				size_t j = 0;
+				while(j < dir->name_length && name[j] == find_name[j])
+					j++;
+				if(j == dir->name_length) {
+					ret = dir->inode;
+					break;
+				}
 			}
 			add += dir->size;
 			dir = (ext2_directory*)((size_t)dir + dir->size);
@@ -415,11 +536,15 @@ Result Ext2Inode::truncate(off_t length) {
 	if((size_t)length == _metadata.size) return Result(SUCCESS);
 	LOCK(lock);
 
+	auto page_cache = cached_vm_object();
+	if(page_cache && page_cache->text_busy())
+		return Result(-ETXTBSY);
+
 	uint32_t new_num_blocks = (length + ext2fs().block_size() - 1) / ext2fs().block_size();
 
 	if(new_num_blocks > num_blocks()) {
 		//We're expanding the file, allocate new blocks
-		auto new_blocks_res = ext2fs().allocate_blocks(new_num_blocks - num_blocks(), true);
+		auto new_blocks_res = allocate_file_blocks(new_num_blocks - num_blocks());
 		if(new_blocks_res.is_error())
 			return new_blocks_res.result();
 
@@ -428,23 +553,25 @@ Result Ext2Inode::truncate(off_t length) {
 		if(new_blocks.size() != new_num_blocks - num_blocks()) return Result(-ENOSPC);
 
 		//Add the new blocks to the block pointers
-		for(size_t i = 0; i < new_blocks.size(); i++)
-			block_pointers.push_back(new_blocks[i]);
+		uint32_t first_new_block = num_blocks();
+		for(size_t i = 0; i < new_blocks.size(); i++) {
+			Result res = set_block_pointer(first_new_block + i, new_blocks[i]);
+			if(res.is_error()) {
+				for(size_t j = 0; j < i; j++)
+					set_block_pointer(first_new_block + j, 0);
+				ext2fs().free_blocks(new_blocks);
+				return res;
+			}
+		}
+		raw.logical_blocks += new_blocks.size() * ext2fs().sectors_per_block;
 
 		//Write inode entry and block pointers to disk
 		_metadata.size = (size_t) length;
 		write_to_disk();
 	} else if(new_num_blocks < num_blocks()) {
-		//We're shrinking the file, free old blocks
-		for(size_t i = num_blocks(); i > new_num_blocks; i--)
-			ext2fs().free_block(get_block_pointer(i - 1));
-		block_pointers.resize(new_num_blocks);
-
-		//Free old pointer blocks as well
-		size_t new_num_pointer_blocks = calculate_num_ptr_blocks(new_num_blocks);
-		for(size_t i = pointer_blocks.size(); i > new_num_pointer_blocks; i--)
-			ext2fs().free_block(pointer_blocks[i - 1]);
-		pointer_blocks.resize(new_num_pointer_blocks);
+		//We're shrinking the file, free old blocks and the pointer blocks that pointed to them
+		release_preallocation();
+		free_blocks_from(new_num_blocks);
 
 		//Zero out the unused portion of the last block
 		if(length % ext2fs().block_size())
@@ -459,6 +586,9 @@ Result Ext2Inode::truncate(off_t length) {
 		write_inode_entry();
 	}
 
+	if(page_cache)
+		page_cache->truncate(length);
+
 	return Result(SUCCESS);
 }
 
@@ -477,154 +607,625 @@ Result Ext2Inode::chown(uid_t uid, gid_t gid) {
 	return Result(SUCCESS);
 }
 
-void Ext2Inode::read_singly_indirect(uint32_t singly_indirect_block, uint32_t& block_index) {
-	if(block_index >= num_blocks()) return;
-	uint8_t block_buf[ext2fs().block_size()];
-	ext2fs().read_block(singly_indirect_block, block_buf);
-	pointer_blocks.push_back(singly_indirect_block);
-	for(uint32_t i = 0; i < ext2fs().block_pointers_per_block && block_index < num_blocks(); i++) {
-		block_pointers.push_back(((uint32_t*)block_buf)[i]);
-		block_index++;
+int Ext2Inode::block_path(uint32_t block_index, uint32_t offsets[3]) {
+	//Returns how many pointer blocks need to be walked through to find a block, and the offset to use in each of them
+	uint32_t ppb = ext2fs().block_pointers_per_block;
+	if(block_index < 12) {
+		offsets[0] = block_index;
+		return 0;
+	}
+
+	block_index -= 12;
+	if(block_index < ppb) {
+		offsets[0] = block_index;
+		return 1;
+	}
+
+	block_index -= ppb;
+	if(block_index < ppb * ppb) {
+		offsets[0] = block_index / ppb;
+		offsets[1] = block_index % ppb;
+		return 2;
 	}
+
+	block_index -= ppb * ppb;
+	if(block_index < ppb * ppb * ppb) {
+		offsets[0] = block_index / (ppb * ppb);
+		offsets[1] = (block_index / ppb) % ppb;
+		offsets[2] = block_index % ppb;
+		return 3;
+	}
+
+	return -1;
 }
 
-void Ext2Inode::read_doubly_indirect(uint32_t doubly_indirect_block, uint32_t& block_index) {
-	if(block_index >= num_blocks()) return;
-	uint8_t block_buf[ext2fs().block_size()];
-	ext2fs().read_block(doubly_indirect_block, block_buf);
-	pointer_blocks.push_back(doubly_indirect_block);
-	for(uint32_t i = 0; i < ext2fs().block_pointers_per_block && block_index < num_blocks(); i++)
-		read_singly_indirect(((uint32_t*)block_buf)[i], block_index);
+uint32_t Ext2Inode::root_pointer(int depth) {
+	switch(depth) {
+		case 1:
+			return raw.s_pointer;
+		case 2:
+			return raw.d_pointer;
+		default:
+			return raw.t_pointer;
+	}
 }
 
-void Ext2Inode::read_triply_indirect(uint32_t triply_indirect_block, uint32_t& block_index) {
-	if(block_index >= num_blocks()) return;
-	uint8_t block_buf[ext2fs().block_size()];
-	ext2fs().read_block(triply_indirect_block, block_buf);
-	pointer_blocks.push_back(triply_indirect_block);
-	for(uint32_t i = 0; i < ext2fs().block_pointers_per_block && block_index < num_blocks(); i++) {
-		read_doubly_indirect(((uint32_t*)block_buf)[i], block_index);
+void Ext2Inode::set_root_pointer(int depth, uint32_t block) {
+	switch(depth) {
+		case 1:
+			raw.s_pointer = block;
+			break;
+		case 2:
+			raw.d_pointer = block;
+			break;
+		default:
+			raw.t_pointer = block;
+			break;
 	}
 }
 
-void Ext2Inode::read_block_pointers() {
-	LOCK(lock);
+ResultRet<kstd::Arc<Ext2Inode::IndirectBlock>> Ext2Inode::get_indirect_block(uint32_t block) {
+	auto cached = _indirect_cache.get(block);
+	if(cached)
+		return cached.value();
+
+	auto indirect = kstd::make_shared<IndirectBlock>(block, ext2fs().block_pointers_per_block);
+	Result res = ext2fs().read_block(block, (uint8_t*) indirect->pointers.storage());
+	if(res.is_error())
+		return res;
+	cache_indirect_block(indirect);
+	return indirect;
+}
+
+void Ext2Inode::cache_indirect_block(const kstd::Arc<IndirectBlock>& indirect) {
+	if(_indirect_cache.size() >= EXT2_INDIRECT_CACHE_SIZE) {
+		auto lru = _indirect_cache.lru_unsafe();
+		if(lru.second->dirty)
+			write_indirect_block(*lru.second);
+		_indirect_cache.prune(1);
+	}
+	_indirect_cache.insert(indirect->block, indirect);
+}
+
+Result Ext2Inode::write_indirect_block(IndirectBlock& indirect) {
+	Result res = ext2fs().write_block(indirect.block, (uint8_t*) indirect.pointers.storage());
+	if(res.is_error()) {
+		KLog::err("ext2", "Error %d writing pointer block %d of inode %d", res.code(), indirect.block, id);
+		return res;
+	}
+	indirect.dirty = false;
+	return Result(SUCCESS);
+}
+
+Result Ext2Inode::flush_indirect_blocks() {
+	Result ret = Result(SUCCESS);
+	_indirect_cache.for_each([&](uint32_t block, kstd::Arc<IndirectBlock>& indirect) {
+		if(!indirect->dirty)
+			return;
+		Result res = write_indirect_block(*indirect);
+		if(res.is_error())
+			ret = res;
+	});
+	return ret;
+}
+
+void Ext2Inode::cache_extent(uint32_t block_index, const uint32_t* pointers, uint32_t offset, uint32_t num_pointers) {
+	if(!pointers[offset]) return;
+
+	//Find how far the run of contiguous blocks goes in either direction in this set of pointers
+	uint32_t first = offset;
+	uint32_t last = offset;
+	while(first > 0 && pointers[first - 1] && pointers[first - 1] + 1 == pointers[first])
+		first--;
+	while(last + 1 < num_pointers && pointers[last + 1] && pointers[last + 1] == pointers[last] + 1)
+		last++;
+
+	//A single block isn't worth pushing a longer run out of the cache for
+	if(first == last) return;
+
+	auto& extent = _extents[_next_extent];
+	_next_extent = (_next_extent + 1) % EXT2_EXTENT_CACHE_SIZE;
+	extent.index = block_index - (offset - first);
+	extent.block = pointers[first];
+	extent.length = last - first + 1;
+}
 
-	if(_metadata.is_symlink() && _metadata.size < 60) {
-		pointer_blocks = kstd::vector<uint32_t>();
-		block_pointers = kstd::vector<uint32_t>();
+void Ext2Inode::invalidate_extents() {
+	for(auto& extent : _extents)
+		extent = Extent();
+}
+
+void Ext2Inode::free_blocks_from(uint32_t first_block) {
+	LOCK(lock);
+	invalidate_extents();
+	_dirty = true;
+	if(uses_extents()) {
+		free_extents_from(first_block);
 		return;
 	}
 
-	uint8_t buf[ext2fs().block_size()];
-	block_pointers = kstd::vector<uint32_t>();
-	block_pointers.reserve(num_blocks());
-	pointer_blocks = kstd::vector<uint32_t>();
+	for(uint32_t i = first_block; i < 12; i++) {
+		if(raw.block_pointers[i]) {
+			ext2fs().free_block(raw.block_pointers[i]);
+			raw.block_pointers[i] = 0;
+			raw.logical_blocks -= ext2fs().sectors_per_block;
+		}
+	}
 
-	uint32_t block_index = 0;
-	while(block_index < 12 && block_index < num_blocks()) {
-		block_pointers.push_back(raw.block_pointers[block_index]);
-		block_index++;
+	uint32_t start = 12;
+	uint32_t span = ext2fs().block_pointers_per_block;
+	for(int depth = 1; depth <= 3; depth++) {
+		uint32_t pointer = root_pointer(depth);
+		if(pointer && free_pointer_block(pointer, depth, start, first_block))
+			set_root_pointer(depth, 0);
+		start += span;
+		span *= ext2fs().block_pointers_per_block;
 	}
+}
 
-	read_singly_indirect(raw.s_pointer, block_index);
-	read_doubly_indirect(raw.d_pointer, block_index);
-	read_triply_indirect(raw.t_pointer, block_index);
+uint32_t Ext2Inode::allocation_goal() {
+	//Right after the last block of the file, or the start of the inode's block group if it doesn't have one
+	uint32_t last_block = num_blocks() ? get_block_pointer(num_blocks() - 1) : 0;
+	if(last_block)
+		return last_block + 1;
+	return ext2fs().get_block_group(block_group())->first_block();
 }
 
-Result Ext2Inode::write_to_disk() {
+ResultRet<kstd::vector<uint32_t>> Ext2Inode::allocate_file_blocks(uint32_t num_blocks) {
 	LOCK(lock);
+	kstd::vector<uint32_t> blocks;
+	blocks.reserve(num_blocks);
+
+	//If the file didn't end where the preallocated blocks start anymore, they're no use to us
+	uint32_t goal = allocation_goal();
+	if(_prealloc_count && _prealloc_block != goal)
+		release_preallocation();
+	while(_prealloc_count && blocks.size() < num_blocks) {
+		blocks.push_back(_prealloc_block++);
+		_prealloc_count--;
+	}
+	if(blocks.size() == num_blocks)
+		return blocks;
+
+	//Allocate the rest along with a new window of blocks after them, falling back to just what we need if that fails
+	goal = blocks.empty() ? goal : blocks[blocks.size() - 1] + 1;
+	uint32_t needed = num_blocks - blocks.size();
+	auto new_blocks_res = ext2fs().allocate_blocks(needed + EXT2_PREALLOC_BLOCKS, true, goal);
+	if(new_blocks_res.is_error())
+		new_blocks_res = ext2fs().allocate_blocks(needed, true, goal);
+	if(new_blocks_res.is_error()) {
+		ext2fs().free_blocks(blocks);
+		return new_blocks_res.result();
+	}
 
-	Result res = write_block_pointers();
-	if(res.is_error())
-		return res;
+	auto& new_blocks = new_blocks_res.value();
+	for(uint32_t i = 0; i < needed && i < new_blocks.size(); i++)
+		blocks.push_back(new_blocks[i]);
+
+	//Keep the extra blocks that directly follow the ones we're using as the new window, and give back any others
+	for(size_t i = needed; i < new_blocks.size(); i++) {
+		if(new_blocks[i] == new_blocks[i - 1] + 1 && i - needed == _prealloc_count) {
+			if(!_prealloc_count)
+				_prealloc_block = new_blocks[i];
+			_prealloc_count++;
+		} else {
+			ext2fs().free_block(new_blocks[i]);
+		}
+	}
+	return blocks;
+}
 
+void Ext2Inode::release_preallocation() {
+	LOCK(lock);
+	if(!_prealloc_count)
+		return;
+	ext2fs().free_blocks(_prealloc_block, _prealloc_count);
+	_prealloc_block = 0;
+	_prealloc_count = 0;
+}
 
-	res = write_inode_entry();
-	if(res.is_error())
+bool Ext2Inode::free_pointer_block(uint32_t block, int level, uint32_t start, uint32_t first_block) {
+	//Frees everything at or after first_block that the pointer block (which maps blocks starting at start) points to,
+	//and the pointer block itself if it's no longer needed. Returns whether it was freed.
+	uint32_t ppb = ext2fs().block_pointers_per_block;
+	uint32_t span = 1;
+	for(int i = 1; i < level; i++)
+		span *= ppb;
+
+	auto indirect_or_err = get_indirect_block(block);
+	if(indirect_or_err.is_error()) {
+		KLog::err("ext2", "Error %d reading pointer block %d of inode %d", indirect_or_err.code(), block, id);
+		return false;
+	}
+	auto indirect = indirect_or_err.value();
+
+	for(uint32_t i = 0; i < ppb; i++) {
+		uint32_t child_start = start + i * span;
+		uint32_t& child = indirect->pointers[i];
+		if(!child || child_start + span <= first_block)
+			continue;
+		if(level == 1) {
+			ext2fs().free_block(child);
+			raw.logical_blocks -= ext2fs().sectors_per_block;
+		} else if(!free_pointer_block(child, level - 1, child_start, first_block)) {
+			continue;
+		}
+		child = 0;
+		indirect->dirty = true;
+	}
+
+	if(start < first_block) {
+		//Walking the children may have pushed this block out of the cache, so write it now
+		if(indirect->dirty)
+			write_indirect_block(*indirect);
+		return false;
+	}
+
+	_indirect_cache.erase(block);
+	ext2fs().free_block(block);
+	raw.logical_blocks -= ext2fs().sectors_per_block;
+	return true;
+}
+
+bool Ext2Inode::uses_extents() {
+	return raw.flags & EXT4_EXTENTS;
+}
+
+Result Ext2Inode::load_extent_tree() {
+	if(_extent_map_loaded)
+		return Result(SUCCESS);
+
+	//The root node is stored in place of the block pointers
+	uint8_t root[sizeof(raw.block_pointers)];
+	memcpy(root, (uint8_t*) raw.block_pointers, sizeof(root));
+	Result res = read_extent_node(root, sizeof(root), -1);
+	if(res.is_error()) {
+		_extent_map.resize(0);
+		_extent_leaf_blocks.resize(0);
+		_extent_index_blocks.resize(0);
 		return res;
+	}
 
+	//We don't know how the leaves on disk are packed, so they all get rewritten the first time anything changes
+	_extent_map_loaded = true;
+	_extent_dirty_from = 0;
 	return Result(SUCCESS);
 }
 
-Result Ext2Inode::write_block_pointers() {
-	LOCK(lock);
-	if(_metadata.is_symlink() && _metadata.size < 60) return Result(SUCCESS);
+Result Ext2Inode::read_extent_node(const uint8_t* node, size_t node_size, int depth) {
+	auto* header = (const ext4_extent_header*) node;
+	if(header->magic != EXT4_EXTENT_MAGIC || header->depth > EXT4_EXTENT_MAX_DEPTH || (depth >= 0 && header->depth != depth)
+		|| sizeof(ext4_extent_header) + header->entries * sizeof(ext4_extent) > node_size) {
+		KLog::err("ext2", "Inode %d has a corrupt extent tree!", id);
+		return Result(-EIO);
+	}
 
-	pointer_blocks = kstd::vector<uint32_t>(0);
-	pointer_blocks.reserve(calculate_num_ptr_blocks(num_blocks()));
+	if(header->depth == 0) {
+		auto* entries = (const ext4_extent*) (header + 1);
+		for(size_t i = 0; i < header->entries; i++) {
+			if(entries[i].start_hi) {
+				KLog::err("ext2", "Inode %d has an extent past the first 2^32 blocks!", id);
+				return Result(-EFBIG);
+			}
+			Extent extent;
+			extent.index = entries[i].block;
+			extent.block = entries[i].start_lo;
+			extent.length = entries[i].length;
+			if(extent.length > EXT4_EXTENT_MAX_LENGTH) {
+				extent.length -= EXT4_EXTENT_MAX_LENGTH;
+				extent.uninitialized = true;
+			}
+			_extent_map.push_back(extent);
+		}
+		return Result(SUCCESS);
+	}
 
-	if(_metadata.is_device()) {
-		//TODO: Update device inode
-	} else {
-		for(uint32_t block_index = 0; block_index < 12; block_index++) {
-			raw.block_pointers[block_index] = get_block_pointer(block_index);
+	//Read each child node in order, so that the leaves end up sorted
+	auto* entries = (const ext4_extent_index*) (header + 1);
+	kstd::vector<uint8_t> block_buf(ext2fs().block_size(), 0);
+	for(size_t i = 0; i < header->entries; i++) {
+		uint32_t child = entries[i].leaf_lo;
+		if(entries[i].leaf_hi) {
+			KLog::err("ext2", "Inode %d has an extent node past the first 2^32 blocks!", id);
+			return Result(-EFBIG);
 		}
+		Result res = ext2fs().read_block(child, block_buf.storage());
+		if(res.is_error())
+			return res;
+		if(header->depth == 1)
+			_extent_leaf_blocks.push_back(child);
+		else
+			_extent_index_blocks.push_back(child);
+		res = read_extent_node(block_buf.storage(), block_buf.size(), header->depth - 1);
+		if(res.is_error())
+			return res;
 	}
+	return Result(SUCCESS);
+}
 
-	uint8_t block_buf[ext2fs().block_size()];
+size_t Ext2Inode::extent_upper_bound(uint32_t block_index) {
+	size_t lo = 0;
+	size_t hi = _extent_map.size();
+	while(lo < hi) {
+		size_t mid = (lo + hi) / 2;
+		if(_extent_map[mid].index <= block_index)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo;
+}
 
-	if(num_blocks() > 12) {
-		if (!raw.s_pointer) {
-			raw.s_pointer = ext2fs().allocate_block();
-			if (!raw.s_pointer) return Result(-ENOSPC); //Block allocation failed
+uint32_t Ext2Inode::get_extent_block(uint32_t block_index) {
+	if(load_extent_tree().is_error())
+		return 0;
+	size_t next = extent_upper_bound(block_index);
+	if(!next)
+		return 0;
+
+	//Uninitialized extents read as zeroes, so they're treated like holes
+	auto& extent = _extent_map[next - 1];
+	if(block_index - extent.index >= extent.length || extent.uninitialized)
+		return 0;
+	return extent.block + (block_index - extent.index);
+}
+
+Result Ext2Inode::set_extent_block(uint32_t block_index, uint32_t block) {
+	Result res = load_extent_tree();
+	if(res.is_error())
+		return res;
+	size_t next = extent_upper_bound(block_index);
+
+	//If the block is already mapped, split it out of the extent it's in first
+	if(next && block_index - _extent_map[next - 1].index < _extent_map[next - 1].length) {
+		size_t cur = next - 1;
+		auto extent = _extent_map[cur];
+		uint32_t offset = block_index - extent.index;
+		mark_extents_dirty(cur);
+
+		//Nothing else knows about the blocks of an uninitialized extent, so we're responsible for freeing them
+		if(extent.uninitialized) {
+			ext2fs().free_block(extent.block + offset);
+			raw.logical_blocks -= ext2fs().sectors_per_block;
 		}
-		pointer_blocks.push_back(raw.s_pointer);
 
-		//Write singly indirect block to disk
-		ext2fs().read_block(raw.s_pointer, block_buf);
-		for (uint32_t block_index = 12; block_index < 12 + ext2fs().block_pointers_per_block; block_index++) {
-			((uint32_t *) block_buf)[block_index - 12] = get_block_pointer(block_index);
+		if(extent.length == 1) {
+			_extent_map.erase(cur);
+			next = cur;
+		} else if(offset == 0) {
+			_extent_map[cur].index++;
+			_extent_map[cur].block++;
+			_extent_map[cur].length--;
+			next = cur;
+		} else if(offset == extent.length - 1) {
+			_extent_map[cur].length--;
+		} else {
+			_extent_map[cur].length = offset;
+			Extent tail = extent;
+			tail.index += offset + 1;
+			tail.block += offset + 1;
+			tail.length -= offset + 1;
+			_extent_map.insert(next, tail);
 		}
-		ext2fs().write_block(raw.s_pointer, block_buf);
-	} else raw.s_pointer = 0;
-
-	if(num_blocks() > 12 + ext2fs().block_pointers_per_block) {
-		//Allocate doubly indirect block if needed and read
-		if(!raw.d_pointer) {
-			raw.d_pointer = ext2fs().allocate_block();
-			if(!raw.d_pointer) return Result(-ENOSPC); //Block allocation failed
-			ext2fs().read_block(raw.d_pointer, block_buf);
-			memset(block_buf, 0, ext2fs().block_size());
-		} else ext2fs().read_block(raw.d_pointer, block_buf);
-		pointer_blocks.push_back(raw.d_pointer);
-
-		uint8_t dblock_buf[ext2fs().block_size()];
-
-		uint32_t cur_block = 12 + ext2fs().block_pointers_per_block;
-		//For each block pointed to in the doubly indirect block,
-		for(uint32_t dindex = 0; dindex < ext2fs().block_pointers_per_block; dindex++) {
-			if(!get_block_pointer(cur_block)) break;
-
-			uint32_t dblock = ((uint32_t*)block_buf)[dindex];
-			//If the block isn't allocated, allocate it
-			if(!dblock) {
-				dblock = ext2fs().allocate_block();
-				((uint32_t*)block_buf)[dindex] = dblock;
-				if(!dblock) return Result(-ENOSPC); //Allocation failed
+	}
+
+	//The block is in a hole now, so extend the extent before or after it if we can or add a new one
+	if(block) {
+		auto can_append = [&](Extent& extent) {
+			return !extent.uninitialized && extent.length < EXT4_EXTENT_MAX_LENGTH
+				&& extent.index + extent.length == block_index && extent.block + extent.length == block;
+		};
+		auto can_prepend = [&](Extent& extent) {
+			return !extent.uninitialized && extent.length < EXT4_EXTENT_MAX_LENGTH
+				&& extent.index == block_index + 1 && extent.block == block + 1;
+		};
+
+		if(next && can_append(_extent_map[next - 1])) {
+			auto& prev = _extent_map[next - 1];
+			mark_extents_dirty(next - 1);
+			prev.length++;
+			if(next < _extent_map.size() && can_prepend(_extent_map[next]) && prev.length + _extent_map[next].length <= EXT4_EXTENT_MAX_LENGTH) {
+				prev.length += _extent_map[next].length;
+				_extent_map.erase(next);
+			}
+		} else if(next < _extent_map.size() && can_prepend(_extent_map[next])) {
+			mark_extents_dirty(next);
+			_extent_map[next].index--;
+			_extent_map[next].block--;
+			_extent_map[next].length++;
+		} else {
+			Extent extent;
+			extent.index = block_index;
+			extent.block = block;
+			extent.length = 1;
+			mark_extents_dirty(next);
+			_extent_map.insert(next, extent);
+		}
+	}
+
+	return Result(SUCCESS);
+}
+
+void Ext2Inode::free_extents_from(uint32_t first_block) {
+	Result res = load_extent_tree();
+	if(res.is_error()) {
+		KLog::err("ext2", "Error %d reading extent tree of inode %d", res.code(), id);
+		return;
+	}
+
+	//Trim the extent containing the first block, then free every extent after it
+	size_t next = extent_upper_bound(first_block);
+	mark_extents_dirty(next ? next - 1 : 0);
+	if(next && first_block - _extent_map[next - 1].index < _extent_map[next - 1].length) {
+		auto& extent = _extent_map[next - 1];
+		uint32_t keep = first_block - extent.index;
+		ext2fs().free_blocks(extent.block + keep, extent.length - keep);
+		raw.logical_blocks -= (extent.length - keep) * ext2fs().sectors_per_block;
+		extent.length = keep;
+		if(!keep)
+			next--;
+	}
+	for(size_t i = next; i < _extent_map.size(); i++) {
+		ext2fs().free_blocks(_extent_map[i].block, _extent_map[i].length);
+		raw.logical_blocks -= _extent_map[i].length * ext2fs().sectors_per_block;
+	}
+	_extent_map.resize(next);
+
+	//Write the tree now so that any nodes that aren't needed anymore are freed, even if the inode is being deleted
+	res = flush_extent_tree();
+	if(res.is_error())
+		KLog::err("ext2", "Error %d writing extent tree of inode %d", res.code(), id);
+}
+
+Result Ext2Inode::flush_extent_tree() {
+	if(!_extent_map_dirty)
+		return Result(SUCCESS);
+
+	size_t block_size = ext2fs().block_size();
+	size_t per_node = (block_size - sizeof(ext4_extent_header)) / sizeof(ext4_extent);
+	size_t num_extents = _extent_map.size();
+	size_t num_leaves = num_extents <= EXT4_EXTENT_ROOT_ENTRIES ? 0 : (num_extents + per_node - 1) / per_node;
+
+	//Leaves keep the blocks they were in, so the ones that didn't change don't have to be written again
+	size_t old_num_leaves = _extent_leaf_blocks.size();
+	while(_extent_leaf_blocks.size() > num_leaves) {
+		free_extent_node_block(_extent_leaf_blocks[_extent_leaf_blocks.size() - 1]);
+		_extent_leaf_blocks.resize(_extent_leaf_blocks.size() - 1);
+	}
+	while(_extent_leaf_blocks.size() < num_leaves) {
+		uint32_t block = allocate_extent_node_block(_extent_map[_extent_leaf_blocks.size() * per_node].block);
+		if(!block)
+			return Result(-ENOSPC);
+		_extent_leaf_blocks.push_back(block);
+	}
+
+	//Fills out a node with a header and either leaf extents or index entries pointing to child nodes
+	auto fill_node = [&](uint8_t* node, size_t max_entries, int depth, Extent* entries, size_t count) {
+		auto* header = (ext4_extent_header*) node;
+		header->magic = EXT4_EXTENT_MAGIC;
+		header->entries = count;
+		header->max = max_entries;
+		header->depth = depth;
+		header->generation = 0;
+		for(size_t i = 0; i < count; i++) {
+			if(depth == 0) {
+				auto* extent = (ext4_extent*) (header + 1) + i;
+				extent->block = entries[i].index;
+				extent->length = entries[i].length + (entries[i].uninitialized ? EXT4_EXTENT_MAX_LENGTH : 0);
+				extent->start_hi = 0;
+				extent->start_lo = entries[i].block;
+			} else {
+				auto* index = (ext4_extent_index*) (header + 1) + i;
+				index->block = entries[i].index;
+				index->leaf_lo = entries[i].block;
+				index->leaf_hi = 0;
+				index->unused = 0;
 			}
-			pointer_blocks.push_back(dblock);
+		}
+	};
+
+	uint8_t root[sizeof(raw.block_pointers)];
+	memset(root, 0, sizeof(root));
+	kstd::vector<uint8_t> node_buf(block_size, 0);
+	size_t num_index_blocks = 0;
+	if(!num_leaves) {
+		fill_node(root, EXT4_EXTENT_ROOT_ENTRIES, 0, _extent_map.storage(), num_extents);
+	} else {
+		//Write the leaves that changed, and remember where each one starts for the level above
+		kstd::vector<Extent> children;
+		children.reserve(num_leaves);
+		for(size_t leaf = 0; leaf < num_leaves; leaf++) {
+			size_t first = leaf * per_node;
+			size_t count = min(per_node, num_extents - first);
+			if(leaf >= old_num_leaves || first + count > _extent_dirty_from) {
+				memset(node_buf.storage(), 0, block_size);
+				fill_node(node_buf.storage(), per_node, 0, &_extent_map[first], count);
+				Result res = ext2fs().write_block(_extent_leaf_blocks[leaf], node_buf.storage());
+				if(res.is_error())
+					return res;
+			}
+			Extent child;
+			child.index = _extent_map[first].index;
+			child.block = _extent_leaf_blocks[leaf];
+			children.push_back(child);
+		}
 
-			//Update entries in the block and write to disk
-			ext2fs().read_block(dblock, dblock_buf);
-			for(uint32_t dblock_index = 0; dblock_index < ext2fs().block_size() / sizeof(uint32_t); dblock_index++) {
-				((uint32_t *) dblock_buf)[dblock_index] = get_block_pointer(cur_block);
-				cur_block++;
+		//Add levels of index nodes until what's left fits in the root. There are few enough of these that they're just
+		//rewritten every time.
+		int depth = 1;
+		while(children.size() > EXT4_EXTENT_ROOT_ENTRIES) {
+			kstd::vector<Extent> parents;
+			for(size_t first = 0; first < children.size(); first += per_node) {
+				size_t count = min(per_node, children.size() - first);
+				if(num_index_blocks == _extent_index_blocks.size()) {
+					uint32_t block = allocate_extent_node_block(children[first].block);
+					if(!block)
+						return Result(-ENOSPC);
+					_extent_index_blocks.push_back(block);
+				}
+				uint32_t block = _extent_index_blocks[num_index_blocks++];
+				memset(node_buf.storage(), 0, block_size);
+				fill_node(node_buf.storage(), per_node, depth, &children[first], count);
+				Result res = ext2fs().write_block(block, node_buf.storage());
+				if(res.is_error())
+					return res;
+				Extent parent;
+				parent.index = children[first].index;
+				parent.block = block;
+				parents.push_back(parent);
 			}
-			ext2fs().write_block(dblock, dblock_buf);
+			children = kstd::move(parents);
+			depth++;
 		}
+		fill_node(root, EXT4_EXTENT_ROOT_ENTRIES, depth, children.storage(), children.size());
+	}
+
+	while(_extent_index_blocks.size() > num_index_blocks) {
+		free_extent_node_block(_extent_index_blocks[_extent_index_blocks.size() - 1]);
+		_extent_index_blocks.resize(_extent_index_blocks.size() - 1);
+	}
+
+	memcpy((uint8_t*) raw.block_pointers, root, sizeof(root));
+	_extent_map_dirty = false;
+	_extent_dirty_from = num_extents;
+	_dirty = true;
+	return Result(SUCCESS);
+}
 
-		//Write doubly-indirect block to disk
-		ext2fs().write_block(raw.d_pointer, block_buf);
-	} else raw.d_pointer = 0;
+uint32_t Ext2Inode::allocate_extent_node_block(uint32_t goal) {
+	uint32_t block = ext2fs().allocate_block(false, goal);
+	if(block)
+		raw.logical_blocks += ext2fs().sectors_per_block;
+	return block;
+}
 
-	if(num_blocks() > 12 + ext2fs().block_pointers_per_block * ext2fs().block_pointers_per_block) {
-		KLog::err("ext2", "Writing triply-indirect blocks to disk isn't supported yet!");
-		//TODO: Triply indirect blocks
-	} else raw.t_pointer = 0;
+void Ext2Inode::free_extent_node_block(uint32_t block) {
+	ext2fs().free_block(block);
+	raw.logical_blocks -= ext2fs().sectors_per_block;
+}
 
-	raw.logical_blocks = (block_pointers.size() + pointer_blocks.size()) * (ext2fs().block_size() / 512);
+void Ext2Inode::mark_extents_dirty(size_t first_changed) {
+	_extent_map_dirty = true;
 	_dirty = true;
+	if(first_changed < _extent_dirty_from)
+		_extent_dirty_from = first_changed;
+}
+
+Result Ext2Inode::write_to_disk() {
+	LOCK(lock);
+
+	Result res = flush_indirect_blocks();
+	if(res.is_error())
+		return res;
+
+	res = flush_extent_tree();
+	if(res.is_error())
+		return res;
+
+	res = write_inode_entry();
+	if(res.is_error())
+		return res;
+
 	return Result(SUCCESS);
 }
 
@@ -794,26 +1395,31 @@ Result Ext2Inode::try_remove_dir() {
 	return Result(SUCCESS);
 }
 
-uint32_t Ext2Inode::calculate_num_ptr_blocks(uint32_t num_blocks) {
-	if(num_blocks <= 12) return 0;
-
-	uint32_t ret = 0;
-	uint32_t blocks_left = num_blocks - 12;
-
-	//Singly indirect blocks
-	blocks_left -= min(blocks_left, ext2fs().block_pointers_per_block);
-	ret += 1;
-	if(blocks_left == 0) return ret;
-
-	//Doubly indirect blocks
-	uint32_t dind_blocks = min(blocks_left, ext2fs().block_pointers_per_block * ext2fs().block_pointers_per_block);
-	blocks_left -= dind_blocks;
-	ret += 1 + (dind_blocks + ext2fs().block_pointers_per_block - 1) / ext2fs().block_pointers_per_block;
-	if(blocks_left == 0) return ret;
+void Ext2Inode::prefetch(size_t start, size_t length) {
+	if(_metadata.is_device() || !exists()) return;
+	LOCK(lock);
 
-	//TODO: Calculate triply indirect blocks
-	PANIC("EXT2_TIND", "We don't know how to calculate triply indirect blocks yet!");
-	return ret;
+	size_t first_block = start / ext2fs().block_size();
+	size_t end_block = num_blocks();
+	if(length < _metadata.size - min(start, _metadata.size))
+		end_block = (start + length + ext2fs().block_size() - 1) / ext2fs().block_size();
+
+	//Prefetch runs of contiguous blocks together so that they can be read with as few commands as possible
+	uint32_t run_start = 0;
+	size_t run_length = 0;
+	for(size_t block_index = first_block; block_index < end_block; block_index++) {
+		uint32_t block = get_block_pointer(block_index);
+		if(run_length && block == run_start + run_length) {
+			run_length++;
+			continue;
+		}
+		if(run_length)
+			ext2fs().prefetch_blocks(run_start, run_length);
+		run_start = block;
+		run_length = block ? 1 : 0;
+	}
+	if(run_length)
+		ext2fs().prefetch_blocks(run_start, run_length);
 }
 
 void Ext2Inode::open(FileDescriptor& fd, int options) {
@@ -821,7 +1427,9 @@ void Ext2Inode::open(FileDescriptor& fd, int options) {
 }
 
 void Ext2Inode::close(FileDescriptor& fd) {
-
+	//Whoever was appending to the file is done with it, so don't keep blocks reserved for them
+	if(fd.writable())
+		release_preallocation();
 }
 
 
@@ -21,6 +21,15 @@
 
 #include <kernel/filesystem/Inode.h>
 #include <kernel/kstd/vector.hpp>
+#include <kernel/kstd/LRUCache.h>
+#include <kernel/kstd/Arc.h>
+
+//The number of indirect (pointer) blocks each inode keeps cached
+#define EXT2_INDIRECT_CACHE_SIZE 4
+//The number of runs of contiguous blocks each inode remembers
+#define EXT2_EXTENT_CACHE_SIZE 4
+//The number of extra blocks reserved after the end of a file when it grows, so that appends stay contiguous
+#define EXT2_PREALLOC_BLOCKS 8
 
 class Ext2Filesystem;
 class Ext2Inode: public Inode {
@@ -50,7 +59,7 @@ public:
 	} Raw;
 
 	explicit Ext2Inode(Ext2Filesystem& filesystem, ino_t i);
-	explicit Ext2Inode(Ext2Filesystem& filesystem, ino_t i, const Raw& raw, kstd::vector<uint32_t>& block_pointers, ino_t parent);
+	explicit Ext2Inode(Ext2Filesystem& filesystem, ino_t i, const Raw& raw, kstd::vector<uint32_t>& blocks, ino_t parent);
 	~Ext2Inode() override;
 
 	uint32_t block_group();
@@ -60,11 +69,11 @@ public:
 	Ext2Filesystem& ext2fs();
 
 	uint32_t get_block_pointer(uint32_t block_index);
-	bool set_block_pointer(uint32_t block_index, uint32_t block);
-	kstd::vector<uint32_t>& get_block_pointers();
+	Result set_block_pointer(uint32_t block_index, uint32_t block);
 	void free_all_blocks();
 
 	ssize_t read(size_t start, size_t length, SafePointer<uint8_t> buffer, FileDescriptor* fd) override;
+	ssize_t read_uncached(size_t start, size_t length, uint8_t* buffer) override;
 	ssize_t read_dir_entry(size_t start, SafePointer<DirectoryEntry> buffer, FileDescriptor* fd) override;
 	ssize_t write(size_t start, size_t length, SafePointer<uint8_t> buffer, FileDescriptor* fd) override;
 	ino_t find_id(const kstd::string& name) override;
@@ -76,24 +85,80 @@ public:
 	Result chown(uid_t uid, gid_t gid) override;
 	void open(FileDescriptor& fd, int options) override;
 	void close(FileDescriptor& fd) override;
+	void prefetch(size_t start, size_t length) override;
 
 private:
-	void read_singly_indirect(uint32_t singly_indirect_block, uint32_t& block_index);
-	void read_doubly_indirect(uint32_t doubly_indirect_block, uint32_t& block_index);
-	void read_triply_indirect(uint32_t triply_indirect_block, uint32_t& block_index);
-	void read_block_pointers();
+	/** A cached block of pointers to other blocks. **/
+	struct IndirectBlock {
+		IndirectBlock(uint32_t block, size_t num_pointers): block(block), pointers(num_pointers, 0) {}
+		uint32_t block;
+		kstd::vector<uint32_t> pointers;
+		bool dirty = false;
+	};
+
+	/** A run of blocks that are contiguous both in the file and on disk. **/
+	struct Extent {
+		uint32_t index = 0; ///< The index of the first block in the file.
+		uint32_t block = 0; ///< The first block on disk.
+		uint32_t length = 0;
+		bool uninitialized = false; ///< Whether the blocks are allocated but haven't been written yet (ext4 only).
+	};
+
+	int block_path(uint32_t block_index, uint32_t offsets[3]);
+	uint32_t root_pointer(int depth);
+	void set_root_pointer(int depth, uint32_t block);
+	ResultRet<kstd::Arc<IndirectBlock>> get_indirect_block(uint32_t block);
+	void cache_indirect_block(const kstd::Arc<IndirectBlock>& indirect);
+	Result write_indirect_block(IndirectBlock& indirect);
+	Result flush_indirect_blocks();
+	void cache_extent(uint32_t block_index, const uint32_t* pointers, uint32_t offset, uint32_t num_pointers);
+	void invalidate_extents();
+	void free_blocks_from(uint32_t first_block);
+
+	//Extent-mapped (ext4) inodes
+	bool uses_extents();
+	/** Reads the inode's extent tree into _extent_map if it hasn't been already. **/
+	Result load_extent_tree();
+	Result read_extent_node(const uint8_t* node, size_t node_size, int depth);
+	/** Returns the index of the first extent in _extent_map that starts after a block. **/
+	size_t extent_upper_bound(uint32_t block_index);
+	uint32_t get_extent_block(uint32_t block_index);
+	Result set_extent_block(uint32_t block_index, uint32_t block);
+	void free_extents_from(uint32_t first_block);
+	/** Writes any changes to the extent map back to the extent tree, allocating or freeing node blocks as needed. **/
+	Result flush_extent_tree();
+	uint32_t allocate_extent_node_block(uint32_t goal);
+	void free_extent_node_block(uint32_t block);
+	void mark_extents_dirty(size_t first_changed);
+	/** The block we'd like new blocks at the end of the file to be allocated at. **/
+	uint32_t allocation_goal();
+	/** Allocates blocks to be appended to the file, taking them from the preallocation window first. **/
+	ResultRet<kstd::vector<uint32_t>> allocate_file_blocks(uint32_t num_blocks);
+	/** Frees any blocks that were preallocated for the file but not used. **/
+	void release_preallocation();
+	bool free_pointer_block(uint32_t block, int level, uint32_t start, uint32_t first_block);
 	Result write_to_disk();
-	Result write_block_pointers();
 	Result write_inode_entry();
 	Result write_directory_entries(kstd::vector<DirectoryEntry>& entries);
 	void create_metadata();
 	void reduce_hardlink_count();
 	void increase_hardlink_count();
 	Result try_remove_dir();
-	uint32_t calculate_num_ptr_blocks(uint32_t num_blocks);
 
-	kstd::vector<uint32_t> block_pointers;
-	kstd::vector<uint32_t> pointer_blocks;
+	kstd::LRUCache<uint32_t, kstd::Arc<IndirectBlock>> _indirect_cache;
+	Extent _extents[EXT2_EXTENT_CACHE_SIZE];
+	size_t _next_extent = 0;
+	//The leaves of an extent-mapped inode's extent tree in order, and the blocks its nodes are stored in
+	kstd::vector<Extent> _extent_map;
+	kstd::vector<uint32_t> _extent_leaf_blocks;
+	kstd::vector<uint32_t> _extent_index_blocks;
+	bool _extent_map_loaded = false;
+	bool _extent_map_dirty = false;
+	//Leaves holding extents from this index on have to be rewritten on the next flush
+	size_t _extent_dirty_from = 0;
+	//A run of blocks right after the end of the file that's allocated on disk but not part of the file yet
+	uint32_t _prealloc_block = 0;
+	uint32_t _prealloc_count = 0;
 
 	Raw raw;
 	bool _dirty = false;
@@ -39,6 +39,8 @@ ProcFS::ProcFS() {
 	entries.push_back(ProcFSEntry(RootMemInfo, 0));
 	entries.push_back(ProcFSEntry(RootUptime, 0));
 	entries.push_back(ProcFSEntry(RootCpuInfo, 0));
+	entries.push_back(ProcFSEntry(RootCacheInfo, 0));
+	entries.push_back(ProcFSEntry(RootSlabInfo, 0));
 
 	root_inode = kstd::make_shared<ProcFSInode>(*this, entries[0]);
 }
@@ -31,6 +31,10 @@
 #include <kernel/tasking/Process.h>
 #include <kernel/memory/PageDirectory.h>
 #include <kernel/device/DiskDevice.h>
+#include <kernel/memory/InodeVMObject.h>
+#include <kernel/filesystem/FileBasedFilesystem.h>
+#include <kernel/filesystem/DentryCache.h>
+#include <kernel/memory/SlabCache.h>
 
 const char* PROC_STATE_NAMES[] = {"Running", "Zombie", "Dead", "Sleeping"};
 
@@ -130,7 +134,11 @@ ssize_t ProcFSInode::read(size_t start, size_t length, SafePointer<uint8_t> buff
 			str += numbuf;
 
 			str += "\nkcache = ";
-			itoa((int) DiskDevice::used_cache_memory(), numbuf, 10);
+			itoa((int) (DiskDevice::used_cache_memory() + InodeVMObject::used_cache_memory()), numbuf, 10);
+			str += numbuf;
+
+			str += "\nkdirty = ";
+			itoa((int) DiskDevice::dirty_cache_memory(), numbuf, 10);
 			str += numbuf;
 			str += "\n";
 
@@ -186,6 +194,83 @@ ssize_t ProcFSInode::read(size_t start, size_t length, SafePointer<uint8_t> buff
 			return length;
 		}
 
+		case RootCacheInfo: {
+			char numbuf[12];
+			kstd::string str;
+
+			auto append_stats = [&](const char* name, const kstd::LRUCacheStats& stats) {
+				str += "[";
+				str += name;
+				str += "]\nsize = ";
+				itoa((int) stats.size, numbuf, 10);
+				str += numbuf;
+
+				str += "\nhits = ";
+				itoa((int) stats.hits, numbuf, 10);
+				str += numbuf;
+
+				str += "\nmisses = ";
+				itoa((int) stats.misses, numbuf, 10);
+				str += numbuf;
+
+				str += "\nevictions = ";
+				itoa((int) stats.evictions, numbuf, 10);
+				str += numbuf;
+				str += "\n";
+			};
+
+			append_stats("blocks", DiskDevice::cache_stats());
+			str += "\n";
+			append_stats("pages", InodeVMObject::cache_stats());
+			str += "\n";
+			append_stats("inodes", FileBasedFilesystem::inode_cache_stats());
+			str += "\n";
+			append_stats("dentries", DentryCache::stats());
+
+			if(start >= str.length())
+				return 0;
+			if(start + length > str.length())
+				length = str.length() - start;
+			buffer.write((unsigned char*) str.c_str() + start, length);
+			return length;
+		}
+
+		case RootSlabInfo: {
+			char numbuf[12];
+			kstd::string str;
+
+			auto append_value = [&](const char* name, size_t value) {
+				str += name;
+				str += " = ";
+				itoa((int) value, numbuf, 10);
+				str += numbuf;
+				str += "\n";
+			};
+
+			str += "[slabs]\n";
+			append_value("pages", SlabCache::total_pages());
+			append_value("free_pages", SlabCache::free_pages());
+
+			for(auto& stats : SlabCache::all_stats()) {
+				str += "\n[";
+				str += stats.name;
+				str += "]\n";
+				append_value("object_size", stats.object_size);
+				append_value("active", stats.active_objects);
+				append_value("total", stats.total_objects);
+				append_value("slabs", stats.num_slabs);
+				append_value("allocs", stats.allocations);
+				append_value("frees", stats.frees);
+			}
+
+			if(start >= str.length())
+				return 0;
+			if(start + length > str.length())
+				length = str.length() - start;
+			buffer.write((unsigned char*) str.c_str() + start, length);
+			return length;
+		}
+
 		case ProcStatus: {
 			auto proc = TaskManager::process_for_pid(pid);
 			if(proc.is_error())
@@ -220,6 +305,10 @@ ssize_t ProcFSInode::read(size_t start, size_t length, SafePointer<uint8_t> buff
 			itoa(proc.value()->user().egid, numbuf, 10);
 			str += numbuf;
 
+			str += "\nnice = ";
+			itoa(proc.value()->nice(), numbuf, 10);
+			str += numbuf;
+
 			str += "\npmem = ";
 			itoa(proc.value()->used_pmem(), numbuf, 10);
 			str += numbuf;
@@ -233,6 +322,24 @@ ssize_t ProcFSInode::read(size_t start, size_t length, SafePointer<uint8_t> buff
 			str += numbuf;
 			str += "\n";
 
+			for(auto tid : proc.value()->threads()) {
+				auto thread = proc.value()->get_thread(tid);
+				if(!thread)
+					continue;
+
+				str += "\n[thread ";
+				itoa(tid, numbuf, 10);
+				str += numbuf;
+
+				str += "]\nuses_fpu = ";
+				str += thread->uses_fpu() ? "1" : "0";
+
+				str += "\nfpu_faults = ";
+				itoa(thread->fpu_faults(), numbuf, 10);
+				str += numbuf;
+				str += "\n";
+			}
+
 			if(start >= str.length())
 				return 0;
 			if(start + length > str.length())
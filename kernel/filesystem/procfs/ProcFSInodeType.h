@@ -30,6 +30,8 @@ enum ProcFSInodeType {
 	RootCmdLine,
 	RootUptime,
 	RootCpuInfo,
+	RootCacheInfo,
+	RootSlabInfo,
 
 	//Process entries
 	ProcExe,
@@ -52,6 +52,7 @@ public:
 	void open(FileDescriptor& fd, int options) override;
 	void close(FileDescriptor& fd) override;
 	bool can_read(const FileDescriptor& fd) override;
+	WaitQueue& poll_queue() override;
 
 private:
 	Type type;
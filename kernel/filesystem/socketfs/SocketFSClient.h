@@ -20,18 +20,19 @@
 #pragma once
 
 #include <kernel/kstd/Arc.h>
-#include <kernel/kstd/queue.hpp>
 #include <kernel/kstd/unix_types.h>
 #include <kernel/tasking/SpinLock.h>
+#include <kernel/memory/RingBuffer.h>
+#include "socketfs_defines.h"
 
 class Process;
 class SocketFSClient {
 public:
-	explicit SocketFSClient(sockid_t id, pid_t pid): id(id), pid(pid), data_queue() {}
+	explicit SocketFSClient(sockid_t id, pid_t pid): id(id), pid(pid), data_buffer(SOCKETFS_MAX_BUFFER_SIZE) {}
 
 	sockid_t id;
 	pid_t pid;
-	kstd::queue<uint8_t> data_queue;
+	RingBuffer data_buffer;
 	SpinLock data_lock;
 	BooleanBlocker blocker;
 };
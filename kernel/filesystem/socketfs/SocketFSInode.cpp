@@ -89,17 +89,7 @@ ssize_t SocketFSInode::read(size_t start, size_t length, SafePointer<uint8_t> bu
 		return -EIO;
 
 	LOCK(reader->data_lock);
-
-	if(length > reader->data_queue.size())
-		length = reader->data_queue.size();
-
-	//Read into the buffer from the queue
-	auto& queue = reader->data_queue;
-	for(size_t i = 0; i < length; i++) {
-		buffer.set(i, queue.front());
-		queue.pop_front();
-	}
-
+	length = reader->data_buffer.read(buffer, length);
 	reader->blocker.set_ready(true);
 
 	return length;
@@ -301,39 +291,41 @@ void SocketFSInode::close(FileDescriptor& fd) {
 bool SocketFSInode::can_read(const FileDescriptor& fd) {
 	auto id = SocketFS::client_hash(&fd);
 	if(id == host->id)
-		return !host->data_queue.empty();
+		return !host->data_buffer.empty();
 	for(auto& client : m_clients)
 		if(client->id == id)
-			return !client->data_queue.empty();
+			return !client->data_buffer.empty();
 	return false;
 }
 
 Result SocketFSInode::write_packet(const kstd::Arc<SocketFSClient>& client, int type, sockid_t sender, size_t length, int shm_id, int shm_perms, SafePointer<uint8_t> buffer, bool nonblock) {
-	//If there's room in the buffer, block (if O_NONBLOCK isn't set)
-	while(sizeof(SocketFSPacket) + length + client->data_queue.size() > SOCKETFS_MAX_BUFFER_SIZE) {
-		if(!nonblock) {
+	//A packet that could never fit in the buffer would block forever
+	if(sizeof(SocketFSPacket) + length > client->data_buffer.capacity())
+		return Result(-EMSGSIZE);
+
+	while(true) {
+		{
+			LOCK(client->data_lock);
+			if(client->data_buffer.free_space() >= sizeof(SocketFSPacket) + length) {
+				//Write the packet header and body
+				SocketFSPacket packet_header = {type, sender, TaskManager::current_process()->pid(), length, shm_id, shm_perms};
+				client->data_buffer.write(KernelPointer<uint8_t>((uint8_t*) &packet_header), sizeof(SocketFSPacket));
+				client->data_buffer.write(buffer, length);
+				break;
+			}
+
+			//If there isn't room in the buffer, block (if O_NONBLOCK isn't set) until the reader makes some
+			if(nonblock)
+				return Result(-ENOSPC);
 			client->blocker.set_ready(false);
-			TaskManager::current_thread()->block(client->blocker);
-			if(client->blocker.was_interrupted())
-				return Result(EINTR);
-		} else {
-			return Result(-ENOSPC);
 		}
-	}
-
-	//Acquire the lock
-	LOCK(client->data_lock);
 
-	//Write the packet header
-	SocketFSPacket packet_header = {type, sender, TaskManager::current_process()->pid(), length, shm_id, shm_perms};
-	auto* data = (const uint8_t*) &packet_header;
-	for(size_t i = 0; i < sizeof(SocketFSPacket); i++)
-		client->data_queue.push_back(*data++);
-
-	//Write the packet body
-	for(size_t i = 0; i < length; i++)
-		client->data_queue.push_back(buffer.get(i));
+		TaskManager::current_thread()->block(client->blocker);
+		if(client->blocker.was_interrupted())
+			return Result(-EINTR);
+	}
 
+	poll_queue().wake_all();
 	return Result(SUCCESS);
 }
 
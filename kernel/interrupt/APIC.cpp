@@ -0,0 +1,244 @@
+/* SPDX-License-Identifier: GPL-3.0-or-later */
+/* Copyright © 2016-2023 Byteduck */
+
+#include "APIC.h"
+#include "idt.h"
+#include <kernel/memory/MemoryManager.h>
+#include <kernel/tasking/CPU.h>
+#include <kernel/tasking/TaskManager.h>
+#include <kernel/kstd/KLog.h>
+
+#define APIC_REG_ID 0x20
+#define APIC_REG_EOI 0xB0
+#define APIC_REG_SPURIOUS 0xF0
+#define APIC_REG_ICR_LOW 0x300
+#define APIC_REG_ICR_HIGH 0x310
+
+#define APIC_SPURIOUS_ENABLE 0x100
+#define APIC_ICR_INIT 0x500
+#define APIC_ICR_STARTUP 0x600
+#define APIC_ICR_DELIVERY_PENDING 0x1000
+#define APIC_ICR_ASSERT 0x4000
+#define APIC_ICR_ALL_BUT_SELF 0xC0000
+
+#define ACPI_EBDA_POINTER 0x40E
+#define ACPI_BIOS_AREA 0xE0000
+#define ACPI_BIOS_AREA_SIZE 0x20000
+
+#define MADT_ENTRY_LOCAL_APIC 0
+#define MADT_LAPIC_ENABLED 0x1
+#define MADT_LAPIC_ONLINE_CAPABLE 0x2
+
+struct ACPIRSDP {
+	char signature[8];
+	uint8_t checksum;
+	char oem_id[6];
+	uint8_t revision;
+	uint32_t rsdt_address;
+} __attribute__((packed));
+
+struct ACPIHeader {
+	char signature[4];
+	uint32_t length;
+	uint8_t revision;
+	uint8_t checksum;
+	char oem_id[6];
+	char oem_table_id[8];
+	uint32_t oem_revision;
+	uint32_t creator_id;
+	uint32_t creator_revision;
+} __attribute__((packed));
+
+struct ACPIMADT {
+	ACPIHeader header;
+	uint32_t lapic_address;
+	uint32_t flags;
+} __attribute__((packed));
+
+struct ACPIMADTEntry {
+	uint8_t type;
+	uint8_t length;
+} __attribute__((packed));
+
+struct ACPIMADTLocalAPIC {
+	ACPIMADTEntry header;
+	uint8_t processor_id;
+	uint8_t apic_id;
+	uint32_t flags;
+} __attribute__((packed));
+
+namespace APIC {
+	kstd::Arc<VMRegion> s_lapic_region;
+	volatile uint32_t* s_lapic = nullptr;
+
+	static inline uint32_t read(size_t reg) {
+		return s_lapic[reg / sizeof(uint32_t)];
+	}
+
+	static inline void write(size_t reg, uint32_t value) {
+		s_lapic[reg / sizeof(uint32_t)] = value;
+	}
+
+	static void wait_for_delivery() {
+		while(read(APIC_REG_ICR_LOW) & APIC_ICR_DELIVERY_PENDING)
+			asm volatile("pause");
+	}
+
+	static void send_icr(uint8_t apic_id, uint32_t command) {
+		TaskManager::ScopedCritical critical;
+		wait_for_delivery();
+		write(APIC_REG_ICR_HIGH, (uint32_t) apic_id << 24);
+		write(APIC_REG_ICR_LOW, command);
+		wait_for_delivery();
+	}
+
+	/**
+	 * Maps a range of physical memory into kernel space and calls a function with a pointer to it. The mapping only
+	 * lasts until the function returns.
+	 */
+	template<typename F>
+	static auto with_physical(PhysicalAddress paddr, size_t size, F&& callback) {
+		PhysicalAddress page_start = (paddr / PAGE_SIZE) * PAGE_SIZE;
+		auto region = MM.alloc_mapped_region(page_start, size + (paddr - page_start));
+		return callback((uint8_t*) region->start() + (paddr - page_start));
+	}
+
+	static bool signature_matches(const uint8_t* ptr, const char* signature, size_t length) {
+		for(size_t i = 0; i < length; i++)
+			if(ptr[i] != (uint8_t) signature[i])
+				return false;
+		return true;
+	}
+
+	static bool checksum_valid(const uint8_t* ptr, size_t length) {
+		uint8_t sum = 0;
+		for(size_t i = 0; i < length; i++)
+			sum += ptr[i];
+		return sum == 0;
+	}
+
+	static PhysicalAddress find_rsdp() {
+		// The RSDP is on a 16-byte boundary in either the first KiB of the EBDA or the BIOS area below 1MiB
+		auto search = [](PhysicalAddress start, size_t size) {
+			return with_physical(start, size, [&](uint8_t* ptr) -> PhysicalAddress {
+				for(size_t offset = 0; offset + sizeof(ACPIRSDP) <= size; offset += 16) {
+					if(signature_matches(ptr + offset, "RSD PTR ", 8) && checksum_valid(ptr + offset, sizeof(ACPIRSDP)))
+						return start + offset;
+				}
+				return 0;
+			});
+		};
+
+		auto ebda = with_physical(ACPI_EBDA_POINTER, sizeof(uint16_t), [](uint8_t* ptr) {
+			return (PhysicalAddress) *((uint16_t*) ptr) << 4;
+		});
+		if(ebda) {
+			auto rsdp = search(ebda, 1024);
+			if(rsdp)
+				return rsdp;
+		}
+		return search(ACPI_BIOS_AREA, ACPI_BIOS_AREA_SIZE);
+	}
+
+	static PhysicalAddress find_table(PhysicalAddress rsdt, const char* signature) {
+		auto rsdt_length = with_physical(rsdt, sizeof(ACPIHeader), [](uint8_t* ptr) {
+			return ((ACPIHeader*) ptr)->length;
+		});
+		return with_physical(rsdt, rsdt_length, [&](uint8_t* ptr) -> PhysicalAddress {
+			if(!signature_matches(ptr, "RSDT", 4) || !checksum_valid(ptr, rsdt_length))
+				return 0;
+			auto* tables = (uint32_t*) (ptr + sizeof(ACPIHeader));
+			size_t num_tables = (rsdt_length - sizeof(ACPIHeader)) / sizeof(uint32_t);
+			for(size_t i = 0; i < num_tables; i++) {
+				bool matches = with_physical(tables[i], sizeof(ACPIHeader), [&](uint8_t* table) {
+					return signature_matches(table, signature, 4);
+				});
+				if(matches)
+					return tables[i];
+			}
+			return 0;
+		});
+	}
+
+	bool init() {
+		auto fail = [](const char* reason) {
+			KLog::dbg("APIC", "%s, only using the bootstrap processor.", reason);
+			CPU::init_bsp(0);
+			return false;
+		};
+
+		auto rsdp = find_rsdp();
+		if(!rsdp)
+			return fail("Couldn't find the ACPI RSDP");
+		auto rsdt = with_physical(rsdp, sizeof(ACPIRSDP), [](uint8_t* ptr) {
+			return (PhysicalAddress) ((ACPIRSDP*) ptr)->rsdt_address;
+		});
+		auto madt = find_table(rsdt, "APIC");
+		if(!madt)
+			return fail("Couldn't find the ACPI MADT");
+
+		auto madt_length = with_physical(madt, sizeof(ACPIHeader), [](uint8_t* ptr) {
+			return ((ACPIHeader*) ptr)->length;
+		});
+		with_physical(madt, madt_length, [&](uint8_t* ptr) {
+			auto* table = (ACPIMADT*) ptr;
+			s_lapic_region = MM.alloc_mapped_region(table->lapic_address, PAGE_SIZE);
+			s_lapic = (volatile uint32_t*) s_lapic_region->start();
+
+			// The bootstrap processor has to be registered first, so find out which one we are before the others
+			uint8_t bsp_id = id();
+			CPU::init_bsp(bsp_id);
+			for(size_t offset = sizeof(ACPIMADT); offset + sizeof(ACPIMADTEntry) <= madt_length;) {
+				auto* entry = (ACPIMADTEntry*) (ptr + offset);
+				if(!entry->length)
+					break;
+				if(entry->type == MADT_ENTRY_LOCAL_APIC) {
+					auto* lapic = (ACPIMADTLocalAPIC*) entry;
+					if((lapic->flags & (MADT_LAPIC_ENABLED | MADT_LAPIC_ONLINE_CAPABLE)) && lapic->apic_id != bsp_id)
+						CPU::add(lapic->apic_id);
+				}
+				offset += entry->length;
+			}
+			return true;
+		});
+
+		Interrupt::idt_set_gate(APIC_SPURIOUS_VECTOR, (unsigned) apic_spurious, 0x08, 0x8E);
+		init_local();
+
+		KLog::info("APIC", "Found %d processor(s).", CPU::count());
+		return true;
+	}
+
+	void init_local() {
+		write(APIC_REG_SPURIOUS, APIC_SPURIOUS_ENABLE | APIC_SPURIOUS_VECTOR);
+	}
+
+	bool available() {
+		return s_lapic;
+	}
+
+	uint8_t id() {
+		return read(APIC_REG_ID) >> 24;
+	}
+
+	void eoi() {
+		write(APIC_REG_EOI, 0);
+	}
+
+	void send_ipi(uint8_t apic_id, uint8_t vector) {
+		send_icr(apic_id, APIC_ICR_ASSERT | vector);
+	}
+
+	void broadcast_ipi(uint8_t vector) {
+		send_icr(0, APIC_ICR_ASSERT | APIC_ICR_ALL_BUT_SELF | vector);
+	}
+
+	void send_init(uint8_t apic_id) {
+		send_icr(apic_id, APIC_ICR_ASSERT | APIC_ICR_INIT);
+	}
+
+	void send_startup(uint8_t apic_id, PhysicalAddress entry) {
+		ASSERT(entry % PAGE_SIZE == 0 && entry < 0x100000);
+		send_icr(apic_id, APIC_ICR_ASSERT | APIC_ICR_STARTUP | (entry / PAGE_SIZE));
+	}
+}
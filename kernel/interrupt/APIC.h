@@ -0,0 +1,41 @@
+/* SPDX-License-Identifier: GPL-3.0-or-later */
+/* Copyright © 2016-2023 Byteduck */
+
+#pragma once
+
+#include <kernel/kstd/kstddef.h>
+#include <kernel/kstd/types.h>
+#include <kernel/memory/Memory.h>
+
+#define APIC_SPURIOUS_VECTOR 0xFF
+
+/**
+ * The local APIC of each processor, which we use to start the other processors and send interrupts between them.
+ * Legacy IRQs are still routed through the PIC to the bootstrap processor.
+ */
+namespace APIC {
+	/**
+	 * Finds the local APIC and the processors in the system using the ACPI MADT, registers each processor with CPU,
+	 * and enables the bootstrap processor's local APIC.
+	 * @return Whether an APIC was found. If not, only the bootstrap processor will be registered.
+	 */
+	bool init();
+
+	/** Enables the local APIC of the current processor. **/
+	void init_local();
+
+	bool available();
+	uint8_t id();
+	void eoi();
+
+	/** Sends an interrupt to the processor with the given local APIC ID. **/
+	void send_ipi(uint8_t apic_id, uint8_t vector);
+	/** Sends an interrupt to every processor except the current one. **/
+	void broadcast_ipi(uint8_t vector);
+	/** Sends an INIT IPI to a processor, which resets it and makes it wait for a startup IPI. **/
+	void send_init(uint8_t apic_id);
+	/** Sends a startup IPI to a processor, which makes it start executing in real mode at a page-aligned address. **/
+	void send_startup(uint8_t apic_id, PhysicalAddress entry);
+
+	extern "C" void apic_spurious();
+}
@@ -79,6 +79,12 @@ namespace Interrupt {
 					handle_fault("DIVIDE_BY_ZERO", "Please don't do that.", SIGILL);
 					break;
 
+				case 7: //FPU not available
+					if(!TaskManager::enabled() || TaskManager::is_preempting())
+						PANIC("FPU_NOT_AVAILABLE", "The FPU was used while it wasn't available.");
+					TaskManager::current_thread()->handle_fpu_fault();
+					break;
+
 				case 13: //GPF
 					handle_fault("GENERAL_PROTECTION_FAULT", "How did you manage to do that?", SIGILL);
 					break;
@@ -89,16 +95,29 @@ namespace Interrupt {
 					} else {
 						size_t err_pos;
 						asm volatile ("mov %%cr2, %0" : "=r" (err_pos));
+						// Faults from kernel mode are the kernel touching user memory on the thread's behalf (e.g. a
+						// syscall writing to a buffer that hasn't been faulted in yet), so treat them the same way.
 						PageFault::Type type;
-						if(r->err_code == FAULT_USER_READ)
-							type = PageFault::Type::Read;
-						else if(r->err_code == FAULT_USER_WRITE)
-							type = PageFault::Type::Write;
-						else
-							type = PageFault::Type::Unknown;
+						switch(r->err_code) {
+							case FAULT_USER_READ:
+							case FAULT_USER_READ_GPF:
+							case FAULT_KERNEL_READ:
+							case FAULT_KERNEL_READ_GPF:
+								type = PageFault::Type::Read;
+								break;
+							case FAULT_USER_WRITE:
+							case FAULT_USER_WRITE_GPF:
+							case FAULT_KERNEL_WRITE:
+							case FAULT_KERNEL_WRITE_GPF:
+								type = PageFault::Type::Write;
+								break;
+							default:
+								type = PageFault::Type::Unknown;
+						}
 						TaskManager::current_thread()->handle_pagefault({
 							err_pos,
 							r->eip,
+							type
 						});
 					}
 					break;
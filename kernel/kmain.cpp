@@ -26,12 +26,14 @@
 #include <kernel/device/Device.h>
 #include <kernel/time/TimeManager.h>
 #include <kernel/interrupt/interrupt.h>
+#include <kernel/interrupt/APIC.h>
 #include <kernel/CommandLine.h>
 #include <kernel/device/BochsVGADevice.h>
 #include <kernel/device/MultibootVGADevice.h>
 #include <kernel/tasking/TaskManager.h>
 #include <kernel/tasking/Process.h>
 #include <kernel/tasking/Thread.h>
+#include <kernel/tasking/CPU.h>
 #include <kernel/device/PATADevice.h>
 #include <kernel/terminal/VirtualTTY.h>
 #include <kernel/filesystem/ext2/Ext2Filesystem.h>
@@ -79,6 +81,7 @@ int kmain(uint32_t mbootptr){
 	Memory::load_gdt();
 	Interrupt::init();
 	MemoryManager::inst().setup_paging();
+	APIC::init();
 	VMWare::detect();
 	Device::init();
 
@@ -118,6 +121,10 @@ void kmain_late(){
 
 	TimeManager::init();
 
+	//Start the other processors if we were asked to
+	if(CommandLine::inst().has_option("smp"))
+		CPU::start_aps();
+
 	auto* tty0 = new VirtualTTY(4, 0);
 	tty0->set_active();
 	setup_tty();
@@ -3,92 +3,230 @@
 
 #pragma once
 
-#include "map.hpp"
-#include "vector.hpp"
+#include "hash.h"
 #include "pair.hpp"
 #include "../Result.hpp"
 #include "Optional.h"
 
 namespace kstd {
-	template<typename Key, typename Value>
+	/** Counters for how well an LRUCache is doing. **/
+	struct LRUCacheStats {
+		size_t hits = 0;
+		size_t misses = 0;
+		size_t evictions = 0;
+		size_t size = 0; ///< The number of items in the cache when the stats were taken.
+
+		LRUCacheStats& operator+=(const LRUCacheStats& other) {
+			hits += other.hits;
+			misses += other.misses;
+			evictions += other.evictions;
+			size += other.size;
+			return *this;
+		}
+	};
+
+	/**
+	 * A cache that keeps track of the order its items were used in. Items are kept in a hash table for lookup and in an
+	 * intrusive doubly linked list from least to most recently used, so every operation is O(1).
+	 */
+	template<typename Key, typename Value, typename Hash = kstd::hash<Key>>
 	class LRUCache {
 	public:
 		LRUCache() = default;
+		LRUCache(const LRUCache& other) = delete;
+		LRUCache& operator=(const LRUCache& other) = delete;
+
+		~LRUCache() {
+			clear();
+			delete[] m_buckets;
+		}
 
 		/** Insert the item with the given key and value, replacing it if it exists. **/
 		void insert(Key key, Value value) {
-			auto node = m_map.get(key);
+			auto node = find_node(key);
 			if(node) {
-				*node = value;
-				promote(key);
-			} else {
-				m_map.insert({key, value});
-				m_lru_list.push_back(key);
+				node->value = value;
+				move_to_back(node);
+				return;
 			}
+
+			if(m_size >= m_num_buckets)
+				grow();
+
+			node = new Node {key, value};
+			auto& bucket = m_buckets[bucket_index(key)];
+			node->hash_next = bucket;
+			bucket = node;
+			link_back(node);
+			m_size++;
 		}
 
 		/** Removes the item with the given key if it exists. **/
 		void erase(Key key) {
-			m_map.erase(key);
-			for(size_t i = 0; i < m_lru_list.size(); i++) {
-				if(m_lru_list[i] == key) {
-					m_lru_list.erase(i);
+			if(!m_size)
+				return;
+			Node** link = &m_buckets[bucket_index(key)];
+			while(*link) {
+				auto node = *link;
+				if(node->key == key) {
+					*link = node->hash_next;
+					unlink(node);
+					delete node;
+					m_size--;
 					return;
 				}
+				link = &node->hash_next;
 			}
 		}
 
 		/** Promote the item with the given key, if in the list, to be most recently used. **/
 		void promote(Key key) {
-			bool found = false;
-			for(size_t i = 0; i < m_lru_list.size(); i++) {
-				if(m_lru_list[i] == key) {
-					m_lru_list.erase(i);
-					found = true;
-					break;
-				}
-			}
+			auto node = find_node(key);
+			if(node)
+				move_to_back(node);
+		}
 
-			if(found)
-				m_lru_list.push_back(key);
+		/** Returns whether the item with the given key is in the cache, without promoting it or counting a hit or miss. **/
+		[[nodiscard]] bool contains(Key key) const {
+			return find_node(key);
 		}
 
 		/** Gets the item with the given key **/
 		kstd::Optional<Value> get(Key key) {
-			auto item = m_map.get(key);
-			if(item) {
-				promote(key);
-				return *item;
+			auto node = find_node(key);
+			if(node) {
+				m_stats.hits++;
+				move_to_back(node);
+				return node->value;
 			}
+			m_stats.misses++;
 			return kstd::nullopt;
 		}
 
 		/** Prunes a number of items from the cache. **/
 		void prune(size_t num) {
-			while(!m_lru_list.empty() && num--) {
-				m_map.erase(m_lru_list[0]);
-				m_lru_list.erase(0);
+			while(m_lru_head && num--) {
+				erase(m_lru_head->key);
+				m_stats.evictions++;
+			}
+		}
+
+		/** Removes every item from the cache. **/
+		void clear() {
+			while(m_lru_head) {
+				auto next = m_lru_head->lru_next;
+				delete m_lru_head;
+				m_lru_head = next;
 			}
+			m_lru_tail = nullptr;
+			for(size_t i = 0; i < m_num_buckets; i++)
+				m_buckets[i] = nullptr;
+			m_size = 0;
+		}
+
+		/** Calls a function with the key and value of every item, from least to most recently used. **/
+		template<typename F>
+		void for_each(F&& callback) {
+			for(auto node = m_lru_head; node; node = node->lru_next)
+				callback(node->key, node->value);
 		}
 
 		/** Returns the least recently used item. **/
 		kstd::Optional<kstd::pair<Key, Value&>> lru() {
 			if(empty())
 				return kstd::nullopt;
-			return kstd::pair<Key, Value&> {m_lru_list[0], m_map[m_lru_list[0]]};
+			return kstd::pair<Key, Value&> {m_lru_head->key, m_lru_head->value};
 		}
 
 		/** Returns the least recently used item without wrapping in an optional. **/
 		kstd::pair<Key, Value&> lru_unsafe() {
 			ASSERT(!empty());
-			return kstd::pair<Key, Value&> {m_lru_list[0], m_map[m_lru_list[0]]};
+			return kstd::pair<Key, Value&> {m_lru_head->key, m_lru_head->value};
 		}
 
-		[[nodiscard]] size_t size() const { return m_lru_list.size(); }
-		[[nodiscard]] bool empty() const { return m_lru_list.empty(); }
+		[[nodiscard]] size_t size() const { return m_size; }
+		[[nodiscard]] bool empty() const { return !m_size; }
+		[[nodiscard]] LRUCacheStats stats() const {
+			auto stats = m_stats;
+			stats.size = m_size;
+			return stats;
+		}
 
 	private:
-		kstd::map<Key, Value> m_map;
-		kstd::vector<Key> m_lru_list;
+		struct Node {
+			Key key;
+			Value value;
+			Node* hash_next = nullptr;
+			Node* lru_prev = nullptr;
+			Node* lru_next = nullptr;
+		};
+
+		static constexpr size_t initial_buckets = 16;
+
+		size_t bucket_index(const Key& key) const {
+			// The number of buckets is always a power of two
+			return Hash()(key) & (m_num_buckets - 1);
+		}
+
+		Node* find_node(const Key& key) const {
+			if(!m_size)
+				return nullptr;
+			auto node = m_buckets[bucket_index(key)];
+			while(node && !(node->key == key))
+				node = node->hash_next;
+			return node;
+		}
+
+		/** Doubles the number of hash buckets (or allocates the first ones) and rehashes every item. **/
+		void grow() {
+			size_t new_num_buckets = m_num_buckets ? m_num_buckets * 2 : initial_buckets;
+			auto new_buckets = new Node*[new_num_buckets];
+			for(size_t i = 0; i < new_num_buckets; i++)
+				new_buckets[i] = nullptr;
+
+			delete[] m_buckets;
+			m_buckets = new_buckets;
+			m_num_buckets = new_num_buckets;
+			for(auto node = m_lru_head; node; node = node->lru_next) {
+				auto& bucket = m_buckets[bucket_index(node->key)];
+				node->hash_next = bucket;
+				bucket = node;
+			}
+		}
+
+		void link_back(Node* node) {
+			node->lru_prev = m_lru_tail;
+			node->lru_next = nullptr;
+			if(m_lru_tail)
+				m_lru_tail->lru_next = node;
+			else
+				m_lru_head = node;
+			m_lru_tail = node;
+		}
+
+		void unlink(Node* node) {
+			if(node->lru_prev)
+				node->lru_prev->lru_next = node->lru_next;
+			else
+				m_lru_head = node->lru_next;
+			if(node->lru_next)
+				node->lru_next->lru_prev = node->lru_prev;
+			else
+				m_lru_tail = node->lru_prev;
+		}
+
+		void move_to_back(Node* node) {
+			if(node == m_lru_tail)
+				return;
+			unlink(node);
+			link_back(node);
+		}
+
+		Node** m_buckets = nullptr;
+		size_t m_num_buckets = 0;
+		size_t m_size = 0;
+		Node* m_lru_head = nullptr;
+		Node* m_lru_tail = nullptr;
+		LRUCacheStats m_stats;
 	};
-}
\ No newline at end of file
+}
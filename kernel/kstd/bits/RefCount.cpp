@@ -3,9 +3,12 @@
 
 #include "RefCount.h"
 #include "../../tasking/SpinLock.h"
+#include "../../memory/SlabCache.h"
 
 using namespace kstd;
 
+SLAB_CACHE(RefCount)
+
 RefCount::RefCount(int strong_count):
 		m_strong_count(strong_count),
 		m_weak_count(0) {}
@@ -19,6 +19,11 @@ namespace kstd {
 		RefCount(const RefCount& other) = delete;
 		~RefCount();
 
+		//Allocated from a SlabCache, like SLAB_ALLOCATED (which can't be used here since SlabCache.h depends on us)
+		static void* operator new(size_t size);
+		static void* operator new(size_t size, void* ptr) { return ptr; }
+		static void operator delete(void* ptr, size_t size);
+
 		/**
 		 * Gets the number of strong references.
 		 */
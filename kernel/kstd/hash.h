@@ -0,0 +1,40 @@
+/* SPDX-License-Identifier: GPL-3.0-or-later */
+/* Copyright © 2016-2023 Byteduck */
+
+#pragma once
+
+#include "types.h"
+
+namespace kstd {
+	/** Mixes the bits of an integer so that keys differing only in a few bits land in different hash buckets. **/
+	inline size_t hash_int(uint64_t val) {
+		val ^= val >> 33;
+		val *= 0xff51afd7ed558ccdULL;
+		val ^= val >> 33;
+		val *= 0xc4ceb9fe1a85ec53ULL;
+		val ^= val >> 33;
+		return (size_t) val;
+	}
+
+	/** Hashes a run of bytes (FNV-1a). **/
+	inline size_t hash_bytes(const void* data, size_t size) {
+		auto* bytes = (const uint8_t*) data;
+		uint32_t hash = 2166136261u;
+		for(size_t i = 0; i < size; i++) {
+			hash ^= bytes[i];
+			hash *= 16777619u;
+		}
+		return hash;
+	}
+
+	/** Hashes integral keys. Specialize this for other key types. **/
+	template<typename T>
+	struct hash {
+		size_t operator()(const T& val) const { return hash_int((uint64_t) val); }
+	};
+
+	template<typename T>
+	struct hash<T*> {
+		size_t operator()(T* val) const { return hash_int((uint64_t) (uintptr_t) val); }
+	};
+}
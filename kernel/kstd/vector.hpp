@@ -112,6 +112,22 @@ namespace kstd {
 			_size--;
 		}
 
+		void insert(size_t index, const T& elem) {
+			ASSERT(index <= _size);
+			if(index == _size) {
+				push_back(elem);
+				return;
+			}
+			if(_size + 1 > _capacity)
+				realloc(_capacity * 2);
+			for(size_t i = _size; i > index; i--) {
+				new(&_storage[i]) T(_storage[i - 1]);
+				_storage[i - 1].~T();
+			}
+			new(&_storage[index]) T(elem);
+			_size++;
+		}
+
 		void reserve(size_t new_capacity) {
 			if(new_capacity > _capacity)
 				realloc(new_capacity);
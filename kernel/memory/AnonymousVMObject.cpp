@@ -16,8 +16,15 @@ AnonymousVMObject::~AnonymousVMObject() {
 	}
 }
 
-ResultRet<kstd::Arc<AnonymousVMObject>> AnonymousVMObject::alloc(size_t size) {
+ResultRet<kstd::Arc<AnonymousVMObject>> AnonymousVMObject::alloc(size_t size, AllocType type) {
 	size_t num_pages = kstd::ceil_div(size, PAGE_SIZE);
+	if(type == AllocType::Lazy) {
+		kstd::vector<PageIndex> pages;
+		pages.resize(num_pages);
+		memset(pages.storage(), 0, pages.size() * sizeof(PageIndex));
+		return kstd::Arc<AnonymousVMObject>(new AnonymousVMObject(kstd::move(pages), false));
+	}
+
 	auto pages = TRY(MemoryManager::inst().alloc_physical_pages(num_pages));
 	auto object = kstd::Arc<AnonymousVMObject>(new AnonymousVMObject(pages, false));
 	auto tmp_mapped = MM.map_object(object);
@@ -89,6 +96,23 @@ ResultRet<VMProt> AnonymousVMObject::get_shared_permissions(pid_t pid) {
 	return node->data.second;
 }
 
+Result AnonymousVMObject::try_fault_in_page(PageIndex page) {
+	ASSERT(page < m_physical_pages.size());
+	LOCK(m_page_lock);
+
+	// Another space sharing this object may have beaten us to it
+	if(m_physical_pages[page])
+		return Result(SUCCESS);
+
+	auto new_page = TRY(MM.alloc_physical_page());
+	MM.with_quickmapped(new_page, [](void* page_buf) {
+		memset(page_buf, 0, PAGE_SIZE);
+	});
+	m_physical_pages[page] = new_page;
+
+	return Result(SUCCESS);
+}
+
 ResultRet<kstd::Arc<VMObject>> AnonymousVMObject::clone() {
 	LOCK(m_page_lock);
 	ASSERT(!is_shared());
@@ -13,14 +13,22 @@
 
 class AnonymousVMObject: public VMObject {
 public:
+	/** Whether physical pages are allocated (and zeroed) when an object is created, or when each is first touched. **/
+	enum class AllocType {
+		Lazy, Populate
+	};
+
 	~AnonymousVMObject() override;
 
 	/**
 	 * Allocates a new anonymous VMObject.
 	 * @param size The minimum size, in bytes, of the object.
+	 * @param type Whether to allocate the physical pages now or when they're first accessed. Lazily-allocated objects
+	 *             can only be accessed through a VMSpace that handles faults for them, so anything the kernel touches
+	 *             directly should be populated.
 	 * @return The newly allocated object, if successful.
 	 */
-	static ResultRet<kstd::Arc<AnonymousVMObject>> alloc(size_t size);
+	static ResultRet<kstd::Arc<AnonymousVMObject>> alloc(size_t size, AllocType type = AllocType::Lazy);
 
 	/**
 	 * Allocates a new anonymous VMObject backed by contiguous physical pages.
@@ -58,6 +66,16 @@ public:
 	 */
 	ResultRet<VMProt> get_shared_permissions(pid_t pid);
 
+	/**
+	 * Allocates and zeroes the physical page at the given index if it hasn't been allocated yet.
+	 * @param page The index of the page in the object.
+	 * @return Whether the page is now present.
+	 */
+	Result try_fault_in_page(PageIndex page);
+
+	/** Returns whether the page at the given index has been allocated yet. **/
+	bool page_is_present(PageIndex page) const { return m_physical_pages[page]; }
+
 	bool is_shared() const { return m_is_shared; }
 	pid_t shared_owner() const { return m_shared_owner; }
 	int shm_id() const { return m_shm_id; }
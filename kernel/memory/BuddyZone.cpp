@@ -40,6 +40,29 @@ ResultRet<PageIndex> BuddyZone::alloc_block(size_t num_pages) {
 	return m_first_page + block_index;
 }
 
+size_t BuddyZone::alloc_pages(size_t num_pages, PageIndex* pages) {
+	size_t num_allocated = 0;
+	unsigned int order = m_highest_order;
+	while(num_allocated < num_pages && m_free_pages) {
+		while(size_of_order(order) > num_pages - num_allocated)
+			order--;
+
+		// If there are no blocks this big left, try smaller ones
+		auto block_res = alloc_block_internal(order);
+		if(block_res.is_error()) {
+			if(!order)
+				break;
+			order--;
+			continue;
+		}
+
+		for(size_t i = 0; i < size_of_order(order); i++)
+			pages[num_allocated++] = page_of_block(block_res.value() + i);
+		m_free_pages -= size_of_order(order);
+	}
+	return num_allocated;
+}
+
 void BuddyZone::free_block(PageIndex start_page, size_t num_pages) {
 	ASSERT(start_page >= m_first_page);
 	ASSERT(start_page + num_pages <= m_first_page + m_num_pages);
@@ -49,7 +72,9 @@ void BuddyZone::free_block(PageIndex start_page, size_t num_pages) {
 }
 
 ResultRet<int> BuddyZone::alloc_block_internal(unsigned int order) {
-	ASSERT(order <= m_highest_order);
+	// We've run out of higher orders to split
+	if(order > m_highest_order)
+		return Result(ENOMEM);
 
 	auto& bucket = m_orders[order];
 	if(bucket.freelist == -1) {
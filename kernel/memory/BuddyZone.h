@@ -80,6 +80,16 @@ public:
 	 */
 	ResultRet<PageIndex> alloc_block(size_t num_pages);
 
+	/**
+	 * Allocates a number of pages in this zone that don't have to be contiguous. They're taken as runs of the biggest
+	 * blocks that fit in what's left to allocate, so that large allocations don't split and walk the freelists once
+	 * per page.
+	 * @param num_pages The number of pages to allocate.
+	 * @param pages The array to put the indices of the allocated pages in.
+	 * @returns The number of pages allocated, which may be fewer than requested if the zone runs out.
+	 */
+	size_t alloc_pages(size_t num_pages, PageIndex* pages);
+
 	/**
 	 * Frees a block in this zone.
 	 * @param start_page The start page of the block to free.
@@ -90,6 +100,7 @@ public:
 
 	PageIndex first_page() const { return m_first_page; }
 	size_t num_pages() const { return m_num_pages; }
+	size_t free_pages() const { return m_free_pages; }
 	bool contains_page(PageIndex page) const {
 		return page >= m_first_page && page < m_first_page + m_num_pages;
 	}
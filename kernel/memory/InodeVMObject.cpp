@@ -2,14 +2,25 @@
 /* Copyright © 2016-2023 Byteduck */
 
 #include "InodeVMObject.h"
+#include "MemoryManager.h"
+#include <kernel/kstd/cstring.h>
+
+SpinLock InodeVMObject::s_cache_lock;
+kstd::LRUCache<uint64_t, InodeVMObject::CachedPage> InodeVMObject::s_cache;
+kstd::LRUCache<uint64_t, InodeVMObject::CachedPage> InodeVMObject::s_mapped_cache;
+kstd::LRUCacheStats InodeVMObject::s_cache_stats;
 
 kstd::Arc<InodeVMObject> InodeVMObject::make_for_inode(kstd::Arc<Inode> inode, InodeVMObject::Type type) {
 	kstd::vector<PageIndex> pages;
 	pages.resize((inode->metadata().size + PAGE_SIZE - 1) / PAGE_SIZE);
 	memset(pages.storage(), 0, pages.size() * sizeof(PageIndex));
-	return kstd::Arc<InodeVMObject>(new InodeVMObject(pages, kstd::move(inode), type, false));
+	auto object = kstd::Arc<InodeVMObject>(new InodeVMObject(pages, inode, type, false));
+	object->m_inode_size = inode->metadata().size;
+	return object;
 }
 
+InodeVMObject::~InodeVMObject() = default;
+
 ResultRet<kstd::Arc<VMObject>> InodeVMObject::clone() {
 	ASSERT(m_inode);
 	LOCK(m_page_lock);
@@ -19,8 +30,287 @@ ResultRet<kstd::Arc<VMObject>> InodeVMObject::clone() {
 	return kstd::static_pointer_cast<VMObject>(new_object);
 }
 
+void InodeVMObject::region_mapped(VMRegion& region) {
+	// Our pages are moved to the mapped list lazily, as free_lru_page() or touch() come across them
+	LOCK(s_cache_lock);
+	m_num_mappings++;
+	if(region.prot().execute)
+		m_num_text_mappings++;
+}
+
+void InodeVMObject::region_prot_changed(VMRegion& region, const VMProt& old_prot) {
+	LOCK(s_cache_lock);
+	if(region.prot().execute && !old_prot.execute)
+		m_num_text_mappings++;
+	else if(!region.prot().execute && old_prot.execute)
+		m_num_text_mappings--;
+}
+
+bool InodeVMObject::text_busy() {
+	LOCK(s_cache_lock);
+	return m_type == Type::Shared && m_num_text_mappings;
+}
+
+void InodeVMObject::region_unmapped(VMRegion& region) {
+	// Declared before the lockers so that it's released after them
+	kstd::Arc<InodeVMObject> cache_ref;
+	LOCK(m_page_lock);
+	LOCK_N(s_cache_lock, cache_locker);
+	if(region.prot().execute)
+		m_num_text_mappings--;
+	if(--m_num_mappings)
+		return;
+
+	// If the inode was truncated while we were mapped, the pages past the end can be dropped now
+	cache_ref = shrink((m_inode_size + PAGE_SIZE - 1) / PAGE_SIZE);
+
+	// Put our pages back on the LRU so they can be reclaimed again
+	for(size_t index = 0; index < m_cache_regions.size(); index++) {
+		if(!m_cache_regions[index])
+			continue;
+		auto key = cache_key(this, index);
+		s_mapped_cache.erase(key);
+		s_cache.insert(key, {this, index, Time::now()});
+	}
+}
+
+ResultRet<PageIndex> InodeVMObject::get_page(size_t index, bool ref) {
+	auto region = TRY(get_cache_region(index));
+	auto& page = region->object()->physical_page(0);
+	if(ref)
+		page.ref();
+	return page.index();
+}
+
+ssize_t InodeVMObject::read(size_t start, size_t length, SafePointer<uint8_t> buffer) {
+	size_t nread = 0;
+	while(nread < length) {
+		size_t offset = start + nread;
+		auto region_res = get_cache_region(offset / PAGE_SIZE);
+		if(region_res.is_error())
+			return nread ? nread : -region_res.code();
+
+		// The region stays mapped for as long as we hold onto it, even if the page is evicted in the meantime, so we
+		// don't need to hold the lock (and risk faulting on the buffer with it held) while copying
+		size_t page_offset = offset % PAGE_SIZE;
+		size_t count = min(PAGE_SIZE - page_offset, length - nread);
+		buffer.write((uint8_t*) region_res.value()->start() + page_offset, nread, count);
+		nread += count;
+	}
+	return nread;
+}
+
+void InodeVMObject::write_cached(size_t start, const uint8_t* data, size_t length) {
+	LOCK(m_page_lock);
+	m_write_generation++;
+	if(start + length > m_inode_size) {
+		m_inode_size = start + length;
+		grow((m_inode_size + PAGE_SIZE - 1) / PAGE_SIZE);
+	}
+	size_t nwritten = 0;
+	while(nwritten < length) {
+		size_t offset = start + nwritten;
+		size_t page_offset = offset % PAGE_SIZE;
+		size_t count = min(PAGE_SIZE - page_offset, length - nwritten);
+		size_t index = offset / PAGE_SIZE;
+		if(index < m_cache_regions.size() && m_cache_regions[index])
+			memcpy((uint8_t*) m_cache_regions[index]->start() + page_offset, data + nwritten, count);
+		nwritten += count;
+	}
+}
+
+void InodeVMObject::truncate(size_t size) {
+	// Declared before the lockers so that if we drop our last cached page, the reference is released after them
+	kstd::Arc<InodeVMObject> cache_ref;
+	LOCK(m_page_lock);
+	m_write_generation++;
+	m_inode_size = size;
+	size_t num_pages = (size + PAGE_SIZE - 1) / PAGE_SIZE;
+	if(num_pages >= m_physical_pages.size()) {
+		grow(num_pages);
+		if(size % PAGE_SIZE && m_cache_regions[size / PAGE_SIZE])
+			memset((uint8_t*) m_cache_regions[size / PAGE_SIZE]->start() + size % PAGE_SIZE, 0, PAGE_SIZE - size % PAGE_SIZE);
+		return;
+	}
+
+	// Pages past the end can't be dropped while they might be mapped, so they're zeroed instead (which is what a
+	// mapping past the end of a file should see anyway) and dropped once the object is unmapped
+	for(size_t index = size / PAGE_SIZE; index < m_cache_regions.size(); index++) {
+		if(!m_cache_regions[index])
+			continue;
+		size_t page_offset = index == size / PAGE_SIZE ? size % PAGE_SIZE : 0;
+		memset((uint8_t*) m_cache_regions[index]->start() + page_offset, 0, PAGE_SIZE - page_offset);
+	}
+	LOCK_N(s_cache_lock, cache_locker);
+	if(!m_num_mappings)
+		cache_ref = shrink(num_pages);
+}
+
+void InodeVMObject::add_cow_page(size_t index, PageIndex page) {
+	ASSERT(m_type == Type::Private);
+	LOCK(m_page_lock);
+	ASSERT(!m_physical_pages[index]);
+	m_physical_pages[index] = page;
+	m_cow_pages.set(index, true);
+}
+
+size_t InodeVMObject::used_cache_memory() {
+	LOCK(s_cache_lock);
+	return (s_cache.size() + s_mapped_cache.size()) * PAGE_SIZE;
+}
+
+kstd::LRUCacheStats InodeVMObject::cache_stats() {
+	LOCK(s_cache_lock);
+	auto stats = s_cache_stats;
+	stats.size = s_cache.size() + s_mapped_cache.size();
+	return stats;
+}
+
+Time InodeVMObject::lru_time() {
+	LOCK(s_cache_lock);
+	auto lru = s_cache.lru();
+	if(!lru)
+		return Time::distant_future();
+	return lru.value().second.last_used;
+}
+
+bool InodeVMObject::free_lru_page() {
+	// Declared before the locker so that if this was the object's last page, it's destroyed after the lock is released
+	kstd::Arc<InodeVMObject> dead_object;
+	LOCK(s_cache_lock);
+
+	// A page can be freed once its object isn't mapped or being used anywhere, which is when the reference held by the
+	// cache is the only one. Pages of mapped objects are moved onto the mapped list as we come across them, so each one
+	// is only passed over once. Objects that are busy are skipped rather than waited on, since whoever has their lock
+	// may be allocating memory right now.
+	size_t busy_skips = 0;
+	while(!s_cache.empty()) {
+		auto lru = s_cache.lru_unsafe();
+		auto key = lru.first;
+		auto victim = lru.second;
+		auto* object = victim.object;
+		if(object->m_num_mappings) {
+			s_cache.erase(key);
+			s_mapped_cache.insert(key, victim);
+			continue;
+		}
+		if(object->m_cache_ref.ref_count()->strong_count() != 1 || !object->m_page_lock.try_acquire()) {
+			if(++busy_skips > max_busy_skips)
+				return false;
+			s_cache.promote(key);
+			continue;
+		}
+
+		auto& physical_page = object->m_physical_pages[victim.index];
+		MM.get_physical_page(physical_page).unref();
+		physical_page = 0;
+		object->m_cache_regions[victim.index].reset();
+		s_cache.erase(key);
+		s_cache_stats.evictions++;
+		if(!--object->m_num_cached)
+			dead_object = kstd::move(object->m_cache_ref);
+		object->m_page_lock.release();
+		return true;
+	}
+	return false;
+}
+
+ResultRet<kstd::Arc<VMRegion>> InodeVMObject::get_cache_region(size_t index) {
+	ASSERT(m_type == Type::Shared);
+	size_t write_generation;
+	{
+		LOCK(m_page_lock);
+		if(index < m_cache_regions.size() && m_cache_regions[index]) {
+			touch(index);
+			LOCK_N(s_cache_lock, cache_locker);
+			s_cache_stats.hits++;
+			return m_cache_regions[index];
+		}
+		write_generation = m_write_generation;
+	}
+
+	// Read the page straight into a new kernel region without holding our lock, since the inode will be locked to
+	// read it (and writes lock the inode before us). A write that lands while we're reading won't find the page in the
+	// cache to update, so if one happened, what we read may be stale and we have to read it again.
+	auto region = MM.alloc_kernel_region(PAGE_SIZE);
+	auto* buf = (uint8_t*) region->start();
+	while(true) {
+		ssize_t nread = m_inode->read_uncached(index * PAGE_SIZE, PAGE_SIZE, buf);
+		if(nread < 0)
+			return Result(-nread);
+		memset(buf + nread, 0, PAGE_SIZE - nread);
+
+		LOCK(m_page_lock);
+		grow(index + 1);
+		// Somebody else may have read the page in while we were
+		if(!m_cache_regions[index]) {
+			if(m_write_generation != write_generation) {
+				write_generation = m_write_generation;
+				continue;
+			}
+			auto& page = region->object()->physical_page(0);
+			page.ref();
+			m_physical_pages[index] = page.index();
+			m_cache_regions[index] = region;
+			if(!m_num_cached++)
+				m_cache_ref = kstd::static_pointer_cast<InodeVMObject>(self());
+		}
+		touch(index);
+		LOCK_N(s_cache_lock, cache_locker);
+		s_cache_stats.misses++;
+		return m_cache_regions[index];
+	}
+}
+
+kstd::Arc<InodeVMObject> InodeVMObject::shrink(size_t num_pages) {
+	if(num_pages >= m_physical_pages.size())
+		return {};
+
+	kstd::Arc<InodeVMObject> cache_ref;
+	for(size_t index = num_pages; index < m_physical_pages.size(); index++) {
+		if(!m_cache_regions[index])
+			continue;
+		MM.get_physical_page(m_physical_pages[index]).unref();
+		m_physical_pages[index] = 0;
+		m_cache_regions[index].reset();
+		s_cache.erase(cache_key(this, index));
+		s_mapped_cache.erase(cache_key(this, index));
+		if(!--m_num_cached)
+			cache_ref = kstd::move(m_cache_ref);
+	}
+	m_physical_pages.resize(num_pages);
+	m_cache_regions.resize(num_pages);
+	m_cow_pages = kstd::Bitmap(num_pages);
+	m_size = num_pages * PAGE_SIZE;
+	return cache_ref;
+}
+
+void InodeVMObject::grow(size_t num_pages) {
+	if(num_pages <= m_physical_pages.size())
+		return;
+	m_physical_pages.resize(num_pages);
+	m_cache_regions.resize(num_pages);
+	// Pages in the page cache are never CoW, so the bitmap can just be replaced
+	m_cow_pages = kstd::Bitmap(num_pages);
+	m_size = num_pages * PAGE_SIZE;
+}
+
+void InodeVMObject::touch(size_t index) {
+	LOCK(s_cache_lock);
+	auto key = cache_key(this, index);
+	if(m_num_mappings) {
+		s_cache.erase(key);
+		s_mapped_cache.insert(key, {this, index, Time::now()});
+	} else {
+		s_cache.insert(key, {this, index, Time::now()});
+	}
+}
+
 InodeVMObject::InodeVMObject(kstd::vector<PageIndex> physical_pages, kstd::Arc<Inode> inode, InodeVMObject::Type type, bool cow):
 	VMObject(kstd::move(physical_pages), cow),
 	m_inode(kstd::move(inode)),
 	m_type(type)
-{}
+{
+	if(m_type == Type::Shared)
+		m_cache_regions.resize(m_physical_pages.size());
+}
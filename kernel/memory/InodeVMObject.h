@@ -5,7 +5,18 @@
 
 #include "VMObject.h"
 #include "../filesystem/Inode.h"
+#include "../kstd/LRUCache.h"
+#include <kernel/time/Time.h>
 
+class VMRegion;
+
+/**
+ * A VMObject backed by an inode. Each inode has one Shared object, which is its page cache: read() and write() on the
+ * inode go through its pages, MAP_SHARED mappings map them directly, and Private (MAP_PRIVATE) objects start out
+ * sharing them copy-on-write. Pages in the page cache are kept in a single LRU across every inode, which is reclaimed
+ * from along with the disk block caches. Pages of objects that are mapped somewhere can't be reclaimed, so they're
+ * kept on a separate list until they're unmapped.
+ */
 class InodeVMObject: public VMObject {
 public:
 	enum class Type {
@@ -13,7 +24,7 @@ public:
 	};
 
 	static kstd::Arc<InodeVMObject> make_for_inode(kstd::Arc<Inode> inode, Type type);
-
+	~InodeVMObject() override;
 
 	PageIndex& physical_page_index(size_t index) const {
 		return m_physical_pages[index];
@@ -27,12 +38,86 @@ public:
 		return m_type == Type::Private ? ForkAction::BecomeCoW : ForkAction::Share;
 	}
 	ResultRet<kstd::Arc<VMObject>> clone() override;
+	void region_mapped(VMRegion& region) override;
+	void region_unmapped(VMRegion& region) override;
+	void region_prot_changed(VMRegion& region, const VMProt& old_prot) override;
+
+	// Page cache (Shared objects only)
+
+	/**
+	 * Gets a page of the page cache, reading it from the inode if it isn't cached yet.
+	 * @param index The index of the page in the inode.
+	 * @param ref Whether to take a reference to the physical page for the caller.
+	 */
+	ResultRet<PageIndex> get_page(size_t index, bool ref = false);
+	/** Copies part of the inode's data out of the page cache, reading in any pages that aren't cached. **/
+	ssize_t read(size_t start, size_t length, SafePointer<uint8_t> buffer);
+	/** Copies data that was written to the inode into any of the pages it covers that are cached, growing the object
+	 * if the write extended the inode. **/
+	void write_cached(size_t start, const uint8_t* data, size_t length);
+	/** Resizes the object to fit the new size of the inode, and zeroes everything in the cached pages past the end. **/
+	void truncate(size_t size);
+	/** Whether the object is mapped as executable anywhere, in which case the inode can't be written to. **/
+	bool text_busy();
+
+	// Private objects
+
+	/** Puts a page from the page cache into a Private object as a CoW page. The page must already be referenced. **/
+	void add_cow_page(size_t index, PageIndex page);
 
-	// TODO: Syncing
+	/** The amount of memory used by the page caches of every inode. **/
+	static size_t used_cache_memory();
+	static kstd::LRUCacheStats cache_stats();
+	/** The last time the least recently used page in any page cache was used. **/
+	static Time lru_time();
+	/** Frees the least recently used page cache page that isn't mapped anywhere. Returns whether one was freed. **/
+	static bool free_lru_page();
 
 private:
 	explicit InodeVMObject(kstd::vector<PageIndex> physical_pages, kstd::Arc<Inode> inode, Type type, bool cow);
 
+	struct CachedPage {
+		InodeVMObject* object;
+		size_t index;
+		Time last_used;
+	};
+
+	/** Gets the kernel region a page of the page cache is mapped into, reading it in if it isn't cached. **/
+	ResultRet<kstd::Arc<VMRegion>> get_cache_region(size_t index);
+	/** Grows the object to fit at least a number of pages. m_page_lock must be held. **/
+	void grow(size_t num_pages);
+	/**
+	 * Shrinks the object to a number of pages, dropping the cached pages past the end. m_page_lock and s_cache_lock must
+	 * be held, and the object must not be mapped anywhere.
+	 * @return The object's reference to itself if that dropped its last cached page, to be released after unlocking.
+	 */
+	kstd::Arc<InodeVMObject> shrink(size_t num_pages);
+	/** Marks a page as just used in the page cache LRU. m_page_lock must be held. **/
+	void touch(size_t index);
+	static uint64_t cache_key(InodeVMObject* object, size_t index) { return ((uint64_t) (uintptr_t) object << 32) | index; }
+
+	// The most times free_lru_page() will pass over pages of objects that are busy before giving up
+	static constexpr size_t max_busy_skips = 8;
+
+	static SpinLock s_cache_lock;
+	// Pages that can be reclaimed once nothing else is using their object
+	static kstd::LRUCache<uint64_t, CachedPage> s_cache;
+	// Pages of objects that are mapped somewhere, which are moved back to s_cache once they're unmapped
+	static kstd::LRUCache<uint64_t, CachedPage> s_mapped_cache;
+	static kstd::LRUCacheStats s_cache_stats;
+
 	kstd::Arc<Inode> m_inode;
 	Type m_type;
+	// The kernel mappings of the pages in the page cache, by page index
+	kstd::vector<kstd::Arc<VMRegion>> m_cache_regions;
+	size_t m_num_cached = 0;
+	// Bumped whenever the inode is written to or truncated, so that a page being read in can tell if it went stale
+	size_t m_write_generation = 0;
+	// The size of the inode as of the last write or truncate
+	size_t m_inode_size = 0;
+	// The number of regions mapping the object, and how many of those are executable. Protected by s_cache_lock.
+	size_t m_num_mappings = 0;
+	size_t m_num_text_mappings = 0;
+	// Keeps the object (and its inode) alive for as long as it has pages cached, even if nothing else is using it
+	kstd::Arc<InodeVMObject> m_cache_ref;
 };
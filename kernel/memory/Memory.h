@@ -23,6 +23,7 @@
 #define KERNEL_VIRTUAL_HEAP_BEGIN 0xE0000000
 #define KERNEL_QUICKMAP_PAGE_A (KERNEL_VIRTUAL_HEAP_BEGIN - PAGE_SIZE)
 #define KERNEL_QUICKMAP_PAGE_B (KERNEL_VIRTUAL_HEAP_BEGIN - (PAGE_SIZE * 2))
+#define AP_BOOT_PADDR 0x8000 //The physical address application processors start executing at
 
 // For disambiguating parameter meanings.
 typedef size_t PageIndex;
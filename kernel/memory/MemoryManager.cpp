@@ -25,10 +25,13 @@
 #include "MemoryManager.h"
 #include <kernel/multiboot.h>
 #include "AnonymousVMObject.h"
+#include "SlabCache.h"
 #include <kernel/interrupt/isr.h>
 #include <kernel/device/DiskDevice.h>
 #include <kernel/tasking/Thread.h>
 #include <kernel/tasking/TaskManager.h>
+#include <kernel/tasking/WaitQueue.h>
+#include <kernel/tasking/SleepBlocker.h>
 #include <kernel/kstd/KLog.h>
 
 size_t usable_bytes_ram = 0;
@@ -45,6 +48,59 @@ uint8_t early_kheap_memory[0x200000]; // 2MiB
 size_t used_early_kheap_memory = 0;
 bool did_setup_paging = false;
 
+static WaitQueue s_reclaimer_queue;
+static bool s_reclaim_requested = false;
+
+/**
+ * Blocks the reclaimer until free memory drops below the low watermark.
+ */
+class ReclaimerBlocker: public Blocker {
+public:
+	bool is_ready() override {
+		return s_reclaim_requested;
+	}
+
+	bool can_be_interrupted() override {
+		return false;
+	}
+
+protected:
+	void on_block() override {
+		s_reclaimer_queue.add(m_entry, *this);
+	}
+
+	void on_unblock() override {
+		WaitQueue::remove(m_entry);
+	}
+
+private:
+	WaitQueue::Entry m_entry;
+};
+
+void kreclaimer_entry() {
+	while(true) {
+		ReclaimerBlocker blocker;
+		TaskManager::current_thread()->block(blocker);
+		{
+			TaskManager::ScopedCritical critical;
+			s_reclaim_requested = false;
+		}
+
+		// Slab pages that aren't being used are given back first, since they don't cost anything to get rid of
+		SlabCache::shrink();
+
+		bool made_progress = true;
+		while(made_progress && MM.free_physical_pages() < MM.reclaim_low_watermark() * 2)
+			made_progress = DiskDevice::free_pages(MM_RECLAIM_BATCH) == MM_RECLAIM_BATCH;
+
+		// If the caches are empty, give it a bit before trying again instead of waking up for every allocation
+		if(!made_progress) {
+			SleepBlocker sleep_blocker(Time(1, 0));
+			TaskManager::current_thread()->block(sleep_blocker);
+		}
+	}
+}
+
 MemoryManager* MemoryManager::_inst;
 kstd::Arc<VMRegion> kernel_text_region;
 kstd::Arc<VMRegion> kernel_data_region;
@@ -186,11 +242,11 @@ void MemoryManager::parse_mboot_memory_map(struct multiboot_info* header, struct
 		uint32_t addr_pagealigned = ((addr + PAGE_SIZE - 1) / PAGE_SIZE) * PAGE_SIZE;
 		uint32_t size_pagealigned = ((size - (addr_pagealigned - addr)) / PAGE_SIZE) * PAGE_SIZE;
 
-		// We don't want the zero page.
-		if(addr_pagealigned == 0) {
-			addr_pagealigned += PAGE_SIZE;
-			if(size_pagealigned)
-				size_pagealigned -= PAGE_SIZE;
+		// We don't want the zero page, or the page the AP trampoline is copied to (or anything in between).
+		if(addr_pagealigned <= AP_BOOT_PADDR) {
+			size_t skip = AP_BOOT_PADDR + PAGE_SIZE - addr_pagealigned;
+			addr_pagealigned += skip;
+			size_pagealigned = size_pagealigned > skip ? size_pagealigned - skip : 0;
 		}
 
 		if(size_pagealigned / PAGE_SIZE < 2) {
@@ -275,36 +331,55 @@ void MemoryManager::parse_mboot_memory_map(struct multiboot_info* header, struct
 }
 
 ResultRet<PageIndex> MemoryManager::alloc_physical_page() const {
-	for(size_t i = 0; i < m_physical_regions.size(); i++) {
-		auto result = m_physical_regions[i]->alloc_page();
-		if(!result.is_error()) {
-			PageIndex ret = result.value();
-			// Set the refcount of the page to 1
-			auto& page = get_physical_page(ret);
-			page.allocated.ref_count = 1;
-			page.allocated.reserved = false;
-			return ret;
-		}
+	PageIndex page;
+	alloc_physical_pages(&page, 1);
+	return page;
+}
+
+ResultRet<kstd::vector<PageIndex>> MemoryManager::alloc_physical_pages(size_t num_pages) const {
+	kstd::vector<PageIndex> pages;
+	pages.resize(num_pages);
+	alloc_physical_pages(pages.storage(), num_pages);
+	return pages;
+}
+
+void MemoryManager::alloc_physical_pages(PageIndex* pages, size_t num_pages) const {
+	size_t num_allocated = 0;
+	while(true) {
+		for(size_t i = 0; i < m_physical_regions.size() && num_allocated < num_pages; i++)
+			num_allocated += m_physical_regions[i]->alloc_bulk(num_pages - num_allocated, pages + num_allocated);
+		if(num_allocated == num_pages)
+			break;
+
+		// The reclaimer couldn't keep up with us, so we have no choice but to free some memory from the caches here
+		if(!DiskDevice::free_pages(num_pages - num_allocated))
+			PANIC("NO_MEM", "The system ran out of physical memory.");
 	}
 
-	// We couldn't allocate any physical pages. Try freeing four for good measure.
-	if(DiskDevice::free_pages(4) >= 1)
-		return alloc_physical_page();
+	for(size_t i = 0; i < num_pages; i++) {
+		auto& page = get_physical_page(pages[i]);
+		page.allocated.ref_count = 1;
+		page.allocated.reserved = false;
+	}
 
-	// No more pages. This is bad.
-	PANIC("NO_MEM", "The system ran out of physical memory.");
+	if(!s_reclaim_requested && free_physical_pages() < reclaim_low_watermark()) {
+		TaskManager::ScopedCritical critical;
+		s_reclaim_requested = true;
+		s_reclaimer_queue.wake_all();
+	}
 }
 
-ResultRet<kstd::vector<PageIndex>> MemoryManager::alloc_physical_pages(size_t num_pages) const {
-	// If we already know we won't have enough free memory, try freeing twice as many up in the disk cache first
-	if((usable_bytes_ram - used_pmem()) / PAGE_SIZE < num_pages)
-		DiskDevice::free_pages(num_pages * 2);
+size_t MemoryManager::free_physical_pages() const {
+	size_t free_pages = 0;
+	for(size_t i = 0; i < m_physical_regions.size(); i++) {
+		if(!m_physical_regions[i]->reserved())
+			free_pages += m_physical_regions[i]->free_pages();
+	}
+	return free_pages;
+}
 
-	auto new_pages = kstd::vector<PageIndex>();
-	new_pages.reserve(num_pages);
-	while(num_pages--)
-		new_pages.push_back(TRY(MemoryManager::inst().alloc_physical_page()));
-	return new_pages;
+size_t MemoryManager::reclaim_low_watermark() const {
+	return usable_bytes_ram / PAGE_SIZE / MM_RECLAIM_DIVISOR;
 }
 
 ResultRet<kstd::vector<PageIndex>> MemoryManager::alloc_contiguous_physical_pages(size_t num_pages) const {
@@ -329,7 +404,7 @@ ResultRet<kstd::vector<PageIndex>> MemoryManager::alloc_contiguous_physical_page
 
 kstd::Arc<VMRegion> MemoryManager::alloc_kernel_region(size_t size) {
 	auto do_alloc = [&]() -> ResultRet<kstd::Arc<VMRegion>> {
-		auto object = TRY(AnonymousVMObject::alloc(size));
+		auto object = TRY(AnonymousVMObject::alloc(size, AnonymousVMObject::AllocType::Populate));
 		return TRY(m_kernel_space->map_object(object, VMProt::RW));
 	};
 	auto res = do_alloc();
@@ -391,8 +466,7 @@ ResultRet<VirtualAddress> MemoryManager::alloc_heap_pages(size_t num_pages) {
 	if(num_pages > 4906)
 		PANIC("KHEAP_ALLOC_TOO_BIG", "Tried allocating more than 4096 pages at once for the kernel heap.");
 
-	for(size_t i = 0; i < num_pages; i++)
-		m_heap_pages[i] = TRY(alloc_physical_page());
+	alloc_physical_pages(m_heap_pages.storage(), num_pages);
 	m_num_heap_pages = num_pages;
 
 	// Find a free area in the heap space. We don't allocate it yet, as that would call `kmalloc` :)
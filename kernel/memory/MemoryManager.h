@@ -64,6 +64,14 @@ struct multiboot_mmap_entry;
 
 #define MM MemoryManager::inst()
 
+//The reclaimer tries to keep 1/MM_RECLAIM_DIVISOR of usable memory free, and frees up to twice that once it's woken up
+#define MM_RECLAIM_DIVISOR 64
+//The number of pages the reclaimer frees from the disk caches at once
+#define MM_RECLAIM_BATCH 32
+
+/** The entry point of the kernel thread that frees memory from the caches in the background. **/
+void kreclaimer_entry();
+
 static_assert(PAGE_SIZE % sizeof(uint32_t) == 0, "Page size is not uint32_t-aligned!");
 
 class MemoryManager {
@@ -109,6 +117,9 @@ public:
 	/** Allocates non-contiguous physical pages for use. The resulting pages will have a refcount of 1. **/
 	ResultRet<kstd::vector<PageIndex>> alloc_physical_pages(size_t num_pages) const;
 
+	/** The number of physical pages that are free to be allocated. **/
+	size_t free_physical_pages() const;
+
 	/** Allocates contiguous physical pages for use. The resulting pages will have a refcount of 1. **/
 	ResultRet<kstd::vector<PageIndex>> alloc_contiguous_physical_pages(size_t num_pages) const;
 
@@ -221,6 +232,16 @@ public:
 
 private:
 	friend class PhysicalRegion;
+	friend void kreclaimer_entry();
+
+	/**
+	 * Allocates non-contiguous physical pages into an array. The resulting pages will have a refcount of 1. If there
+	 * isn't enough free memory, pages are freed from the disk caches right away; otherwise, the reclaimer is woken up
+	 * when free memory gets low, so that allocations don't have to wait for it.
+	 */
+	void alloc_physical_pages(PageIndex* pages, size_t num_pages) const;
+	/** The number of free pages below which the reclaimer is woken up. **/
+	size_t reclaim_low_watermark() const;
 
 	static MemoryManager* _inst;
 
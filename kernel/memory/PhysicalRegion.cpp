@@ -40,22 +40,10 @@ PhysicalRegion::~PhysicalRegion() {
 }
 
 ResultRet<PageIndex> PhysicalRegion::alloc_page() {
-	if(m_reserved)
-		return Result(ENOMEM);
-
-	LOCK(m_lock);
-	if(!m_free_pages)
+	PageIndex page;
+	if(!alloc_bulk(1, &page))
 		return Result(ENOMEM);
-
-	for(size_t zone = 0; zone < m_zones.size(); zone++) {
-		auto page_res = m_zones[zone]->alloc_block(1);
-		if(!page_res.is_error()) {
-			m_free_pages--;
-			return page_res.value();
-		}
-	}
-
-	return Result(ENOMEM);
+	return page;
 }
 
 ResultRet<PageIndex> PhysicalRegion::alloc_pages(size_t num_pages) {
@@ -70,30 +58,63 @@ ResultRet<PageIndex> PhysicalRegion::alloc_pages(size_t num_pages) {
 	if(order > BuddyZone::MAX_ORDER)
 		return Result(EINVAL);
 
-	for(size_t zone = 0; zone < m_zones.size(); zone++) {
-		auto page_res = m_zones[zone]->alloc_block(num_pages);
-		if(!page_res.is_error()) {
-			m_free_pages -= num_pages;
-			return page_res.value();
+	// The pages we need might be sitting in the page cache, so give it back to the zones before giving up
+	for(int attempt = 0; attempt < 2; attempt++) {
+		for(size_t zone = 0; zone < m_zones.size(); zone++) {
+			auto page_res = m_zones[zone]->alloc_block(num_pages);
+			if(!page_res.is_error()) {
+				m_free_pages -= num_pages;
+				return page_res.value();
+			}
 		}
+		if(!m_cache_count)
+			break;
+		drain_cache(m_cache_count);
 	}
 
 	return Result(ENOMEM);
 }
 
+size_t PhysicalRegion::alloc_bulk(size_t num_pages, PageIndex* pages) {
+	if(m_reserved)
+		return 0;
+
+	LOCK(m_lock);
+	size_t num_allocated = 0;
+
+	// Single pages come from the hot end of the cache, refilling it from the zones if it's empty
+	if(num_pages == 1 && !m_cache_count && m_free_pages) {
+		for(size_t zone = 0; zone < m_zones.size() && m_cache_count < PAGE_CACHE_BATCH; zone++)
+			m_cache_count += m_zones[zone]->alloc_pages(PAGE_CACHE_BATCH - m_cache_count, m_cache + m_cache_count);
+		m_cache_head = 0;
+	}
+
+	while(num_allocated < num_pages && m_cache_count) {
+		pages[num_allocated++] = m_cache[m_cache_head];
+		m_cache_head = (m_cache_head + 1) % PAGE_CACHE_SIZE;
+		m_cache_count--;
+	}
+
+	// Bigger allocations take whole runs of blocks straight from the zones
+	for(size_t zone = 0; zone < m_zones.size() && num_allocated < num_pages; zone++) {
+		if(m_zones[zone]->free_pages())
+			num_allocated += m_zones[zone]->alloc_pages(num_pages - num_allocated, pages + num_allocated);
+	}
+
+	m_free_pages -= num_allocated;
+	return num_allocated;
+}
+
 void PhysicalRegion::free_page(PageIndex page) {
 	ASSERT(!m_reserved);
 	ASSERT(page >= m_start_page && page < m_start_page + m_num_pages);
 	LOCK(m_lock);
-	for(size_t i = 0; i < m_zones.size(); i++) {
-		auto zone = m_zones[i];
-		if(zone->contains_page(page)) {
-			m_free_pages++;
-			zone->free_block(page, 1);
-			return;
-		}
-	}
-	ASSERT(false);
+	if(m_cache_count == PAGE_CACHE_SIZE)
+		drain_cache(PAGE_CACHE_BATCH);
+	m_cache_head = (m_cache_head + PAGE_CACHE_SIZE - 1) % PAGE_CACHE_SIZE;
+	m_cache[m_cache_head] = page;
+	m_cache_count++;
+	m_free_pages++;
 }
 
 bool PhysicalRegion::contains_page(PageIndex page) {
@@ -110,3 +131,20 @@ void PhysicalRegion::init() {
 		page.free.next = -1;
 	}
 }
+
+BuddyZone* PhysicalRegion::zone_for(PageIndex page) {
+	// Every zone is as big as it can be except the ones at the very end, so we can go straight to the right one (or
+	// the first of the small ones at the end)
+	size_t zone = min((page - m_start_page) / BuddyZone::MAX_ZONE_SIZE, m_zones.size() - 1);
+	while(!m_zones[zone]->contains_page(page))
+		zone++;
+	return m_zones[zone];
+}
+
+void PhysicalRegion::drain_cache(size_t num_pages) {
+	while(num_pages-- && m_cache_count) {
+		auto page = m_cache[(m_cache_head + m_cache_count - 1) % PAGE_CACHE_SIZE];
+		m_cache_count--;
+		zone_for(page)->free_block(page, 1);
+	}
+}
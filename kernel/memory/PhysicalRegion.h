@@ -8,6 +8,17 @@
 #include "../kstd/vector.hpp"
 #include "../tasking/SpinLock.h"
 
+// The number of free pages each region keeps in its page cache instead of giving them back to its buddy zones
+#define PAGE_CACHE_SIZE 128
+// The number of pages moved between a region's page cache and its buddy zones at once
+#define PAGE_CACHE_BATCH 32
+
+/**
+ * A range of physical memory, split into buddy zones. Single pages are allocated from and freed to a small cache of free
+ * pages in front of the zones, so that allocating a page that was just freed doesn't merge and split buddies every
+ * time. The most recently freed (hot) pages are handed out first, and the pages that have sat in the cache the longest
+ * (cold) are the ones given back to the zones when it fills up.
+ */
 class PhysicalRegion {
 public:
 	PhysicalRegion(size_t start_page, size_t num_pages, bool reserved, bool used);
@@ -30,6 +41,14 @@ public:
 	 */
 	ResultRet<PageIndex> alloc_pages(size_t num_pages);
 
+	/**
+	 * Allocates pages in this region that don't have to be contiguous.
+	 * @param num_pages The number of pages to allocate.
+	 * @param pages The array to put the indices of the allocated pages in (absolute).
+	 * @return The number of pages allocated, which may be fewer than requested if the region runs out.
+	 */
+	size_t alloc_bulk(size_t num_pages, PageIndex* pages);
+
 	/**
 	 * Frees a page in this region.
 	 * @param page The index of the page to free (absolute).
@@ -44,8 +63,15 @@ protected:
 	void init();
 
 private:
+	BuddyZone* zone_for(PageIndex page);
+	/** Gives the coldest pages in the page cache back to the buddy zones. m_lock must be held. **/
+	void drain_cache(size_t num_pages);
+
 	SpinLock m_lock;
 	kstd::vector<BuddyZone*> m_zones;
+	PageIndex m_cache[PAGE_CACHE_SIZE]; // A ring of free pages, from hottest to coldest starting at m_cache_head
+	size_t m_cache_head = 0;
+	size_t m_cache_count = 0;
 	PageIndex m_start_page;
 	size_t m_num_pages;
 	size_t m_free_pages;
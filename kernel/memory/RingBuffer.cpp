@@ -0,0 +1,63 @@
+/* SPDX-License-Identifier: GPL-3.0-or-later */
+/* Copyright © 2016-2023 Byteduck */
+
+#include "RingBuffer.h"
+#include <kernel/kstd/kstdlib.h>
+
+RingBuffer::RingBuffer(size_t capacity):
+	m_region(MM.alloc_kernel_region(capacity)),
+	m_data((uint8_t*) m_region->start()),
+	m_capacity(capacity)
+{}
+
+size_t RingBuffer::read(SafePointer<uint8_t> buffer, size_t count) {
+	if(count > m_size)
+		count = m_size;
+	if(!count)
+		return 0;
+
+	size_t first_count = min(count, m_capacity - m_start);
+	buffer.write(m_data + m_start, 0, first_count);
+	if(first_count < count)
+		buffer.write(m_data, first_count, count - first_count);
+
+	m_size -= count;
+	// Start from the beginning again when empty so that future copies are less likely to wrap around
+	m_start = m_size ? (m_start + count) % m_capacity : 0;
+	return count;
+}
+
+size_t RingBuffer::write(SafePointer<uint8_t> buffer, size_t count) {
+	if(count > free_space())
+		count = free_space();
+	if(!count)
+		return 0;
+
+	size_t end = (m_start + m_size) % m_capacity;
+	size_t first_count = min(count, m_capacity - end);
+	buffer.read(m_data + end, 0, first_count);
+	if(first_count < count)
+		buffer.read(m_data, first_count, count - first_count);
+
+	m_size += count;
+	return count;
+}
+
+Result RingBuffer::resize(size_t new_capacity) {
+	if(new_capacity < m_size)
+		return Result(-EBUSY);
+	if(new_capacity == m_capacity)
+		return Result(SUCCESS);
+
+	auto new_region = MM.alloc_kernel_region(new_capacity);
+	auto* new_data = (uint8_t*) new_region->start();
+	size_t size = m_size;
+	read(KernelPointer<uint8_t>(new_data), size);
+
+	m_region = new_region;
+	m_data = new_data;
+	m_capacity = new_capacity;
+	m_start = 0;
+	m_size = size;
+	return Result(SUCCESS);
+}
@@ -0,0 +1,104 @@
+/* SPDX-License-Identifier: GPL-3.0-or-later */
+/* Copyright © 2016-2023 Byteduck */
+
+#pragma once
+
+#include "SafePointer.h"
+#include "VMRegion.h"
+#include <kernel/kstd/kstdlib.h>
+
+/**
+ * A fixed-capacity FIFO byte buffer backed by kernel pages. Data is copied in and out in at most two memcpys (one if
+ * it doesn't wrap around the end of the buffer), so it's suitable for moving large amounts of data between processes.
+ * This does no locking of its own.
+ */
+class RingBuffer {
+public:
+	explicit RingBuffer(size_t capacity);
+
+	/**
+	 * Copies data out of the buffer, removing it.
+	 * @param buffer The buffer to copy into.
+	 * @param count The maximum number of bytes to copy.
+	 * @return The number of bytes copied, which is less than count if there wasn't enough data.
+	 */
+	size_t read(SafePointer<uint8_t> buffer, size_t count);
+
+	/**
+	 * Copies data into the buffer.
+	 * @param buffer The buffer to copy from.
+	 * @param count The maximum number of bytes to copy.
+	 * @return The number of bytes copied, which is less than count if there wasn't enough space.
+	 */
+	size_t write(SafePointer<uint8_t> buffer, size_t count);
+
+	/**
+	 * Fills the buffer by calling a producer with each contiguous span of free space in turn, so that data can be
+	 * copied in directly from somewhere else (like a file) without an intermediate buffer.
+	 * @param count The maximum number of bytes to add.
+	 * @param producer A function taking (uint8_t* dest, size_t max) and returning the number of bytes it wrote to dest
+	 *                 or a negative error. Returning less than max stops the fill.
+	 * @return The number of bytes added, or the producer's error if nothing was added.
+	 */
+	template<typename F>
+	ssize_t fill(size_t count, F&& producer) {
+		count = min(count, free_space());
+		size_t total = 0;
+		while(total < count) {
+			size_t end = (m_start + m_size) % m_capacity;
+			size_t span = min(count - total, m_capacity - end);
+			ssize_t nread = producer(m_data + end, span);
+			if(nread < 0)
+				return total ? (ssize_t) total : nread;
+			m_size += nread;
+			total += nread;
+			if((size_t) nread < span)
+				break;
+		}
+		return total;
+	}
+
+	/**
+	 * Drains the buffer by calling a consumer with each contiguous span of data in turn. The counterpart to fill().
+	 * @param count The maximum number of bytes to remove.
+	 * @param consumer A function taking (const uint8_t* src, size_t count) and returning the number of bytes it used or
+	 *                 a negative error. Returning less than count stops the drain.
+	 * @return The number of bytes removed, or the consumer's error if nothing was removed.
+	 */
+	template<typename F>
+	ssize_t drain(size_t count, F&& consumer) {
+		count = min(count, m_size);
+		size_t total = 0;
+		while(total < count) {
+			size_t span = min(count - total, m_capacity - m_start);
+			ssize_t nwritten = consumer((const uint8_t*) m_data + m_start, span);
+			if(nwritten < 0)
+				return total ? (ssize_t) total : nwritten;
+			m_size -= nwritten;
+			m_start = m_size ? (m_start + nwritten) % m_capacity : 0;
+			total += nwritten;
+			if((size_t) nwritten < span)
+				break;
+		}
+		return total;
+	}
+
+	/**
+	 * Changes the capacity of the buffer, keeping its contents.
+	 * @return -EBUSY if the buffer holds more data than the new capacity.
+	 */
+	Result resize(size_t new_capacity);
+
+	[[nodiscard]] size_t size() const { return m_size; }
+	[[nodiscard]] size_t capacity() const { return m_capacity; }
+	[[nodiscard]] size_t free_space() const { return m_capacity - m_size; }
+	[[nodiscard]] bool empty() const { return !m_size; }
+	[[nodiscard]] bool full() const { return m_size == m_capacity; }
+
+private:
+	kstd::Arc<VMRegion> m_region;
+	uint8_t* m_data;
+	size_t m_capacity;
+	size_t m_start = 0;
+	size_t m_size = 0;
+};
@@ -0,0 +1,263 @@
+/* SPDX-License-Identifier: GPL-3.0-or-later */
+/* Copyright © 2016-2023 Byteduck */
+
+#include "SlabCache.h"
+#include "Memory.h"
+#include <kernel/kstd/kstdlib.h>
+
+/** The pages shared by every slab cache, and the list of caches. **/
+struct SlabCache::Pool {
+	SpinLock lock;
+	Chunk* partial_chunks = nullptr; //Chunks with some of their pages free
+	Chunk* empty_chunks = nullptr; //Chunks with all of their pages free
+	size_t num_free = 0;
+	size_t num_pages = 0;
+	int num_growing = 0;
+	SlabCache* caches = nullptr;
+};
+
+SlabCache::Pool& SlabCache::pool() {
+	//Slab caches can be used before global constructors are run, so this is constructed on first use
+	static Pool pool;
+	return pool;
+}
+
+SlabCache::SlabCache(const char* name, size_t object_size, size_t alignment):
+	m_name(name)
+{
+	//Free objects hold the free list pointer, so they need to be at least that big
+	if(alignment < sizeof(void*))
+		alignment = sizeof(void*);
+	m_object_size = ((max(object_size, sizeof(void*)) + alignment - 1) / alignment) * alignment;
+	m_first_object = ((sizeof(Slab) + alignment - 1) / alignment) * alignment;
+	m_objects_per_slab = (PAGE_SIZE - m_first_object) / m_object_size;
+	ASSERT(m_objects_per_slab);
+
+	LOCK(pool().lock);
+	m_next_cache = pool().caches;
+	pool().caches = this;
+}
+
+void* SlabCache::alloc() {
+	m_lock.acquire();
+	if(!m_partial) {
+		if(m_empty) {
+			auto* slab = m_empty;
+			unlink(m_empty, slab);
+			link(m_partial, slab);
+		} else {
+			//Getting a page may allocate from this cache, so the lock can't be held while doing so
+			m_lock.release();
+			auto* slab = alloc_page();
+			slab->cache = this;
+			slab->free_list = nullptr;
+			slab->num_free = m_objects_per_slab;
+			for(size_t i = m_objects_per_slab; i > 0; i--) {
+				auto* object = (uint8_t*) slab + m_first_object + (i - 1) * m_object_size;
+				*(void**) object = slab->free_list;
+				slab->free_list = object;
+			}
+			m_lock.acquire();
+			link(m_partial, slab);
+			m_num_slabs++;
+		}
+	}
+
+	auto* slab = m_partial;
+	void* object = slab->free_list;
+	slab->free_list = *(void**) object;
+	if(!--slab->num_free) {
+		unlink(m_partial, slab);
+		link(m_full, slab);
+	}
+	m_active++;
+	m_allocations++;
+	m_lock.release();
+	return object;
+}
+
+void SlabCache::free(void* ptr) {
+	auto* slab = (Slab*) ((VirtualAddress) ptr & ~(PAGE_SIZE - 1));
+	ASSERT(slab->cache == this);
+
+	Slab* unused_slab = nullptr;
+	{
+		LOCK(m_lock);
+		*(void**) ptr = slab->free_list;
+		slab->free_list = ptr;
+		if(!slab->num_free++) {
+			unlink(m_full, slab);
+			link(m_partial, slab);
+		}
+		m_active--;
+		m_frees++;
+
+		if(slab->num_free == m_objects_per_slab) {
+			//Keep one empty slab around, so that a cache going back and forth over the end of a slab doesn't keep
+			//getting and giving back pages
+			unlink(m_partial, slab);
+			if(m_empty) {
+				unused_slab = slab;
+				m_num_slabs--;
+			} else {
+				link(m_empty, slab);
+			}
+		}
+	}
+
+	if(unused_slab)
+		free_page(unused_slab);
+}
+
+SlabCache::Stats SlabCache::stats() {
+	LOCK(m_lock);
+	return {
+		.name = m_name,
+		.object_size = m_object_size,
+		.active_objects = m_active,
+		.total_objects = m_num_slabs * m_objects_per_slab,
+		.num_slabs = m_num_slabs,
+		.allocations = m_allocations,
+		.frees = m_frees
+	};
+}
+
+kstd::vector<SlabCache::Stats> SlabCache::all_stats() {
+	//The heap can't be used with the pool locked, so count the caches first and then collect them. Caches are only
+	//ever added to the front of the list, so the first ones we count are the ones we'll collect.
+	kstd::vector<SlabCache*> caches;
+	size_t num_caches = 0;
+	{
+		LOCK(pool().lock);
+		for(auto* cache = pool().caches; cache; cache = cache->m_next_cache)
+			num_caches++;
+	}
+	caches.reserve(num_caches);
+	{
+		LOCK(pool().lock);
+		auto* cache = pool().caches;
+		for(size_t i = 0; i < num_caches; i++, cache = cache->m_next_cache)
+			caches.push_back(cache);
+	}
+
+	kstd::vector<Stats> ret;
+	ret.reserve(caches.size());
+	for(auto* cache : caches)
+		ret.push_back(cache->stats());
+	return ret;
+}
+
+size_t SlabCache::total_pages() {
+	LOCK(pool().lock);
+	return pool().num_pages;
+}
+
+size_t SlabCache::free_pages() {
+	LOCK(pool().lock);
+	return pool().num_free;
+}
+
+size_t SlabCache::shrink() {
+	auto& pool = SlabCache::pool();
+
+	//The heap may free slab objects while we're giving it memory back, so the chunks are taken out of the pool first and
+	//then freed without holding the lock
+	Chunk* unused_chunks = nullptr;
+	size_t num_freed = 0;
+	{
+		LOCK(pool.lock);
+		while(pool.empty_chunks && pool.num_free >= SLAB_RESERVE_PAGES + SLAB_CHUNK_PAGES) {
+			auto* chunk = pool.empty_chunks;
+			unlink(pool.empty_chunks, chunk);
+			link(unused_chunks, chunk);
+			pool.num_free -= SLAB_CHUNK_PAGES;
+			pool.num_pages -= SLAB_CHUNK_PAGES;
+			num_freed += SLAB_CHUNK_PAGES;
+		}
+	}
+
+	while(unused_chunks) {
+		auto* chunk = unused_chunks;
+		unused_chunks = chunk->next;
+		kfree(chunk->allocation);
+	}
+	return num_freed;
+}
+
+SlabCache::Slab* SlabCache::alloc_page() {
+	auto& pool = SlabCache::pool();
+	Slab* page = nullptr;
+	bool grow;
+	{
+		LOCK(pool.lock);
+		//Use up partially free chunks first, so that the empty ones can be given back
+		auto*& chunks = pool.partial_chunks ? pool.partial_chunks : pool.empty_chunks;
+		if(chunks) {
+			auto* chunk = chunks;
+			page = chunk->free_pages;
+			chunk->free_pages = page->next;
+			if(chunk->num_free-- == SLAB_CHUNK_PAGES) {
+				unlink(pool.empty_chunks, chunk);
+				link(pool.partial_chunks, chunk);
+			}
+			if(!chunk->num_free)
+				unlink(pool.partial_chunks, chunk);
+			pool.num_free--;
+		}
+		//Top off the reserve, unless somebody else is already doing so and there was a page left for us
+		grow = !page || (pool.num_free < SLAB_RESERVE_PAGES && !pool.num_growing);
+		if(grow)
+			pool.num_growing++;
+	}
+	if(!grow)
+		return page;
+
+	//The heap may allocate slab objects while it's getting more memory, so none of our locks can be held here
+	size_t chunk_size = (SLAB_CHUNK_PAGES + 1) * PAGE_SIZE;
+	auto allocation = (VirtualAddress) kmalloc(chunk_size);
+	ASSERT(allocation);
+	auto first_page = (allocation + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1);
+
+	//The chunk's header goes in whichever end of the allocation is left over after aligning the pages, since one of them
+	//is always at least half a page
+	auto* chunk = (Chunk*) (first_page - allocation >= sizeof(Chunk) ? allocation : first_page + SLAB_CHUNK_PAGES * PAGE_SIZE);
+	chunk->allocation = (void*) allocation;
+	chunk->free_pages = nullptr;
+	chunk->num_free = 0;
+	for(size_t i = 0; i < SLAB_CHUNK_PAGES; i++) {
+		auto* new_page = (Slab*) (first_page + i * PAGE_SIZE);
+		new_page->cache = nullptr;
+		new_page->chunk = chunk;
+		if(!page) {
+			page = new_page;
+			continue;
+		}
+		new_page->next = chunk->free_pages;
+		chunk->free_pages = new_page;
+		chunk->num_free++;
+	}
+
+	LOCK(pool.lock);
+	if(chunk->num_free)
+		link(pool.partial_chunks, chunk);
+	pool.num_free += chunk->num_free;
+	pool.num_pages += SLAB_CHUNK_PAGES;
+	pool.num_growing--;
+	return page;
+}
+
+void SlabCache::free_page(Slab* page) {
+	auto& pool = SlabCache::pool();
+	LOCK(pool.lock);
+	auto* chunk = page->chunk;
+	page->cache = nullptr;
+	page->next = chunk->free_pages;
+	chunk->free_pages = page;
+	if(!chunk->num_free++)
+		link(pool.partial_chunks, chunk);
+	if(chunk->num_free == SLAB_CHUNK_PAGES) {
+		unlink(pool.partial_chunks, chunk);
+		link(pool.empty_chunks, chunk);
+	}
+	pool.num_free++;
+}
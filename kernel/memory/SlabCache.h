@@ -0,0 +1,146 @@
+/* SPDX-License-Identifier: GPL-3.0-or-later */
+/* Copyright © 2016-2023 Byteduck */
+
+#pragma once
+
+#include <kernel/kstd/types.h>
+#include <kernel/kstd/vector.hpp>
+#include <kernel/tasking/SpinLock.h>
+
+//The number of pages the slab allocator takes from the kernel heap at once. They're given back together once all of them
+//are unused.
+#define SLAB_CHUNK_PAGES 16
+//The number of free pages the slab allocator tries to keep on hand, so that slab objects allocated by the heap while
+//it's getting more memory for us can still be allocated
+#define SLAB_RESERVE_PAGES 4
+
+/**
+ * A cache of fixed-size objects, for kernel objects that are created and destroyed all the time. Objects are carved out
+ * of page-sized slabs that each belong to a single cache, so allocating or freeing one is just popping or pushing a free
+ * list under the cache's own lock instead of a first-fit search of the heap under the heap lock. Freed objects stay in
+ * their slab for the next allocation, and a slab is only given back once all of its objects are free. Pages that no
+ * cache is using are given back to the heap by shrink(), which the reclaimer calls when memory is low.
+ *
+ * Classes opt into having their own cache with SLAB_ALLOCATED and SLAB_CACHE.
+ */
+class SlabCache {
+public:
+	struct Stats {
+		const char* name;
+		size_t object_size;
+		size_t active_objects;
+		size_t total_objects;
+		size_t num_slabs;
+		size_t allocations;
+		size_t frees;
+	};
+
+	SlabCache(const char* name, size_t object_size, size_t alignment);
+	SlabCache(const SlabCache& other) = delete;
+
+	void* alloc();
+	void free(void* ptr);
+	Stats stats();
+
+	/** Gets the stats of every slab cache that has been created. **/
+	static kstd::vector<Stats> all_stats();
+	/** The number of pages the slab allocator has taken from the heap, including ones that aren't being used. **/
+	static size_t total_pages();
+	/** The number of pages the slab allocator has that aren't being used by any cache. **/
+	static size_t free_pages();
+	/**
+	 * Gives chunks of pages that no cache is using back to the heap, keeping SLAB_RESERVE_PAGES on hand. No locks that
+	 * the heap uses may be held when calling this.
+	 * @return The number of pages given back.
+	 */
+	static size_t shrink();
+
+private:
+	struct Chunk;
+	struct Pool;
+
+	/** The header at the start of each slab's page. Pages that aren't being used by a cache have a null cache. **/
+	struct Slab {
+		SlabCache* cache;
+		Chunk* chunk;
+		Slab* prev;
+		Slab* next;
+		void* free_list;
+		size_t num_free;
+	};
+
+	/** A run of pages taken from the heap at once. The header is kept in the allocation, outside of the pages. **/
+	struct Chunk {
+		void* allocation;
+		Chunk* prev;
+		Chunk* next;
+		Slab* free_pages; //Linked through Slab::next
+		size_t num_free;
+	};
+
+	static Pool& pool();
+	static Slab* alloc_page();
+	static void free_page(Slab* page);
+
+	template<typename T>
+	static void link(T*& list, T* item) {
+		item->prev = nullptr;
+		item->next = list;
+		if(list)
+			list->prev = item;
+		list = item;
+	}
+
+	template<typename T>
+	static void unlink(T*& list, T* item) {
+		if(item->prev)
+			item->prev->next = item->next;
+		else
+			list = item->next;
+		if(item->next)
+			item->next->prev = item->prev;
+		item->prev = nullptr;
+		item->next = nullptr;
+	}
+
+	const char* m_name;
+	size_t m_object_size;
+	size_t m_first_object;
+	size_t m_objects_per_slab;
+	SpinLock m_lock;
+	Slab* m_partial = nullptr;
+	Slab* m_full = nullptr;
+	Slab* m_empty = nullptr;
+	size_t m_num_slabs = 0;
+	size_t m_active = 0;
+	size_t m_allocations = 0;
+	size_t m_frees = 0;
+	SlabCache* m_next_cache = nullptr;
+};
+
+/**
+ * Declares the operators that allocate a class from its slab cache. The cache itself is defined in the class's source
+ * file with SLAB_CACHE. Subclasses that are bigger than the class are allocated from the regular heap instead, so a
+ * class with subclasses needs a virtual destructor for delete to tell them apart.
+ */
+#define SLAB_ALLOCATED \
+	public: \
+		static void* operator new(size_t size); \
+		static void* operator new(size_t size, void* ptr) { return ptr; } \
+		static void operator delete(void* ptr, size_t size); \
+	private:
+
+#define SLAB_CACHE(T) \
+	static SlabCache& T##_slab_cache() { \
+		static SlabCache cache(#T, sizeof(T), alignof(T)); \
+		return cache; \
+	} \
+	void* T::operator new(size_t size) { \
+		return size == sizeof(T) ? T##_slab_cache().alloc() : kmalloc(size); \
+	} \
+	void T::operator delete(void* ptr, size_t size) { \
+		if(size == sizeof(T)) \
+			T##_slab_cache().free(ptr); \
+		else \
+			kfree(ptr); \
+	}
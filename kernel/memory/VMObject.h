@@ -11,6 +11,9 @@
 #include "../kstd/Bitmap.h"
 #include "../tasking/SpinLock.h"
 
+class VMRegion;
+struct VMProt;
+
 /**
  * This is a base class to describe a (contiguous) object in virtual memory. This object may be shared across multiple
  * address spaces (ie page directories / processes), and may be mapped at different virtual locations in each one.
@@ -41,6 +44,12 @@ public:
 	bool page_is_cow(PageIndex page) const { return m_cow_pages.get(page); };
 	/** Clones this VMObject using all the same physical pages and properties. **/
 	virtual ResultRet<kstd::Arc<VMObject>> clone();
+	/** Called when a VMRegion mapping this object is created. **/
+	virtual void region_mapped(VMRegion& region) {}
+	/** Called when a VMRegion mapping this object is destroyed. **/
+	virtual void region_unmapped(VMRegion& region) {}
+	/** Called when the protection of a VMRegion mapping this object is changed. **/
+	virtual void region_prot_changed(VMRegion& region, const VMProt& old_prot) {}
 
 protected:
 	/** Marks every page in this object as CoW, and increases the reference count of all pages by 1. **/
@@ -35,7 +35,7 @@ VMRegion::VMRegion(kstd::Arc<VMObject> object, kstd::Arc<VMSpace> space, Virtual
 	m_object_start(object_start),
 	m_prot(prot)
 {
-
+	m_object->region_mapped(*this);
 }
 
 VMRegion::~VMRegion() {
@@ -43,8 +43,11 @@ VMRegion::~VMRegion() {
 		auto unmap_res = space->unmap_region(*this);
 		ASSERT(unmap_res.is_success());
 	});
+	m_object->region_unmapped(*this);
 }
 
 void VMRegion::set_prot(VMProt prot) {
+	auto old_prot = m_prot;
 	m_prot = prot;
+	m_object->region_prot_changed(*this, old_prot);
 }
\ No newline at end of file
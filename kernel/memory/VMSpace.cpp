@@ -19,7 +19,9 @@ VMSpace::VMSpace(VirtualAddress start, size_t size, PageDirectory& page_director
 	m_size(size),
 	m_region_map(new VMSpaceRegion {.start = start, .size = size, .used = false, .next = nullptr, .prev = nullptr}),
 	m_page_directory(page_directory)
-{}
+{
+	tree_insert(m_region_map);
+}
 
 VMSpace::~VMSpace() {
 	auto cur_region = m_region_map;
@@ -35,6 +37,7 @@ kstd::Arc<VMSpace> VMSpace::fork(PageDirectory& page_directory, kstd::vector<kst
 	auto new_space = kstd::Arc<VMSpace>(new VMSpace(m_start, m_size, page_directory));
 	new_space->m_used = m_used;
 	delete new_space->m_region_map;
+	new_space->m_region_tree = nullptr;
 
 	// Clone regions
 	auto cur_region = m_region_map;
@@ -45,9 +48,11 @@ kstd::Arc<VMSpace> VMSpace::fork(PageDirectory& page_directory, kstd::vector<kst
 		if(cur_region == m_region_map)
 			new_space->m_region_map = new_region;
 		new_region->prev = prev_new_region;
+		new_region->next = nullptr;
 		if(prev_new_region)
 			prev_new_region->next = new_region;
 		prev_new_region = new_region;
+		new_space->tree_insert(new_region);
 
 		// Clone the vmRegion
 		if(cur_region->vmRegion) {
@@ -71,7 +76,7 @@ kstd::Arc<VMSpace> VMSpace::fork(PageDirectory& page_directory, kstd::vector<kst
 							new_space,
 							region->range(), region->object_start(),
 							region->prot());
-					page_directory.map(*new_vmRegion);
+					// The new page directory is left empty, and its entries are filled in as they're faulted on
 					new_region->vmRegion = new_vmRegion.get();
 					regions_vec.push_back(new_vmRegion);
 					break;
@@ -107,7 +112,7 @@ ResultRet<kstd::Arc<VMRegion>> VMSpace::map_object(kstd::Arc<VMObject> object, V
 	auto vmRegion = kstd::make_shared<VMRegion>(
 			object,
 			self(),
-			VirtualRange {region->start, object->size()},
+			VirtualRange {region->start, range.size},
 			object_start,
 			prot);
 	region->vmRegion = vmRegion.get();
@@ -118,87 +123,63 @@ ResultRet<kstd::Arc<VMRegion>> VMSpace::map_object(kstd::Arc<VMObject> object, V
 ResultRet<kstd::Arc<VMRegion>> VMSpace::map_stack(kstd::Arc<VMObject> object, VMProt prot) {
 	LOCK(m_lock);
 
-	// Find the endmost region with space in it
-	auto cur_region = m_region_map;
-	while(cur_region->next)
-		cur_region = cur_region->next;
-	while((cur_region->used || cur_region->size < object->size()) && cur_region)
-		cur_region = cur_region->prev;
-	if(!cur_region)
+	// Stacks are aligned to their size, so that userspace can find the bottom of the current thread's stack from the
+	// stack pointer. Try the endmost region with space in it, and if the aligned stack doesn't fit there, find one with
+	// enough space to spare to align it.
+	size_t size = object->size();
+	ASSERT(!(size & (size - 1)));
+	auto free_region = tree_find_highest_free(size);
+	if(free_region && ((free_region->end() - size) & ~(size - 1)) < free_region->start)
+		free_region = tree_find_highest_free(size * 2 - PAGE_SIZE);
+	if(!free_region)
 		return Result(ENOMEM);
-	return map_object(object, prot, {cur_region->end() - object->size(), object->size()});
+	return map_object(object, prot, {(free_region->end() - size) & ~(size - 1), size});
 }
 
 Result VMSpace::unmap_region(VMRegion& region) {
 	m_lock.acquire();
-	VMSpaceRegion* cur_region = m_region_map;
-	while(cur_region) {
-		if(cur_region->vmRegion == &region) {
-			if(cur_region->vmRegion) {
-				cur_region->vmRegion->m_space.reset();
-				m_page_directory.unmap(*cur_region->vmRegion);
-				m_lock.release();
-				auto free_res = free_region(cur_region);
-				ASSERT(!free_res.is_error());
-				return free_res;
-			}
-			m_lock.release();
-			return Result(ENOENT);
-		}
-		cur_region = cur_region->next;
+	auto cur_region = tree_find_containing(region.start());
+	if(!cur_region || cur_region->vmRegion != &region) {
+		m_lock.release();
+		return Result(ENOENT);
 	}
+	cur_region->vmRegion->m_space.reset();
+	m_page_directory.unmap(*cur_region->vmRegion);
 	m_lock.release();
-	return Result(ENOENT);
+	auto free_res = free_region(cur_region);
+	ASSERT(!free_res.is_error());
+	return free_res;
 }
 
 Result VMSpace::unmap_region(VirtualAddress address) {
 	m_lock.acquire();
-	VMSpaceRegion* cur_region = m_region_map;
-	while(cur_region) {
-		if(cur_region->start == address) {
-			if(cur_region->vmRegion) {
-				cur_region->vmRegion->m_space.reset();
-				m_page_directory.unmap(*cur_region->vmRegion);
-				m_lock.release();
-				auto free_res = free_region(cur_region);
-				ASSERT(!free_res.is_error());
-				return free_res;
-			}
-			m_lock.release();
-			return Result(ENOENT);
-		}
-		cur_region = cur_region->next;
+	auto cur_region = tree_find_containing(address);
+	if(!cur_region || cur_region->start != address || !cur_region->vmRegion) {
+		m_lock.release();
+		return Result(ENOENT);
 	}
+	cur_region->vmRegion->m_space.reset();
+	m_page_directory.unmap(*cur_region->vmRegion);
 	m_lock.release();
-	return Result(ENOENT);
+	auto free_res = free_region(cur_region);
+	ASSERT(!free_res.is_error());
+	return free_res;
 }
 
 ResultRet<kstd::Arc<VMRegion>> VMSpace::get_region_at(VirtualAddress address) {
 	LOCK(m_lock);
-	VMSpaceRegion* cur_region = m_region_map;
-	while(cur_region) {
-		if(cur_region->start == address) {
-			if(cur_region->vmRegion)
-				return cur_region->vmRegion->self();
-			return Result(ENOENT);
-		}
-		cur_region = cur_region->next;
-	}
-	return Result(ENOENT);
+	auto cur_region = tree_find_containing(address);
+	if(!cur_region || cur_region->start != address || !cur_region->vmRegion)
+		return Result(ENOENT);
+	return cur_region->vmRegion->self();
 }
 
 ResultRet<kstd::Arc<VMRegion>> VMSpace::get_region_containing(VirtualAddress address) {
 	LOCK(m_lock);
-	VMSpaceRegion* cur_region = m_region_map;
-	while(cur_region) {
-		if(cur_region->contains(address)) {
-			if(cur_region->vmRegion)
-				return cur_region->vmRegion->self();
-			return Result(ENOENT);
-		}
-		cur_region = cur_region->next;
-	}
-	return Result(ENOENT);
+	auto cur_region = tree_find_containing(address);
+	if(!cur_region || !cur_region->vmRegion)
+		return Result(ENOENT);
+	return cur_region->vmRegion->self();
 }
 
 Result VMSpace::reserve_region(VirtualAddress start, size_t size) {
@@ -208,99 +189,99 @@ Result VMSpace::reserve_region(VirtualAddress start, size_t size) {
 
 Result VMSpace::try_pagefault(PageFault fault) {
 	LOCK(m_lock);
-	auto cur_region = m_region_map;
-	while(cur_region) {
-		if(cur_region->contains(fault.address)) {
-			auto vmRegion = cur_region->vmRegion;
-			if(!vmRegion)
-				return Result(EINVAL);
-
-			// First, sanity check. If the region doesn't have the proper permissions, we can just fail here.
-			auto prot = vmRegion->prot();
-			if(
-				(!prot.read && fault.type == PageFault::Type::Read) ||
-				(!prot.write && fault.type == PageFault::Type::Write) ||
-				(!prot.execute && fault.type == PageFault::Type::Execute)
-			) {
-				return Result(EINVAL);
-			}
+	auto cur_region = tree_find_containing(fault.address);
+	if(!cur_region)
+		return Result(ENOENT);
+	auto vmRegion = cur_region->vmRegion;
+	if(!vmRegion)
+		return Result(EINVAL);
 
-			PageIndex error_page = (fault.address - vmRegion->start()) / PAGE_SIZE;
+	// First, sanity check. If the region doesn't have the proper permissions, we can just fail here.
+	auto prot = vmRegion->prot();
+	if(
+		(!prot.read && fault.type == PageFault::Type::Read) ||
+		(!prot.write && fault.type == PageFault::Type::Write) ||
+		(!prot.execute && fault.type == PageFault::Type::Execute)
+	) {
+		return Result(EINVAL);
+	}
 
-			// Check if the region is a mapped inode.
-			if(vmRegion->object()->is_inode()) {
-				auto inode_object = kstd::static_pointer_cast<InodeVMObject>(vmRegion->object());
+	PageIndex error_page = (fault.address - vmRegion->start()) / PAGE_SIZE;
 
-				// Check to see if it needs to be read in
-				LOCK_N(inode_object->lock(), inode_locker);
-				if(inode_object->physical_page_index(error_page)) {
-					// This page may be marked CoW, so copy it if it is
-					if(vmRegion->prot().write && inode_object->page_is_cow(error_page)) {
-						auto res = vmRegion->m_object->try_cow_page(error_page);
-						if(res.is_error())
-							return res;
-					}
+	// Check if the region is a mapped inode.
+	if(vmRegion->object()->is_inode()) {
+		auto inode_object = kstd::static_pointer_cast<InodeVMObject>(vmRegion->object());
+		PageIndex object_page = error_page + (vmRegion->object_start() / PAGE_SIZE);
 
-					// Or, we may have encountered a race where the page was created by another thread after the fault.
-					m_page_directory.map(*vmRegion, VirtualRange { error_page * PAGE_SIZE, PAGE_SIZE });
-					return Result(SUCCESS);
-				}
-
-				// Allocate a new physical page.
-				auto new_page = TRY(MM.alloc_physical_page());
+		// Shared objects are the inode's page cache, so we just need to make sure the page is in it.
+		if(inode_object->type() == InodeVMObject::Type::Shared) {
+			auto res = inode_object->get_page(object_page);
+			if(res.is_error())
+				return res.result();
+			m_page_directory.map(*vmRegion, VirtualRange { error_page * PAGE_SIZE, PAGE_SIZE });
+			return Result(SUCCESS);
+		}
 
-				// We read directly from the shared VMObject if this page exists in it.
-				auto inode = inode_object->inode();
-				auto shared_object = inode->shared_vm_object();
-				PageIndex shared_page_index = error_page + (vmRegion->object_start() / PAGE_SIZE);
-				auto shared_page = shared_object->physical_page_index(shared_page_index);
-				if(shared_object != inode_object && shared_page) {
-					MM.copy_page(shared_page, new_page);
-				} else {
-					// Read the appropriate part of the file into the buffer.
-					kstd::Arc<uint8_t> buf((uint8_t*) kmalloc(PAGE_SIZE));
-					ssize_t nread = inode->read(error_page * PAGE_SIZE + vmRegion->object_start(), PAGE_SIZE, KernelPointer<uint8_t>(buf.get()), nullptr);
-					if(nread < 0)
-						return Result(-nread);
-
-					// Read the contents of the buffer into the newly allocated physical page.
-					MM.with_quickmapped(new_page, [&](void* page_buf) {
-						memcpy_uint32((uint32_t*) page_buf, (uint32_t*) buf.get(), PAGE_SIZE / sizeof(uint32_t));
-					});
-				}
+		LOCK_N(inode_object->lock(), inode_locker);
+		if(!inode_object->physical_page_index(object_page)) {
+			// Private mappings start out sharing the page cache's page, and get their own copy once written to.
+			auto page = inode_object->inode()->shared_vm_object()->get_page(object_page, true);
+			if(page.is_error())
+				return page.result();
+			inode_object->add_cow_page(object_page, page.value());
+		} else if(!vmRegion->prot().write || !inode_object->page_is_cow(object_page)) {
+			// We may have encountered a race where the page was created by another thread after the fault.
+			m_page_directory.map(*vmRegion, VirtualRange { error_page * PAGE_SIZE, PAGE_SIZE });
+			return Result(SUCCESS);
+		}
 
-				// Remap the page.
-				inode_object->physical_page_index(error_page) = new_page;
-				m_page_directory.map(*vmRegion, VirtualRange { error_page * PAGE_SIZE, PAGE_SIZE });
+		// Copy the page now if this is a write, since we'd just fault again otherwise
+		if(vmRegion->prot().write && fault.type == PageFault::Type::Write) {
+			auto res = inode_object->try_cow_page(object_page);
+			if(res.is_error())
+				return res;
+		}
 
-				return Result(SUCCESS);
-			}
+		m_page_directory.map(*vmRegion, VirtualRange { error_page * PAGE_SIZE, PAGE_SIZE });
+		return Result(SUCCESS);
+	}
 
-			// CoW if the region is writeable.
-			if(vmRegion->prot().write) {
-				auto result = vmRegion->m_object->try_cow_page(error_page);
-				if(result.is_success())
-					m_page_directory.map(*vmRegion, VirtualRange { error_page * PAGE_SIZE, PAGE_SIZE });
-				return result;
-			}
+	// Anonymous objects are allocated lazily, so fill in the page if this is the first time it's been touched.
+	if(vmRegion->object()->is_anonymous()) {
+		auto anon_object = kstd::static_pointer_cast<AnonymousVMObject>(vmRegion->object());
+		if(!anon_object->page_is_present(error_page)) {
+			auto res = anon_object->try_fault_in_page(error_page);
+			if(res.is_error())
+				return res;
+			m_page_directory.map(*vmRegion, VirtualRange { error_page * PAGE_SIZE, PAGE_SIZE });
+			return Result(SUCCESS);
+		}
 
-			return Result(EINVAL);
+		// If the object is shared or we were forked, the page may have been filled in without being mapped here, so we
+		// just need to map it. If this is a write to a CoW page though, we'd just fault again, so copy it right away.
+		if(!m_page_directory.is_mapped(fault.address, false) && !(fault.type == PageFault::Type::Write && anon_object->page_is_cow(error_page))) {
+			m_page_directory.map(*vmRegion, VirtualRange { error_page * PAGE_SIZE, PAGE_SIZE });
+			return Result(SUCCESS);
 		}
-		cur_region = cur_region->next;
 	}
 
-	return Result(ENOENT);
+	// CoW if the region is writeable.
+	if(vmRegion->prot().write) {
+		auto result = vmRegion->m_object->try_cow_page(error_page);
+		if(result.is_success())
+			m_page_directory.map(*vmRegion, VirtualRange { error_page * PAGE_SIZE, PAGE_SIZE });
+		return result;
+	}
+
+	return Result(EINVAL);
 }
 
 ResultRet<VirtualAddress> VMSpace::find_free_space(size_t size) {
 	LOCK(m_lock);
-	auto cur_region = m_region_map;
-	while(cur_region) {
-		if(!cur_region->used && cur_region->size >= size)
-			return cur_region->start;
-		cur_region = cur_region->next;
-	}
-	return Result(ENOMEM);
+	auto free_region = tree_find_lowest_free(size);
+	if(!free_region)
+		return Result(ENOMEM);
+	return free_region->start;
 }
 
 size_t VMSpace::calculate_regular_anonymous_total() {
@@ -325,24 +306,20 @@ ResultRet<VMSpace::VMSpaceRegion*> VMSpace::alloc_space(size_t size) {
 	ASSERT(size % PAGE_SIZE == 0);
 
 	/**
-	 * We allocate a new region if we need one BEFORE iterating through the regions, because there's a chance we'll
-	 * need to allocate more pages for the heap and if we're in the middle of iterating through regions when that
+	 * We allocate a new region if we need one BEFORE looking through the regions, because there's a chance we'll
+	 * need to allocate more pages for the heap and if we're in the middle of modifying the regions when that
 	 * happens, it could get ugly.
 	 */
 	auto new_region = new VMSpaceRegion;
 
 	{
 		LOCK(m_lock);
-		auto cur_region = m_region_map;
-		while(cur_region) {
-			if(cur_region->used || cur_region->size < size) {
-				cur_region = cur_region->next;
-				continue;
-			}
-
+		auto cur_region = tree_find_lowest_free(size);
+		if(cur_region) {
 			if(cur_region->size == size) {
 				cur_region->used = true;
 				m_used += cur_region->size;
+				tree_update(cur_region);
 				delete new_region;
 				return cur_region;
 			}
@@ -362,6 +339,8 @@ ResultRet<VMSpace::VMSpaceRegion*> VMSpace::alloc_space(size_t size) {
 			cur_region->size -= size;
 			cur_region->prev = new_region;
 			m_used += new_region->size;
+			tree_update(cur_region);
+			tree_insert(new_region);
 
 			if(m_region_map == cur_region)
 				m_region_map = new_region;
@@ -378,8 +357,8 @@ ResultRet<VMSpace::VMSpaceRegion*> VMSpace::alloc_space_at(size_t size, VirtualA
 	ASSERT(size % PAGE_SIZE == 0);
 
 	/**
-	 * We allocate new regions if we need one BEFORE iterating through the regions, because there's a chance we'll
-	 * need to allocate more pages for the heap and if we're in the middle of iterating through regions when that
+	 * We allocate new regions if we need one BEFORE looking through the regions, because there's a chance we'll
+	 * need to allocate more pages for the heap and if we're in the middle of modifying the regions when that
 	 * happens, it could get ugly.
 	 */
 	auto new_region_before = new VMSpaceRegion;
@@ -387,72 +366,70 @@ ResultRet<VMSpace::VMSpaceRegion*> VMSpace::alloc_space_at(size_t size, VirtualA
 
 	{
 		LOCK(m_lock);
-		auto cur_region = m_region_map;
-		while(cur_region) {
-			if(cur_region->contains(address)) {
-				if(cur_region->used) {
-					delete new_region_before;
-					delete new_region_after;
-					return Result(ENOMEM);
-				}
+		auto cur_region = tree_find_containing(address);
+		if(cur_region && !cur_region->used) {
+			if(cur_region->start == address && cur_region->size == size) {
+				cur_region->used = true;
+				m_used += cur_region->size;
+				tree_update(cur_region);
+				delete new_region_before;
+				delete new_region_after;
+				return cur_region;
+			}
 
-				if(cur_region->size == size) {
-					cur_region->used = true;
-					m_used += cur_region->size;
+			if(cur_region->size - (address - cur_region->start) >= size) {
+				// Shrink the region to the requested range first, so that the new regions stay in order in the tree
+				auto old_start = cur_region->start;
+				auto old_end = cur_region->end();
+				cur_region->start = address;
+				cur_region->size = size;
+				cur_region->used = true;
+				m_used += cur_region->size;
+				tree_update(cur_region);
+
+				// Create new region before if needed
+				if(old_start < address) {
+					*new_region_before = VMSpaceRegion {
+							.start = old_start,
+							.size = address - old_start,
+							.used = false,
+							.next = cur_region,
+							.prev = cur_region->prev
+					};
+					if(cur_region->prev)
+						cur_region->prev->next = new_region_before;
+					cur_region->prev = new_region_before;
+					if(m_region_map == cur_region)
+						m_region_map = new_region_before;
+					tree_insert(new_region_before);
+				} else {
 					delete new_region_before;
-					delete new_region_after;
-					return cur_region;
 				}
 
-				if(cur_region->size - (address - cur_region->start) >= size) {
-					// Create new region before if needed
-					if(cur_region->start < address) {
-						*new_region_before = VMSpaceRegion {
-								.start = cur_region->start,
-								.size = address - cur_region->start,
-								.used = false,
-								.next = cur_region,
-								.prev = cur_region->prev
-						};
-						if(cur_region->prev)
-							cur_region->prev->next = new_region_before;
-						cur_region->prev = new_region_before;
-						if(m_region_map == cur_region)
-							m_region_map = new_region_before;
-					} else {
-						delete new_region_before;
-					}
-
-					// Create new region after if needed
-					if(cur_region->end() > address + size) {
-						*new_region_after = VMSpaceRegion {
-								.start = address + size,
-								.size = cur_region->end() - (address + size),
-								.used = false,
-								.next = cur_region->next,
-								.prev = cur_region
-						};
-						if(cur_region->next)
-							cur_region->next->prev = new_region_after;
-						cur_region->next = new_region_after;
-					} else {
-						delete new_region_after;
-					}
-
-					cur_region->start = address;
-					cur_region->size = size;
-					cur_region->used = true;
-					m_used += cur_region->size;
-					return cur_region;
+				// Create new region after if needed
+				if(old_end > address + size) {
+					*new_region_after = VMSpaceRegion {
+							.start = address + size,
+							.size = old_end - (address + size),
+							.used = false,
+							.next = cur_region->next,
+							.prev = cur_region
+					};
+					if(cur_region->next)
+						cur_region->next->prev = new_region_after;
+					cur_region->next = new_region_after;
+					tree_insert(new_region_after);
+				} else {
+					delete new_region_after;
 				}
 
-				return Result(ENOMEM);
+				return cur_region;
 			}
-
-			cur_region = cur_region->next;
 		}
 	}
 
+	delete new_region_before;
+	delete new_region_after;
 	return Result(ENOMEM);
 }
 
@@ -467,6 +444,7 @@ Result VMSpace::free_region(VMSpaceRegion* region) {
 		// Merge previous region if needed
 		if(region->prev && !region->prev->used) {
 			to_delete[0] = region->prev;
+			tree_remove(to_delete[0]);
 			region->prev = region->prev->prev;
 			if(to_delete[0]->prev)
 				to_delete[0]->prev->next = region;
@@ -479,11 +457,14 @@ Result VMSpace::free_region(VMSpaceRegion* region) {
 		// Merge next region if needed
 		if(region->next && !region->next->used) {
 			to_delete[1] = region->next;
+			tree_remove(to_delete[1]);
 			region->next = region->next->next;
 			if(to_delete[1]->next)
 				to_delete[1]->next->prev = region;
 			region->size += to_delete[1]->size;
 		}
+
+		tree_update(region);
 	}
 
 	// We do this while not holding the lock just in case this triggers a page free in the allocator.
@@ -492,3 +473,175 @@ Result VMSpace::free_region(VMSpaceRegion* region) {
 
 	return Result(SUCCESS);
 }
+
+int VMSpace::tree_height(VMSpaceRegion* node) {
+	return node ? node->height : 0;
+}
+
+size_t VMSpace::tree_max_free(VMSpaceRegion* node) {
+	return node ? node->max_free : 0;
+}
+
+void VMSpace::tree_update_node(VMSpaceRegion* node) {
+	node->height = max(tree_height(node->left), tree_height(node->right)) + 1;
+	node->max_free = max(node->used ? 0 : node->size, max(tree_max_free(node->left), tree_max_free(node->right)));
+}
+
+void VMSpace::tree_insert(VMSpaceRegion* region) {
+	region->left = nullptr;
+	region->right = nullptr;
+	region->parent = nullptr;
+	tree_update_node(region);
+
+	if(!m_region_tree) {
+		m_region_tree = region;
+		return;
+	}
+
+	auto cur_node = m_region_tree;
+	while(true) {
+		auto& slot = region->start < cur_node->start ? cur_node->left : cur_node->right;
+		if(!slot) {
+			slot = region;
+			region->parent = cur_node;
+			break;
+		}
+		cur_node = slot;
+	}
+
+	tree_rebalance_from(cur_node);
+}
+
+void VMSpace::tree_remove(VMSpaceRegion* region) {
+	VMSpaceRegion* rebalance_from;
+	if(region->left && region->right) {
+		// Replace the region with its successor, which is the leftmost node of the right subtree and has no left child
+		auto successor = region->right;
+		while(successor->left)
+			successor = successor->left;
+
+		if(successor->parent == region) {
+			rebalance_from = successor;
+		} else {
+			rebalance_from = successor->parent;
+			tree_replace_child(successor->parent, successor, successor->right);
+			successor->right = region->right;
+			successor->right->parent = successor;
+		}
+
+		tree_replace_child(region->parent, region, successor);
+		successor->left = region->left;
+		successor->left->parent = successor;
+	} else {
+		rebalance_from = region->parent;
+		tree_replace_child(region->parent, region, region->left ? region->left : region->right);
+	}
+
+	region->left = nullptr;
+	region->right = nullptr;
+	region->parent = nullptr;
+	tree_rebalance_from(rebalance_from);
+}
+
+void VMSpace::tree_update(VMSpaceRegion* region) {
+	while(region) {
+		tree_update_node(region);
+		region = region->parent;
+	}
+}
+
+VMSpace::VMSpaceRegion* VMSpace::tree_find_containing(VirtualAddress address) {
+	auto cur_node = m_region_tree;
+	while(cur_node) {
+		if(address < cur_node->start)
+			cur_node = cur_node->left;
+		else if(address >= cur_node->end())
+			cur_node = cur_node->right;
+		else
+			return cur_node;
+	}
+	return nullptr;
+}
+
+VMSpace::VMSpaceRegion* VMSpace::tree_find_lowest_free(size_t size) {
+	if(tree_max_free(m_region_tree) < size)
+		return nullptr;
+	auto cur_node = m_region_tree;
+	while(true) {
+		if(tree_max_free(cur_node->left) >= size)
+			cur_node = cur_node->left;
+		else if(!cur_node->used && cur_node->size >= size)
+			return cur_node;
+		else
+			cur_node = cur_node->right;
+	}
+}
+
+VMSpace::VMSpaceRegion* VMSpace::tree_find_highest_free(size_t size) {
+	if(tree_max_free(m_region_tree) < size)
+		return nullptr;
+	auto cur_node = m_region_tree;
+	while(true) {
+		if(tree_max_free(cur_node->right) >= size)
+			cur_node = cur_node->right;
+		else if(!cur_node->used && cur_node->size >= size)
+			return cur_node;
+		else
+			cur_node = cur_node->left;
+	}
+}
+
+void VMSpace::tree_replace_child(VMSpaceRegion* parent, VMSpaceRegion* old_child, VMSpaceRegion* new_child) {
+	if(!parent)
+		m_region_tree = new_child;
+	else if(parent->left == old_child)
+		parent->left = new_child;
+	else
+		parent->right = new_child;
+	if(new_child)
+		new_child->parent = parent;
+}
+
+VMSpace::VMSpaceRegion* VMSpace::tree_rotate_left(VMSpaceRegion* node) {
+	auto new_top = node->right;
+	tree_replace_child(node->parent, node, new_top);
+	node->right = new_top->left;
+	if(node->right)
+		node->right->parent = node;
+	new_top->left = node;
+	node->parent = new_top;
+	tree_update_node(node);
+	tree_update_node(new_top);
+	return new_top;
+}
+
+VMSpace::VMSpaceRegion* VMSpace::tree_rotate_right(VMSpaceRegion* node) {
+	auto new_top = node->left;
+	tree_replace_child(node->parent, node, new_top);
+	node->left = new_top->right;
+	if(node->left)
+		node->left->parent = node;
+	new_top->right = node;
+	node->parent = new_top;
+	tree_update_node(node);
+	tree_update_node(new_top);
+	return new_top;
+}
+
+void VMSpace::tree_rebalance_from(VMSpaceRegion* node) {
+	// Walk up to the root, rebalancing and updating the height and largest free region of each node along the way
+	while(node) {
+		tree_update_node(node);
+		int balance = tree_height(node->right) - tree_height(node->left);
+		if(balance > 1) {
+			if(tree_height(node->right->left) > tree_height(node->right->right))
+				tree_rotate_right(node->right);
+			node = tree_rotate_left(node);
+		} else if(balance < -1) {
+			if(tree_height(node->left->right) > tree_height(node->left->left))
+				tree_rotate_left(node->left);
+			node = tree_rotate_right(node);
+		}
+		node = node->parent;
+	}
+}
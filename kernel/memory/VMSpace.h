@@ -39,8 +39,8 @@ public:
 	ResultRet<kstd::Arc<VMRegion>> map_object(kstd::Arc<VMObject> object, VMProt prot, VirtualRange range = VirtualRange::null, VirtualAddress object_start = 0);
 
 	/**
-	 * Allocates a new region for the given object near the end of the memory space.
-	 * @param object The object to allocate a region for.
+	 * Allocates a new region for the given object near the end of the memory space, aligned to its size.
+	 * @param object The object to allocate a region for. Its size must be a power of two.
 	 * @return The newly created region.
 	 */
 	ResultRet<kstd::Arc<VMRegion>> map_stack(kstd::Arc<VMObject> object, VMProt prot = VMSpace::default_prot);
@@ -109,6 +109,11 @@ public:
 	SpinLock& lock() { return m_lock; }
 
 private:
+	/**
+	 * The regions in a space cover the whole thing without overlapping. They're kept both in a list in address order
+	 * (for finding neighbors) and in an AVL tree keyed by start address (for lookups). Each node in the tree also keeps
+	 * track of the largest free region in its subtree, so that free space can be found without visiting every region.
+	 */
 	struct VMSpaceRegion {
 		VirtualAddress start;
 		size_t size;
@@ -117,6 +122,13 @@ private:
 		VMSpaceRegion* prev;
 		VMRegion* vmRegion;
 
+		// Tree
+		VMSpaceRegion* left = nullptr;
+		VMSpaceRegion* right = nullptr;
+		VMSpaceRegion* parent = nullptr;
+		int height = 1;
+		size_t max_free = 0;
+
 		size_t end() const { return start + size; }
 		bool contains(VirtualAddress address) const { return start <= address && end() > address; }
 	};
@@ -125,9 +137,28 @@ private:
 	ResultRet<VMSpaceRegion*> alloc_space_at(size_t size, VirtualAddress address);
 	Result free_region(VMSpaceRegion* region);
 
+	// Region tree. These should only be used while holding m_lock.
+	void tree_insert(VMSpaceRegion* region);
+	void tree_remove(VMSpaceRegion* region);
+	/** Updates the tree after the size or usage of a region changes. The order of the regions must not change. **/
+	void tree_update(VMSpaceRegion* region);
+	VMSpaceRegion* tree_find_containing(VirtualAddress address);
+	/** Finds the free region with the lowest address that is at least `size` bytes. **/
+	VMSpaceRegion* tree_find_lowest_free(size_t size);
+	/** Finds the free region with the highest address that is at least `size` bytes. **/
+	VMSpaceRegion* tree_find_highest_free(size_t size);
+	void tree_replace_child(VMSpaceRegion* parent, VMSpaceRegion* old_child, VMSpaceRegion* new_child);
+	VMSpaceRegion* tree_rotate_left(VMSpaceRegion* node);
+	VMSpaceRegion* tree_rotate_right(VMSpaceRegion* node);
+	void tree_rebalance_from(VMSpaceRegion* node);
+	static int tree_height(VMSpaceRegion* node);
+	static size_t tree_max_free(VMSpaceRegion* node);
+	static void tree_update_node(VMSpaceRegion* node);
+
 	VirtualAddress m_start;
 	size_t m_size;
 	VMSpaceRegion* m_region_map;
+	VMSpaceRegion* m_region_tree = nullptr;
 	size_t m_used = 0;
 	SpinLock m_lock;
 	PageDirectory& m_page_directory;
@@ -20,7 +20,6 @@
 #include <kernel/kstd/kstddef.h>
 #include <kernel/memory/gdt.h>
 #include <kernel/tasking/TSS.h>
-#include <kernel/tasking/TaskManager.h>
 #include <kernel/kstd/cstring.h>
 
 Memory::GDTEntry gdt[GDT_ENTRIES];
@@ -49,37 +48,43 @@ void Memory::gdt_set_gate(uint32_t num, uint32_t limit, uint32_t base, bool read
 	gdt[num].access.bits.ring = ring;
 }
 
-void Memory::setup_tss(){
-	uint32_t base = (uint32_t) &TaskManager::tss;
-	uint32_t limit = sizeof(TaskManager::tss) - 1;
+void Memory::setup_tss(int cpu){
+	auto& tss = CPU::get(cpu).tss;
+	auto& entry = gdt[GDT_TSS_ENTRY + cpu];
+	uint32_t base = (uint32_t) &tss;
+	uint32_t limit = sizeof(tss) - 1;
 
 	// Now, add our TSS descriptor's address to the GDT.
-	gdt[5].limit_low = limit & 0xFFFFu;
-	gdt[5].base_low = (base & 0xFFFFu);
-	gdt[5].base_middle = (base >> 16u) & 0xFFu;
-	gdt[5].base_high = (base >> 24u) & 0xFFu;
-	gdt[5].access.bits.accessed = true; //This indicates it's a TSS and not a LDT. This is a changed meaning
-	gdt[5].access.bits.read_write = false; //This indicates if the TSS is busy or not. 0 for not busy
-	gdt[5].access.bits.direction = false; //always 0 for TSS
-	gdt[5].access.bits.executable = true; //For TSS this is 1 for 32bit usage, or 0 for 16bit.
-	gdt[5].access.bits.type = false; //indicate it is a TSS
-	gdt[5].access.bits.ring = 3; //same meaning
-	gdt[5].access.bits.present = true; //same meaning
-	gdt[5].flags_and_limit.bits.limit_high = (limit >> 16u) & 0xFu; //isolate top nibble
-	gdt[5].flags_and_limit.bits.zero = 0;
-	gdt[5].flags_and_limit.bits.size = false; //should leave zero according to manuals. No effect
-	gdt[5].flags_and_limit.bits.granularity = false; //so that our computed GDT limit is in bytes, not pages
-
-	memset(&TaskManager::tss, 0, sizeof(TSS));
-
-	TaskManager::tss.ss0 = 0x10;
-
-	TaskManager::tss.cs = 0x0b;
-	TaskManager::tss.ss = 0x13;
-	TaskManager::tss.ds = 0x13;
-	TaskManager::tss.es = 0x13;
-	TaskManager::tss.fs = 0x13;
-	TaskManager::tss.gs = 0x13;
+	entry.limit_low = limit & 0xFFFFu;
+	entry.base_low = (base & 0xFFFFu);
+	entry.base_middle = (base >> 16u) & 0xFFu;
+	entry.base_high = (base >> 24u) & 0xFFu;
+	entry.access.bits.accessed = true; //This indicates it's a TSS and not a LDT. This is a changed meaning
+	entry.access.bits.read_write = false; //This indicates if the TSS is busy or not. 0 for not busy
+	entry.access.bits.direction = false; //always 0 for TSS
+	entry.access.bits.executable = true; //For TSS this is 1 for 32bit usage, or 0 for 16bit.
+	entry.access.bits.type = false; //indicate it is a TSS
+	entry.access.bits.ring = 3; //same meaning
+	entry.access.bits.present = true; //same meaning
+	entry.flags_and_limit.bits.limit_high = (limit >> 16u) & 0xFu; //isolate top nibble
+	entry.flags_and_limit.bits.zero = 0;
+	entry.flags_and_limit.bits.size = false; //should leave zero according to manuals. No effect
+	entry.flags_and_limit.bits.granularity = false; //so that our computed GDT limit is in bytes, not pages
+
+	memset(&tss, 0, sizeof(TSS));
+
+	tss.ss0 = 0x10;
+
+	tss.cs = 0x0b;
+	tss.ss = 0x13;
+	tss.ds = 0x13;
+	tss.es = 0x13;
+	tss.fs = 0x13;
+	tss.gs = 0x13;
+}
+
+uint16_t Memory::tss_selector(int cpu) {
+	return ((GDT_TSS_ENTRY + cpu) * sizeof(GDTEntry)) | 3;
 }
 
 void Memory::load_gdt(){
@@ -92,8 +97,15 @@ void Memory::load_gdt(){
 	gdt_set_gate(3, 0xFFFFF, 0, true, true, true, 3); //User code
 	gdt_set_gate(4, 0xFFFFF, 0, true, false, true, 3); //User data
 
-	setup_tss();
+	//Set up the TSS for every CPU we could possibly have so that the APs just have to load theirs
+	for(int cpu = 0; cpu < MAX_CPUS; cpu++)
+		setup_tss(cpu);
+
+	gdt_flush();
+	asm volatile("ltr %0": : "r"(tss_selector(0)));
+}
 
+void Memory::load_gdt_ap(int cpu) {
 	gdt_flush();
-	asm volatile("ltr %0": : "r"((uint16_t)0x2B));
+	asm volatile("ltr %0": : "r"(tss_selector(cpu)));
 }
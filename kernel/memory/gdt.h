@@ -20,8 +20,10 @@
 #pragma once
 
 #include <kernel/kstd/types.h>
+#include <kernel/tasking/CPU.h>
 
-#define GDT_ENTRIES 6
+#define GDT_TSS_ENTRY 5 //Each CPU gets a TSS entry, starting at this one
+#define GDT_ENTRIES (GDT_TSS_ENTRY + MAX_CPUS)
 
 namespace Memory {
 	union GDTEntryAccessByte {
@@ -63,7 +65,9 @@ namespace Memory {
 
 	void gdt_set_gate(uint32_t num, uint32_t limit, uint32_t base, bool read_write, bool executable, bool type, uint8_t ring, bool present = true, bool accessed = false);
 
-	void setup_tss();
+	void setup_tss(int cpu);
+	uint16_t tss_selector(int cpu);
 	extern "C" void load_gdt();
+	void load_gdt_ap(int cpu);
 	extern "C" void gdt_flush();
 }
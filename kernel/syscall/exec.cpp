@@ -20,6 +20,7 @@ int Process::exec(const kstd::string& filename, ProcessArgs* args) {
 		new_proc->_user = _user;
 		new_proc->_pgid = _pgid;
 		new_proc->_sid = _sid;
+		new_proc->_nice = _nice;
 		if (_kernel_mode) {
 			//Kernel processes have no file descriptors, so we need to initialize them
 			auto ttydesc = kstd::make_shared<FileDescriptor>(VirtualTTY::current_tty());
@@ -59,9 +60,14 @@ int Process::exec(const kstd::string& filename, ProcessArgs* args) {
 			main_thread->_tid = -1;
 			insert_thread(main_thread);
 		}
+		auto parent = TaskManager::process_for_pid(_ppid);
 		_pid = -1;
 		_ppid = 0;
 		TaskManager::add_process(new_proc);
+
+		//If we were vfork()'d, our parent is waiting for us to stop using its address space
+		if(!parent.is_error())
+			parent.value()->child_wait_queue().wake_all();
 	}
 
 	kill(SIGKILL);
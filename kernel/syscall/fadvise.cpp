@@ -0,0 +1,13 @@
+/* SPDX-License-Identifier: GPL-3.0-or-later */
+/* Copyright © 2016-2023 Byteduck */
+
+#include "../tasking/Process.h"
+#include "../filesystem/FileDescriptor.h"
+#include "syscall_numbers.h"
+
+int Process::sys_fadvise(UserspacePointer<struct fadvise_args> args_ptr) {
+	auto args = args_ptr.get();
+	if(args.fd < 0 || args.fd >= (int) _file_descriptors.size() || !_file_descriptors[args.fd])
+		return -EBADF;
+	return _file_descriptors[args.fd]->advise(args.offset, args.len, args.advice).code();
+}
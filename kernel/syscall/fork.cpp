@@ -3,6 +3,7 @@
 
 #include "../tasking/Process.h"
 #include "../tasking/TaskManager.h"
+#include "../tasking/VForkBlocker.h"
 
 pid_t Process::sys_fork(Registers& regs) {
 	auto* new_proc = new Process(this, regs);
@@ -10,4 +11,15 @@ pid_t Process::sys_fork(Registers& regs) {
 	auto pid = new_proc->pid();
 	TaskManager::add_process(new_proc->_self_ptr);
 	return pid;
-}
\ No newline at end of file
+}
+
+pid_t Process::sys_vfork(Registers& regs) {
+	auto* new_proc = new Process(this, regs, true);
+	auto pid = new_proc->pid();
+	TaskManager::add_process(new_proc->_self_ptr);
+
+	// The child is running in our address space and on our stack, so wait until it execs or exits
+	VForkBlocker blocker(TaskManager::current_thread(), pid);
+	TaskManager::current_thread()->block(blocker);
+	return pid;
+}
@@ -127,7 +127,8 @@ ResultRet<void*> Process::sys_mmap(UserspacePointer<struct mmap_args> args_ptr)
 
 	// First, create an appropriate object
 	if(args.flags & MAP_ANONYMOUS) {
-		vm_object = TRY(AnonymousVMObject::alloc(args.length));
+		auto alloc_type = (args.flags & MAP_POPULATE) ? AnonymousVMObject::AllocType::Populate : AnonymousVMObject::AllocType::Lazy;
+		vm_object = TRY(AnonymousVMObject::alloc(args.length, alloc_type));
 	} else {
 		if(args.fd >= _file_descriptors.size() || !_file_descriptors[args.fd])
 			return Result(EBADF);
@@ -33,4 +33,21 @@ int Process::sys_pipe(UserspacePointer<int> filedes, int options) {
 	filedes.set(1, (int) _file_descriptors.size() - 1);
 
 	return SUCCESS;
-}
\ No newline at end of file
+}
+int Process::sys_splice(int fd_in, int fd_out, size_t len) {
+	if(fd_in < 0 || fd_in >= (int) _file_descriptors.size() || !_file_descriptors[fd_in])
+		return -EBADF;
+	if(fd_out < 0 || fd_out >= (int) _file_descriptors.size() || !_file_descriptors[fd_out])
+		return -EBADF;
+	auto in = _file_descriptors[fd_in];
+	auto out = _file_descriptors[fd_out];
+	if(!in->readable() || !out->writable())
+		return -EBADF;
+
+	// One end has to be a pipe, and the other has to be a file on a filesystem
+	if(in->file()->is_fifo() && out->file()->is_inode())
+		return ((Pipe*) in->file().get())->splice_to(*in, *out, len);
+	if(out->file()->is_fifo() && in->file()->is_inode())
+		return ((Pipe*) out->file().get())->splice_from(*out, *in, len);
+	return -EINVAL;
+}
@@ -0,0 +1,84 @@
+/* SPDX-License-Identifier: GPL-3.0-or-later */
+/* Copyright © 2016-2023 Byteduck */
+
+#include "../tasking/Process.h"
+#include "../tasking/TaskManager.h"
+#include "../api/resource.h"
+
+/**
+ * Calls func on each process matched by a getpriority/setpriority target.
+ * @return -EINVAL if which is invalid, -ESRCH if no processes matched, or SUCCESS.
+ */
+template<typename F>
+static int for_each_prio_target(Process* self, int which, int who, F&& func) {
+	if(who < 0)
+		return -ESRCH;
+
+	switch(which) {
+		case PRIO_PROCESS:
+			if(!who)
+				who = self->pid();
+			break;
+		case PRIO_PGRP:
+			if(!who)
+				who = self->pgid();
+			break;
+		case PRIO_USER:
+			if(!who)
+				who = self->user().uid;
+			break;
+		default:
+			return -EINVAL;
+	}
+
+	LOCK(TaskManager::g_process_lock);
+	bool found = false;
+	for(auto proc : *TaskManager::process_list()) {
+		if(proc->state() == Process::DEAD || proc->is_kernel_mode())
+			continue;
+		bool matches =
+				(which == PRIO_PROCESS && proc->pid() == who) ||
+				(which == PRIO_PGRP && proc->pgid() == who) ||
+				(which == PRIO_USER && proc->user().uid == who);
+		if(!matches)
+			continue;
+		found = true;
+		int res = func(proc);
+		if(res < 0)
+			return res;
+	}
+
+	return found ? SUCCESS : -ESRCH;
+}
+
+int Process::sys_getpriority(int which, int who) {
+	// Returns PRIO_MAX - nice instead of nice, so that a valid result is never negative and mistaken for an error
+	int lowest_nice = PRIO_MAX;
+	int res = for_each_prio_target(this, which, who, [&](Process* proc) {
+		if(proc->nice() < lowest_nice)
+			lowest_nice = proc->nice();
+		return SUCCESS;
+	});
+	if(res < 0)
+		return res;
+	return PRIO_MAX - lowest_nice;
+}
+
+int Process::sys_setpriority(int which, int who, int prio) {
+	if(prio < PRIO_MIN)
+		prio = PRIO_MIN;
+	if(prio >= PRIO_MAX)
+		prio = PRIO_MAX - 1;
+
+	return for_each_prio_target(this, which, who, [&](Process* proc) {
+		// Only root may change other users' processes or make processes less nice
+		if(!_user.can_override_permissions()) {
+			if(proc->user().uid != _user.euid && proc->user().euid != _user.euid)
+				return -EPERM;
+			if(prio < proc->nice())
+				return -EACCES;
+		}
+		proc->set_nice(prio);
+		return SUCCESS;
+	});
+}
@@ -0,0 +1,145 @@
+/* SPDX-License-Identifier: GPL-3.0-or-later */
+/* Copyright © 2016-2023 Byteduck */
+
+#include "../tasking/Process.h"
+#include "../tasking/TaskManager.h"
+#include "../tasking/ProcessArgs.h"
+#include "../memory/SafePointer.h"
+#include "../filesystem/VFS.h"
+#include "../filesystem/FileDescriptor.h"
+#include "../terminal/TTYDevice.h"
+#include "../api/spawn.h"
+
+pid_t Process::sys_posix_spawn(UserspacePointer<struct posix_spawn_args> args_ptr) {
+	auto args = args_ptr.get();
+	if(!args.path)
+		return -EFAULT;
+	auto path = UserspacePointer<char>((char*) args.path).str();
+
+	ProcessArgs proc_args(_cwd);
+	if(args.argv) {
+		UserspacePointer<char*> argv((char**) args.argv);
+		for(int i = 0; argv.get(i); i++)
+			proc_args.argv.push_back(UserspacePointer<char>(argv.get(i)).str());
+	}
+	if(args.envp) {
+		UserspacePointer<char*> envp((char**) args.envp);
+		for(int i = 0; envp.get(i); i++)
+			proc_args.env.push_back(UserspacePointer<char>(envp.get(i)).str());
+	}
+
+	posix_spawnattr_t attr = {0, 0};
+	if(args.attr)
+		attr = UserspacePointer<posix_spawnattr_t>((posix_spawnattr_t*) args.attr).get();
+
+	// Build the child's file descriptors before creating it, so that a bad file action doesn't leave a half-made process
+	kstd::vector<kstd::Arc<FileDescriptor>> file_descriptors;
+	file_descriptors.resize(_file_descriptors.size());
+	for(size_t i = 0; i < _file_descriptors.size(); i++) {
+		if(_file_descriptors[i] && !_file_descriptors[i]->cloexec())
+			file_descriptors[i] = kstd::make_shared<FileDescriptor>(*_file_descriptors[i]);
+	}
+
+	if(args.file_actions) {
+		auto actions = UserspacePointer<posix_spawn_file_actions_t>((posix_spawn_file_actions_t*) args.file_actions).get();
+		if(actions.num_actions < 0 || actions.num_actions > SPAWN_MAX_FILE_ACTIONS)
+			return -EINVAL;
+		UserspacePointer<posix_spawn_file_action> actions_ptr(actions.actions);
+		for(int i = 0; i < actions.num_actions; i++) {
+			auto action = actions_ptr.get(i);
+			if(action.fd < 0)
+				return -EBADF;
+			if(action.fd >= (int) file_descriptors.size())
+				file_descriptors.resize(action.fd + 1);
+
+			switch(action.type) {
+				case SPAWN_FILE_ACTION_OPEN: {
+					if(!action.path)
+						return -EFAULT;
+					auto open_path = UserspacePointer<char>((char*) action.path).str();
+					auto fd_or_err = VFS::inst().open(open_path, action.flags, (action.mode & 04777) & ~_umask, _user, _cwd);
+					if(fd_or_err.is_error())
+						return fd_or_err.code();
+					fd_or_err.value()->set_path(open_path);
+					file_descriptors[action.fd] = fd_or_err.value();
+					break;
+				}
+
+				case SPAWN_FILE_ACTION_CLOSE:
+					if(!file_descriptors[action.fd])
+						return -EBADF;
+					file_descriptors[action.fd] = kstd::Arc<FileDescriptor>(nullptr);
+					break;
+
+				case SPAWN_FILE_ACTION_DUP2: {
+					if(action.src_fd < 0 || action.src_fd >= (int) file_descriptors.size() || !file_descriptors[action.src_fd])
+						return -EBADF;
+					if(action.src_fd == action.fd)
+						break;
+					auto new_fd = kstd::make_shared<FileDescriptor>(*file_descriptors[action.src_fd]);
+					new_fd->unset_options(O_CLOEXEC);
+					file_descriptors[action.fd] = new_fd;
+					break;
+				}
+
+				default:
+					return -EINVAL;
+			}
+		}
+	}
+
+	// Check the process group the same way setpgid() would
+	if((attr.flags & POSIX_SPAWN_SETPGROUP) && attr.pgroup) {
+		if(attr.pgroup < 0)
+			return -EINVAL;
+		bool found_group = false;
+		auto* procs = TaskManager::process_list();
+		for(int i = 0; i < procs->size(); i++) {
+			auto c_proc = procs->at(i);
+			if(c_proc->_pgid == attr.pgroup) {
+				if(c_proc->_sid != _sid)
+					return -EPERM;
+				found_group = true;
+			}
+		}
+		if(!found_group)
+			return -EPERM;
+	}
+
+	// Create the process straight from the executable, rather than copying ourselves and then throwing that away
+	auto new_proc_or_err = Process::create_user(path, _user, &proc_args, TaskManager::get_new_pid(), _pid);
+	if(new_proc_or_err.is_error())
+		return new_proc_or_err.code();
+	auto* new_proc = new_proc_or_err.value();
+
+	new_proc->_user = _user;
+	new_proc->_sid = _sid;
+	new_proc->_pgid = _pgid;
+	new_proc->_nice = _nice;
+	new_proc->_umask = _umask;
+	new_proc->_tty = _tty;
+	if(attr.flags & POSIX_SPAWN_SETSID) {
+		new_proc->_sid = new_proc->_pid;
+		new_proc->_pgid = new_proc->_pid;
+		new_proc->_tty.reset();
+	} else if(attr.flags & POSIX_SPAWN_SETPGROUP) {
+		new_proc->_pgid = attr.pgroup ? attr.pgroup : new_proc->_pid;
+	}
+
+	//Trim off null file descriptors, and give the rest to the new process
+	int last_fd = -1;
+	for(size_t i = 0; i < file_descriptors.size(); i++) {
+		if(file_descriptors[i]) {
+			last_fd = i;
+			file_descriptors[i]->set_owner(new_proc->_self_ptr);
+			file_descriptors[i]->set_id(i);
+		}
+	}
+	file_descriptors.resize(last_fd + 1);
+	new_proc->_file_descriptors = file_descriptors;
+
+	// The new process might exit before we return, so we save its pid here
+	auto pid = new_proc->_pid;
+	TaskManager::add_process(new_proc->_self_ptr);
+	return pid;
+}
@@ -0,0 +1,17 @@
+/* SPDX-License-Identifier: GPL-3.0-or-later */
+/* Copyright © 2016-2023 Byteduck */
+
+#include "../tasking/Process.h"
+#include "../filesystem/FileDescriptor.h"
+#include "../device/DiskDevice.h"
+
+int Process::sys_sync() {
+	return DiskDevice::sync_all().code();
+}
+
+int Process::sys_fsync(int file) {
+	if(file < 0 || file >= (int) _file_descriptors.size() || !_file_descriptors[file])
+		return -EBADF;
+	// Files don't keep track of which cached blocks belong to them, so this writes back their whole filesystem
+	return _file_descriptors[file]->file()->sync().code();
+}
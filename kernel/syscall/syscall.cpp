@@ -186,6 +186,22 @@ int handle_syscall(Registers& regs, uint32_t call, uint32_t arg1, uint32_t arg2,
 			return cur_proc->sys_mprotect((void*) arg1, (size_t) arg2, arg3);
 		case SYS_UNAME:
 			return cur_proc->sys_uname((struct utsname*) arg1);
+		case SYS_GETPRIORITY:
+			return cur_proc->sys_getpriority((int) arg1, (int) arg2);
+		case SYS_SETPRIORITY:
+			return cur_proc->sys_setpriority((int) arg1, (int) arg2, (int) arg3);
+		case SYS_SYNC:
+			return cur_proc->sys_sync();
+		case SYS_FSYNC:
+			return cur_proc->sys_fsync((int) arg1);
+		case SYS_SPLICE:
+			return cur_proc->sys_splice((int) arg1, (int) arg2, (size_t) arg3);
+		case SYS_FADVISE:
+			return cur_proc->sys_fadvise((struct fadvise_args*) arg1);
+		case SYS_VFORK:
+			return cur_proc->sys_vfork(regs);
+		case SYS_POSIX_SPAWN:
+			return cur_proc->sys_posix_spawn((struct posix_spawn_args*) arg1);
 
 		//TODO: Implement these syscalls
 		case SYS_TIMES:
@@ -78,9 +78,19 @@
 #define SYS_ACCESS 75
 #define SYS_MPROTECT 76
 #define SYS_UNAME 77
+#define SYS_GETPRIORITY 78
+#define SYS_SETPRIORITY 79
+#define SYS_SYNC 80
+#define SYS_FSYNC 81
+#define SYS_SPLICE 82
+#define SYS_FADVISE 83
+#define SYS_VFORK 84
+#define SYS_POSIX_SPAWN 85
 
 #ifndef DUCKOS_KERNEL
 #include <sys/types.h>
+#else
+#include <kernel/api/types.h>
 #endif
 
 struct readlinkat_args {
@@ -88,4 +98,11 @@ struct readlinkat_args {
 	const char* path;
 	char* buf;
 	size_t bufsize;
+};
+
+struct fadvise_args {
+	int fd;
+	off_t offset;
+	off_t len;
+	int advice;
 };
\ No newline at end of file
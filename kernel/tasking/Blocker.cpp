@@ -19,6 +19,7 @@
 
 #include "Blocker.h"
 #include "Process.h"
+#include "TaskManager.h"
 
 bool Blocker::can_be_interrupted() {
 	return true;
@@ -26,6 +27,7 @@ bool Blocker::can_be_interrupted() {
 
 void Blocker::interrupt() {
 	_interrupted = true;
+	m_woken = true;
 }
 
 void Blocker::reset_interrupted() {
@@ -36,10 +38,50 @@ bool Blocker::was_interrupted() {
 	return _interrupted;
 }
 
+void Blocker::notify() {
+	m_woken = true;
+	if(!m_thread)
+		return;
+	TaskManager::ScopedCritical critical;
+	if(m_thread)
+		m_thread->unblock();
+}
+
 void Blocker::on_interrupted() {
 
 }
 
+void Blocker::on_block() {
+
+}
+
+void Blocker::on_unblock() {
+
+}
+
+void Blocker::set_timeout(Time timeout) {
+	m_has_timeout = true;
+	m_timeout = timeout;
+}
+
+void Blocker::attach(Thread* thread) {
+	ASSERT(TaskManager::in_critical());
+	ASSERT(!m_thread);
+	m_thread = thread;
+	if(m_has_timeout)
+		TaskManager::add_timeout(*this);
+	on_block();
+}
+
+void Blocker::detach() {
+	ASSERT(TaskManager::in_critical());
+	if(!m_thread)
+		return;
+	on_unblock();
+	TaskManager::remove_timeout(*this);
+	m_thread = nullptr;
+}
+
 bool Blocker::is_lock() {
 	return false;
 }
@@ -19,8 +19,11 @@
 
 #pragma once
 
+#include <kernel/time/Time.h>
+
 class Process;
 class Thread;
+class TimerHeap;
 class Blocker {
 public:
 	virtual bool is_ready() = 0;
@@ -32,10 +35,52 @@ public:
 	void reset_interrupted();
 	bool was_interrupted();
 
+	/**
+	 * Wakes up the thread blocked on this blocker (if any) so that it can check is_ready() again. This should be called
+	 * whenever the condition the blocker is waiting on may have changed. Safe to call from an interrupt handler.
+	 */
+	void notify();
+
+	bool has_timeout() const { return m_has_timeout; }
+	Time timeout() const { return m_timeout; }
+
 protected:
 	virtual void on_interrupted();
 
+	/**
+	 * Called in a critical section when a thread begins waiting on this blocker. Blockers should add themselves to any
+	 * WaitQueues that will notify them here.
+	 */
+	virtual void on_block();
+
+	/**
+	 * Called in a critical section when a thread stops waiting on this blocker. Blockers should remove themselves from
+	 * any WaitQueues they were added to in on_block() here.
+	 */
+	virtual void on_unblock();
+
+	/**
+	 * Sets a time at which this blocker will be notified even if nothing else notifies it.
+	 */
+	void set_timeout(Time timeout);
+
 private:
+	friend class Thread;
+	friend class TimerHeap;
+
+	void attach(Thread* thread);
+	void detach();
+
 	bool _interrupted = false;
+	volatile bool m_woken = false;
+	Thread* m_thread = nullptr;
+
+	//Timeout
+	bool m_has_timeout = false;
+	Time m_timeout;
+	bool m_timer_queued = false;
+	Blocker* m_timer_child = nullptr;
+	Blocker* m_timer_sibling = nullptr;
+	Blocker* m_timer_prev = nullptr;
 };
 
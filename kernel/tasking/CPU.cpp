@@ -0,0 +1,106 @@
+/* SPDX-License-Identifier: GPL-3.0-or-later */
+/* Copyright © 2016-2023 Byteduck */
+
+#include "CPU.h"
+#include "Thread.h"
+#include "TaskManager.h"
+#include <kernel/memory/gdt.h>
+#include <kernel/memory/MemoryManager.h>
+#include <kernel/interrupt/APIC.h>
+#include <kernel/interrupt/idt.h>
+#include <kernel/time/Time.h>
+#include <kernel/kstd/KLog.h>
+#include <kernel/kstd/cstring.h>
+
+CPU CPU::s_cpus[MAX_CPUS];
+int CPU::s_num_cpus = 1;
+Atomic<int> CPU::s_num_online = 1;
+
+// These are used by the AP trampoline in asm/ap_boot.s
+extern "C" uint8_t ap_boot_start[];
+extern "C" uint8_t ap_boot_end[];
+extern "C" uint32_t ap_boot_cr3;
+extern "C" uint32_t ap_boot_stack;
+extern "C" uint32_t BootPageDirectory[];
+extern "C" uint32_t IdentityPageTable[];
+static int s_booting_cpu = 0;
+
+void CPU::init_bsp(uint8_t apic_id) {
+	s_cpus[0].m_id = 0;
+	s_cpus[0].m_apic_id = apic_id;
+	s_cpus[0].m_online = true;
+}
+
+CPU* CPU::add(uint8_t apic_id) {
+	if(s_num_cpus >= MAX_CPUS) {
+		KLog::warn("CPU", "Ignoring processor with APIC ID %d, since there are too many processors!", apic_id);
+		return nullptr;
+	}
+	auto& cpu = s_cpus[s_num_cpus];
+	cpu.m_id = s_num_cpus++;
+	cpu.m_apic_id = apic_id;
+	return &cpu;
+}
+
+static bool wait_until_online(CPU& cpu, long usec) {
+	auto end = Time::now() + Time(0, usec);
+	while(!cpu.online() && Time::now() < end)
+		asm volatile("pause");
+	return cpu.online();
+}
+
+void CPU::start_aps() {
+	if(s_num_cpus == 1 || !APIC::available())
+		return;
+
+	// Copy the trampoline to low memory, where the APs can run it in real mode
+	size_t trampoline_size = ap_boot_end - ap_boot_start;
+	ASSERT(trampoline_size <= PAGE_SIZE);
+	{
+		auto region = MM.alloc_mapped_region(AP_BOOT_PADDR, PAGE_SIZE);
+		memcpy((void*) region->start(), ap_boot_start, trampoline_size);
+	}
+
+	// The trampoline turns on paging with the boot page directory before jumping to the kernel, so its identity mapping
+	// of low memory needs to be put back. Nothing else uses the boot page directory anymore, so we just leave it.
+	BootPageDirectory[0] = ((uint32_t) IdentityPageTable - HIGHER_HALF) | 0x3;
+	ap_boot_cr3 = MM.kernel_page_directory.entries_physaddr();
+
+	for(int i = 1; i < s_num_cpus; i++) {
+		auto& cpu = s_cpus[i];
+		cpu.m_boot_stack = MM.alloc_kernel_region(AP_BOOT_STACK_SIZE);
+		ap_boot_stack = cpu.m_boot_stack->end();
+		s_booting_cpu = i;
+
+		// Send an INIT followed by up to two startup IPIs, as the MultiProcessor spec says to
+		APIC::send_init(cpu.m_apic_id);
+		wait_until_online(cpu, 10000);
+		for(int attempt = 0; attempt < 2 && !cpu.online(); attempt++) {
+			APIC::send_startup(cpu.m_apic_id, AP_BOOT_PADDR);
+			wait_until_online(cpu, 100000);
+		}
+
+		if(cpu.online())
+			KLog::dbg("CPU", "Processor %d (APIC ID %d) is online.", i, cpu.m_apic_id);
+		else
+			KLog::warn("CPU", "Processor %d (APIC ID %d) didn't start!", i, cpu.m_apic_id);
+	}
+
+	KLog::info("CPU", "%d of %d processors online.", online_count(), s_num_cpus);
+}
+
+void ap_main() {
+	auto& cpu = CPU::s_cpus[s_booting_cpu];
+	Memory::load_gdt_ap(cpu.m_id);
+	Interrupt::idt_load();
+	APIC::init_local();
+	CPU::s_num_online.add(1);
+	cpu.m_online = true;
+
+	// Threads can't be scheduled on the APs until critical sections are safe across processors, since they only
+	// disable interrupts on the current processor. Until then, just park here. Nothing runs here that could have stale
+	// TLB entries, so there's no need for TLB shootdowns either. Once the APs do run threads, CPU::current() will need to
+	// look up the CPU from the task register, since each CPU has its own TSS.
+	while(true)
+		asm volatile("cli; hlt");
+}
@@ -0,0 +1,86 @@
+/* SPDX-License-Identifier: GPL-3.0-or-later */
+/* Copyright © 2016-2023 Byteduck */
+
+#pragma once
+
+#include <kernel/kstd/Arc.h>
+#include <kernel/kstd/types.h>
+#include <kernel/Atomic.h>
+#include <kernel/memory/Memory.h>
+#include "TSS.h"
+#include "RunQueue.h"
+
+#define MAX_CPUS 16
+#define AP_BOOT_STACK_SIZE 16384
+
+class Thread;
+class VMRegion;
+
+extern "C" void ap_main();
+
+/**
+ * The state belonging to a single processor. Each CPU has its own TSS (and GDT entry for it).
+ *
+ * Only bring-up is supported for now: the application processors are started and then parked, and every thread runs on
+ * the bootstrap processor. Scheduling on the APs needs SpinLock and critical sections to work across processors first.
+ */
+class CPU {
+public:
+	/// The CPU the calling code is running on. Since the APs are parked, this is always the bootstrap processor for now.
+	static CPU& current() { return s_cpus[0]; }
+	/// The bootstrap processor. This is always the first CPU.
+	static CPU& bsp() { return s_cpus[0]; }
+	static CPU& get(int id) { return s_cpus[id]; }
+	/// The number of CPUs that were found, whether or not they were started.
+	static int count() { return s_num_cpus; }
+	/// The number of CPUs that are up and running.
+	static int online_count() { return s_num_online.load(); }
+
+	/**
+	 * Sets up the bootstrap processor. Must be called once before anything else is registered.
+	 * @param apic_id The ID of the bootstrap processor's local APIC.
+	 */
+	static void init_bsp(uint8_t apic_id);
+
+	/**
+	 * Registers an application processor found in the system. It won't be started until start_aps() is called.
+	 * @param apic_id The ID of the processor's local APIC.
+	 * @return The new CPU, or nullptr if there are too many.
+	 */
+	static CPU* add(uint8_t apic_id);
+
+	/**
+	 * Starts all of the application processors and waits for them to come online.
+	 */
+	static void start_aps();
+
+	int id() const { return m_id; }
+	uint8_t apic_id() const { return m_apic_id; }
+	bool online() const { return m_online.load(); }
+
+	// Scheduler state, which should only be touched while holding TaskManager::g_tasking_lock (or by the CPU itself in
+	// the case of the counters and flags)
+	TSS tss;
+	kstd::Arc<Thread> current_thread;
+	kstd::Arc<Thread> idle_thread;
+	RunQueue run_queue;
+	Atomic<int, MemoryOrder::SeqCst> critical_count = 0;
+	bool preempting = false;
+	bool yield_async = false;
+	bool need_resched = false;
+	bool preempt_from_tick = false;
+	/// The thread whose FPU state is currently loaded into this CPU's FPU, if any. See Thread::handle_fpu_fault.
+	Thread* fpu_owner = nullptr;
+
+private:
+	friend void ap_main();
+
+	static CPU s_cpus[MAX_CPUS];
+	static int s_num_cpus;
+	static Atomic<int> s_num_online;
+
+	int m_id = 0;
+	uint8_t m_apic_id = 0;
+	Atomic<bool> m_online = false;
+	kstd::Arc<VMRegion> m_boot_stack;
+};
@@ -22,6 +22,9 @@
 #include <kernel/memory/MemoryManager.h>
 #include <kernel/filesystem/FileDescriptor.h>
 #include <kernel/memory/PageDirectory.h>
+#include <kernel/memory/InodeVMObject.h>
+#include <kernel/memory/AnonymousVMObject.h>
+#include <kernel/filesystem/InodeFile.h>
 #include <kernel/kstd/KLog.h>
 
 bool ELF::is_valid_elf_header(elf32_header* header) {
@@ -112,29 +115,101 @@ ResultRet<kstd::string> ELF::read_interp(FileDescriptor& fd, kstd::vector<elf32_
 	return Result(-ENOENT);
 }
 
+/**
+ * Loads a segment by reading it into a new anonymous object, for when it can't be mapped from the file.
+ */
+static ResultRet<kstd::Arc<VMRegion>> load_segment_copy(FileDescriptor& fd, ELF::elf32_segment_header& header, const kstd::Arc<VMSpace>& vm_space, VMProt prot) {
+	size_t loadloc_pagealigned = (header.p_vaddr/PAGE_SIZE) * PAGE_SIZE;
+	size_t loadsize_pagealigned = header.p_memsz + (header.p_vaddr % PAGE_SIZE);
+
+	//Allocate a kernel memory region to load the section into
+	auto tmp_region = MM.alloc_kernel_region(loadsize_pagealigned);
+
+	//Read the section into the region
+	fd.seek(header.p_offset, SEEK_SET);
+	fd.read(KernelPointer<uint8_t>((uint8_t*) tmp_region->start() + (header.p_vaddr - loadloc_pagealigned)), header.p_filesz);
+
+	//Map it into the program's vmem
+	return vm_space->map_object(tmp_region->object(), prot, VirtualRange { loadloc_pagealigned, tmp_region->size() });
+}
+
+/**
+ * Gives a private copy of a file a page of its own with everything past a certain point zeroed, for the last page of a
+ * writable segment whose data doesn't end on a page boundary.
+ */
+static Result zero_page_tail(const kstd::Arc<InodeVMObject>& object, size_t page_index, size_t num_valid) {
+	auto cache_page = TRY(object->inode()->shared_vm_object()->get_page(page_index, true));
+	auto page = MM.alloc_physical_page();
+	if(page.is_error()) {
+		MM.get_physical_page(cache_page).unref();
+		return page.result();
+	}
+
+	MM.copy_page(cache_page, page.value());
+	MM.get_physical_page(cache_page).unref();
+	MM.with_quickmapped(page.value(), [&](void* page_ptr) {
+		memset((uint8_t*) page_ptr + num_valid, 0, PAGE_SIZE - num_valid);
+	});
+
+	LOCK(object->lock());
+	object->physical_page_index(page_index) = page.value();
+	return Result(SUCCESS);
+}
+
 ResultRet<kstd::vector<kstd::Arc<VMRegion>>> ELF::load_sections(FileDescriptor& fd, kstd::vector<elf32_segment_header>& headers, const kstd::Arc<VMSpace>& vm_space) {
+	//Segments are mapped straight from the file's page cache when possible
+	kstd::Arc<Inode> inode;
+	auto file = fd.file();
+	if(file && file->is_inode())
+		inode = kstd::static_pointer_cast<InodeFile>(file)->inode();
+
 	kstd::vector<kstd::Arc<VMRegion>> regions;
 	for(uint32_t i = 0; i < headers.size(); i++) {
 		auto& header = headers[i];
-		if(header.p_type == ELF_PT_LOAD) {
-			size_t loadloc_pagealigned = (header.p_vaddr/PAGE_SIZE) * PAGE_SIZE;
-			size_t loadsize_pagealigned = header.p_memsz + (header.p_vaddr % PAGE_SIZE);
-
-			//Allocate a kernel memory region to load the section into
-			auto tmp_region = MM.alloc_kernel_region(loadsize_pagealigned);
-
-			//Read the section into the region
-			fd.seek(header.p_offset, SEEK_SET);
-			fd.read(KernelPointer<uint8_t>((uint8_t*) tmp_region->start() + (header.p_vaddr - loadloc_pagealigned)), header.p_filesz);
-
-			//Map it into the program's vmem
-			VMProt prot = {
-				.read = (bool) (header.p_flags & ELF_PF_R),
-				.write = (bool) (header.p_flags & ELF_PF_W),
-				.execute = (bool) (header.p_flags & ELF_PF_X)
-			};
-			auto vmem_region = TRY(vm_space->map_object(tmp_region->object(), prot, VirtualRange { loadloc_pagealigned, tmp_region->size() }));
-			regions.push_back(vmem_region);
+		if(header.p_type != ELF_PT_LOAD)
+			continue;
+
+		VMProt prot = {
+			.read = (bool) (header.p_flags & ELF_PF_R),
+			.write = (bool) (header.p_flags & ELF_PF_W),
+			.execute = (bool) (header.p_flags & ELF_PF_X)
+		};
+
+		//The segment can only be mapped if it's at the same offset into a page in the file as it is in memory
+		size_t page_offset = header.p_vaddr % PAGE_SIZE;
+		if(!inode || header.p_offset % PAGE_SIZE != page_offset || (!prot.write && header.p_memsz != header.p_filesz)) {
+			regions.push_back(TRY(load_segment_copy(fd, header, vm_space, prot)));
+			continue;
+		}
+
+		VirtualAddress start = header.p_vaddr - page_offset;
+		size_t file_start = header.p_offset - page_offset;
+		size_t file_size = ((page_offset + header.p_filesz + PAGE_SIZE - 1) / PAGE_SIZE) * PAGE_SIZE;
+		size_t mem_size = ((page_offset + header.p_memsz + PAGE_SIZE - 1) / PAGE_SIZE) * PAGE_SIZE;
+
+		//Read-only segments (text) map the page cache itself, so every process running the program shares them
+		if(!prot.write) {
+			auto object = kstd::static_pointer_cast<VMObject>(inode->shared_vm_object());
+			regions.push_back(TRY(vm_space->map_object(object, prot, VirtualRange { start, file_size }, file_start)));
+			continue;
+		}
+
+		//Writable segments get a private copy of the file that's faulted in and copied on write as it's used
+		if(header.p_filesz) {
+			auto object = InodeVMObject::make_for_inode(inode, InodeVMObject::Type::Private);
+			size_t data_end = header.p_offset + header.p_filesz;
+			if(data_end % PAGE_SIZE) {
+				auto res = zero_page_tail(object, data_end / PAGE_SIZE, data_end % PAGE_SIZE);
+				if(res.is_error())
+					return res;
+			}
+			regions.push_back(TRY(vm_space->map_object(kstd::static_pointer_cast<VMObject>(object), prot, VirtualRange { start, file_size }, file_start)));
+		}
+
+		//The rest of the segment (.bss) is zeroed memory
+		if(mem_size > file_size) {
+			auto object = kstd::static_pointer_cast<VMObject>(TRY(AnonymousVMObject::alloc(mem_size - file_size)));
+			regions.push_back(TRY(vm_space->map_object(object, prot, VirtualRange { start + file_size, mem_size - file_size })));
 		}
 	}
 
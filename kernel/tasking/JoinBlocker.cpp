@@ -29,6 +29,14 @@ bool JoinBlocker::is_ready() {
 	return _wait_thread->state() == Thread::ZOMBIE || _wait_thread->state() == Thread::DEAD;
 }
 
+void JoinBlocker::on_block() {
+	_wait_thread->join_queue().add(_wait_entry, *this);
+}
+
+void JoinBlocker::on_unblock() {
+	WaitQueue::remove(_wait_entry);
+}
+
 kstd::Arc<Thread> JoinBlocker::waited_thread() {
 	return _wait_thread;
 }
\ No newline at end of file
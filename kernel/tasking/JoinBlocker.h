@@ -21,6 +21,7 @@
 
 
 #include "Blocker.h"
+#include "WaitQueue.h"
 #include <kernel/kstd/unix_types.h>
 #include <kernel/kstd/Arc.h>
 
@@ -30,11 +31,17 @@ public:
 	JoinBlocker(kstd::Arc<Thread> thread, kstd::Arc<Thread> wait_for);
 	bool is_ready() override;
 	kstd::Arc<Thread> waited_thread();
+
+protected:
+	void on_block() override;
+	void on_unblock() override;
+
 private:
 	int _err = 0;
 	int _exit_status = 0;
 	kstd::Arc<Thread> _wait_thread;
 	kstd::Arc<Thread> _thread;
+	WaitQueue::Entry _wait_entry;
 };
 
 
@@ -24,6 +24,8 @@
 PollBlocker::PollBlocker(kstd::vector<PollFD>& pollfd, Time timeout):
 	polls(pollfd), has_timeout(timeout >= Time()), start_time(Time::now()), end_time(Time::now() + timeout)
 {
+	if(has_timeout)
+		set_timeout(end_time);
 }
 
 bool PollBlocker::is_ready() {
@@ -47,4 +49,14 @@ bool PollBlocker::is_ready() {
 		return true;
 
 	return false;
+}
+
+void PollBlocker::on_block() {
+	for(auto& poll : polls)
+		poll.fd->file()->poll_queue().add(poll.wait_entry, *this);
+}
+
+void PollBlocker::on_unblock() {
+	for(auto& poll : polls)
+		WaitQueue::remove(poll.wait_entry);
 }
\ No newline at end of file
@@ -21,6 +21,7 @@
 
 #include <kernel/kstd/vector.hpp>
 #include "Blocker.h"
+#include "WaitQueue.h"
 #include <kernel/time/Time.h>
 #include <kernel/kstd/Arc.h>
 
@@ -32,6 +33,7 @@ public:
 		int fd_num;
 		kstd::Arc<FileDescriptor> fd;
 		short events;
+		WaitQueue::Entry wait_entry;
 	};
 
 	PollBlocker(kstd::vector<PollFD>& pollfd, Time timeout);
@@ -39,6 +41,11 @@ public:
 
 	int polled;
 	short polled_revent;
+
+protected:
+	void on_block() override;
+	void on_unblock() override;
+
 private:
 	kstd::vector<PollFD> polls;
 	Time end_time;
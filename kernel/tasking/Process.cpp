@@ -28,6 +28,7 @@
 #include "Thread.h"
 #include "../kstd/KLog.h"
 #include "../filesystem/procfs/ProcFS.h"
+#include "../api/resource.h"
 
 Process* Process::create_kernel(const kstd::string& name, void (*func)()){
 	ProcessArgs args = ProcessArgs(kstd::Arc<LinkedInode>(nullptr));
@@ -142,6 +143,19 @@ bool Process::is_kernel_mode() {
 	return _kernel_mode;
 }
 
+int Process::nice() {
+	return _nice;
+}
+
+void Process::set_nice(int nice) {
+	// Threads already in the run queue will pick up the new priority the next time they're queued
+	if(nice < PRIO_MIN)
+		nice = PRIO_MIN;
+	if(nice >= PRIO_MAX)
+		nice = PRIO_MAX - 1;
+	_nice = nice;
+}
+
 tid_t Process::last_active_thread() {
 	return _last_active_thread;
 }
@@ -170,6 +184,10 @@ kstd::Arc<Thread> Process::get_thread(tid_t tid) {
 	return {};
 }
 
+WaitQueue& Process::child_wait_queue() {
+	return _child_wait_queue;
+}
+
 Process::Process(const kstd::string& name, size_t entry_point, bool kernel, ProcessArgs* args, pid_t pid, pid_t ppid):
 		_user(User::root()),
 		_name(name),
@@ -198,7 +216,7 @@ Process::Process(const kstd::string& name, size_t entry_point, bool kernel, Proc
 	insert_thread(kstd::Arc<Thread>(main_thread));
 }
 
-Process::Process(Process *to_fork, Registers &regs): _user(to_fork->_user), _self_ptr(this) {
+Process::Process(Process *to_fork, Registers &regs, bool share_vm): _user(to_fork->_user), _self_ptr(this) {
 	if(to_fork->_kernel_mode)
 		PANIC("KRNL_PROCESS_FORK", "Kernel processes cannot be forked.");
 
@@ -211,9 +229,10 @@ Process::Process(Process *to_fork, Registers &regs): _user(to_fork->_user), _sel
 	_sid = to_fork->_sid;
 	_pgid = to_fork->_pgid;
 	_umask = to_fork->_umask;
+	_nice = to_fork->_nice;
 	_tty = to_fork->_tty;
-	m_used_pmem = to_fork->m_used_pmem;
-	m_used_shmem = to_fork->m_used_shmem;
+	m_used_pmem = share_vm ? 0 : to_fork->m_used_pmem;
+	m_used_shmem = share_vm ? 0 : to_fork->m_used_shmem;
 	_state = ALIVE;
 
 	//TODO: Prevent thread race condition when copying signal handlers/file descriptors
@@ -230,12 +249,18 @@ Process::Process(Process *to_fork, Registers &regs): _user(to_fork->_user), _sel
 		}
 	}
 
-	// Create page directory and fork the old one
+	// A vfork()'d child borrows our address space until it execs or exits, so there's nothing to copy.
+	// Otherwise, create a page directory and fork the old one.
 	/* TODO: We're probably leaking thread stack regions here, since they'll be put into _vm_regions rather than
 	 * Thread::_stack_region (they will be cleaned up once the process dies / exec()s, though).
 	 */
-	_page_directory = kstd::make_shared<PageDirectory>();
-	_vm_space = to_fork->_vm_space->fork(*_page_directory, _vm_regions);
+	if(share_vm) {
+		_page_directory = to_fork->_page_directory;
+		_vm_space = to_fork->_vm_space;
+	} else {
+		_page_directory = kstd::make_shared<PageDirectory>();
+		_vm_space = to_fork->_vm_space->fork(*_page_directory, _vm_regions);
+	}
 
 	//Create the main thread
 	auto* main_thread = new Thread(_self_ptr, _pid, regs);
@@ -378,6 +403,8 @@ void Process::alert_thread_died(kstd::Arc<Thread> thread) {
 		}
 		TaskManager::reparent_orphans(this);
 		_state = ZOMBIE;
+		if(!parent.is_error())
+			parent.value()->_child_wait_queue.wake_all();
 	}
 }
 
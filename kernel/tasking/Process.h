@@ -27,6 +27,7 @@
 #include <kernel/User.h>
 #include <kernel/kstd/string.h>
 #include "../api/poll.h"
+#include "WaitQueue.h"
 
 class FileDescriptor;
 class Blocker;
@@ -70,6 +71,8 @@ public:
 	int all_threads_state();
 	int exit_status();
 	bool is_kernel_mode();
+	int nice();
+	void set_nice(int nice);
 
 	//Threads
 	tid_t last_active_thread();
@@ -77,6 +80,7 @@ public:
 	kstd::Arc<Thread> spawn_kernel_thread(void (*entry)());
 	const kstd::vector<tid_t>& threads();
 	kstd::Arc<Thread> get_thread(tid_t tid);
+	WaitQueue& child_wait_queue();
 
 	//Signals and death
 	void kill(int signal);
@@ -98,6 +102,7 @@ public:
 	ssize_t sys_read(int fd, UserspacePointer<uint8_t> buf, size_t count);
 	ssize_t sys_write(int fd, UserspacePointer<uint8_t> buf, size_t count);
 	pid_t sys_fork(Registers& regs);
+	pid_t sys_vfork(Registers& regs);
 	int exec(const kstd::string& filename, ProcessArgs* args);
 	int sys_execve(UserspacePointer<char> filename, UserspacePointer<char*> argv, UserspacePointer<char*> envp);
 	int sys_execvp(UserspacePointer<char> filename, UserspacePointer<char*> argv);
@@ -167,12 +172,19 @@ public:
 	int sys_munmap(void* addr, size_t length);
 	int sys_mprotect(void* addr, size_t length, int prot);
 	int sys_uname(UserspacePointer<struct utsname> buf);
+	int sys_getpriority(int which, int who);
+	int sys_setpriority(int which, int who, int prio);
+	int sys_sync();
+	int sys_fsync(int file);
+	int sys_splice(int fd_in, int fd_out, size_t len);
+	int sys_fadvise(UserspacePointer<struct fadvise_args> args);
+	pid_t sys_posix_spawn(UserspacePointer<struct posix_spawn_args> args);
 
 private:
 	friend class Thread;
 	friend class Reaper;
 	Process(const kstd::string& name, size_t entry_point, bool kernel, ProcessArgs* args, pid_t pid, pid_t ppid);
-	Process(Process* to_fork, Registers& regs);
+	Process(Process* to_fork, Registers& regs, bool share_vm = false);
 
 	void alert_thread_died(kstd::Arc<Thread> thread);
 	void recalculate_pmem_total();
@@ -189,6 +201,7 @@ private:
 	kstd::Arc<TTYDevice> _tty;
 	User _user;
 	mode_t _umask = 022;
+	int _nice = 0;
 	int _exit_status = 0;
 	State _state;
 	bool _kernel_mode = false;
@@ -217,6 +230,7 @@ private:
 	kstd::vector<tid_t> _tids;
 	tid_t _last_active_thread = 1;
 	SpinLock _thread_lock;
+	WaitQueue _child_wait_queue;
 
 	Process* _self_ptr;
 };
@@ -0,0 +1,82 @@
+/* SPDX-License-Identifier: GPL-3.0-or-later */
+/* Copyright © 2016-2023 Byteduck */
+
+#include "RunQueue.h"
+#include "Thread.h"
+
+void RunQueue::push(Thread* thread) {
+	if(thread->m_run_queue)
+		return;
+
+	int level = thread->priority();
+	ASSERT(level >= 0 && level < num_levels);
+	auto& queue = m_levels[level];
+	thread->m_run_queue = this;
+	thread->m_queued_level = level;
+	thread->m_queued_tick = m_ticks;
+	thread->m_next = nullptr;
+	thread->m_prev = queue.tail;
+	if(queue.tail)
+		queue.tail->m_next = thread;
+	else
+		queue.head = thread;
+	queue.tail = thread;
+	m_bitmap |= 1u << level;
+	m_size++;
+}
+
+Thread* RunQueue::pop() {
+	int level = highest_level();
+	if(level < 0)
+		return nullptr;
+	auto* thread = m_levels[level].head;
+	remove(thread);
+	// It's getting its turn now, so it no longer needs the boost it got from waiting
+	thread->_aging_boost = 0;
+	return thread;
+}
+
+void RunQueue::remove(Thread* thread) {
+	if(thread->m_run_queue != this)
+		return;
+
+	auto& queue = m_levels[thread->m_queued_level];
+	if(thread->m_prev)
+		thread->m_prev->m_next = thread->m_next;
+	else
+		queue.head = thread->m_next;
+	if(thread->m_next)
+		thread->m_next->m_prev = thread->m_prev;
+	else
+		queue.tail = thread->m_prev;
+	if(!queue.head)
+		m_bitmap &= ~(1u << thread->m_queued_level);
+
+	thread->m_run_queue = nullptr;
+	thread->m_next = nullptr;
+	thread->m_prev = nullptr;
+	m_size--;
+}
+
+void RunQueue::age(uint32_t max_wait) {
+	if(++m_ticks % max_wait)
+		return;
+
+	// Threads move up at most one level, and we go from the top down, so nobody gets aged twice
+	for(int level = 1; level < num_levels; level++) {
+		auto* thread = m_levels[level].head;
+		while(thread) {
+			auto* next = thread->m_next;
+			if(m_ticks - thread->m_queued_tick >= max_wait) {
+				remove(thread);
+				thread->age_priority();
+				push(thread);
+			}
+			thread = next;
+		}
+	}
+}
+
+Thread* RunQueue::next_of(Thread* thread) {
+	return thread->m_next;
+}
@@ -0,0 +1,69 @@
+/* SPDX-License-Identifier: GPL-3.0-or-later */
+/* Copyright © 2016-2023 Byteduck */
+
+#pragma once
+
+#include <kernel/kstd/types.h>
+
+class Thread;
+
+/**
+ * A set of FIFO thread queues, one for each priority level. Threads are linked into the queues intrusively, so queueing
+ * and dequeueing never allocate, and a bitmap of non-empty levels makes picking the highest-priority thread O(1).
+ * This must only be modified while holding TaskManager::g_tasking_lock.
+ */
+class RunQueue {
+public:
+	/// The number of priority levels. Level 0 is the highest priority.
+	static constexpr int num_levels = 8;
+
+	/**
+	 * Adds a thread to the back of the queue for its current priority level. Does nothing if it's already queued.
+	 */
+	void push(Thread* thread);
+
+	/**
+	 * Removes and returns the thread at the front of the highest-priority non-empty level.
+	 * @return The thread, or nullptr if the queue is empty.
+	 */
+	Thread* pop();
+
+	/**
+	 * Removes a thread from the queue, if it is in it.
+	 */
+	void remove(Thread* thread);
+
+	/**
+	 * Advances the queue's clock by a tick. Every max_wait ticks, threads that have been waiting since the last check
+	 * are moved up a level (see Thread::age_priority()), so that busy threads at higher levels can't starve them forever.
+	 */
+	void age(uint32_t max_wait);
+
+	/**
+	 * Calls a function on each queued thread, from highest to lowest priority. The function must not modify the queue.
+	 */
+	template<typename F>
+	void for_each(F&& func) {
+		for(auto& level : m_levels)
+			for(auto* thread = level.head; thread; thread = next_of(thread))
+				func(thread);
+	}
+
+	/// The highest priority level with a thread queued, or -1 if the queue is empty.
+	int highest_level() const { return m_bitmap ? __builtin_ctz(m_bitmap) : -1; }
+	bool empty() const { return !m_bitmap; }
+	size_t size() const { return m_size; }
+
+private:
+	struct Level {
+		Thread* head = nullptr;
+		Thread* tail = nullptr;
+	};
+
+	static Thread* next_of(Thread* thread);
+
+	Level m_levels[num_levels];
+	uint32_t m_bitmap = 0;
+	size_t m_size = 0;
+	uint32_t m_ticks = 0;
+};
@@ -21,6 +21,7 @@
 #include <kernel/kstd/kstdio.h>
 
 SleepBlocker::SleepBlocker(Time time): _end_time(Time::now() + time) {
+	set_timeout(_end_time);
 }
 
 bool SleepBlocker::is_ready() {
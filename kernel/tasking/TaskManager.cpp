@@ -25,22 +25,33 @@
 #include "Process.h"
 #include "Thread.h"
 #include "Reaper.h"
+#include "Blocker.h"
+#include "TimerHeap.h"
+#include "RunQueue.h"
+#include "CPU.h"
 #include <kernel/kstd/KLog.h>
+#include <kernel/CommandLine.h>
+#include <kernel/device/DiskDevice.h>
+#include <kernel/kstd/kstdlib.h>
 
-TSS TaskManager::tss;
 SpinLock TaskManager::g_tasking_lock;
 SpinLock TaskManager::g_process_lock;
 
-kstd::Arc<Thread> cur_thread;
 Process* kernel_process;
 kstd::vector<Process*>* processes = nullptr;
-Thread* TaskManager::g_next_thread;
 
 Atomic<int> next_pid = 0;
 bool tasking_enabled = false;
-bool yield_async = false;
-bool preempting = false;
-static uint8_t quantum_counter = 0;
+static TimerHeap timeouts;
+
+// Lower priority levels get longer quanta, since threads end up there by being CPU-bound and switching less often is
+// kinder to their caches. Higher priority threads are usually interactive and won't use their whole quantum anyway.
+#define DEFAULT_BASE_QUANTUM 5
+static int quanta[RunQueue::num_levels];
+// Threads waiting in a run queue for this many of the longest quantum are moved up a level
+#define AGING_QUANTA 2
+
+#define CR0_TS 0x8 // The "task switched" bit, which makes the next FPU instruction trap
 
 void kidle(){
 	tasking_enabled = true;
@@ -108,9 +119,20 @@ void TaskManager::kill_pgid(pid_t pgid, int sig) {
 
 void TaskManager::reparent_orphans(Process* dead) {
 	CRITICAL_LOCK(g_tasking_lock);
-	for(auto process : *processes)
-		if(process->ppid() == dead->pid())
+	bool reparented = false;
+	for(auto process : *processes) {
+		if(process->ppid() == dead->pid()) {
 			process->set_ppid(1);
+			reparented = true;
+		}
+	}
+
+	// Init may be waiting on children, and some of its new ones may already be zombies
+	if(reparented) {
+		auto init = process_for_pid(1);
+		if(!init.is_error())
+			init.value()->child_wait_queue().wake_all();
+	}
 }
 
 bool TaskManager::enabled(){
@@ -118,13 +140,14 @@ bool TaskManager::enabled(){
 }
 
 bool TaskManager::is_idle() {
-	if(!kernel_process)
+	auto& cpu = CPU::current();
+	if(!cpu.idle_thread)
 		return true;
-	return cur_thread->tid() == kernel_process->pid();
+	return cpu.current_thread == cpu.idle_thread;
 }
 
 bool TaskManager::is_preempting() {
-	return preempting;
+	return CPU::current().preempting;
 }
 
 pid_t TaskManager::get_new_pid(){
@@ -137,6 +160,14 @@ void TaskManager::init(){
 
 	processes = new kstd::vector<Process*>();
 
+	//Set up the quantum for each priority level
+	int base_quantum = DEFAULT_BASE_QUANTUM;
+	auto& quantum_opt = CommandLine::inst().get_option_value("sched_quantum");
+	if(quantum_opt.length() && atoi(quantum_opt.c_str()) > 0)
+		base_quantum = atoi(quantum_opt.c_str());
+	for(int level = 0; level < RunQueue::num_levels; level++)
+		quanta[level] = base_quantum * (1 + level / 2);
+
 	//Create kernel process
 	kernel_process = Process::create_kernel("[kernel]", kidle);
 	processes->push_back(kernel_process);
@@ -148,10 +179,15 @@ void TaskManager::init(){
 
 	//Create kernel threads
 	kernel_process->spawn_kernel_thread(kreaper_entry);
+	kernel_process->spawn_kernel_thread(kflusher_entry);
+	kernel_process->spawn_kernel_thread(kreadahead_entry);
+	kernel_process->spawn_kernel_thread(kreclaimer_entry);
 
 	//Preempt
-	cur_thread = kernel_process->get_thread(kernel_process->pid());
-	preempt_init_asm(cur_thread->registers.esp);
+	auto& cpu = CPU::bsp();
+	cpu.idle_thread = kernel_process->get_thread(kernel_process->pid());
+	cpu.current_thread = cpu.idle_thread;
+	preempt_init_asm(cpu.current_thread->registers.esp);
 }
 
 kstd::vector<Process*>* TaskManager::process_list() {
@@ -159,11 +195,11 @@ kstd::vector<Process*>* TaskManager::process_list() {
 }
 
 kstd::Arc<Thread>& TaskManager::current_thread() {
-	return cur_thread;
+	return CPU::current().current_thread;
 }
 
 Process* TaskManager::current_process() {
-	return cur_thread->process();
+	return CPU::current().current_thread->process();
 }
 
 int TaskManager::add_process(Process* proc){
@@ -206,45 +242,54 @@ void TaskManager::queue_thread(const kstd::Arc<Thread>& thread) {
 		return;
 	}
 
-	if(g_next_thread)
-		g_next_thread->enqueue_thread(thread.get());
-	else
-		g_next_thread = thread.get();
+	// Queue the thread on the current CPU
+	auto& cpu = CPU::current();
+	cpu.run_queue.push(thread.get());
+
+	// If the thread should run before the current one, preempt as soon as possible instead of waiting for its quantum
+	if(!cpu.current_thread || is_idle() || thread->priority() < cpu.current_thread->priority())
+		cpu.need_resched = true;
+}
+
+void TaskManager::dequeue_thread(Thread* thread) {
+	CRITICAL_LOCK(g_tasking_lock);
+	for(int i = 0; i < CPU::count(); i++)
+		CPU::get(i).run_queue.remove(thread);
 }
 
 void TaskManager::notify_current(uint32_t sig){
-	cur_thread->process()->kill(sig);
+	current_process()->kill(sig);
 }
 
 kstd::Arc<Thread> TaskManager::pick_next_thread() {
 	ASSERT(g_tasking_lock.held_by_current_thread());
-
-	// Make sure the next thread is in a runnable state
-	while(g_next_thread && !g_next_thread->can_be_run())
-		g_next_thread = g_next_thread->next_thread();
-
-	// If we don't have a next thread to run, either continue running the current thread or run kidle
-	if(!g_next_thread) {
-		if(cur_thread->can_be_run()) {
-			return cur_thread;
-		} else if(kernel_process->get_thread(kernel_process->pid())->state() != Thread::ALIVE) {
+	auto& cpu = CPU::current();
+
+	// Find the highest priority thread that's in a runnable state
+	Thread* next;
+	while((next = cpu.run_queue.pop()) && !next->can_be_run());
+
+	// If we don't have a next thread to run, either continue running the current thread or run the idle thread
+	if(!next) {
+		if(cpu.current_thread->can_be_run()) {
+			cpu.current_thread->quantum_left() = quantum(cpu.current_thread->priority());
+			return cpu.current_thread;
+		} else if(cpu.idle_thread->state() != Thread::ALIVE) {
 			PANIC("KTHREAD_DEADLOCK", "The kernel idle thread is blocked!");
 		} else {
-			return kernel_process->get_thread(kernel_process->pid());
+			return cpu.idle_thread;
 		}
 	}
 
-	auto next = g_next_thread->self();
-	g_next_thread = g_next_thread->next_thread();
-	return next;
+	next->quantum_left() = quantum(next->priority());
+	return next->self();
 }
 
 bool TaskManager::yield() {
-	ASSERT(!preempting);
-	quantum_counter = 0;
+	ASSERT(!is_preempting());
 	if(Interrupt::in_irq()) {
 		// We can't yield in an interrupt. Instead, we'll yield immediately after we exit the interrupt
-		yield_async = true;
+		CPU::current().yield_async = true;
 		return false;
 	} else {
 		preempt();
@@ -253,7 +298,7 @@ bool TaskManager::yield() {
 }
 
 bool TaskManager::yield_if_not_preempting() {
-	if(!preempting)
+	if(!is_preempting())
 		return yield();
 	return true;
 }
@@ -261,69 +306,122 @@ bool TaskManager::yield_if_not_preempting() {
 bool TaskManager::yield_if_idle() {
 	if(!kernel_process)
 		return false;
-	if(cur_thread->tid() == kernel_process->pid())
+	if(is_idle())
 		return yield();
 	return false;
 }
 
 void TaskManager::do_yield_async() {
-	if(yield_async) {
-		yield_async = false;
+	auto& cpu = CPU::current();
+	if(cpu.yield_async) {
+		cpu.yield_async = false;
 		preempt();
 	}
 }
 
+void TaskManager::add_timeout(Blocker& blocker) {
+	ASSERT(in_critical());
+	timeouts.insert(blocker);
+}
+
+void TaskManager::remove_timeout(Blocker& blocker) {
+	ASSERT(in_critical());
+	timeouts.remove(blocker);
+}
+
 void TaskManager::tick() {
 	ASSERT(Interrupt::in_irq());
+
+	// Wake up any threads whose timeouts have expired
+	if(!timeouts.empty()) {
+		auto now = Time::now();
+		while(true) {
+			ScopedCritical critical;
+			auto* expired = timeouts.pop_expired(now);
+			if(!expired)
+				break;
+			expired->notify();
+		}
+	}
+
+	// Move up threads that have been waiting too long, and preempt for them if they now come before the current thread
+	auto& cpu = CPU::current();
+	{
+		CRITICAL_LOCK(g_tasking_lock);
+		cpu.run_queue.age(AGING_QUANTA * quanta[RunQueue::num_levels - 1]);
+		auto level = cpu.run_queue.highest_level();
+		if(level >= 0 && !is_idle() && level < cpu.current_thread->priority())
+			cpu.need_resched = true;
+	}
+
+	// Preempt if a higher priority thread became runnable or the current thread used up its quantum
+	if(!cpu.need_resched && !is_idle()) {
+		auto& quantum_left = cpu.current_thread->quantum_left();
+		if(--quantum_left > 0)
+			return;
+		cpu.current_thread->penalize_priority();
+	}
+
+	cpu.preempt_from_tick = true;
 	yield();
 }
 
-Atomic<int, MemoryOrder::SeqCst> g_critical_count = 0;
+int TaskManager::quantum(int level) {
+	ASSERT(level >= 0 && level < RunQueue::num_levels);
+	return quanta[level];
+}
+
+void TaskManager::set_quantum(int level, int ticks) {
+	ASSERT(level >= 0 && level < RunQueue::num_levels);
+	ASSERT(ticks > 0);
+	quanta[level] = ticks;
+}
 
 void TaskManager::enter_critical() {
 	asm volatile("cli");
-	g_critical_count.add(1);
+	CPU::current().critical_count.add(1);
 }
 
 void TaskManager::leave_critical() {
-	ASSERT(g_critical_count.load() > 0);
-	if(g_critical_count.sub(1) == 1)
+	auto& critical_count = CPU::current().critical_count;
+	ASSERT(critical_count.load() > 0);
+	if(critical_count.sub(1) == 1)
 		asm volatile("sti");
 }
 
 bool TaskManager::in_critical() {
-	return g_critical_count.load();
+	return CPU::current().critical_count.load();
+}
+
+static inline void set_fpu_trap(bool trap) {
+	size_t cr0;
+	asm volatile("mov %%cr0, %0" : "=r"(cr0));
+	size_t new_cr0 = trap ? (cr0 | CR0_TS) : (cr0 & ~CR0_TS);
+	if(new_cr0 != cr0)
+		asm volatile("mov %0, %%cr0" :: "r"(new_cr0));
 }
 
 void TaskManager::preempt(){
 	if(!tasking_enabled)
 		return;
-	ASSERT(!g_critical_count.load());
+	ASSERT(!in_critical());
 
 	g_tasking_lock.acquire_and_enter_critical();
-	cur_thread->enter_critical();
-	preempting = true;
-
-	// Try unblocking threads that are blocked
-	if(g_process_lock.try_acquire()) {
-		for(auto& process : *processes) {
-			if(process->state() != Process::ALIVE)
-				continue;
-			for(auto& tid : process->threads()) {
-				auto thread = process->get_thread(tid);
-				if(!thread)
-					continue;
-				if(thread->state() == Thread::BLOCKED && thread->should_unblock())
-					thread->unblock();
-			}
-		}
-		g_process_lock.release();
-	}
+	auto& cpu = CPU::current();
+	cpu.current_thread->enter_critical();
+	cpu.preempting = true;
+	cpu.need_resched = false;
+
+	// If we're being preempted by the timer, put the current thread back in the queue first so that it only keeps
+	// running if nothing with a higher priority is waiting. When yielding voluntarily (e.g. while waiting on a lock), we
+	// pick the next thread first so that we don't pick ourselves again.
+	auto old_thread = cpu.current_thread;
+	if(cpu.preempt_from_tick && old_thread != cpu.idle_thread && old_thread->can_be_run())
+		queue_thread(old_thread);
+	cpu.preempt_from_tick = false;
 
 	// Pick a new thread
-	auto old_thread = cur_thread;
 	auto next_thread = pick_next_thread();
-	quantum_counter = 1; //Every process has a quantum of 1 for now
 
 	bool should_preempt = old_thread != next_thread;
 
@@ -356,31 +454,32 @@ void TaskManager::preempt(){
 	unsigned int* new_esp;
 	if(next_thread->in_signal_handler()) {
 		new_esp = &next_thread->signal_registers.esp;
-		tss.esp0 = (size_t) next_thread->signal_stack_top();
+		cpu.tss.esp0 = (size_t) next_thread->signal_stack_top();
 	} else {
 		new_esp = &next_thread->registers.esp;
-		tss.esp0 = (size_t) next_thread->kernel_stack_top();
+		cpu.tss.esp0 = (size_t) next_thread->kernel_stack_top();
 	}
 
 	if(should_preempt)
 		next_thread->process()->set_last_active_thread(next_thread->tid());
 
 	// Switch context.
-	preempting = false;
+	cpu.preempting = false;
 	if(!next_thread->can_be_run())
 		PANIC("INVALID_CONTEXT_SWITCH", "Tried to switch to thread %d of PID %d in state %d", next_thread->tid(), next_thread->process()->pid(), next_thread->state());
 	if(should_preempt) {
 		// If we can run the old thread, re-queue it after we preempt
-		if(old_thread->tid() != kernel_process->pid() && old_thread->can_be_run())
+		if(old_thread != cpu.idle_thread && old_thread->can_be_run())
 			queue_thread(old_thread);
 
-		cur_thread = next_thread;
+		cpu.current_thread = next_thread;
 		next_thread.reset();
 		old_thread.reset();
 
-		asm volatile("fxsave %0" : "=m"(cur_thread->fpu_state));
-		preempt_asm(old_esp, new_esp, cur_thread->page_directory()->entries_physaddr());
-		asm volatile("fxrstor %0" ::"m"(cur_thread->fpu_state));
+		// Rather than saving and restoring the FPU state every switch, set CR0.TS so the new thread traps the first time
+		// it uses the FPU and its state gets swapped in then (see Thread::handle_fpu_fault)
+		set_fpu_trap(cpu.current_thread.get() != cpu.fpu_owner);
+		preempt_asm(old_esp, new_esp, cpu.current_thread->page_directory()->entries_physaddr());
 	}
 
 	preempt_finish();
@@ -391,7 +490,8 @@ void TaskManager::preempt_finish() {
 	g_tasking_lock.release();
 	leave_critical();
 	// Handle a pending signal.
-	if(cur_thread->tid() != kernel_process->pid())
+	auto& cur_thread = current_thread();
+	if(!is_idle())
 		cur_thread->process()->handle_pending_signal();
 	cur_thread->leave_critical();
 }
\ No newline at end of file
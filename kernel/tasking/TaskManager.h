@@ -29,11 +29,9 @@
 class Process;
 class Thread;
 class SpinLock;
-struct TSS;
+class Blocker;
 
 namespace TaskManager {
-	extern TSS tss;
-
 	/** This lock is acquired while preempting to ensure that thread queues are in a valid state. This lock MUST be
 	 *  held prior to calling queue_thread or messing with the thread queue. You should use a ScopedCriticalLocker or
 	 *  the CRITICAL_LOCK macro to acquire g_tasking_lock and enter a critical state which will automatically be
@@ -44,11 +42,6 @@ namespace TaskManager {
 	/** This lock is acquired while editing the process list. **/
 	extern SpinLock g_process_lock;
 
-	/** This is the thread at the beginning of the thread queue. The thread queue is updated on calls to `queue_thread`
-	 *  and in Thread::reap (which ensures that the reaped thread is removed from the queue.
-	 */
-	extern Thread* g_next_thread;
-
 	void init();
 	bool enabled();
 	bool is_idle();
@@ -59,6 +52,7 @@ namespace TaskManager {
 	int add_process(Process* proc);
 	void remove_process(Process* proc);
 	void queue_thread(const kstd::Arc<Thread>& thread);
+	void dequeue_thread(Thread* thread);
 	kstd::Arc<Thread>& current_thread();
 	Process* current_process();
 	ResultRet<Process*> process_for_pid(pid_t pid);
@@ -74,6 +68,16 @@ namespace TaskManager {
 	void do_yield_async();
 	void tick();
 
+	/** Gets the number of ticks a thread at the given priority level may run for before being preempted. **/
+	int quantum(int level);
+	/** Sets the number of ticks a thread at the given priority level may run for before being preempted. **/
+	void set_quantum(int level, int ticks);
+
+	/** Adds a blocker to the timeout heap so that it is notified once its timeout passes. Must be in critical. **/
+	void add_timeout(Blocker& blocker);
+	/** Removes a blocker from the timeout heap, if it is in it. Must be in critical. **/
+	void remove_timeout(Blocker& blocker);
+
 	void enter_critical();
 	extern "C" void leave_critical();
 	bool in_critical();
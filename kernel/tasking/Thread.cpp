@@ -28,6 +28,11 @@
 #include <kernel/memory/SafePointer.h>
 #include "../memory/AnonymousVMObject.h"
 #include "Reaper.h"
+#include "RunQueue.h"
+#include "CPU.h"
+#include <kernel/api/resource.h>
+
+SLAB_CACHE(Thread)
 
 Thread::Thread(Process* process, tid_t tid, size_t entry_point, ProcessArgs* args):
 	_tid(tid),
@@ -43,7 +48,7 @@ Thread::Thread(Process* process, tid_t tid, size_t entry_point, ProcessArgs* arg
 
 	if(!is_kernel_mode()) {
 		auto do_create_stack = [&]() -> Result {
-			auto stack_object = TRY(AnonymousVMObject::alloc(THREAD_STACK_SIZE));
+			auto stack_object = TRY(AnonymousVMObject::alloc(THREAD_STACK_SIZE, AnonymousVMObject::AllocType::Populate));
 			_stack_region = TRY(m_vm_space->map_stack(stack_object));
 			mapped_user_stack_region = MM.map_object(stack_object);
 			return Result(SUCCESS);
@@ -99,6 +104,14 @@ Thread::Thread(Process* process, tid_t tid, Registers& regs):
 	//Allocate kernel stack
 	_kernel_stack_region = MM.alloc_kernel_region(THREAD_KERNEL_STACK_SIZE);
 
+	//Inherit the FPU state of the thread that forked us, which might still be loaded in the FPU
+	auto& parent_thread = TaskManager::current_thread();
+	if(parent_thread->uses_fpu()) {
+		parent_thread->save_fpu_state();
+		memcpy(fpu_state, parent_thread->fpu_state, sizeof(fpu_state));
+		_uses_fpu = true;
+	}
+
 	//Setup registers and stack
 	registers.eax = 0; // fork() in child returns zero
 	Stack stack((void*) (_kernel_stack_region->start() + _kernel_stack_region->size()));
@@ -119,7 +132,7 @@ Thread::Thread(Process* process, tid_t tid, void* (*entry_func)(void* (*)(void*)
 
 	if(!is_kernel_mode()) {
 		auto do_create_stack = [&]() -> Result {
-			auto stack_object = TRY(AnonymousVMObject::alloc(THREAD_STACK_SIZE));
+			auto stack_object = TRY(AnonymousVMObject::alloc(THREAD_STACK_SIZE, AnonymousVMObject::AllocType::Populate));
 			_stack_region = TRY(m_vm_space->map_stack(stack_object));
 			mapped_user_stack_region = MM.map_object(stack_object);
 			return Result(SUCCESS);
@@ -170,6 +183,13 @@ Thread::Thread(Process* process, tid_t tid, void* (*entry_func)(void* (*)(void*)
 
 Thread::~Thread() {
 	ASSERT(_state == DEAD);
+
+	//Make sure no CPU tries to save its FPU state into us after we're gone
+	TaskManager::ScopedCritical critical;
+	for(int i = 0; i < CPU::count(); i++) {
+		if(CPU::get(i).fpu_owner == this)
+			CPU::get(i).fpu_owner = nullptr;
+	}
 }
 
 Process* Thread::process() {
@@ -214,7 +234,7 @@ void* Thread::return_value() {
 }
 
 void Thread::kill() {
-	if(is_blocked()) {
+	if(_blocker) {
 		if (_blocker->can_be_interrupted()) {
 			_blocker->interrupt();
 			unblock();
@@ -281,21 +301,42 @@ void Thread::block(Blocker& blocker) {
 		}
 	}
 
+	// Start listening for wakeups before checking the blocker so that we can't miss one in between
 	{
 		TaskManager::ScopedCritical critical;
-		_state = BLOCKED;
 		_blocker = &blocker;
+		blocker.attach(this);
+	}
+
+	while(true) {
+		blocker.m_woken = false;
+		if(blocker.is_ready() || blocker.was_interrupted())
+			break;
+
+		{
+			TaskManager::ScopedCritical critical;
+			// If we were woken up after checking the blocker, check it again instead of going to sleep
+			if(blocker.m_woken)
+				continue;
+			_state = BLOCKED;
+		}
+
+		ASSERT(TaskManager::yield());
 	}
 
-	ASSERT(TaskManager::yield());
+	{
+		TaskManager::ScopedCritical critical;
+		blocker.detach();
+		_blocker = nullptr;
+	}
 }
 
 void Thread::unblock() {
-	if(!_blocker)
+	TaskManager::ScopedCritical critical;
+	if(!_blocker || _state != BLOCKED)
 		return;
-	_blocker = nullptr;
-	if(_state == BLOCKED)
-		_state = ALIVE;
+	_state = ALIVE;
+	boost_priority();
 	{
 		CRITICAL_LOCK(TaskManager::g_tasking_lock);
 		TaskManager::queue_thread(self());
@@ -310,6 +351,10 @@ bool Thread::should_unblock() {
 	return _blocker && (_blocker->is_ready() || _blocker->was_interrupted());
 }
 
+WaitQueue& Thread::join_queue() {
+	return _join_queue;
+}
+
 Result Thread::join(const kstd::Arc<Thread>& self_ptr, const kstd::Arc<Thread>& other, UserspacePointer<void*> retp) {
 	//See if we're trying to join ourself
 	if(other.get() == this)
@@ -369,7 +414,7 @@ bool Thread::call_signal_handler(int signal) {
 	if(_ready_to_handle_signal || _in_signal || _just_finished_signal)
 		return false;
 
-	if(is_blocked()) {
+	if(_blocker) {
 		if(_blocker->can_be_interrupted()) {
 			_blocker->interrupt();
 			unblock();
@@ -387,8 +432,8 @@ bool Thread::call_signal_handler(int signal) {
 	//Allocate a userspace stack
 	auto alloc_user_stack = [&]() -> Result {
 		if(!_sighandler_ustack_region) {
-			auto user_stack = TRY(AnonymousVMObject::alloc(THREAD_STACK_SIZE));
-			_sighandler_ustack_region = TRY(m_vm_space->map_object(user_stack, VMProt::RW));
+			auto user_stack = TRY(AnonymousVMObject::alloc(THREAD_STACK_SIZE, AnonymousVMObject::AllocType::Populate));
+			_sighandler_ustack_region = TRY(m_vm_space->map_stack(user_stack, VMProt::RW));
 		}
 		return Result(SUCCESS);
 	};
@@ -493,22 +538,82 @@ void Thread::handle_pagefault(PageFault fault) {
 	}
 }
 
-void Thread::enqueue_thread(Thread* thread) {
-	ASSERT(TaskManager::g_tasking_lock.held_by_current_thread());
-	if(thread == this)
+bool Thread::uses_fpu() {
+	return _uses_fpu;
+}
+
+uint32_t Thread::fpu_faults() {
+	return _fpu_faults;
+}
+
+void Thread::handle_fpu_fault() {
+	// CR0.TS was set when we were switched to because our state wasn't in the FPU. Swap it in now that we need it.
+	TaskManager::ScopedCritical critical;
+	auto& cpu = CPU::current();
+	asm volatile("clts");
+	if(cpu.fpu_owner == this)
 		return;
-	if(m_next) {
-		m_next->enqueue_thread(thread);
+	if(cpu.fpu_owner)
+		asm volatile("fxsave %0" : "=m"(cpu.fpu_owner->fpu_state));
+
+	if(_uses_fpu) {
+		asm volatile("fxrstor %0" ::"m"(fpu_state));
 	} else {
-		m_next = thread;
-		thread->m_prev = this;
+		// First time using the FPU, so start with a clean state
+		uint32_t mxcsr = 0x1F80;
+		asm volatile("fninit");
+		asm volatile("ldmxcsr %0" ::"m"(mxcsr));
+		_uses_fpu = true;
 	}
+
+	cpu.fpu_owner = this;
+	_fpu_faults++;
+}
+
+void Thread::save_fpu_state() {
+	TaskManager::ScopedCritical critical;
+	auto& cpu = CPU::current();
+	if(cpu.fpu_owner != this)
+		return;
+	// If we own the FPU but were switched away from and back to, TS is set and fxsave would trap
+	asm volatile("clts");
+	asm volatile("fxsave %0" : "=m"(fpu_state));
+}
+
+int Thread::base_priority() {
+	// Map the process's nice value linearly onto the run queue levels
+	return ((_process->nice() - PRIO_MIN) * RunQueue::num_levels) / (PRIO_MAX - PRIO_MIN);
 }
 
-Thread* Thread::next_thread() {
-	auto next = m_next;
-	m_next = nullptr;
-	return next;
+int Thread::priority() {
+	int priority = base_priority() + _priority_offset - _aging_boost;
+	if(priority < 0)
+		return 0;
+	if(priority >= RunQueue::num_levels)
+		return RunQueue::num_levels - 1;
+	return priority;
+}
+
+void Thread::boost_priority() {
+	// Threads that wake up from blocking are usually interactive or waiting on I/O, so let them jump ahead a bit
+	if(_priority_offset > -THREAD_MAX_PRIORITY_BOOST)
+		_priority_offset--;
+}
+
+void Thread::penalize_priority() {
+	// Threads that use up their whole quantum are probably CPU-bound, so let others go ahead of them
+	if(_priority_offset < THREAD_MAX_PRIORITY_PENALTY)
+		_priority_offset++;
+}
+
+void Thread::age_priority() {
+	// Threads that have been waiting a long time are moved up until they get to run, however low their priority is
+	if(priority() > 0)
+		_aging_boost++;
+}
+
+int& Thread::quantum_left() {
+	return _quantum_left;
 }
 
 void Thread::setup_kernel_stack(Stack& kernel_stack, size_t user_stack_ptr, Registers& regs) {
@@ -556,10 +661,10 @@ void Thread::exit(void* return_value) {
 void Thread::reap() {
 	_process->alert_thread_died(self());
 	TaskManager::ScopedCritical critical;
-	if(TaskManager::g_next_thread == this)
-		TaskManager::g_next_thread = m_next;
-	if(m_prev && m_prev->m_next == this)
-		m_prev->m_next = m_next;
-	if(m_next)
-		m_next->m_prev = this;
+	// If we died while blocked, stop listening for wakeups since the blocker won't be around for much longer
+	if(_blocker) {
+		_blocker->detach();
+		_blocker = nullptr;
+	}
+	TaskManager::dequeue_thread(this);
 }
@@ -23,21 +23,27 @@
 #include <kernel/kstd/unix_types.h>
 #include <kernel/kstd/Arc.h>
 #include <kernel/memory/Stack.h>
+#include <kernel/memory/SlabCache.h>
 #include <kernel/Result.hpp>
 #include "kernel/memory/VMRegion.h"
 #include "SpinLock.h"
+#include "WaitQueue.h"
 #include "../memory/PageDirectory.h"
 #include "../kstd/queue.hpp"
 #include "kernel/kstd/circular_queue.hpp"
+#include "../api/thread.h"
 
-#define THREAD_STACK_SIZE 1048576 //1024KiB
 #define THREAD_KERNEL_STACK_SIZE 524288 //512KiB
+#define THREAD_MAX_PRIORITY_BOOST 1 //How many levels above its base priority a thread can be boosted after waking
+#define THREAD_MAX_PRIORITY_PENALTY 2 //How many levels below its base priority a thread can drop after using its quantum
 
 class Process;
 class Blocker;
+class RunQueue;
 class ProcessArgs;
 template<typename T> class UserspacePointer;
 class Thread: public kstd::ArcSelf<Thread> {
+	SLAB_ALLOCATED
 public:
 	enum State {
 		ALIVE = 0,
@@ -75,6 +81,7 @@ public:
 	void unblock();
 	bool is_blocked();
 	bool should_unblock();
+	WaitQueue& join_queue();
 	Result join(const kstd::Arc<Thread>& self_ptr, const kstd::Arc<Thread>& other, UserspacePointer<void*> retp);
 	void acquired_lock(SpinLock* lock);
 	void released_lock(SpinLock* lock);
@@ -90,9 +97,19 @@ public:
 	//Misc
 	void handle_pagefault(PageFault fault);
 
-	//Thread queue
-	void enqueue_thread(Thread* thread);
-	Thread* next_thread();
+	//FPU
+	bool uses_fpu();
+	uint32_t fpu_faults();
+	void handle_fpu_fault();
+	void save_fpu_state();
+
+	//Scheduling
+	int base_priority();
+	int priority();
+	void boost_priority();
+	void penalize_priority();
+	void age_priority();
+	int& quantum_left();
 
 	uint8_t fpu_state[512] __attribute__((aligned(16)));
 	Registers registers = {};
@@ -101,6 +118,7 @@ public:
 private:
 	friend class Process;
 	friend class Reaper;
+	friend class RunQueue;
 
 	void setup_kernel_stack(Stack& kernel_stack, size_t user_stack_ptr, Registers& regs);
 	void exit(void* return_value);
@@ -127,6 +145,7 @@ private:
 	bool _joined = false;
 	SpinLock _join_lock;
 	kstd::Arc<Thread> _joined_thread;
+	WaitQueue _join_queue;
 	kstd::circular_queue<SpinLock*> _held_locks { 100 };
 
 	//Signals
@@ -137,7 +156,19 @@ private:
 	kstd::Arc<VMRegion> _sighandler_ustack_region;
 	kstd::Arc<VMRegion> _sighandler_kstack_region;
 
-	// Thread queue
+	//Scheduling
+	int _priority_offset = 0;
+	int _aging_boost = 0; //How many levels the thread has been moved up for waiting in the run queue
+	int _quantum_left = 0;
+
+	//FPU
+	bool _uses_fpu = false;
+	uint32_t _fpu_faults = 0;
+
+	// Run queue
+	RunQueue* m_run_queue = nullptr;
+	int m_queued_level = 0;
+	uint32_t m_queued_tick = 0;
 	Thread* m_next = nullptr;
 	Thread* m_prev = nullptr;
 };
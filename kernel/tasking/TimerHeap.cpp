@@ -0,0 +1,97 @@
+/* SPDX-License-Identifier: GPL-3.0-or-later */
+/* Copyright © 2016-2022 Byteduck */
+
+#include "TimerHeap.h"
+#include "Blocker.h"
+#include <kernel/kstd/kstdio.h>
+
+void TimerHeap::insert(Blocker& blocker) {
+	ASSERT(!blocker.m_timer_queued);
+	blocker.m_timer_child = nullptr;
+	blocker.m_timer_sibling = nullptr;
+	blocker.m_timer_prev = nullptr;
+	blocker.m_timer_queued = true;
+	m_root = meld(m_root, &blocker);
+}
+
+void TimerHeap::remove(Blocker& blocker) {
+	if(!blocker.m_timer_queued)
+		return;
+
+	if(&blocker == m_root) {
+		m_root = merge_pairs(blocker.m_timer_child);
+	} else {
+		// Detach the blocker from its parent or left sibling, then merge its children back into the heap
+		if(blocker.m_timer_prev->m_timer_child == &blocker)
+			blocker.m_timer_prev->m_timer_child = blocker.m_timer_sibling;
+		else
+			blocker.m_timer_prev->m_timer_sibling = blocker.m_timer_sibling;
+		if(blocker.m_timer_sibling)
+			blocker.m_timer_sibling->m_timer_prev = blocker.m_timer_prev;
+		m_root = meld(m_root, merge_pairs(blocker.m_timer_child));
+	}
+
+	blocker.m_timer_child = nullptr;
+	blocker.m_timer_sibling = nullptr;
+	blocker.m_timer_prev = nullptr;
+	blocker.m_timer_queued = false;
+}
+
+Blocker* TimerHeap::pop_expired(Time now) {
+	if(!m_root || m_root->m_timeout > now)
+		return nullptr;
+	auto* expired = m_root;
+	remove(*expired);
+	return expired;
+}
+
+Blocker* TimerHeap::meld(Blocker* a, Blocker* b) {
+	if(!a)
+		return b;
+	if(!b)
+		return a;
+	if(b->m_timeout < a->m_timeout) {
+		auto* tmp = a;
+		a = b;
+		b = tmp;
+	}
+
+	// Make b the first child of a
+	b->m_timer_prev = a;
+	b->m_timer_sibling = a->m_timer_child;
+	if(a->m_timer_child)
+		a->m_timer_child->m_timer_prev = b;
+	a->m_timer_child = b;
+	a->m_timer_sibling = nullptr;
+	a->m_timer_prev = nullptr;
+	return a;
+}
+
+Blocker* TimerHeap::merge_pairs(Blocker* first) {
+	// First pass: Meld siblings together in pairs from left to right, collecting the results in reverse order
+	Blocker* pairs = nullptr;
+	while(first) {
+		auto* a = first;
+		auto* b = a->m_timer_sibling;
+		first = b ? b->m_timer_sibling : nullptr;
+		a->m_timer_sibling = nullptr;
+		a->m_timer_prev = nullptr;
+		if(b) {
+			b->m_timer_sibling = nullptr;
+			b->m_timer_prev = nullptr;
+		}
+		auto* melded = meld(a, b);
+		melded->m_timer_sibling = pairs;
+		pairs = melded;
+	}
+
+	// Second pass: Meld the pairs together from right to left
+	Blocker* result = nullptr;
+	while(pairs) {
+		auto* next = pairs->m_timer_sibling;
+		pairs->m_timer_sibling = nullptr;
+		result = meld(result, pairs);
+		pairs = next;
+	}
+	return result;
+}
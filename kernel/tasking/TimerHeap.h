@@ -0,0 +1,41 @@
+/* SPDX-License-Identifier: GPL-3.0-or-later */
+/* Copyright © 2016-2022 Byteduck */
+
+#pragma once
+
+#include <kernel/time/Time.h>
+
+class Blocker;
+
+/**
+ * A pairing heap of blockers ordered by their timeout. The nodes are stored in the blockers themselves, so insertion
+ * and removal never allocate. Insertion is O(1), and removal of the earliest timeout is amortized O(log n).
+ * This must only be modified while in a critical section.
+ */
+class TimerHeap {
+public:
+	/**
+	 * Inserts a blocker into the heap. The blocker must have a timeout set and must not already be in a heap.
+	 */
+	void insert(Blocker& blocker);
+
+	/**
+	 * Removes a blocker from the heap. Does nothing if the blocker isn't in the heap.
+	 */
+	void remove(Blocker& blocker);
+
+	/**
+	 * Removes and returns the blocker with the earliest timeout if it has expired.
+	 * @param now The current time.
+	 * @return The expired blocker, or nullptr if no blockers have expired.
+	 */
+	Blocker* pop_expired(Time now);
+
+	bool empty() const { return !m_root; }
+
+private:
+	static Blocker* meld(Blocker* a, Blocker* b);
+	static Blocker* merge_pairs(Blocker* first);
+
+	Blocker* m_root = nullptr;
+};
@@ -0,0 +1,33 @@
+/* SPDX-License-Identifier: GPL-3.0-or-later */
+/* Copyright © 2016-2023 Byteduck */
+
+#include "VForkBlocker.h"
+#include "TaskManager.h"
+#include "Thread.h"
+#include "Process.h"
+
+VForkBlocker::VForkBlocker(kstd::Arc<Thread> thread, pid_t child):
+	_child(child),
+	_thread(thread)
+{}
+
+bool VForkBlocker::is_ready() {
+	//The child keeps its pid when it execs, but the new process has its own address space
+	auto child = TaskManager::process_for_pid(_child);
+	if(child.is_error())
+		return true;
+	return child.value()->state() != Process::ALIVE || child.value()->vm_space() != _thread->process()->vm_space();
+}
+
+bool VForkBlocker::can_be_interrupted() {
+	//The child is running on our stack, so we can't return to userspace until it's done with it
+	return false;
+}
+
+void VForkBlocker::on_block() {
+	_thread->process()->child_wait_queue().add(_wait_entry, *this);
+}
+
+void VForkBlocker::on_unblock() {
+	WaitQueue::remove(_wait_entry);
+}
@@ -0,0 +1,31 @@
+/* SPDX-License-Identifier: GPL-3.0-or-later */
+/* Copyright © 2016-2023 Byteduck */
+
+#pragma once
+
+#include "Blocker.h"
+#include "WaitQueue.h"
+#include <kernel/kstd/unix_types.h>
+#include <kernel/kstd/Arc.h>
+
+class Thread;
+
+/**
+ * Blocks the thread that called vfork() until the child stops using its address space, which is when it either
+ * execs or exits. The child wakes the parent's child wait queue when either happens.
+ */
+class VForkBlocker: public Blocker {
+public:
+	VForkBlocker(kstd::Arc<Thread> thread, pid_t child);
+	bool is_ready() override;
+	bool can_be_interrupted() override;
+
+protected:
+	void on_block() override;
+	void on_unblock() override;
+
+private:
+	pid_t _child;
+	kstd::Arc<Thread> _thread;
+	WaitQueue::Entry _wait_entry;
+};
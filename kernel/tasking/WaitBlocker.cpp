@@ -59,6 +59,14 @@ bool WaitBlocker::is_ready() {
 	return !found_one;
 }
 
+void WaitBlocker::on_block() {
+	_thread->process()->child_wait_queue().add(_wait_entry, *this);
+}
+
+void WaitBlocker::on_unblock() {
+	WaitQueue::remove(_wait_entry);
+}
+
 pid_t WaitBlocker::waited_pid() {
 	return _wait_pid;
 }
@@ -20,6 +20,7 @@
 #pragma once
 
 #include "Blocker.h"
+#include "WaitQueue.h"
 #include <kernel/kstd/unix_types.h>
 #include <kernel/kstd/Arc.h>
 
@@ -34,6 +35,10 @@ public:
 	pid_t error();
 	pid_t exit_status();
 
+protected:
+	void on_block() override;
+	void on_unblock() override;
+
 private:
 	int _err = 0;
 	int _exit_status = 0;
@@ -41,5 +46,6 @@ private:
 	pid_t _wait_pid;
 	pid_t _wait_pgid;
 	kstd::Arc<Thread> _thread;
+	WaitQueue::Entry _wait_entry;
 };
 
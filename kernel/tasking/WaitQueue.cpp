@@ -0,0 +1,54 @@
+/* SPDX-License-Identifier: GPL-3.0-or-later */
+/* Copyright © 2016-2022 Byteduck */
+
+#include "WaitQueue.h"
+#include "Blocker.h"
+#include "TaskManager.h"
+
+WaitQueue::~WaitQueue() {
+	TaskManager::ScopedCritical critical;
+	while(m_head)
+		remove(*m_head);
+}
+
+void WaitQueue::add(Entry& entry, Blocker& blocker) {
+	TaskManager::ScopedCritical critical;
+	ASSERT(!entry.queue);
+	entry.blocker = &blocker;
+	entry.queue = this;
+	entry.next = nullptr;
+	entry.prev = m_tail;
+	if(m_tail)
+		m_tail->next = &entry;
+	else
+		m_head = &entry;
+	m_tail = &entry;
+}
+
+void WaitQueue::remove(Entry& entry) {
+	TaskManager::ScopedCritical critical;
+	auto* queue = entry.queue;
+	if(!queue)
+		return;
+	if(entry.prev)
+		entry.prev->next = entry.next;
+	else
+		queue->m_head = entry.next;
+	if(entry.next)
+		entry.next->prev = entry.prev;
+	else
+		queue->m_tail = entry.prev;
+	entry.queue = nullptr;
+	entry.next = nullptr;
+	entry.prev = nullptr;
+}
+
+void WaitQueue::wake_all() {
+	if(!m_head)
+		return;
+	TaskManager::ScopedCritical critical;
+	// Waking a blocker never removes it from the queue (the blocked thread does that itself once it runs again), so
+	// it's safe to walk the list here.
+	for(auto* entry = m_head; entry; entry = entry->next)
+		entry->blocker->notify();
+}
@@ -0,0 +1,56 @@
+/* SPDX-License-Identifier: GPL-3.0-or-later */
+/* Copyright © 2016-2022 Byteduck */
+
+#pragma once
+
+class Blocker;
+
+/**
+ * A list of blockers waiting for some event to happen. Whatever owns the queue should call wake_all() whenever the
+ * condition the blockers are waiting on may have changed, which will wake up the threads blocked on them so they can
+ * re-check their blocker. Entries are intrusive, so adding and removing them never allocates.
+ */
+class WaitQueue {
+public:
+	class Entry {
+	public:
+		Entry() = default;
+		Entry(const Entry& other) {}
+		Entry& operator=(const Entry& other) { return *this; }
+
+	private:
+		friend class WaitQueue;
+		Blocker* blocker = nullptr;
+		WaitQueue* queue = nullptr;
+		Entry* next = nullptr;
+		Entry* prev = nullptr;
+	};
+
+	WaitQueue() = default;
+	WaitQueue(const WaitQueue& other) = delete;
+	~WaitQueue();
+
+	/**
+	 * Adds a blocker to the queue.
+	 * @param entry The entry to use for the blocker. Must stay valid until it is removed.
+	 * @param blocker The blocker to be woken up.
+	 */
+	void add(Entry& entry, Blocker& blocker);
+
+	/**
+	 * Removes an entry from whichever queue it is in, if any.
+	 * @param entry The entry to remove.
+	 */
+	static void remove(Entry& entry);
+
+	/**
+	 * Wakes up every thread waiting on a blocker in this queue.
+	 */
+	void wake_all();
+
+	bool empty() const { return !m_head; }
+
+private:
+	Entry* m_head = nullptr;
+	Entry* m_tail = nullptr;
+};
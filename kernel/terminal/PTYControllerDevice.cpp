@@ -97,6 +97,7 @@ size_t PTYControllerDevice::putchars(const uint8_t* buffer, size_t count) {
 		_output_buffer.push_back(*(buffer++));
 
 	_output_lock.release();
+	poll_queue().wake_all();
 
 	return count;
 }
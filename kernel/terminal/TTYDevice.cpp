@@ -115,11 +115,13 @@ void TTYDevice::emit(uint8_t c) {
 			_input_buffer.push_back('\0');
 			_lines++;
 			_buffer_blocker.set_ready(true);
+			poll_queue().wake_all();
 			return;
 		}
 		if(c == '\n' || c == _termios.c_cc[VEOL]) {
 			_lines++;
 			_buffer_blocker.set_ready(true);
+			poll_queue().wake_all();
 		}
 		if(c == _termios.c_cc[VERASE]) {
 			backspace();
@@ -140,8 +142,10 @@ void TTYDevice::emit(uint8_t c) {
 
 	_input_buffer.push_back(c);
 
-	if(!(_termios.c_lflag & ICANON))
+	if(!(_termios.c_lflag & ICANON)) {
 		_buffer_blocker.set_ready(true);
+		poll_queue().wake_all();
+	}
 
 	if(_termios.c_lflag & ECHO)
 		echo(c);
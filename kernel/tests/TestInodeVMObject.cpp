@@ -0,0 +1,61 @@
+/* SPDX-License-Identifier: GPL-3.0-or-later */
+/* Copyright © 2016-2023 Byteduck */
+
+#include "KernelTest.h"
+#include "../filesystem/VFS.h"
+#include "../filesystem/FileDescriptor.h"
+#include "../filesystem/InodeFile.h"
+#include "../memory/InodeVMObject.h"
+#include "../memory/VMSpace.h"
+#include "../memory/PageDirectory.h"
+#include "../api/fcntl.h"
+#include "../User.h"
+#include "../kstd/cstring.h"
+
+#define TEST_FILE "/.test_page_cache"
+
+/**
+ * Appends to a file whose page cache is already in use, and makes sure the extended part can be mapped and read.
+ */
+KERNEL_TEST(page_cache_append_then_map) {
+	auto user = User::root();
+	auto fd_or_err = VFS::inst().open(TEST_FILE, O_CREAT | O_RDWR | O_TRUNC | O_APPEND, 0644, user, VFS::inst().root_ref());
+	ENSURE(!fd_or_err.is_error());
+	if(fd_or_err.is_error())
+		return;
+	auto fd = fd_or_err.value();
+	auto inode = kstd::static_pointer_cast<InodeFile>(fd->file())->inode();
+
+	uint8_t buf[PAGE_SIZE];
+	memset(buf, 'a', PAGE_SIZE);
+	ENSURE_EQ(fd->write(KernelPointer<uint8_t>(buf), PAGE_SIZE), PAGE_SIZE);
+
+	// Keep the page cache around and mapped, as a running program would
+	PageDirectory page_directory;
+	auto space = kstd::make_shared<VMSpace>(PAGE_SIZE, HIGHER_HALF - PAGE_SIZE, page_directory);
+	auto object = inode->shared_vm_object();
+	auto first_region = space->map_object(kstd::static_pointer_cast<VMObject>(object), VMProt::R, {0, PAGE_SIZE});
+	ENSURE(!first_region.is_error());
+	ENSURE(space->try_pagefault({first_region.value()->start(), 0, PageFault::Type::Read}).is_success());
+
+	// Append a page, which should grow the object that's already mapped
+	memset(buf, 'b', PAGE_SIZE);
+	ENSURE_EQ(fd->write(KernelPointer<uint8_t>(buf), PAGE_SIZE), PAGE_SIZE);
+	ENSURE_EQ(object->size(), PAGE_SIZE * 2);
+
+	auto region = space->map_object(kstd::static_pointer_cast<VMObject>(object), VMProt::R, {0, PAGE_SIZE * 2});
+	ENSURE(!region.is_error());
+	if(!region.is_error()) {
+		ENSURE(space->try_pagefault({region.value()->start() + PAGE_SIZE, 0, PageFault::Type::Read}).is_success());
+		ENSURE(page_directory.is_mapped(region.value()->start() + PAGE_SIZE, false));
+	}
+
+	uint8_t read_buf[PAGE_SIZE];
+	ENSURE_EQ(object->read(PAGE_SIZE, PAGE_SIZE, KernelPointer<uint8_t>(read_buf)), PAGE_SIZE);
+	bool matches = true;
+	for(size_t i = 0; i < PAGE_SIZE; i++)
+		matches &= read_buf[i] == 'b';
+	ENSURE(matches, "Appended data doesn't match");
+
+	ENSURE(VFS::inst().unlink(TEST_FILE, user, VFS::inst().root_ref()).is_success());
+}
@@ -0,0 +1,99 @@
+/* SPDX-License-Identifier: GPL-3.0-or-later */
+/* Copyright © 2016-2023 Byteduck */
+
+#include "KernelTest.h"
+#include "../memory/VMSpace.h"
+#include "../memory/AnonymousVMObject.h"
+#include "../memory/PageDirectory.h"
+#include "../time/Time.h"
+
+#define NUM_FAULTS 512
+
+/**
+ * Maps `num_regions` single-page anonymous regions into a new space and times faulting in NUM_FAULTS of them. The
+ * time per fault should stay roughly flat as the number of regions grows.
+ */
+static void benchmark_faults(size_t num_regions) {
+	PageDirectory page_directory;
+	auto space = kstd::make_shared<VMSpace>(PAGE_SIZE, HIGHER_HALF - PAGE_SIZE, page_directory);
+	kstd::vector<kstd::Arc<VMRegion>> regions;
+	regions.reserve(num_regions);
+
+	for(size_t i = 0; i < num_regions; i++) {
+		auto object = AnonymousVMObject::alloc(PAGE_SIZE);
+		ENSURE(!object.is_error());
+		if(object.is_error())
+			return;
+		auto region = space->map_object(object.value(), VMProt::RW);
+		ENSURE(!region.is_error());
+		if(region.is_error())
+			return;
+		regions.push_back(region.value());
+	}
+
+	// Fault in every region (or an evenly spread subset of them if there are a lot)
+	size_t stride = num_regions > NUM_FAULTS ? num_regions / NUM_FAULTS : 1;
+	size_t num_faults = 0;
+	auto start = Time::now();
+	for(size_t i = 0; i < num_regions; i += stride) {
+		auto address = regions[i]->start();
+		ENSURE(space->try_pagefault({address, 0, PageFault::Type::Write}).is_success());
+		num_faults++;
+	}
+	auto elapsed = Time::now() - start;
+
+	// Make sure the faults actually did something
+	for(size_t i = 0; i < num_regions; i += stride)
+		ENSURE(page_directory.is_mapped(regions[i]->start(), true));
+	ENSURE(space->try_pagefault({space->end() - PAGE_SIZE, 0, PageFault::Type::Read}).code() == ENOENT);
+
+	long usec = elapsed.sec() * 1000000 + elapsed.usec();
+	KLog::info("vmspace_fault_latency", "%d regions: %d faults in %dus (%dns/fault)",
+			   num_regions, num_faults, usec, (usec * 1000) / num_faults);
+}
+
+KERNEL_TEST(vmspace_fault_latency) {
+	benchmark_faults(16);
+	benchmark_faults(256);
+	benchmark_faults(4096);
+}
+
+KERNEL_TEST(vmspace_fork_lazy_mapping) {
+	PageDirectory parent_directory;
+	auto parent = kstd::make_shared<VMSpace>(PAGE_SIZE, HIGHER_HALF - PAGE_SIZE, parent_directory);
+	auto object = AnonymousVMObject::alloc(PAGE_SIZE * 2);
+	ENSURE(!object.is_error());
+	if(object.is_error())
+		return;
+	auto region = parent->map_object(object.value(), VMProt::RW);
+	ENSURE(!region.is_error());
+	if(region.is_error())
+		return;
+	auto first_page = region.value()->start();
+	auto second_page = first_page + PAGE_SIZE;
+	ENSURE(parent->try_pagefault({first_page, 0, PageFault::Type::Write}).is_success());
+	ENSURE(parent->try_pagefault({second_page, 0, PageFault::Type::Write}).is_success());
+
+	PageDirectory child_directory;
+	kstd::vector<kstd::Arc<VMRegion>> child_regions;
+	auto child = parent->fork(child_directory, child_regions);
+	ENSURE(child_regions.size() == 1);
+
+	// The parent's pages become read-only, and the child doesn't get any page table entries until it faults
+	ENSURE(parent_directory.is_mapped(first_page, false) && !parent_directory.is_mapped(first_page, true));
+	ENSURE(!child_directory.is_mapped(first_page, false));
+	ENSURE(!child_directory.is_mapped(second_page, false));
+
+	// Reading maps the shared page read-only, and writing to it afterwards copies it
+	ENSURE(child->try_pagefault({first_page, 0, PageFault::Type::Read}).is_success());
+	ENSURE(child_directory.is_mapped(first_page, false) && !child_directory.is_mapped(first_page, true));
+	ENSURE(child->try_pagefault({first_page, 0, PageFault::Type::Write}).is_success());
+	ENSURE(child_directory.is_mapped(first_page, true));
+
+	// Writing to a page that was never mapped should copy it right away, rather than taking a second fault
+	ENSURE(child->try_pagefault({second_page, 0, PageFault::Type::Write}).is_success());
+	ENSURE(child_directory.is_mapped(second_page, true));
+
+	ENSURE(parent->try_pagefault({first_page, 0, PageFault::Type::Write}).is_success());
+	ENSURE(parent_directory.is_mapped(first_page, true));
+}
@@ -0,0 +1,73 @@
+/* SPDX-License-Identifier: GPL-3.0-or-later */
+/* Copyright © 2016-2023 Byteduck */
+
+#include "../KernelTest.h"
+#include <kernel/kstd/LRUCache.h>
+
+using IntCache = kstd::LRUCache<int, int>;
+
+KERNEL_TEST(lru_insert_get) {
+	IntCache cache;
+	for(int i = 0; i < 1000; i++)
+		cache.insert(i, i * 2);
+	ENSURE_EQ(cache.size(), 1000);
+	for(int i = 0; i < 1000; i++) {
+		auto val = cache.get(i);
+		ENSURE(val);
+		ENSURE_EQ(val.value(), i * 2);
+	}
+	ENSURE(!cache.get(1000));
+
+	// Replacing an item shouldn't add another one
+	cache.insert(5, 1);
+	ENSURE_EQ(cache.size(), 1000);
+	ENSURE_EQ(cache.get(5).value(), 1);
+
+	auto stats = cache.stats();
+	ENSURE_EQ(stats.hits, 1001);
+	ENSURE_EQ(stats.misses, 1);
+	ENSURE_EQ(stats.size, 1000);
+}
+
+KERNEL_TEST(lru_order) {
+	IntCache cache;
+	for(int i = 0; i < 10; i++)
+		cache.insert(i, i);
+	ENSURE_EQ(cache.lru_unsafe().first, 0);
+
+	// Using items should move them to the back of the list
+	cache.get(0);
+	cache.promote(1);
+	ENSURE_EQ(cache.lru_unsafe().first, 2);
+
+	cache.prune(3);
+	ENSURE_EQ(cache.size(), 7);
+	ENSURE_EQ(cache.lru_unsafe().first, 5);
+	ENSURE(!cache.get(2));
+	ENSURE(!cache.get(4));
+	ENSURE(cache.get(0));
+	ENSURE_EQ(cache.stats().evictions, 3);
+
+	// Erasing the least recently used item should move on to the next one
+	cache.erase(5);
+	ENSURE_EQ(cache.lru_unsafe().first, 6);
+	cache.prune(100);
+	ENSURE(cache.empty());
+	ENSURE(!cache.lru());
+}
+
+KERNEL_TEST(lru_erase) {
+	IntCache cache;
+	for(int i = 0; i < 1000; i++)
+		cache.insert(i, i);
+	for(int i = 0; i < 1000; i += 2)
+		cache.erase(i);
+	ENSURE_EQ(cache.size(), 500);
+	for(int i = 0; i < 1000; i++)
+		ENSURE_EQ((bool) cache.get(i), (bool) (i % 2));
+
+	// Erasing something that isn't there shouldn't do anything
+	cache.erase(0);
+	cache.erase(5000);
+	ENSURE_EQ(cache.size(), 500);
+}
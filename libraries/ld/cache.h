@@ -0,0 +1,89 @@
+/* SPDX-License-Identifier: GPL-3.0-or-later */
+/* Copyright © 2016-2023 Byteduck */
+
+#pragma once
+
+#include <cstdint>
+#include <sys/stat.h>
+
+#define LD_CACHE_PATH "/etc/ld.so.cache"
+#define LD_CACHE_MAGIC 0x4843444C //'LDCH'
+#define LD_CACHE_VERSION 2
+//The address ldconfig starts laying out libraries at, one after the other. This should be well above any executable.
+//Libraries that aren't in the cache are loaded after the end of the layout.
+#define LD_CACHE_BASE 0x40000000
+//The directories ldconfig looks for libraries in, which is the same as ld's default search path
+#define LD_CACHE_SEARCH_PATH "/lib:/usr/lib"
+
+/**
+ * The cache written by ldconfig, so that ld doesn't have to search for libraries or look up most of their symbols.
+ * The file is the header followed by the directories, libraries, and bindings, followed by the strings that they refer
+ * to by offset. Libraries are sorted by name, and each library's bindings are sorted by symbol.
+ */
+struct LDCacheHeader {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t num_directories;
+	uint32_t num_libraries;
+	uint32_t num_bindings;
+	uint32_t strings_size;
+	uint32_t layout_end; //The end of the last library laid out
+};
+
+/** A directory that ldconfig searched. If it changes, a library might have been added that the cache doesn't know about. **/
+struct LDCacheDirectory {
+	uint32_t path;
+	uint32_t inode;
+	int64_t mtime;
+};
+
+/** A library, and where it should be loaded. This is only valid while the file still has the same inode, size, and mtime. **/
+struct LDCacheLibrary {
+	uint32_t name;
+	uint32_t path;
+	uint32_t inode;
+	uint32_t size;
+	int64_t mtime;
+	uint32_t load_address;
+	uint32_t first_binding;
+	uint32_t num_bindings;
+};
+
+/**
+ * A symbol used by a library that's only defined by one library in the cache, so as long as every loaded library is
+ * where the cache put it and the executable doesn't define the symbol, it can only ever be bound to one address.
+ */
+struct LDCacheBinding {
+	uint32_t symbol; //The index of the symbol in the library's symbol table
+	uint32_t library; //The index of the library that defines it
+	uint32_t address;
+};
+
+/**
+ * Checks that a cache file is one we understand and that its size matches what its header says is in it.
+ * @param data The contents of the file.
+ * @param size The size of the file.
+ */
+inline bool ld_cache_validate(const void* data, uint64_t size) {
+	if(size < sizeof(LDCacheHeader))
+		return false;
+	auto* header = (const LDCacheHeader*) data;
+	uint64_t expected_size = sizeof(LDCacheHeader) +
+			(uint64_t) header->num_directories * sizeof(LDCacheDirectory) +
+			(uint64_t) header->num_libraries * sizeof(LDCacheLibrary) +
+			(uint64_t) header->num_bindings * sizeof(LDCacheBinding) +
+			header->strings_size;
+	if(header->magic != LD_CACHE_MAGIC || header->version != LD_CACHE_VERSION || expected_size != size || !header->strings_size)
+		return false;
+
+	//The strings are at the end of the file, and the last one has to be terminated
+	return !((const char*) data)[size - 1];
+}
+
+inline bool ld_cache_matches(const LDCacheDirectory& directory, const struct stat& statbuf) {
+	return directory.inode == statbuf.st_ino && directory.mtime == statbuf.st_mtime;
+}
+
+inline bool ld_cache_matches(const LDCacheLibrary& library, const struct stat& statbuf) {
+	return library.inode == statbuf.st_ino && library.size == (uint32_t) statbuf.st_size && library.mtime == statbuf.st_mtime;
+}
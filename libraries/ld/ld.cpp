@@ -25,19 +25,29 @@
 #include <cstring>
 #include <cstdlib>
 #include <map>
+#include <algorithm>
 #include <libduck/Log.h>
 #include <sys/mman.h>
 
 using Duck::Log;
 
-std::unordered_map<std::string, uintptr_t> global_symbols;
-std::unordered_map<std::string, uintptr_t> symbols;
 std::map<std::string, Object*> objects;
-size_t current_brk = 0;
+std::vector<Object*> search_order; //The executable, followed by libraries in the order they were loaded
+std::vector<std::pair<size_t, size_t>> loaded_ranges; //The start and end of each object that's been loaded
+size_t current_brk = 0; //Where the next library that isn't loaded at its cached address goes
 bool debug = false;
+bool bind_now_env = false; //Whether LD_BIND_NOW is set, in which case nothing is bound lazily
 Object* executable;
 
+LDCacheHeader* cache_header = nullptr;
+LDCacheLibrary* cache_libraries = nullptr;
+LDCacheBinding* cache_bindings = nullptr;
+char* cache_strings = nullptr;
+std::vector<Object*> cache_objects; //The object loaded for each library in the cache, if any
+bool use_cache_bindings = true; //Cleared if a library is loaded somewhere the cache's bindings don't account for
+
 extern "C" [[noreturn]] void call_main(int argc, char** argv, char** envp, main_t main);
+extern "C" void plt_trampoline();
 
 int main(int argc, char** argv, char** envp) {
 	if(argc < 2) {
@@ -47,6 +57,9 @@ int main(int argc, char** argv, char** envp) {
 
 	executable = new Object();
 	objects[std::string(argv[1])] = executable;
+	search_order.push_back(executable);
+	bind_now_env = getenv("LD_BIND_NOW");
+	load_cache();
 
 	//Open the executable
 	executable->fd  = open(argv[1], O_RDONLY);
@@ -70,16 +83,8 @@ int main(int argc, char** argv, char** envp) {
 	if(executable->load(argv[1], true) < 0)
 		return errno;
 
-	//Read the symbols from the libraries and executable
-	auto rev_it = objects.rbegin();
-	while(rev_it != objects.rend()) {
-		auto* object = rev_it->second;
-		object->read_symbols();
-		rev_it++;
-	}
-
 	//Relocate the libraries and executable
-	rev_it = objects.rbegin();
+	auto rev_it = objects.rbegin();
 	while(rev_it != objects.rend()) {
 		auto* object = rev_it->second;
 		object->relocate();
@@ -88,8 +93,9 @@ int main(int argc, char** argv, char** envp) {
 	}
 
 	//Call __init_stdio for libc.so before any other initializer
-	if(symbols["__init_stdio"] != 0) {
-		((void(*)()) symbols["__init_stdio"])();
+	auto init_stdio = lookup_symbol("__init_stdio");
+	if(init_stdio != 0) {
+		((void(*)()) init_stdio)();
 	}
 
 	//Call the initializer methods for the libraries and executable
@@ -117,11 +123,23 @@ int main(int argc, char** argv, char** envp) {
 	if(debug)
 		Log::dbgf("Calling entry point for {} {#x}", executable->name, (size_t) executable->entry);
 
+	// Give back our heap, so the program's own allocator doesn't find it in the slot at the bottom of our shared stack
+	__malloc_thread_exit();
+
 	// Finally, jump to the executable's entry point!
 	executable->entry(argc - 2, argv + 2, envp);
 	return 0;
 }
 
+/** Returns whether a range of memory doesn't overlap any of the objects that have been loaded. **/
+static bool range_is_free(size_t start, size_t size) {
+	for(auto& range : loaded_ranges) {
+		if(start < range.second && range.first < start + size)
+			return false;
+	}
+	return true;
+}
+
 int Object::load(char* name_cstr, bool is_main_executable) {
 	if(loaded)
 		return 0;
@@ -146,11 +164,30 @@ int Object::load(char* name_cstr, bool is_main_executable) {
 		memloc = 0;
 		size_t alloc_start = (calculated_base / PAGE_SIZE) * PAGE_SIZE;
 		size_t alloc_size = ((memsz + (calculated_base - alloc_start) + PAGE_SIZE - 1) / PAGE_SIZE) * PAGE_SIZE;
+		loaded_ranges.push_back({alloc_start, alloc_start + alloc_size});
+		//Libraries that aren't in the cache go after it, so they can't take the place of one that is
 		current_brk = alloc_start + alloc_size;
+		if(cache_header)
+			current_brk = std::max(current_brk, (size_t) cache_header->layout_end);
 	} else {
-		memloc = current_brk;
 		size_t alloc_size = ((memsz + PAGE_SIZE - 1) / PAGE_SIZE) * PAGE_SIZE;
-		current_brk += alloc_size;
+		if(cache_entry && range_is_free(cache_entry->load_address, alloc_size)) {
+			//Load the library where ldconfig laid it out, so that the bindings it worked out are right. Libraries are
+			//loaded in dependency order rather than the order ldconfig laid them out in, but their ranges never overlap.
+			memloc = cache_entry->load_address;
+			cache_objects[cache_entry - cache_libraries] = this;
+			if(debug)
+				Log::dbgf("Loading {} at its cached address {#x}", name, memloc);
+		} else {
+			//Something else is loaded where the cache expects this library (or it isn't in the cache), so the cached
+			//bindings might not be right anymore
+			if(use_cache_bindings && cache_header && debug)
+				Log::dbgf("Not using cached bindings, since {} isn't at its cached address", name);
+			use_cache_bindings = false;
+			memloc = current_brk;
+			current_brk += alloc_size;
+		}
+		loaded_ranges.push_back({memloc, memloc + alloc_size});
 	}
 
 	//Read the dynamic table and figure out the required libraries
@@ -177,12 +214,6 @@ int Object::load(char* name_cstr, bool is_main_executable) {
 	// Read the dynamic table
 	read_dynamic_table();
 
-	//Read the copy relocations of the main executable
-	if(is_main_executable && read_copy_relocations() < 0) {
-		Log::err("Failed to read copy relocations of ", name_cstr, ": ", strerror(errno));
-		return -1;
-	}
-
 	//Load the required libraries
 	for(auto& library_name : required_libraries) {
 		//Open the library
@@ -209,17 +240,31 @@ Object* Object::open_library(char* library_name) {
 		return objects[library_name];
 	}
 
-	//Find the library
-	auto library_loc = find_library(library_name);
-	if(library_loc.empty())
-		return nullptr;
-
-	//Open the library
-	int fd = open(library_loc.c_str(), O_RDONLY);
-	if(fd < 0)
-		return nullptr;
+	//Open the library from the cache if it's there and still the same file
+	int fd = -1;
 	struct stat statbuf;
-	fstat(fd, &statbuf);
+	auto* cache_entry = find_cached_library(library_name);
+	if(cache_entry) {
+		fd = open(cache_strings + cache_entry->path, O_RDONLY);
+		if(fd >= 0 && (fstat(fd, &statbuf) < 0 || !ld_cache_matches(*cache_entry, statbuf))) {
+			close(fd);
+			fd = -1;
+		}
+		if(fd < 0)
+			cache_entry = nullptr;
+	}
+
+	//Otherwise, search for it
+	if(fd < 0) {
+		auto library_loc = find_library(library_name);
+		if(library_loc.empty())
+			return nullptr;
+		fd = open(library_loc.c_str(), O_RDONLY);
+		if(fd < 0)
+			return nullptr;
+		fstat(fd, &statbuf);
+	}
+
 	size_t mapped_size = ((statbuf.st_size + PAGE_SIZE - 1) / PAGE_SIZE) * PAGE_SIZE;
 	auto* mapped_file = mmap(nullptr, mapped_size, PROT_READ, MAP_SHARED, fd, 0);
 	if(mapped_file == MAP_FAILED) {
@@ -230,10 +275,12 @@ Object* Object::open_library(char* library_name) {
 	//Add it to the objects map
 	auto* object = new Object();
 	objects[library_name] = object;
+	search_order.push_back(object);
 	object->fd = fd;
 	object->name = library_name;
 	object->mapped_file = (uint8_t*) mapped_file;
 	object->mapped_size = mapped_size;
+	object->cache_entry = cache_entry;
 
 	return object;
 }
@@ -297,8 +344,39 @@ void Object::read_dynamic_table() {
 		switch(dynamic.d_tag) {
 			case DT_HASH:
 				hash = (uint32_t*) (memloc + dynamic.d_val);
-				//Size of symbol table should be the same as the number of entries in the symbol hash table
-				symbol_table_size = hash[1];
+				break;
+
+			case DT_GNU_HASH:
+				gnu_hash = (uint32_t*) (memloc + dynamic.d_val);
+				break;
+
+			case DT_PLTGOT:
+				got = (uintptr_t*) (memloc + dynamic.d_val);
+				break;
+
+			case DT_REL:
+				relocations = (elf32_rel*) (memloc + dynamic.d_val);
+				break;
+
+			case DT_RELSZ:
+				relocations_size = dynamic.d_val;
+				break;
+
+			case DT_JMPREL:
+				plt_relocations = (elf32_rel*) (memloc + dynamic.d_val);
+				break;
+
+			case DT_PLTRELSZ:
+				plt_relocations_size = dynamic.d_val;
+				break;
+
+			case DT_BIND_NOW:
+				bind_now = true;
+				break;
+
+			case DT_FLAGS:
+				if(dynamic.d_val & DF_BIND_NOW)
+					bind_now = true;
 				break;
 
 			case DT_STRTAB:
@@ -323,12 +401,19 @@ void Object::read_dynamic_table() {
 
 			case DT_INIT_ARRAYSZ:
 				init_array_size = dynamic.d_val / sizeof(uintptr_t);
+				break;
 
 			default:
 				break;
 		}
 	}
 
+	//Some linkers count the PLT relocations as part of the regular ones, but we want to bind those separately
+	auto rel_start = (uintptr_t) relocations;
+	auto plt_start = (uintptr_t) plt_relocations;
+	if(plt_relocations && plt_start >= rel_start && plt_start < rel_start + relocations_size)
+		relocations_size = plt_start - rel_start;
+
 	//Now that the string table is loaded, we can iterate again and find the required libraries
 	required_libraries.resize(0);
 	for(auto& dynamic : dynamic_table) {
@@ -338,161 +423,296 @@ void Object::read_dynamic_table() {
 }
 
 int Object::load_sections() {
-	for(auto& pheader : pheaders) {
-		if(pheader.p_type != PT_LOAD)
-			continue;
-
-		// Allocate memory for the section
-		size_t vaddr_mod = pheader.p_vaddr % PAGE_SIZE;
-		size_t round_memloc = memloc + pheader.p_vaddr - vaddr_mod;
-		size_t round_size = ((pheader.p_memsz + vaddr_mod + PAGE_SIZE - 1) / PAGE_SIZE) * PAGE_SIZE;
-		if(mmap((void*) round_memloc, round_size, PROT_READ | PROT_WRITE, MAP_ANONYMOUS | MAP_FIXED, 0, 0) == MAP_FAILED)
-			Duck::Log::errf("ld: Failed to allocate memory for section at {#x}->{#x}: {}", pheader.p_vaddr, pheader.p_vaddr + pheader.p_memsz, strerror(errno));
-		lseek(fd, pheader.p_offset, SEEK_SET);
-		read(fd, (void*) (memloc + pheader.p_vaddr), pheader.p_filesz);
-
-		// Map the section into memory
-		// TODO: Why is this slower?
-//		size_t round_offset = pheader.p_offset - vaddr_mod;
-//		size_t round_filesz = ((pheader.p_filesz + vaddr_mod + PAGE_SIZE - 1) / PAGE_SIZE) * PAGE_SIZE;
-//		if(mmap((void*) round_memloc, round_filesz, PROT_READ | PROT_WRITE, MAP_FIXED | MAP_PRIVATE, fd, round_offset) == MAP_FAILED)
-//			Duck::Log::errf("ld: Failed to allocate memory for section at {#x}->{#x}: {}", pheader.p_vaddr, pheader.p_vaddr + pheader.p_memsz, strerror(errno));
-//		if(pheader.p_memsz != pheader.p_filesz)
-//			if(mmap((void*) (round_memloc + round_filesz), round_size - round_filesz, PROT_READ | PROT_WRITE, MAP_ANONYMOUS | MAP_FIXED, 0, 0) == MAP_FAILED)
-//				Duck::Log::errf("ld: Failed to allocate memory for section at {#x}->{#x}: {}", pheader.p_vaddr, pheader.p_vaddr + pheader.p_memsz, strerror(errno));
-
-		// Zero out the remaining bytes
-		size_t bytes_left = pheader.p_memsz - pheader.p_filesz;
-		if(bytes_left)
-			memset((void*) (memloc + pheader.p_vaddr + pheader.p_filesz), 0, bytes_left);
+	//Text relocations write to read-only segments, so those segments can't be shared with other processes
+	bool text_relocations = false;
+	for(auto& dynamic : dynamic_table) {
+		if(dynamic.d_tag == DT_TEXTREL || (dynamic.d_tag == DT_FLAGS && (dynamic.d_val & DF_TEXTREL)))
+			text_relocations = true;
 	}
 
-	return 0;
-}
-
-void Object::mprotect_sections() {
 	for(auto& pheader : pheaders) {
 		if(pheader.p_type != PT_LOAD)
 			continue;
+
 		size_t vaddr_mod = pheader.p_vaddr % PAGE_SIZE;
+		if(!pheader.p_filesz || pheader.p_offset % PAGE_SIZE != vaddr_mod) {
+			//The segment isn't laid out in the file the way it is in memory, so it has to be read in
+			if(load_segment_copy(pheader) < 0)
+				return -1;
+			continue;
+		}
+
 		size_t round_memloc = memloc + pheader.p_vaddr - vaddr_mod;
 		size_t round_size = ((pheader.p_memsz + vaddr_mod + PAGE_SIZE - 1) / PAGE_SIZE) * PAGE_SIZE;
-		int mmap_prot =
+		size_t round_offset = pheader.p_offset - vaddr_mod;
+		size_t round_filesz = ((pheader.p_filesz + vaddr_mod + PAGE_SIZE - 1) / PAGE_SIZE) * PAGE_SIZE;
+		int prot =
 				((pheader.p_flags & PF_R) ? PROT_READ : 0) |
 				((pheader.p_flags & PF_W) ? PROT_WRITE : 0) |
 				((pheader.p_flags & PF_X) ? PROT_EXEC : 0);
-		mprotect((void*) round_memloc, round_size, mmap_prot);
-	}
-}
 
-int Object::read_copy_relocations() {
-	//In the relocation table, find all of the copy relocations (ELF32_R_TYPE == STT_COMMON) and put them in the global symbols
-	for(auto& shdr : sheaders) {
-		if(shdr.sh_type != SHT_REL)
+		//Segments we never write to are mapped straight from the page cache, so every process using the object shares
+		//the same pages. Everything else gets a private copy-on-write mapping that we can relocate.
+		bool shared = !(pheader.p_flags & PF_W) && !text_relocations && pheader.p_memsz == pheader.p_filesz;
+		int map_prot = shared ? prot : PROT_READ | PROT_WRITE;
+		int map_flags = MAP_FIXED | (shared ? MAP_SHARED : MAP_PRIVATE);
+		if(mmap((void*) round_memloc, round_filesz, map_prot, map_flags, fd, round_offset) == MAP_FAILED) {
+			Duck::Log::errf("ld: Failed to map section at {#x}->{#x}: {}", pheader.p_vaddr, pheader.p_vaddr + pheader.p_filesz, strerror(errno));
+			return -1;
+		}
+		mappings.push_back({round_memloc, round_filesz, prot});
+
+		if(pheader.p_memsz == pheader.p_filesz)
 			continue;
-		auto* rel_table = (elf32_rel*) (shdr.sh_addr + memloc);
-		for(size_t i = 0; i < shdr.sh_size / sizeof(elf32_rel); i++) {
-			auto& rel = rel_table[i];
-			if(ELF32_R_TYPE(rel.r_info) == R_386_COPY) {
-				auto& symbol = symbol_table[ELF32_R_SYM(rel.r_info)];
-				auto* symbol_name = (char*)((uintptr_t)string_table + symbol.st_name);
-				global_symbols[symbol_name] = rel.r_offset;
+
+		//Zero out the part of the last file page that belongs to the bss, and give the rest of it anonymous memory
+		size_t tail_size = std::min<size_t>(pheader.p_memsz, round_filesz - vaddr_mod) - pheader.p_filesz;
+		if(tail_size)
+			memset((void*) (memloc + pheader.p_vaddr + pheader.p_filesz), 0, tail_size);
+		if(round_size > round_filesz) {
+			if(mmap((void*) (round_memloc + round_filesz), round_size - round_filesz, PROT_READ | PROT_WRITE, MAP_ANONYMOUS | MAP_FIXED, 0, 0) == MAP_FAILED) {
+				Duck::Log::errf("ld: Failed to allocate memory for section at {#x}->{#x}: {}", pheader.p_vaddr, pheader.p_vaddr + pheader.p_memsz, strerror(errno));
+				return -1;
 			}
+			mappings.push_back({round_memloc + round_filesz, round_size - round_filesz, prot});
 		}
 	}
+
 	return 0;
 }
 
-int Object::read_symbols() {
-	//Put all the symbols into the symbols map if they aren't there already
-	for(size_t i = 0; i < symbol_table_size; i++) {
-		auto* symbol = &symbol_table[i];
-		char* symbol_name = (char*)((uintptr_t) string_table + symbol->st_name);
-		if(symbol->st_shndx && symbols.find(symbol_name) == symbols.end()) {
-			symbols[symbol_name] = symbol->st_value + memloc;
-		}
+int Object::load_segment_copy(elf32_pheader& pheader) {
+	// Allocate memory for the section
+	size_t vaddr_mod = pheader.p_vaddr % PAGE_SIZE;
+	size_t round_memloc = memloc + pheader.p_vaddr - vaddr_mod;
+	size_t round_size = ((pheader.p_memsz + vaddr_mod + PAGE_SIZE - 1) / PAGE_SIZE) * PAGE_SIZE;
+	if(mmap((void*) round_memloc, round_size, PROT_READ | PROT_WRITE, MAP_ANONYMOUS | MAP_FIXED, 0, 0) == MAP_FAILED) {
+		Duck::Log::errf("ld: Failed to allocate memory for section at {#x}->{#x}: {}", pheader.p_vaddr, pheader.p_vaddr + pheader.p_memsz, strerror(errno));
+		return -1;
 	}
+	int prot =
+			((pheader.p_flags & PF_R) ? PROT_READ : 0) |
+			((pheader.p_flags & PF_W) ? PROT_WRITE : 0) |
+			((pheader.p_flags & PF_X) ? PROT_EXEC : 0);
+	mappings.push_back({round_memloc, round_size, prot});
+
+	lseek(fd, pheader.p_offset, SEEK_SET);
+	read(fd, (void*) (memloc + pheader.p_vaddr), pheader.p_filesz);
+
+	// Zero out the remaining bytes
+	size_t bytes_left = pheader.p_memsz - pheader.p_filesz;
+	if(bytes_left)
+		memset((void*) (memloc + pheader.p_vaddr + pheader.p_filesz), 0, bytes_left);
+
 	return 0;
 }
 
+void Object::mprotect_sections() {
+	for(auto& mapping : mappings)
+		mprotect((void*) mapping.start, mapping.size, mapping.prot);
+}
+
+const elf32_sym* Object::find_symbol(const char* symbol_name, uint32_t sysv_hash, uint32_t gnu_hash_value) {
+	auto is_match = [&](uint32_t index) {
+		auto& symbol = symbol_table[index];
+		return symbol.st_shndx && ELF32_ST_BIND(symbol.st_info) != STB_LOCAL && !strcmp(string_table + symbol.st_name, symbol_name);
+	};
+
+	if(gnu_hash) {
+		//The GNU hash table has a bloom filter in front of it, so most lookups for symbols we don't have stop there
+		uint32_t num_buckets = gnu_hash[0];
+		uint32_t sym_offset = gnu_hash[1];
+		uint32_t bloom_size = gnu_hash[2];
+		uint32_t bloom_shift = gnu_hash[3];
+		auto* bloom = &gnu_hash[4];
+		auto* buckets = &bloom[bloom_size];
+		auto* chain = &buckets[num_buckets];
+
+		uint32_t bloom_word = bloom[(gnu_hash_value / 32) % bloom_size];
+		uint32_t bloom_mask = (1u << (gnu_hash_value % 32)) | (1u << ((gnu_hash_value >> bloom_shift) % 32));
+		if((bloom_word & bloom_mask) != bloom_mask)
+			return nullptr;
+
+		uint32_t index = buckets[gnu_hash_value % num_buckets];
+		if(index < sym_offset)
+			return nullptr;
+		while(true) {
+			uint32_t chain_hash = chain[index - sym_offset];
+			if((chain_hash | 1) == (gnu_hash_value | 1) && is_match(index))
+				return &symbol_table[index];
+			if(chain_hash & 1)
+				return nullptr;
+			index++;
+		}
+	}
+
+	if(hash) {
+		uint32_t num_buckets = hash[0];
+		auto* buckets = &hash[2];
+		auto* chain = &buckets[num_buckets];
+		for(uint32_t index = buckets[sysv_hash % num_buckets]; index; index = chain[index]) {
+			if(is_match(index))
+				return &symbol_table[index];
+		}
+	}
+
+	return nullptr;
+}
+
 int Object::relocate() {
-	//Relocate the symbols
-	for(auto& shdr : sheaders) {
-		if(shdr.sh_type != SHT_REL)
-			continue;
-		auto* rel_table = (elf32_rel*) (shdr.sh_addr + memloc);
-		for(size_t i = 0; i < shdr.sh_size / sizeof(elf32_rel); i++) {
-			auto& rel = rel_table[i];
-			uint8_t rel_type = ELF32_R_TYPE(rel.r_info);
-			uint32_t rel_symbol = ELF32_R_SYM(rel.r_info);
-
-			if(rel_type == R_386_NONE)
-				continue;
-
-			auto& symbol = symbol_table[rel_symbol];
-			uintptr_t symbol_loc = memloc + symbol.st_value;
-			char* symbol_name = (char *)((uintptr_t) string_table + symbol.st_name);
-
-			//If this kind of relocation is a symbol, look it up
-			if(rel_type == R_386_32 || rel_type == R_386_PC32 || rel_type == R_386_COPY || rel_type == R_386_GLOB_DAT || rel_type == R_386_JMP_SLOT) {
-				if(symbol_name) {
-					auto map_it = symbols.find(symbol_name);
-					if(map_it == symbols.end()) {
-						if(debug)
-							Log::warn("Symbol ", symbol_name, " not found for ", name);
-						symbol_loc = 0x0;
-					} else {
-						symbol_loc = map_it->second;
-					}
-				}
-			}
+	for(size_t i = 0; i < relocations_size / sizeof(elf32_rel); i++)
+		apply_relocation(relocations[i]);
 
-			//If this is a global symbol, try finding it in the global symbol table
-			if(rel_type == R_386_GLOB_DAT) {
-				if(symbol_name) {
-					auto map_it = global_symbols.find(symbol_name);
-					if(map_it != symbols.end()) {
-						symbol_loc = map_it->second;
-					}
-				}
-			}
+	if(!plt_relocations)
+		return 0;
 
-			//Perform the actual relocation
-			auto* reloc_loc = (void*) (memloc + rel.r_offset);
-			switch(rel_type) {
-				case R_386_32:
-					symbol_loc += *((ssize_t*) reloc_loc);
-					*((uintptr_t*)reloc_loc) = (uintptr_t) symbol_loc;
-					break;
-
-				case R_386_PC32:
-					symbol_loc += *((ssize_t*) reloc_loc);
-					symbol_loc -= memloc + rel.r_offset;
-					*((uintptr_t*)reloc_loc) = (uintptr_t) symbol_loc;
-					break;
-
-				case R_386_COPY:
-					memcpy(reloc_loc, (const void*) symbol_loc, symbol.st_size);
-					break;
-
-				case R_386_GLOB_DAT:
-				case R_386_JMP_SLOT:
-					*((uintptr_t*) reloc_loc) = (uintptr_t) symbol_loc;
-					break;
-
-				case R_386_RELATIVE:
-					symbol_loc = memloc + *((ssize_t*) reloc_loc);
-					*((uintptr_t*) reloc_loc) = (uintptr_t) symbol_loc;
-					break;
-
-				default:
-					if(debug)
-						Log::warn("Unknown relocation type ", (int) rel_type, " for ",  (int) rel_symbol);
-					break;
-			}
+	size_t num_plt_relocations = plt_relocations_size / sizeof(elf32_rel);
+	if(bind_now || bind_now_env || !got) {
+		for(size_t i = 0; i < num_plt_relocations; i++)
+			apply_relocation(plt_relocations[i]);
+		return 0;
+	}
+
+	//Bind functions the first time they're called instead. Each GOT entry starts out pointing back into its PLT stub,
+	//which pushes the relocation's offset and jumps to the first PLT entry, which pushes GOT[1] and jumps to GOT[2].
+	got[1] = (uintptr_t) this;
+	got[2] = (uintptr_t) plt_trampoline;
+	for(size_t i = 0; i < num_plt_relocations; i++) {
+		auto& rel = plt_relocations[i];
+		if(ELF32_R_TYPE(rel.r_info) == R_386_JMP_SLOT)
+			*((uintptr_t*) (memloc + rel.r_offset)) += memloc;
+		else
+			apply_relocation(rel);
+	}
+
+	return 0;
+}
+
+void Object::apply_relocation(const elf32_rel& rel) {
+	uint8_t rel_type = ELF32_R_TYPE(rel.r_info);
+	uint32_t rel_symbol = ELF32_R_SYM(rel.r_info);
+
+	if(rel_type == R_386_NONE)
+		return;
+
+	auto& symbol = symbol_table[rel_symbol];
+	uintptr_t symbol_loc = memloc + symbol.st_value;
+
+	//If this kind of relocation is a symbol, look it up. Copy relocations copy the symbol from a library into the
+	//executable, so we skip the executable when looking those up.
+	if(rel_symbol && ELF32_ST_BIND(symbol.st_info) != STB_LOCAL) {
+		if(rel_type == R_386_32 || rel_type == R_386_PC32 || rel_type == R_386_COPY || rel_type == R_386_GLOB_DAT || rel_type == R_386_JMP_SLOT) {
+			symbol_loc = bind_symbol(rel_symbol, rel_type == R_386_COPY);
+			if(!symbol_loc && debug)
+				Log::warn("Symbol ", string_table + symbol.st_name, " not found for ", name);
 		}
 	}
 
+	//Perform the actual relocation
+	auto* reloc_loc = (void*) (memloc + rel.r_offset);
+	switch(rel_type) {
+		case R_386_32:
+			symbol_loc += *((ssize_t*) reloc_loc);
+			*((uintptr_t*)reloc_loc) = (uintptr_t) symbol_loc;
+			break;
+
+		case R_386_PC32:
+			symbol_loc += *((ssize_t*) reloc_loc);
+			symbol_loc -= memloc + rel.r_offset;
+			*((uintptr_t*)reloc_loc) = (uintptr_t) symbol_loc;
+			break;
+
+		case R_386_COPY:
+			if(symbol_loc)
+				memcpy(reloc_loc, (const void*) symbol_loc, symbol.st_size);
+			break;
+
+		case R_386_GLOB_DAT:
+		case R_386_JMP_SLOT:
+			*((uintptr_t*) reloc_loc) = (uintptr_t) symbol_loc;
+			break;
+
+		case R_386_RELATIVE:
+			symbol_loc = memloc + *((ssize_t*) reloc_loc);
+			*((uintptr_t*) reloc_loc) = (uintptr_t) symbol_loc;
+			break;
+
+		default:
+			if(debug)
+				Log::warn("Unknown relocation type ", (int) rel_type, " for ",  (int) rel_symbol);
+			break;
+	}
+}
+
+uintptr_t Object::resolve_plt(uint32_t reloc_offset) {
+	auto& rel = *((elf32_rel*) ((uintptr_t) plt_relocations + reloc_offset));
+	auto& symbol = symbol_table[ELF32_R_SYM(rel.r_info)];
+	char* symbol_name = string_table + symbol.st_name;
+	uintptr_t symbol_loc = bind_symbol(ELF32_R_SYM(rel.r_info), false);
+	if(!symbol_loc) {
+		Log::errf("ld-duckos.so: {}: undefined symbol {}", name, symbol_name);
+		_exit(127);
+	}
+
+	if(debug)
+		Log::dbgf("Bound {} @ {#x} for {}", symbol_name, symbol_loc, name);
+
+	//Storing a word is atomic, so threads racing to bind the same function will just store the same thing
+	*((uintptr_t*) (memloc + rel.r_offset)) = symbol_loc;
+	return symbol_loc;
+}
+
+//Called by plt_trampoline with the object whose PLT was called and the offset of the relocation to bind
+extern "C" uintptr_t resolve_plt(Object* object, uint32_t reloc_offset) {
+	return object->resolve_plt(reloc_offset);
+}
+
+uintptr_t Object::bind_symbol(uint32_t index, bool skip_executable) {
+	char* symbol_name = string_table + symbol_table[index].st_name;
+
+	//If ldconfig already worked out where the symbol is, we just need to make sure the executable doesn't override it
+	if(cache_entry && use_cache_bindings && !skip_executable) {
+		auto* bindings = cache_bindings + cache_entry->first_binding;
+		auto* bindings_end = bindings + cache_entry->num_bindings;
+		auto* binding = std::lower_bound(bindings, bindings_end, index, [](const LDCacheBinding& binding, uint32_t index) {
+			return binding.symbol < index;
+		});
+		if(binding != bindings_end && binding->symbol == index && cache_objects[binding->library]) {
+			uint32_t sysv_hash, gnu_hash;
+			symbol_hashes(symbol_name, sysv_hash, gnu_hash);
+			if(!executable->find_symbol(symbol_name, sysv_hash, gnu_hash))
+				return binding->address;
+		}
+	}
+
+	return lookup_symbol(symbol_name, skip_executable ? executable : nullptr);
+}
+
+void symbol_hashes(const char* symbol_name, uint32_t& sysv_hash, uint32_t& gnu_hash) {
+	//Both kinds of hash are cheap, so we calculate them together for whichever table each object has
+	sysv_hash = 0;
+	gnu_hash = 5381;
+	for(auto* c = (const uint8_t*) symbol_name; *c; c++) {
+		sysv_hash = (sysv_hash << 4) + *c;
+		uint32_t high = sysv_hash & 0xf0000000;
+		if(high)
+			sysv_hash ^= high >> 24;
+		sysv_hash &= ~high;
+		gnu_hash = gnu_hash * 33 + *c;
+	}
+}
+
+uintptr_t lookup_symbol(const char* symbol_name, const Object* skip) {
+	uint32_t sysv_hash, gnu_hash;
+	symbol_hashes(symbol_name, sysv_hash, gnu_hash);
+
+	for(auto* object : search_order) {
+		if(object == skip)
+			continue;
+		auto* symbol = object->find_symbol(symbol_name, sysv_hash, gnu_hash);
+		if(symbol)
+			return object->memloc + symbol->st_value;
+	}
 	return 0;
 }
 
@@ -516,4 +736,63 @@ std::string find_library(char* library_name) {
 	}
 
 	return "";
-}
\ No newline at end of file
+}
+
+void load_cache() {
+	//LD_LIBRARY_PATH changes where libraries are found, so the cache wouldn't be right
+	if(getenv("LD_LIBRARY_PATH"))
+		return;
+
+	int fd = open(LD_CACHE_PATH, O_RDONLY);
+	if(fd < 0)
+		return;
+	struct stat statbuf;
+	if(fstat(fd, &statbuf) < 0 || (size_t) statbuf.st_size < sizeof(LDCacheHeader)) {
+		close(fd);
+		return;
+	}
+	size_t mapped_size = ((statbuf.st_size + PAGE_SIZE - 1) / PAGE_SIZE) * PAGE_SIZE;
+	auto* mapped_file = mmap(nullptr, mapped_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if(mapped_file == MAP_FAILED)
+		return;
+
+	auto* header = (LDCacheHeader*) mapped_file;
+	auto* directories = (LDCacheDirectory*) (header + 1);
+	auto* libraries = (LDCacheLibrary*) (directories + header->num_directories);
+	auto* bindings = (LDCacheBinding*) (libraries + header->num_libraries);
+	auto* strings = (char*) (bindings + header->num_bindings);
+	bool valid = ld_cache_validate(mapped_file, statbuf.st_size);
+
+	//If any of the directories changed, a library might have been added or removed since the cache was written
+	for(size_t i = 0; valid && i < header->num_directories; i++) {
+		struct stat dir_stat;
+		if(stat(strings + directories[i].path, &dir_stat) < 0 || !ld_cache_matches(directories[i], dir_stat))
+			valid = false;
+	}
+
+	if(!valid) {
+		if(debug)
+			Log::dbg("Ignoring out of date library cache");
+		munmap(mapped_file, mapped_size);
+		return;
+	}
+
+	cache_header = header;
+	cache_libraries = libraries;
+	cache_bindings = bindings;
+	cache_strings = strings;
+	cache_objects.resize(header->num_libraries);
+}
+
+LDCacheLibrary* find_cached_library(const char* library_name) {
+	if(!cache_header)
+		return nullptr;
+	auto* end = cache_libraries + cache_header->num_libraries;
+	auto* library = std::lower_bound(cache_libraries, end, library_name, [](const LDCacheLibrary& library, const char* name) {
+		return strcmp(cache_strings + library.name, name) < 0;
+	});
+	if(library == end || strcmp(cache_strings + library->name, library_name))
+		return nullptr;
+	return library;
+}
@@ -22,6 +22,7 @@
 #include <vector>
 #include <unordered_map>
 #include <kernel/api/page_size.h>
+#include "cache.h"
 
 #define ELF_MAGIC 0x464C457F //0x7F followed by 'ELF'
 
@@ -75,8 +76,10 @@
 #define DT_DEBUG	21
 #define DT_TEXTREL	22
 #define DT_JMPREL	23
+#define DT_BIND_NOW	24
 #define DT_INIT_ARRAY	25
 #define DT_INIT_ARRAYSZ	27
+#define DT_FLAGS	30
 #define DT_ENCODING	32
 #define OLD_DT_LOOS		0x60000000
 #define DT_LOOS			0x6000000d
@@ -84,6 +87,7 @@
 #define DT_VALRNGLO		0x6ffffd00
 #define DT_VALRNGHI		0x6ffffdff
 #define DT_ADDRRNGLO	0x6ffffe00
+#define DT_GNU_HASH		0x6ffffef5
 #define DT_ADDRRNGHI	0x6ffffeff
 #define DT_VERSYM		0x6ffffff0
 #define DT_RELACOUNT	0x6ffffff9
@@ -97,6 +101,9 @@
 #define DT_LOPROC		0x70000000
 #define DT_HIPROC		0x7fffffff
 
+#define DF_TEXTREL		0x4
+#define DF_BIND_NOW		0x8
+
 #define SHT_NULL		0
 #define SHT_PROGBITS	1
 #define SHT_SYMTAB		2
@@ -123,6 +130,12 @@
 #define STT_COMMON  5
 #define STT_TLS     6
 
+#define STB_LOCAL   0
+#define STB_GLOBAL  1
+#define STB_WEAK    2
+
+#define ELF32_ST_BIND(x) ((x) >> 4u)
+
 #define R_386_NONE		0
 #define R_386_32		1
 #define R_386_PC32		2
@@ -218,10 +231,13 @@ public:
 	int load_dynamic_table();
 	void read_dynamic_table();
 	int load_sections();
+	int load_segment_copy(elf32_pheader& pheader);
 	void mprotect_sections();
-	int read_copy_relocations();
-	int read_symbols();
+	const elf32_sym* find_symbol(const char* symbol_name, uint32_t sysv_hash, uint32_t gnu_hash_value);
+	uintptr_t bind_symbol(uint32_t index, bool skip_executable);
 	int relocate();
+	void apply_relocation(const elf32_rel& rel);
+	uintptr_t resolve_plt(uint32_t reloc_offset);
 
 	std::string name;
 	int fd = 0;
@@ -230,12 +246,19 @@ public:
 	size_t memloc = 0;
 	size_t calculated_base = 0;
 	bool loaded = false;
+	LDCacheLibrary* cache_entry = nullptr;
 
 	char* string_table = nullptr;
 	size_t string_table_size = 0;
 	elf32_sym* symbol_table = nullptr;
-	size_t symbol_table_size = 0;
 	uint32_t* hash = nullptr;
+	uint32_t* gnu_hash = nullptr;
+	uintptr_t* got = nullptr;
+	elf32_rel* relocations = nullptr;
+	size_t relocations_size = 0;
+	elf32_rel* plt_relocations = nullptr;
+	size_t plt_relocations_size = 0;
+	bool bind_now = false;
 	void (**init_array)() = nullptr;
 	size_t init_array_size = 0;
 	void (*init_func)() = nullptr;
@@ -247,7 +270,19 @@ public:
 	std::vector<elf32_pheader> pheaders;
 	std::vector<elf32_sheader> sheaders;
 	std::vector<elf32_dynamic> dynamic_table;
+
+	/** A region mapped for one of the object's segments, and the protection it should end up with. **/
+	struct Mapping {
+		size_t start;
+		size_t size;
+		int prot;
+	};
+	std::vector<Mapping> mappings;
 };
 
 std::string find_library(char* library_name);
+uintptr_t lookup_symbol(const char* symbol_name, const Object* skip = nullptr);
+void symbol_hashes(const char* symbol_name, uint32_t& sysv_hash, uint32_t& gnu_hash);
+void load_cache();
+LDCacheLibrary* find_cached_library(const char* library_name);
 
@@ -20,6 +20,7 @@
 #include <sys/syscall.h>
 #include <fcntl.h>
 #include <stdarg.h>
+#include <sys/ioctl.h>
 
 int open(const char* pathname, int flags, ...) {
 	mode_t mode = 0;
@@ -37,5 +38,26 @@ int openat(int dirfd, const char* pathname, int flags) {
 }
 
 int fcntl(int fd, int cmd, ...) {
-	return -1;
+	va_list list;
+	va_start(list, cmd);
+	int arg = va_arg(list, int);
+	va_end(list);
+
+	switch(cmd) {
+		case F_GETPIPE_SZ:
+			return ioctl(fd, FIOGETPIPESZ);
+		case F_SETPIPE_SZ:
+			return ioctl(fd, FIOSETPIPESZ, arg);
+		default:
+			return -1;
+	}
+}
+
+ssize_t splice(int fd_in, int fd_out, size_t len) {
+	return syscall4(SYS_SPLICE, fd_in, fd_out, (int) len);
+}
+
+int posix_fadvise(int fd, off_t offset, off_t len, int advice) {
+	struct fadvise_args args = {fd, offset, len, advice};
+	return -syscall2_noerr(SYS_FADVISE, (int) &args);
 }
\ No newline at end of file
@@ -30,6 +30,14 @@ int open(const char* pathname, int flags, ...);
 int openat(int dirfd, const char* pathname, int flags);
 int fcntl(int fd, int cmd, ...);
 
+// Moves up to len bytes between a pipe and a file without copying through userspace. Either fd_in or fd_out must be
+// a pipe, and the data is read and written at the current offsets of the file descriptors.
+ssize_t splice(int fd_in, int fd_out, size_t len);
+
+// Tells the kernel how a range of a file is going to be accessed (one of POSIX_FADV_*), so it can read ahead
+// accordingly. A len of zero means until the end of the file. Returns an error number instead of setting errno.
+int posix_fadvise(int fd, off_t offset, off_t len, int advice);
+
 __DECL_END
 
 #endif //DUCKOS_FCNTL_H
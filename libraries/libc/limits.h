@@ -48,6 +48,7 @@
 #define ULONG_LONG_MAX	18446744073709551615ULL
 
 #define ARG_MAX 65536
+#define PATH_MAX 4096
 
 #ifndef PAGE_SIZE
 #include <kernel/api/page_size.h>
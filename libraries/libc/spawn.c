@@ -0,0 +1,124 @@
+/* SPDX-License-Identifier: GPL-3.0-or-later */
+/* Copyright © 2016-2023 Byteduck */
+
+#include "spawn.h"
+#include <sys/syscall.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/internals.h>
+
+int posix_spawn(pid_t* pid, const char* path, const posix_spawn_file_actions_t* file_actions,
+				const posix_spawnattr_t* attr, char* const argv[], char* const envp[]) {
+	struct posix_spawn_args args = {path, argv, envp, file_actions, attr};
+	int res = syscall2_noerr(SYS_POSIX_SPAWN, (int) &args);
+	if(res < 0)
+		return -res;
+	if(pid)
+		*pid = res;
+	return 0;
+}
+
+int posix_spawnp(pid_t* pid, const char* file, const posix_spawn_file_actions_t* file_actions,
+				 const posix_spawnattr_t* attr, char* const argv[], char* const envp[]) {
+	// If the file contains a slash, ignore the path
+	if(strchr(file, '/'))
+		return posix_spawn(pid, file, file_actions, attr, argv, envp);
+
+	// Try each element of path
+	const char* path = NULL;
+	char full_path[PATH_MAX];
+	while(__path_next_candidate(&path, file, full_path)) {
+		int res = posix_spawn(pid, full_path, file_actions, attr, argv, envp);
+		if(res != ENOENT)
+			return res;
+	}
+
+	return ENOENT;
+}
+
+int posix_spawn_file_actions_init(posix_spawn_file_actions_t* file_actions) {
+	file_actions->actions = NULL;
+	file_actions->num_actions = 0;
+	file_actions->capacity = 0;
+	return 0;
+}
+
+int posix_spawn_file_actions_destroy(posix_spawn_file_actions_t* file_actions) {
+	for(int i = 0; i < file_actions->num_actions; i++)
+		free((char*) file_actions->actions[i].path);
+	free(file_actions->actions);
+	return posix_spawn_file_actions_init(file_actions);
+}
+
+static int add_file_action(posix_spawn_file_actions_t* file_actions, struct posix_spawn_file_action action) {
+	if(action.fd < 0 || action.src_fd < 0)
+		return EBADF;
+	if(file_actions->num_actions >= SPAWN_MAX_FILE_ACTIONS)
+		return ENOMEM;
+	if(file_actions->num_actions == file_actions->capacity) {
+		int new_capacity = file_actions->capacity ? file_actions->capacity * 2 : 4;
+		struct posix_spawn_file_action* new_actions = realloc(file_actions->actions, new_capacity * sizeof(struct posix_spawn_file_action));
+		if(!new_actions)
+			return ENOMEM;
+		file_actions->actions = new_actions;
+		file_actions->capacity = new_capacity;
+	}
+	file_actions->actions[file_actions->num_actions++] = action;
+	return 0;
+}
+
+int posix_spawn_file_actions_addopen(posix_spawn_file_actions_t* file_actions, int fd, const char* path, int oflag, mode_t mode) {
+	char* path_copy = strdup(path);
+	if(!path_copy)
+		return ENOMEM;
+	struct posix_spawn_file_action action = {SPAWN_FILE_ACTION_OPEN, fd, 0, oflag, mode, path_copy};
+	int res = add_file_action(file_actions, action);
+	if(res)
+		free(path_copy);
+	return res;
+}
+
+int posix_spawn_file_actions_addclose(posix_spawn_file_actions_t* file_actions, int fd) {
+	struct posix_spawn_file_action action = {SPAWN_FILE_ACTION_CLOSE, fd, 0, 0, 0, NULL};
+	return add_file_action(file_actions, action);
+}
+
+int posix_spawn_file_actions_adddup2(posix_spawn_file_actions_t* file_actions, int fd, int new_fd) {
+	struct posix_spawn_file_action action = {SPAWN_FILE_ACTION_DUP2, new_fd, fd, 0, 0, NULL};
+	return add_file_action(file_actions, action);
+}
+
+int posix_spawnattr_init(posix_spawnattr_t* attr) {
+	attr->flags = 0;
+	attr->pgroup = 0;
+	return 0;
+}
+
+int posix_spawnattr_destroy(posix_spawnattr_t* attr) {
+	return 0;
+}
+
+int posix_spawnattr_getflags(const posix_spawnattr_t* attr, short* flags) {
+	*flags = attr->flags;
+	return 0;
+}
+
+int posix_spawnattr_setflags(posix_spawnattr_t* attr, short flags) {
+	if(flags & ~(POSIX_SPAWN_SETPGROUP | POSIX_SPAWN_SETSID))
+		return EINVAL;
+	attr->flags = flags;
+	return 0;
+}
+
+int posix_spawnattr_getpgroup(const posix_spawnattr_t* attr, pid_t* pgroup) {
+	*pgroup = attr->pgroup;
+	return 0;
+}
+
+int posix_spawnattr_setpgroup(posix_spawnattr_t* attr, pid_t pgroup) {
+	attr->pgroup = pgroup;
+	return 0;
+}
@@ -0,0 +1,38 @@
+/* SPDX-License-Identifier: GPL-3.0-or-later */
+/* Copyright © 2016-2023 Byteduck */
+
+#ifndef DUCKOS_LIBC_SPAWN_H
+#define DUCKOS_LIBC_SPAWN_H
+
+#include <sys/cdefs.h>
+#include <sys/types.h>
+#include <kernel/api/spawn.h>
+
+__DECL_BEGIN
+
+// Starts a new process running path, without copying the calling process first. The file actions are applied to a
+// copy of the caller's file descriptors and the attributes to the new process before it starts. Returns an error
+// number instead of setting errno, and writes the new process's pid to pid if it isn't null.
+int posix_spawn(pid_t* pid, const char* path, const posix_spawn_file_actions_t* file_actions,
+				const posix_spawnattr_t* attr, char* const argv[], char* const envp[]);
+
+// Like posix_spawn(), but searches PATH for file if it doesn't contain a slash.
+int posix_spawnp(pid_t* pid, const char* file, const posix_spawn_file_actions_t* file_actions,
+				 const posix_spawnattr_t* attr, char* const argv[], char* const envp[]);
+
+int posix_spawn_file_actions_init(posix_spawn_file_actions_t* file_actions);
+int posix_spawn_file_actions_destroy(posix_spawn_file_actions_t* file_actions);
+int posix_spawn_file_actions_addopen(posix_spawn_file_actions_t* file_actions, int fd, const char* path, int oflag, mode_t mode);
+int posix_spawn_file_actions_addclose(posix_spawn_file_actions_t* file_actions, int fd);
+int posix_spawn_file_actions_adddup2(posix_spawn_file_actions_t* file_actions, int fd, int new_fd);
+
+int posix_spawnattr_init(posix_spawnattr_t* attr);
+int posix_spawnattr_destroy(posix_spawnattr_t* attr);
+int posix_spawnattr_getflags(const posix_spawnattr_t* attr, short* flags);
+int posix_spawnattr_setflags(posix_spawnattr_t* attr, short flags);
+int posix_spawnattr_getpgroup(const posix_spawnattr_t* attr, pid_t* pgroup);
+int posix_spawnattr_setpgroup(posix_spawnattr_t* attr, pid_t pgroup);
+
+__DECL_END
+
+#endif //DUCKOS_LIBC_SPAWN_H
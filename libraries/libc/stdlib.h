@@ -47,7 +47,7 @@ int rand();
 void srand(unsigned int seed);
 
 //Memory
-#include <sys/liballoc.h>
+#include <sys/malloc.h>
 
 //Environment & System
 char* getenv(const char* name);
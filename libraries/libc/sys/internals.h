@@ -28,4 +28,14 @@ void __cxa_finalize(void* dso_handle);
 __attribute__((noreturn)) void __cxa_pure_virtual() __attribute__((weak));
 __attribute__((noreturn)) void __stack_chk_fail();
 
+/**
+ * Gets the next place to look for a file in PATH, for the exec*p() and posix_spawnp() family. Doesn't allocate, so it's
+ * safe to use in a vfork()'d child.
+ * @param path The position in PATH, which should start out NULL.
+ * @param file The file to look for.
+ * @param buf A buffer of PATH_MAX bytes to put the path in.
+ * @return buf, or NULL once every element of PATH has been tried.
+ */
+char* __path_next_candidate(const char** path, const char* file, char* buf);
+
 #endif //DUCKOS_LIBC_INTERNALS_H
@@ -37,8 +37,9 @@
 //#define _HAVE_UINTPTR_T
 //typedef	unsigned long	uintptr_t;
 
-//This lets you prefix malloc and friends
-#define __DUCKOS_LIBALLOC_PREFIX(func) func
+//This lets you prefix malloc and friends. libc's malloc is in malloc.cpp now, so liballoc is only kept around to compare
+//against it (see the mallocbench coreutil).
+#define __DUCKOS_LIBALLOC_PREFIX(func) __liballoc_##func
 
 #ifdef __cplusplus
 extern "C" {
@@ -0,0 +1,528 @@
+/* SPDX-License-Identifier: GPL-3.0-or-later */
+/* Copyright © 2016-2023 Byteduck */
+
+/*
+ * Small allocations are carved out of spans of MALLOC_SPAN_PAGES pages, which each hold objects of a single size class.
+ * Every thread has its own heap of spans to allocate from, found through a pointer at the bottom of its stack (stacks are
+ * aligned to THREAD_STACK_SIZE), so allocating, and freeing on the thread that owns the span, doesn't take any locks or
+ * atomics. Objects freed by other threads are pushed onto their span's remote free list with a compare-and-swap, and are
+ * picked up by the owner the next time it runs out of objects of that size.
+ *
+ * Large allocations get their own mapping. Spans that become empty are kept around to be reused by any heap, and are
+ * only unmapped once there are more than MALLOC_MAX_FREE_SPANS of them, so a program that frees and allocates a lot of
+ * memory in a loop doesn't mmap and munmap on every iteration.
+ *
+ * The dynamic linker is linked statically with its own copy of this allocator, and runs on the same stack as the
+ * program it loads. Heaps are tagged with the copy that made them, so one copy never adopts (or frees into) a heap
+ * belonging to the other.
+ */
+
+#include "malloc.h"
+#include "mman.h"
+#include <kernel/api/page_size.h>
+#include <kernel/api/thread.h>
+#include <libduck/SpinLock.h>
+#include <atomic>
+#include <new>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#define MALLOC_SPAN_PAGES 16
+#define MALLOC_SPAN_SIZE (MALLOC_SPAN_PAGES * PAGE_SIZE)
+#define MALLOC_MAX_SMALL 16384
+#define MALLOC_NUM_CLASSES 36
+#define MALLOC_LARGE_CLASS 0xFF
+//Once there are more than MALLOC_MAX_FREE_SPANS empty spans, they're unmapped until there are MALLOC_MIN_FREE_SPANS left
+#define MALLOC_MAX_FREE_SPANS 32
+#define MALLOC_MIN_FREE_SPANS 8
+//The amount of memory mapped at once for spans' and heaps' bookkeeping
+#define MALLOC_META_CHUNK_SIZE 65536
+//The page map is a two-level table, with each leaf covering 4MiB of the (32-bit) address space
+#define MALLOC_PAGEMAP_LEAF_BITS 10
+#define MALLOC_PAGEMAP_LEAF_SIZE (1 << MALLOC_PAGEMAP_LEAF_BITS)
+#define MALLOC_PAGEMAP_ROOT_SIZE (1 << (32 - 12 - MALLOC_PAGEMAP_LEAF_BITS))
+
+static_assert(sizeof(void*) == 4, "The malloc page map assumes a 32-bit address space");
+static_assert(MALLOC_PAGEMAP_LEAF_SIZE * sizeof(void*) == PAGE_SIZE, "Page map leaves should be one page");
+
+namespace {
+	struct Heap;
+
+	struct Span {
+		uintptr_t start;
+		size_t num_pages;
+		uint8_t size_class;
+		bool full; //Whether the span is in its heap's full list
+		size_t object_size;
+		size_t capacity;
+		Heap* owner;
+		void* free_list; //Objects freed by the owner
+		std::atomic<void*> remote_free = {nullptr}; //Objects freed by other threads
+		size_t num_used;
+		size_t num_bumped; //Objects past this index have never been handed out, so they aren't on the free list
+		Span* prev;
+		Span* next;
+	};
+
+	struct Heap {
+		const void* allocator; //The copy of the allocator this heap belongs to. Kept first, since other copies read it
+		Span* spans[MALLOC_NUM_CLASSES]; //The spans with space in them, with the one being allocated from first
+		Span* full_spans[MALLOC_NUM_CLASSES];
+		//The number of objects freed by other threads in each size class since it was last checked, so we know when the
+		//full spans might have space again
+		std::atomic<size_t> remote_frees[MALLOC_NUM_CLASSES];
+		Heap* next_idle;
+	};
+
+	/** A pool of bookkeeping structures, which are never given back to the kernel. **/
+	template<typename T>
+	class MetaPool {
+	public:
+		T* alloc() {
+			LOCK(m_lock);
+			if(!m_free) {
+				auto* chunk = (uint8_t*) mmap(nullptr, MALLOC_META_CHUNK_SIZE, PROT_READ | PROT_WRITE, MAP_ANONYMOUS, 0, 0);
+				if(chunk == MAP_FAILED)
+					return nullptr;
+				for(size_t offset = 0; offset + sizeof(T) <= MALLOC_META_CHUNK_SIZE; offset += sizeof(T)) {
+					*(void**) (chunk + offset) = m_free;
+					m_free = chunk + offset;
+				}
+			}
+			void* object = m_free;
+			m_free = *(void**) object;
+			memset(object, 0, sizeof(T));
+			return new(object) T;
+		}
+
+		void free(T* object) {
+			LOCK(m_lock);
+			*(void**) object = m_free;
+			m_free = object;
+		}
+
+	private:
+		Duck::SpinLock m_lock;
+		void* m_free = nullptr;
+	};
+
+	MetaPool<Span> s_span_pool;
+	MetaPool<Heap> s_heap_pool;
+	//Identifies this copy of the allocator; see the comment at the top of the file
+	const char s_allocator_tag = 0;
+
+	//Which span every page we've mapped belongs to
+	std::atomic<Span**> s_pagemap[MALLOC_PAGEMAP_ROOT_SIZE];
+
+	//Empty spans that are still mapped, and heaps that don't belong to any thread right now
+	Duck::SpinLock s_free_span_lock;
+	Span* s_free_spans = nullptr;
+	size_t s_num_free_spans = 0;
+	Duck::SpinLock s_idle_heap_lock;
+	Heap* s_idle_heaps = nullptr;
+
+	inline size_t size_class_of(size_t size) {
+		if(size <= 128)
+			return size ? (size - 1) / 16 : 0;
+		//Past 128 bytes, each power of two is split into four classes
+		size_t bit = 31 - __builtin_clz(size - 1);
+		return 8 + (bit - 7) * 4 + (((size - 1) >> (bit - 2)) & 3);
+	}
+
+	inline size_t class_size(size_t size_class) {
+		if(size_class < 8)
+			return (size_class + 1) * 16;
+		return (5 + (size_class - 8) % 4) << ((size_class - 8) / 4 + 5);
+	}
+
+	inline Span* span_for(void* ptr) {
+		auto page = (uintptr_t) ptr / PAGE_SIZE;
+		auto* leaf = s_pagemap[page >> MALLOC_PAGEMAP_LEAF_BITS].load(std::memory_order_acquire);
+		return leaf ? leaf[page & (MALLOC_PAGEMAP_LEAF_SIZE - 1)] : nullptr;
+	}
+
+	bool set_pagemap(uintptr_t start, size_t num_pages, Span* span) {
+		for(auto page = start / PAGE_SIZE; page < start / PAGE_SIZE + num_pages; page++) {
+			auto& root_entry = s_pagemap[page >> MALLOC_PAGEMAP_LEAF_BITS];
+			auto* leaf = root_entry.load(std::memory_order_acquire);
+			if(!leaf) {
+				auto* new_leaf = (Span**) mmap(nullptr, PAGE_SIZE, PROT_READ | PROT_WRITE, MAP_ANONYMOUS, 0, 0);
+				if(new_leaf == MAP_FAILED)
+					return false;
+				//Somebody else may have made the leaf in the meantime
+				if(root_entry.compare_exchange_strong(leaf, new_leaf, std::memory_order_acq_rel))
+					leaf = new_leaf;
+				else
+					munmap(new_leaf, PAGE_SIZE);
+			}
+			leaf[page & (MALLOC_PAGEMAP_LEAF_SIZE - 1)] = span;
+		}
+		return true;
+	}
+
+	/** Maps memory for a span and makes its bookkeeping, or returns null if we're out of memory. **/
+	Span* map_span(size_t num_pages) {
+		auto* span = s_span_pool.alloc();
+		if(!span)
+			return nullptr;
+		auto* mem = mmap(nullptr, num_pages * PAGE_SIZE, PROT_READ | PROT_WRITE, MAP_ANONYMOUS, 0, 0);
+		if(mem == MAP_FAILED) {
+			s_span_pool.free(span);
+			return nullptr;
+		}
+		span->start = (uintptr_t) mem;
+		span->num_pages = num_pages;
+		if(!set_pagemap(span->start, num_pages, span)) {
+			set_pagemap(span->start, num_pages, nullptr);
+			munmap(mem, num_pages * PAGE_SIZE);
+			s_span_pool.free(span);
+			return nullptr;
+		}
+		return span;
+	}
+
+	void unmap_span(Span* span) {
+		//The page map has to be cleared before the memory is unmapped, since it could be mapped again by someone else
+		set_pagemap(span->start, span->num_pages, nullptr);
+		munmap((void*) span->start, span->num_pages * PAGE_SIZE);
+		s_span_pool.free(span);
+	}
+
+	void link(Span*& list, Span* span) {
+		span->prev = nullptr;
+		span->next = list;
+		if(list)
+			list->prev = span;
+		list = span;
+	}
+
+	void unlink(Span*& list, Span* span) {
+		if(span->prev)
+			span->prev->next = span->next;
+		else
+			list = span->next;
+		if(span->next)
+			span->next->prev = span->prev;
+		span->prev = nullptr;
+		span->next = nullptr;
+	}
+
+	/** Gets an empty span for a heap, reusing a free one if there is one. **/
+	Span* new_span(Heap* heap, size_t size_class) {
+		Span* span = nullptr;
+		{
+			LOCK(s_free_span_lock);
+			if(s_free_spans) {
+				span = s_free_spans;
+				unlink(s_free_spans, span);
+				s_num_free_spans--;
+			}
+		}
+		if(!span)
+			span = map_span(MALLOC_SPAN_PAGES);
+		if(!span)
+			return nullptr;
+
+		span->size_class = size_class;
+		span->full = false;
+		span->object_size = class_size(size_class);
+		span->capacity = MALLOC_SPAN_SIZE / span->object_size;
+		span->owner = heap;
+		span->free_list = nullptr;
+		span->remote_free.store(nullptr, std::memory_order_relaxed);
+		span->num_used = 0;
+		span->num_bumped = 0;
+		return span;
+	}
+
+	/** Gives back an empty span, unmapping free spans if there are too many of them. **/
+	void release_span(Span* span) {
+		Span* to_unmap = nullptr;
+		{
+			LOCK(s_free_span_lock);
+			link(s_free_spans, span);
+			if(++s_num_free_spans > MALLOC_MAX_FREE_SPANS) {
+				while(s_num_free_spans > MALLOC_MIN_FREE_SPANS) {
+					auto* unmap = s_free_spans;
+					unlink(s_free_spans, unmap);
+					link(to_unmap, unmap);
+					s_num_free_spans--;
+				}
+			}
+		}
+
+		while(to_unmap) {
+			auto* next = to_unmap->next;
+			unmap_span(to_unmap);
+			to_unmap = next;
+		}
+	}
+
+	inline void* take_object(Span* span) {
+		void* object = span->free_list;
+		if(object)
+			span->free_list = *(void**) object;
+		else if(span->num_bumped < span->capacity)
+			object = (void*) (span->start + span->num_bumped++ * span->object_size);
+		else
+			return nullptr;
+		span->num_used++;
+		return object;
+	}
+
+	/** Moves the objects freed by other threads onto a span's free list. Must be called by the span's owner. **/
+	void collect_remote_frees(Span* span) {
+		if(!span->remote_free.load(std::memory_order_relaxed))
+			return;
+		void* head = span->remote_free.exchange(nullptr, std::memory_order_acquire);
+		void* tail = head;
+		size_t count = 1;
+		while(*(void**) tail) {
+			tail = *(void**) tail;
+			count++;
+		}
+		*(void**) tail = span->free_list;
+		span->free_list = head;
+		span->num_used -= count;
+	}
+
+	Heap* acquire_heap() {
+		{
+			LOCK(s_idle_heap_lock);
+			if(s_idle_heaps) {
+				auto* heap = s_idle_heaps;
+				s_idle_heaps = heap->next_idle;
+				return heap;
+			}
+		}
+		auto* heap = s_heap_pool.alloc();
+		if(heap)
+			heap->allocator = &s_allocator_tag;
+		return heap;
+	}
+
+	inline Heap** heap_slot() {
+		return (Heap**) ((uintptr_t) __builtin_frame_address(0) & ~(uintptr_t) (THREAD_STACK_SIZE - 1));
+	}
+
+	/** Returns the heap in the calling thread's slot, or null if there isn't one or it belongs to another allocator. **/
+	inline Heap* slot_heap() {
+		auto* heap = *heap_slot();
+		if(__builtin_expect(heap && heap->allocator != &s_allocator_tag, 0))
+			return nullptr;
+		return heap;
+	}
+
+	inline Heap* current_heap() {
+		auto* heap = slot_heap();
+		if(__builtin_expect(!heap, 0)) {
+			heap = acquire_heap();
+			*heap_slot() = heap;
+		}
+		return heap;
+	}
+
+	void* alloc_small_slow(Heap* heap, size_t size_class) {
+		//If other threads have freed objects of this size, some of our full spans might have space now
+		if(heap->remote_frees[size_class].exchange(0, std::memory_order_acquire)) {
+			auto* span = heap->full_spans[size_class];
+			while(span) {
+				auto* next = span->next;
+				collect_remote_frees(span);
+				if(span->num_used < span->capacity) {
+					unlink(heap->full_spans[size_class], span);
+					span->full = false;
+					if(span->num_used)
+						link(heap->spans[size_class], span);
+					else
+						release_span(span);
+				}
+				span = next;
+			}
+		}
+
+		//Move spans out of the way until we find one with space in it
+		while(auto* span = heap->spans[size_class]) {
+			collect_remote_frees(span);
+			if(auto* object = take_object(span))
+				return object;
+			unlink(heap->spans[size_class], span);
+			span->full = true;
+			link(heap->full_spans[size_class], span);
+		}
+
+		auto* span = new_span(heap, size_class);
+		if(!span)
+			return nullptr;
+		link(heap->spans[size_class], span);
+		return take_object(span);
+	}
+
+	void* alloc_large(size_t size) {
+		if(size > SIZE_MAX - PAGE_SIZE)
+			return nullptr;
+		auto* span = map_span((size + PAGE_SIZE - 1) / PAGE_SIZE);
+		if(!span)
+			return nullptr;
+		span->size_class = MALLOC_LARGE_CLASS;
+		span->object_size = span->num_pages * PAGE_SIZE;
+		return (void*) span->start;
+	}
+
+	void free_local(Heap* heap, Span* span, void* ptr) {
+		*(void**) ptr = span->free_list;
+		span->free_list = ptr;
+		span->num_used--;
+
+		auto& list = heap->spans[span->size_class];
+		if(span->full) {
+			unlink(heap->full_spans[span->size_class], span);
+			span->full = false;
+			if(list) {
+				//Put it after the span we're allocating from, so that one keeps getting filled up first
+				span->prev = list;
+				span->next = list->next;
+				if(list->next)
+					list->next->prev = span;
+				list->next = span;
+			} else {
+				link(list, span);
+			}
+		}
+
+		//Keep the span we're allocating from even if it's empty, so allocating and freeing one object over and over
+		//doesn't keep getting a new span
+		if(!span->num_used && span != list) {
+			unlink(list, span);
+			release_span(span);
+		}
+	}
+
+	void free_remote(Span* span, void* ptr) {
+		//The span could be reused by another heap as soon as our object is on its list, so read what we need first
+		auto* owner = span->owner;
+		auto size_class = span->size_class;
+		void* head = span->remote_free.load(std::memory_order_relaxed);
+		do {
+			*(void**) ptr = head;
+		} while(!span->remote_free.compare_exchange_weak(head, ptr, std::memory_order_release, std::memory_order_relaxed));
+		owner->remote_frees[size_class].fetch_add(1, std::memory_order_release);
+	}
+}
+
+void* malloc(size_t size) {
+	if(size > MALLOC_MAX_SMALL) {
+		auto* ret = alloc_large(size);
+		if(!ret)
+			errno = ENOMEM;
+		return ret;
+	}
+
+	auto* heap = current_heap();
+	if(!heap) {
+		errno = ENOMEM;
+		return nullptr;
+	}
+	auto size_class = size_class_of(size);
+	auto* span = heap->spans[size_class];
+	void* ret = span ? take_object(span) : nullptr;
+	if(__builtin_expect(!ret, 0))
+		ret = alloc_small_slow(heap, size_class);
+	if(!ret)
+		errno = ENOMEM;
+	return ret;
+}
+
+void free(void* ptr) {
+	if(!ptr)
+		return;
+	auto* span = span_for(ptr);
+	if(!span) {
+		fprintf(stderr, "free(): %p wasn't allocated by malloc\n", ptr);
+		abort();
+	}
+
+	if(span->size_class == MALLOC_LARGE_CLASS) {
+		unmap_span(span);
+		return;
+	}
+
+	auto* heap = slot_heap();
+	if(span->owner == heap)
+		free_local(heap, span, ptr);
+	else
+		free_remote(span, ptr);
+}
+
+void* calloc(size_t nmemb, size_t size) {
+	if(size && nmemb > SIZE_MAX / size) {
+		errno = ENOMEM;
+		return nullptr;
+	}
+	void* ret = malloc(nmemb * size);
+	if(ret)
+		memset(ret, 0, nmemb * size);
+	return ret;
+}
+
+void* realloc(void* ptr, size_t size) {
+	if(!ptr)
+		return malloc(size);
+	if(!size) {
+		free(ptr);
+		return nullptr;
+	}
+
+	auto* span = span_for(ptr);
+	if(!span) {
+		fprintf(stderr, "realloc(): %p wasn't allocated by malloc\n", ptr);
+		abort();
+	}
+	//Keep the allocation if it still fits and wouldn't be mostly wasted
+	size_t usable = span->object_size;
+	if(size <= usable && size > usable / 2)
+		return ptr;
+
+	void* ret = malloc(size);
+	if(!ret)
+		return nullptr;
+	memcpy(ret, ptr, size < usable ? size : usable);
+	free(ptr);
+	return ret;
+}
+
+void __malloc_thread_exit() {
+	auto* heap = slot_heap();
+	if(!heap)
+		return;
+
+	//Give back the spans that are empty, since it might be a while until another thread picks up the heap
+	for(size_t size_class = 0; size_class < MALLOC_NUM_CLASSES; size_class++) {
+		heap->remote_frees[size_class].store(0, std::memory_order_relaxed);
+		Span** lists[] = {&heap->spans[size_class], &heap->full_spans[size_class]};
+		for(auto* list : lists) {
+			auto* span = *list;
+			while(span) {
+				auto* next = span->next;
+				collect_remote_frees(span);
+				if(!span->num_used) {
+					unlink(*list, span);
+					release_span(span);
+				} else if(span->full && span->num_used < span->capacity) {
+					unlink(*list, span);
+					span->full = false;
+					link(heap->spans[size_class], span);
+				}
+				span = next;
+			}
+		}
+	}
+
+	*heap_slot() = nullptr;
+	LOCK(s_idle_heap_lock);
+	heap->next_idle = s_idle_heaps;
+	s_idle_heaps = heap;
+}
@@ -0,0 +1,19 @@
+/* SPDX-License-Identifier: GPL-3.0-or-later */
+/* Copyright © 2016-2023 Byteduck */
+
+#pragma once
+
+#include "cdefs.h"
+#include <stddef.h>
+
+__DECL_BEGIN
+
+void* malloc(size_t size);
+void* realloc(void* ptr, size_t size);
+void* calloc(size_t nmemb, size_t size);
+void free(void* ptr);
+
+/** Gives the calling thread's heap back so that it can be used by another thread. Called by libc when a thread exits. **/
+void __malloc_thread_exit();
+
+__DECL_END
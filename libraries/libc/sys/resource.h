@@ -0,0 +1,13 @@
+/* SPDX-License-Identifier: GPL-3.0-or-later */
+/* Copyright © 2016-2023 Byteduck */
+
+#pragma once
+
+#include <kernel/api/resource.h>
+
+__DECL_BEGIN
+
+int getpriority(int which, id_t who);
+int setpriority(int which, id_t who, int prio);
+
+__DECL_END
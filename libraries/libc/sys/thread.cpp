@@ -21,6 +21,7 @@
 #include <atomic>
 #include "thread.h"
 #include "syscall.h"
+#include "malloc.h"
 
 void thread_entry(void* (*entry_func)(void*), void* arg) {
 	void* ret = entry_func(arg);
@@ -32,6 +33,7 @@ tid_t thread_create(void* (*entry_func)(void*), void* arg) {
 }
 
 void thread_exit(void* retval) {
+	__malloc_thread_exit();
 	syscall2(SYS_THREADEXIT, (int) retval);
 }
 
@@ -25,6 +25,10 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
+#include <errno.h>
+#include <sys/resource.h>
+#include <limits.h>
+#include <sys/internals.h>
 
 char** environ = NULL;
 char** __original_environ = NULL;
@@ -33,6 +37,30 @@ pid_t fork() {
 	return syscall(SYS_FORK);
 }
 
+#define __VFORK_STR(x) #x
+#define __VFORK_XSTR(x) __VFORK_STR(x)
+
+// Takes the negated error number returned by the syscall in eax, since vfork() jumps here instead of calling it
+__attribute__((used, regparm(1))) static pid_t __vfork_error(int err) {
+	errno = -err;
+	return -1;
+}
+
+// The child returns from vfork() on the parent's stack, and will overwrite whatever vfork() leaves there once it calls
+// something else. So, the return address is kept in a register across the syscall rather than on the stack.
+asm(
+	".global vfork\n"
+	".type vfork, @function\n"
+	"vfork:\n"
+	"	popl %ecx\n"
+	"	movl $" __VFORK_XSTR(SYS_VFORK) ", %eax\n"
+	"	int $0x80\n"
+	"	pushl %ecx\n"
+	"	cmpl $0, %eax\n"
+	"	jl __vfork_error\n"
+	"	ret\n"
+);
+
 int execv(const char* path, char* const argv[]) {
 	return execve(path, argv, environ);
 }
@@ -42,42 +70,50 @@ int execve(const char* filename, char* const argv[], char* const envp[]) {
 }
 
 int execvpe(const char* filename, char* const argv[], char* const envp[]) {
-	char cwd[512];
-	getcwd(cwd, 512);
-
 	// If the path contains a slash, ignore the path
 	if(strchr(filename, '/'))
-		execve(filename, argv, envp);
-
-	// Get the path
-	char* path = getenv("PATH");
-	if(!path)
-		path = DEFAULT_PATH;
-	path = strdup(path);
-
-	// Try each element of path
-	char* path_elem = strtok(path, ":");
-	while(path_elem) {
-		// Create a string with the full path of the executable
-		size_t path_len = strlen(path_elem);
-		char* full_path = malloc(path_len + strlen(filename) + 2);
-		strcpy(full_path, path_elem);
-		full_path[path_len] = '/';
-		strcpy(full_path + path_len + 1, filename);
-
-		// Try executing it
+		return execve(filename, argv, envp);
+
+	// Try each element of path. This may be called from a vfork()'d child, so it can't allocate anything.
+	const char* path = NULL;
+	char full_path[PATH_MAX];
+	while(__path_next_candidate(&path, filename, full_path)) {
 		int res = execve(full_path, argv, envp);
-		free(full_path);
 		if(res && errno != ENOENT)
 			return res;
-		path_elem = strtok(NULL, ":");
 	}
 
-	free(path);
 	errno = ENOENT;
 	return -1;
 }
 
+char* __path_next_candidate(const char** path, const char* file, char* buf) {
+	if(!*path) {
+		*path = getenv("PATH");
+		if(!*path)
+			*path = DEFAULT_PATH;
+	}
+
+	// Skip over empty elements and ones that would make too long of a path
+	size_t file_len = strlen(file);
+	while(**path) {
+		const char* elem = *path;
+		const char* elem_end = strchr(elem, ':');
+		if(!elem_end)
+			elem_end = elem + strlen(elem);
+		*path = *elem_end ? elem_end + 1 : elem_end;
+
+		size_t elem_len = elem_end - elem;
+		if(!elem_len || elem_len + file_len + 2 > PATH_MAX)
+			continue;
+		memcpy(buf, elem, elem_len);
+		buf[elem_len] = '/';
+		memcpy(buf + elem_len + 1, file, file_len + 1);
+		return buf;
+	}
+	return NULL;
+}
+
 int execvp(const char* filename, char* const argv[]) {
 	return execvpe(filename, argv, environ);
 }
@@ -150,6 +186,16 @@ int setgid(gid_t gid) {
 	return syscall2(SYS_SETGID, gid);
 }
 
+int nice(int inc) {
+	errno = 0;
+	int prio = getpriority(PRIO_PROCESS, 0);
+	if(prio == -1 && errno)
+		return -1;
+	if(setpriority(PRIO_PROCESS, 0, prio + inc) < 0)
+		return -1;
+	return getpriority(PRIO_PROCESS, 0);
+}
+
 ssize_t read(int fd, void* buf, size_t count) {
 	return syscall4(SYS_READ, fd, (int) buf, count);
 }
@@ -281,6 +327,14 @@ unsigned int alarm(unsigned int seconds) {
 	return -1; // TODO
 }
 
+void sync() {
+	syscall(SYS_SYNC);
+}
+
+int fsync(int fd) {
+	return syscall2(SYS_FSYNC, fd);
+}
+
 void _exit(int status) {
 	syscall2(SYS_EXIT, status);
 	__builtin_unreachable();
@@ -42,6 +42,9 @@ __DECL_BEGIN
 extern char** environ;
 
 pid_t fork();
+// Like fork(), but the child borrows the parent's memory and the parent is suspended until the child calls exec or
+// _exit. The child must not return from the function that called vfork() or modify anything but the returned pid.
+pid_t vfork();
 int execv(const char* path, char* const argv[]);
 int execve(const char* filename, char* const argv[], char* const envp[]);
 int execvpe(const char* filename, char* const argv[], char* const envp[]);
@@ -64,6 +67,7 @@ int getgroups(int ngroups, gid_t list[]);
 int setgroups(size_t ngroups, const gid_t* list);
 int setuid(uid_t uid);
 int setgid(gid_t gid);
+int nice(int inc);
 
 ssize_t read(int fd, void* buf, size_t count);
 ssize_t pread(int fd, void* buf, size_t count, off_t offset);
@@ -103,6 +107,9 @@ int tcsetpgrp(int fd, pid_t pgid);
 
 unsigned int alarm(unsigned int seconds);
 
+void sync();
+int fsync(int fd);
+
 void _exit(int status);
 
 __DECL_END
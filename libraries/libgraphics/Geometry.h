@@ -20,6 +20,7 @@
 #pragma once
 
 #include <algorithm>
+#include <vector>
 #include <math.h>
 #include <libduck/Stream.h>
 
@@ -338,6 +339,33 @@ namespace Gfx {
 			return ret;
 		}
 
+		/**
+		 * Splits the part of this rect that isn't covered by another rect into up to four rects that don't overlap.
+		 * @param other The rect to cut out of this one.
+		 * @param out The array to put the resulting rects in.
+		 * @return The number of rects written to out.
+		 */
+		int subtract(const GenericRect& other, GenericRect out[4]) const {
+			if(!collides(other)) {
+				out[0] = *this;
+				return 1;
+			}
+
+			// Take full-width bands off of the top and bottom, and then whatever is left on the left and right
+			int num_rects = 0;
+			T top = std::max(y, other.y);
+			T bottom = std::min(y + height, other.y + other.height);
+			if(other.y > y)
+				out[num_rects++] = {x, y, width, other.y - y};
+			if(other.y + other.height < y + height)
+				out[num_rects++] = {x, bottom, width, (y + height) - bottom};
+			if(other.x > x)
+				out[num_rects++] = {x, top, other.x - x, bottom - top};
+			if(other.x + other.width < x + width)
+				out[num_rects++] = {other.x + other.width, top, (x + width) - (other.x + other.width), bottom - top};
+			return num_rects;
+		}
+
 		/**
 		 * Returns a rect that would contain both rectangles.
 		 * @param other The other rectangle to combine with.
@@ -426,4 +454,117 @@ namespace Gfx {
 	using IntRect = GenericRect<int>;
 	using FloatRect = GenericRect<float>;
 	using DoubleRect = GenericRect<double>;
+
+	/**
+	 * An area made up of a list of rects that don't overlap each other, which can be added to and subtracted from.
+	 */
+	template<typename T>
+	class GenericRegion {
+	public:
+		using Rect = GenericRect<T>;
+
+		GenericRegion() = default;
+		GenericRegion(const Rect& rect) {
+			add(rect);
+		}
+
+		/**
+		 * The rects that make up the region. None of them overlap, and none of them are empty.
+		 */
+		inline const std::vector<Rect>& rects() const {
+			return m_rects;
+		}
+
+		inline bool empty() const {
+			return m_rects.empty();
+		}
+
+		inline void clear() {
+			m_rects.clear();
+		}
+
+		/**
+		 * Returns the smallest rect that contains the entire region.
+		 */
+		Rect bounds() const {
+			if(m_rects.empty())
+				return {0, 0, 0, 0};
+			Rect ret = m_rects[0];
+			for(auto& rect : m_rects)
+				ret = ret.combine(rect);
+			return ret;
+		}
+
+		/**
+		 * Returns whether any part of the region overlaps the given rect.
+		 */
+		bool collides(const Rect& rect) const {
+			for(auto& region_rect : m_rects) {
+				if(region_rect.collides(rect))
+					return true;
+			}
+			return false;
+		}
+
+		/**
+		 * Adds a rect to the region. Only the parts of the rect that aren't already in the region are added.
+		 */
+		void add(const Rect& rect) {
+			if(!has_area(rect))
+				return;
+			std::vector<Rect> pieces = {rect};
+			std::vector<Rect> new_pieces;
+			Rect split[4];
+			for(auto& region_rect : m_rects) {
+				new_pieces.clear();
+				for(auto& piece : pieces) {
+					int num_split = piece.subtract(region_rect, split);
+					new_pieces.insert(new_pieces.end(), split, split + num_split);
+				}
+				std::swap(pieces, new_pieces);
+				if(pieces.empty())
+					return;
+			}
+			m_rects.insert(m_rects.end(), pieces.begin(), pieces.end());
+		}
+
+		/**
+		 * Removes the area of a rect from the region.
+		 */
+		void subtract(const Rect& rect) {
+			if(!has_area(rect))
+				return;
+			std::vector<Rect> new_rects;
+			new_rects.reserve(m_rects.size());
+			Rect split[4];
+			for(auto& region_rect : m_rects) {
+				int num_split = region_rect.subtract(rect, split);
+				new_rects.insert(new_rects.end(), split, split + num_split);
+			}
+			m_rects = std::move(new_rects);
+		}
+
+		/**
+		 * Returns the part of the region that is inside the given rect.
+		 */
+		GenericRegion intersected(const Rect& rect) const {
+			GenericRegion ret;
+			if(!has_area(rect))
+				return ret;
+			for(auto& region_rect : m_rects) {
+				if(region_rect.collides(rect))
+					ret.m_rects.push_back(region_rect.overlapping_area(rect));
+			}
+			return ret;
+		}
+
+	private:
+		static inline bool has_area(const Rect& rect) {
+			return rect.width > 0 && rect.height > 0;
+		}
+
+		std::vector<Rect> m_rects;
+	};
+
+	using Region = GenericRegion<int>;
 }
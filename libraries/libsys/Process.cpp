@@ -97,6 +97,7 @@ Result Process::update() {
 	_ppid = std::stoi(proc["ppid"]);
 	_gid = std::stoi(proc["gid"]);
 	_uid = std::stoi(proc["uid"]);
+	_nice = std::stoi(proc["nice"]);
 	_state = (State) std::stoi(proc["state"]);
 	_physical_mem = {std::stoul(proc["pmem"])};
 	_virtual_mem = {std::stoul(proc["vmem"])};
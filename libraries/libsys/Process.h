@@ -44,6 +44,7 @@ namespace Sys {
 		pid_t ppid() const { return _ppid; }
 		gid_t gid() const { return _gid; }
 		uid_t uid() const { return _uid; }
+		int nice() const { return _nice; }
 		State state() const { return _state; }
 		std::string state_name() const;
 		Mem::Amount physical_mem() const { return _physical_mem; }
@@ -60,6 +61,7 @@ namespace Sys {
 		pid_t _ppid;
 		gid_t _gid;
 		uid_t _uid;
+		int _nice;
 		State _state;
 		Mem::Amount _physical_mem;
 		Mem::Amount _virtual_mem;
@@ -0,0 +1,385 @@
+/* SPDX-License-Identifier: GPL-3.0-or-later */
+/* Copyright © 2016-2023 Byteduck */
+
+// A program that writes the cache ld uses to find libraries and bind their symbols without searching for them.
+
+#include <libduck/Args.h>
+#include <libduck/Path.h>
+#include <libduck/DirectoryEntry.h>
+#include <ld/ld.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#define CACHE_TEMP_PATH LD_CACHE_PATH ".tmp"
+
+struct Library {
+	std::string name;
+	std::string path;
+	struct stat statbuf;
+	uint8_t* file = nullptr;
+	size_t mapped_size = 0;
+	size_t memsz = 0;
+	uint32_t load_address = 0;
+	elf32_sym* symbols = nullptr;
+	size_t num_symbols = 0;
+	const char* strings = nullptr;
+	std::vector<std::pair<elf32_rel*, size_t>> relocation_tables;
+	std::vector<LDCacheBinding> bindings;
+};
+
+struct Definition {
+	uint32_t library;
+	uint32_t address;
+	bool ambiguous;
+};
+
+bool verbose = false;
+bool update = false;
+
+// Translates an address in the library to where that part of the library is in the file.
+uint8_t* file_pointer(Library& library, uint32_t vaddr, std::vector<elf32_pheader*>& segments) {
+	for(auto* segment : segments) {
+		if(vaddr >= segment->p_vaddr && vaddr < segment->p_vaddr + segment->p_filesz)
+			return library.file + segment->p_offset + (vaddr - segment->p_vaddr);
+	}
+	return nullptr;
+}
+
+// Maps the library and finds its size and the tables we need out of its dynamic section.
+bool read_library(Library& library) {
+	int fd = open(library.path.c_str(), O_RDONLY);
+	if(fd < 0)
+		return false;
+	if(fstat(fd, &library.statbuf) < 0 || (size_t) library.statbuf.st_size < sizeof(elf32_ehdr)) {
+		close(fd);
+		return false;
+	}
+	library.mapped_size = ((library.statbuf.st_size + PAGE_SIZE - 1) / PAGE_SIZE) * PAGE_SIZE;
+	auto* mapped_file = mmap(nullptr, library.mapped_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if(mapped_file == MAP_FAILED)
+		return false;
+	library.file = (uint8_t*) mapped_file;
+
+	auto* header = (elf32_ehdr*) library.file;
+	if(*((uint32_t*) header->e_ident) != ELF_MAGIC || header->e_type != ELF_TYPE_SHARED)
+		return false;
+
+	std::vector<elf32_pheader*> segments;
+	elf32_pheader* dynamic_header = nullptr;
+	for(size_t i = 0; i < header->e_phnum; i++) {
+		auto* pheader = (elf32_pheader*) (library.file + header->e_phoff + i * header->e_phentsize);
+		if(pheader->p_type == PT_LOAD) {
+			segments.push_back(pheader);
+			library.memsz = std::max<size_t>(library.memsz, pheader->p_vaddr + pheader->p_memsz);
+		} else if(pheader->p_type == PT_DYNAMIC) {
+			dynamic_header = pheader;
+		}
+	}
+	if(!dynamic_header || !library.memsz)
+		return false;
+
+	uint32_t* hash = nullptr;
+	uint32_t* gnu_hash = nullptr;
+	elf32_rel* relocations = nullptr;
+	size_t relocations_size = 0;
+	elf32_rel* plt_relocations = nullptr;
+	size_t plt_relocations_size = 0;
+	auto* dynamic_table = (elf32_dynamic*) (library.file + dynamic_header->p_offset);
+	for(size_t i = 0; i < dynamic_header->p_filesz / sizeof(elf32_dynamic) && dynamic_table[i].d_tag != DT_NULL; i++) {
+		auto& dynamic = dynamic_table[i];
+		switch(dynamic.d_tag) {
+			case DT_HASH:
+				hash = (uint32_t*) file_pointer(library, dynamic.d_val, segments);
+				break;
+			case DT_GNU_HASH:
+				gnu_hash = (uint32_t*) file_pointer(library, dynamic.d_val, segments);
+				break;
+			case DT_STRTAB:
+				library.strings = (char*) file_pointer(library, dynamic.d_val, segments);
+				break;
+			case DT_SYMTAB:
+				library.symbols = (elf32_sym*) file_pointer(library, dynamic.d_val, segments);
+				break;
+			case DT_REL:
+				relocations = (elf32_rel*) file_pointer(library, dynamic.d_val, segments);
+				break;
+			case DT_RELSZ:
+				relocations_size = dynamic.d_val;
+				break;
+			case DT_JMPREL:
+				plt_relocations = (elf32_rel*) file_pointer(library, dynamic.d_val, segments);
+				break;
+			case DT_PLTRELSZ:
+				plt_relocations_size = dynamic.d_val;
+				break;
+			default:
+				break;
+		}
+	}
+	if(!library.strings || !library.symbols || (!hash && !gnu_hash))
+		return false;
+
+	// The SysV hash table has a chain entry for every symbol, but with just the GNU one we have to find the end of the
+	// chain that ends with the last symbol
+	if(hash) {
+		library.num_symbols = hash[1];
+	} else {
+		uint32_t num_buckets = gnu_hash[0];
+		uint32_t sym_offset = gnu_hash[1];
+		auto* buckets = &gnu_hash[4 + gnu_hash[2]];
+		auto* chain = &buckets[num_buckets];
+		uint32_t last_symbol = 0;
+		for(uint32_t i = 0; i < num_buckets; i++)
+			last_symbol = std::max(last_symbol, buckets[i]);
+		if(last_symbol >= sym_offset) {
+			while(!(chain[last_symbol - sym_offset] & 1))
+				last_symbol++;
+		}
+		library.num_symbols = std::max(last_symbol + 1, sym_offset);
+	}
+
+	if(relocations)
+		library.relocation_tables.emplace_back(relocations, relocations_size / sizeof(elf32_rel));
+	if(plt_relocations)
+		library.relocation_tables.emplace_back(plt_relocations, plt_relocations_size / sizeof(elf32_rel));
+	return true;
+}
+
+bool is_defined(const elf32_sym& symbol) {
+	return symbol.st_shndx && ELF32_ST_BIND(symbol.st_info) != STB_LOCAL && symbol.st_name;
+}
+
+// Finds the libraries in the search path, preferring the first directory a library is found in like ld does.
+std::vector<Library> find_libraries(std::vector<std::string>& directories) {
+	std::vector<Library> libraries;
+	for(auto& directory : directories) {
+		auto entries_res = Duck::Path(directory).get_directory_entries();
+		if(entries_res.is_error())
+			continue;
+		for(auto& entry : entries_res.value()) {
+			if(entry.is_directory() || entry.path().extension() != "so")
+				continue;
+			std::string name(entry.name());
+			bool found = std::any_of(libraries.begin(), libraries.end(), [&](const Library& library) {
+				return library.name == name;
+			});
+			if(!found)
+				libraries.push_back({name, directory + "/" + name});
+		}
+	}
+	std::sort(libraries.begin(), libraries.end(), [](const Library& a, const Library& b) {
+		return a.name < b.name;
+	});
+	return libraries;
+}
+
+// Binds every symbol a library relocates against that only one library defines.
+void bind_symbols(Library& library, std::unordered_map<std::string, Definition>& definitions) {
+	std::vector<uint32_t> symbols;
+	for(auto& table : library.relocation_tables) {
+		for(size_t i = 0; i < table.second; i++) {
+			auto& rel = table.first[i];
+			uint32_t rel_type = ELF32_R_TYPE(rel.r_info);
+			uint32_t rel_symbol = ELF32_R_SYM(rel.r_info);
+			if(rel_type != R_386_32 && rel_type != R_386_PC32 && rel_type != R_386_GLOB_DAT && rel_type != R_386_JMP_SLOT)
+				continue;
+			if(!rel_symbol || rel_symbol >= library.num_symbols || ELF32_ST_BIND(library.symbols[rel_symbol].st_info) == STB_LOCAL)
+				continue;
+			symbols.push_back(rel_symbol);
+		}
+	}
+	std::sort(symbols.begin(), symbols.end());
+	symbols.erase(std::unique(symbols.begin(), symbols.end()), symbols.end());
+
+	for(auto symbol : symbols) {
+		auto definition = definitions.find(library.strings + library.symbols[symbol].st_name);
+		if(definition == definitions.end() || definition->second.ambiguous)
+			continue;
+		library.bindings.push_back({symbol, definition->second.library, definition->second.address});
+	}
+}
+
+uint32_t add_string(std::vector<char>& strings, const std::string& string) {
+	uint32_t offset = strings.size();
+	strings.insert(strings.end(), string.begin(), string.end());
+	strings.push_back('\0');
+	return offset;
+}
+
+bool write_cache(std::vector<std::string>& directories, std::vector<Library>& libraries, uint32_t layout_end) {
+	std::vector<char> strings;
+	std::vector<LDCacheDirectory> cache_directories;
+	std::vector<LDCacheLibrary> cache_libraries;
+	std::vector<LDCacheBinding> cache_bindings;
+
+	for(auto& directory : directories) {
+		struct stat statbuf;
+		if(stat(directory.c_str(), &statbuf) < 0)
+			continue;
+		cache_directories.push_back({add_string(strings, directory), (uint32_t) statbuf.st_ino, statbuf.st_mtime});
+	}
+
+	for(auto& library : libraries) {
+		cache_libraries.push_back({
+			.name = add_string(strings, library.name),
+			.path = add_string(strings, library.path),
+			.inode = (uint32_t) library.statbuf.st_ino,
+			.size = (uint32_t) library.statbuf.st_size,
+			.mtime = library.statbuf.st_mtime,
+			.load_address = library.load_address,
+			.first_binding = (uint32_t) cache_bindings.size(),
+			.num_bindings = (uint32_t) library.bindings.size()
+		});
+		cache_bindings.insert(cache_bindings.end(), library.bindings.begin(), library.bindings.end());
+	}
+
+	LDCacheHeader header = {
+		.magic = LD_CACHE_MAGIC,
+		.version = LD_CACHE_VERSION,
+		.num_directories = (uint32_t) cache_directories.size(),
+		.num_libraries = (uint32_t) cache_libraries.size(),
+		.num_bindings = (uint32_t) cache_bindings.size(),
+		.strings_size = (uint32_t) strings.size(),
+		.layout_end = layout_end
+	};
+
+	// Write to a temporary file and move it into place, so ld never sees a half-written cache
+	FILE* file = fopen(CACHE_TEMP_PATH, "w");
+	if(!file) {
+		perror("ldconfig: " CACHE_TEMP_PATH);
+		return false;
+	}
+	bool success =
+			fwrite(&header, sizeof(header), 1, file) == 1 &&
+			fwrite(cache_directories.data(), sizeof(LDCacheDirectory), cache_directories.size(), file) == cache_directories.size() &&
+			fwrite(cache_libraries.data(), sizeof(LDCacheLibrary), cache_libraries.size(), file) == cache_libraries.size() &&
+			fwrite(cache_bindings.data(), sizeof(LDCacheBinding), cache_bindings.size(), file) == cache_bindings.size() &&
+			fwrite(strings.data(), 1, strings.size(), file) == strings.size();
+	success = !fclose(file) && success;
+	if(!success) {
+		perror("ldconfig: " CACHE_TEMP_PATH);
+		unlink(CACHE_TEMP_PATH);
+		return false;
+	}
+
+	unlink(LD_CACHE_PATH);
+	if(rename(CACHE_TEMP_PATH, LD_CACHE_PATH) < 0) {
+		perror("ldconfig: " LD_CACHE_PATH);
+		return false;
+	}
+	return true;
+}
+
+// Checks whether the existing cache still describes the libraries in the search path. Adding or removing a library
+// changes its directory's mtime, so we only need to check the directories and the libraries that are in the cache.
+bool cache_up_to_date(std::vector<std::string>& directories) {
+	int fd = open(LD_CACHE_PATH, O_RDONLY);
+	if(fd < 0)
+		return false;
+	std::vector<uint8_t> contents;
+	uint8_t buffer[4096];
+	ssize_t nread;
+	while((nread = read(fd, buffer, sizeof(buffer))) > 0)
+		contents.insert(contents.end(), buffer, buffer + nread);
+	close(fd);
+	if(!ld_cache_validate(contents.data(), contents.size()))
+		return false;
+
+	auto* header = (LDCacheHeader*) contents.data();
+	auto* cache_directories = (LDCacheDirectory*) (header + 1);
+	auto* cache_libraries = (LDCacheLibrary*) (cache_directories + header->num_directories);
+	auto* strings = (char*) ((LDCacheBinding*) (cache_libraries + header->num_libraries) + header->num_bindings);
+	if(header->num_directories != directories.size())
+		return false;
+
+	for(size_t i = 0; i < directories.size(); i++) {
+		struct stat statbuf;
+		if(directories[i] != strings + cache_directories[i].path || stat(directories[i].c_str(), &statbuf) < 0 || !ld_cache_matches(cache_directories[i], statbuf))
+			return false;
+	}
+
+	for(size_t i = 0; i < header->num_libraries; i++) {
+		struct stat statbuf;
+		if(stat(strings + cache_libraries[i].path, &statbuf) < 0 || !ld_cache_matches(cache_libraries[i], statbuf))
+			return false;
+	}
+
+	return true;
+}
+
+int main(int argc, char** argv) {
+	Duck::Args args;
+	args.add_flag(verbose, "v", "verbose", "Print the libraries in the cache and where they will be loaded.");
+	args.add_flag(update, "u", "update", "Only rebuild the cache if it's out of date.");
+	args.parse(argc, argv);
+
+	std::vector<std::string> directories;
+	std::string search_path = LD_CACHE_SEARCH_PATH;
+	size_t start = 0;
+	while(start <= search_path.size()) {
+		size_t end = search_path.find(':', start);
+		if(end == std::string::npos)
+			end = search_path.size();
+		directories.push_back(search_path.substr(start, end - start));
+		start = end + 1;
+	}
+
+	if(update && cache_up_to_date(directories)) {
+		if(verbose)
+			printf("The library cache is up to date.\n");
+		return EXIT_SUCCESS;
+	}
+	auto libraries = find_libraries(directories);
+
+	// Read the libraries and lay them out one after another
+	uint32_t load_address = LD_CACHE_BASE;
+	std::vector<Library> valid_libraries;
+	for(auto& library : libraries) {
+		if(!read_library(library)) {
+			if(verbose)
+				printf("Skipping %s: not a shared library\n", library.path.c_str());
+			if(library.file)
+				munmap(library.file, library.mapped_size);
+			continue;
+		}
+		library.load_address = load_address;
+		load_address += ((library.memsz + PAGE_SIZE - 1) / PAGE_SIZE) * PAGE_SIZE;
+		valid_libraries.push_back(library);
+	}
+
+	// Find out which library defines each symbol, so we can tell which ones only have one definition
+	std::unordered_map<std::string, Definition> definitions;
+	for(uint32_t i = 0; i < valid_libraries.size(); i++) {
+		auto& library = valid_libraries[i];
+		for(size_t symbol = 1; symbol < library.num_symbols; symbol++) {
+			auto& elf_symbol = library.symbols[symbol];
+			if(!is_defined(elf_symbol))
+				continue;
+			auto result = definitions.insert({library.strings + elf_symbol.st_name, {i, library.load_address + elf_symbol.st_value, false}});
+			if(!result.second)
+				result.first->second.ambiguous = true;
+		}
+	}
+
+	for(auto& library : valid_libraries)
+		bind_symbols(library, definitions);
+
+	if(verbose) {
+		for(auto& library : valid_libraries)
+			printf("%s => %s @ %#x (%zu bindings)\n", library.name.c_str(), library.path.c_str(), library.load_address, library.bindings.size());
+	}
+
+	bool success = write_cache(directories, valid_libraries, load_address);
+	for(auto& library : valid_libraries)
+		munmap(library.file, library.mapped_size);
+	return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,129 @@
+/* SPDX-License-Identifier: GPL-3.0-or-later */
+/* Copyright © 2016-2023 Byteduck */
+
+// A program that measures how fast libc's malloc is, compared to the liballoc allocator it replaced.
+
+#include <libduck/Args.h>
+#include <libduck/Time.h>
+#include <sys/liballoc.h>
+#include <sys/thread.h>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+struct Allocator {
+	const char* name;
+	void* (*alloc)(size_t);
+	void (*free)(void*);
+};
+
+const Allocator allocators[] = {
+	{"malloc", malloc, free},
+	{"liballoc", __liballoc_malloc, __liballoc_free}
+};
+
+unsigned long iterations = 200000;
+unsigned long num_threads = 4;
+unsigned long max_size = 512;
+unsigned long working_set = 1024;
+
+struct Job {
+	const Allocator* allocator;
+	uint32_t seed;
+	std::vector<void*> pointers;
+};
+
+uint32_t next_random(uint32_t& state) {
+	state ^= state << 13;
+	state ^= state >> 17;
+	state ^= state << 5;
+	return state;
+}
+
+// Allocates and frees random sizes, keeping up to working_set allocations alive at once.
+void* churn(void* arg) {
+	auto* job = (Job*) arg;
+	std::vector<void*> live(working_set, nullptr);
+	for(unsigned long i = 0; i < iterations; i++) {
+		auto& slot = live[next_random(job->seed) % working_set];
+		if(slot)
+			job->allocator->free(slot);
+		slot = job->allocator->alloc(next_random(job->seed) % max_size + 1);
+	}
+	for(auto ptr : live)
+		job->allocator->free(ptr);
+	return nullptr;
+}
+
+// Fills the job's pointers with allocations, to be freed by another thread.
+void* produce(void* arg) {
+	auto* job = (Job*) arg;
+	for(auto& ptr : job->pointers)
+		ptr = job->allocator->alloc(next_random(job->seed) % max_size + 1);
+	return nullptr;
+}
+
+void* consume(void* arg) {
+	auto* job = (Job*) arg;
+	for(auto ptr : job->pointers)
+		job->allocator->free(ptr);
+	return nullptr;
+}
+
+void run_threads(void* (*func)(void*), std::vector<Job>& jobs) {
+	std::vector<tid_t> threads;
+	for(auto& job : jobs)
+		threads.push_back(thread_create(func, &job));
+	for(auto thread : threads)
+		thread_join(thread, nullptr);
+}
+
+// Runs a benchmark and returns how long it took in milliseconds.
+template<typename F>
+long time_ms(F&& benchmark) {
+	auto start_time = Duck::Time::now();
+	benchmark();
+	auto elapsed = (Duck::Time::now() - start_time).millis();
+	return elapsed ? elapsed : 1;
+}
+
+int main(int argc, char** argv) {
+	Duck::Args args;
+	args.add_named(iterations, "i", "iterations", "The number of allocations each thread makes.");
+	args.add_named(num_threads, "t", "threads", "The number of threads to use for the multithreaded benchmarks.");
+	args.add_named(max_size, "s", "size", "The largest allocation to make, in bytes.");
+	args.add_named(working_set, "w", "working-set", "The number of allocations each thread keeps alive at once.");
+	args.parse(argc, argv);
+
+	if(!iterations || !num_threads || !max_size || !working_set) {
+		fprintf(stderr, "mallocbench: The arguments must be greater than zero.\n");
+		return EXIT_FAILURE;
+	}
+
+	printf("%-10s %12s %12s %12s\n", "", "1 thread", "threaded", "cross-thread");
+	for(auto& allocator : allocators) {
+		Job single_job = {&allocator, 1, {}};
+		auto single_ms = time_ms([&] { churn(&single_job); });
+
+		std::vector<Job> jobs;
+		for(unsigned long i = 0; i < num_threads; i++)
+			jobs.push_back({&allocator, (uint32_t) (i + 1), {}});
+		auto threaded_ms = time_ms([&] { run_threads(churn, jobs); });
+
+		// Every thread frees the allocations made by the next one
+		for(auto& job : jobs)
+			job.pointers.resize(iterations);
+		auto cross_ms = time_ms([&] {
+			run_threads(produce, jobs);
+			for(size_t i = 0; i + 1 < jobs.size(); i++)
+				std::swap(jobs[i].pointers, jobs[i + 1].pointers);
+			run_threads(consume, jobs);
+		});
+
+		auto total_ops = iterations * num_threads;
+		printf("%-10s %9ld ms %9ld ms %9ld ms\n", allocator.name, single_ms, threaded_ms, cross_ms);
+		printf("%-10s %7lu op/ms %7lu op/ms %7lu op/ms\n", "", iterations / single_ms, total_ops / threaded_ms, total_ops / cross_ms);
+	}
+
+	return EXIT_SUCCESS;
+}
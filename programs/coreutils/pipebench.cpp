@@ -0,0 +1,132 @@
+/* SPDX-License-Identifier: GPL-3.0-or-later */
+/* Copyright © 2016-2023 Byteduck */
+
+// A program that measures how fast data can be moved through a pipe.
+
+#include <libduck/Args.h>
+#include <libduck/Time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+unsigned long total_kib = 65536;
+unsigned long block_kib = 64;
+unsigned long pipe_kib = 0;
+std::string splice_file;
+
+// Writes total_kib of data into the pipe, either from memory or by splicing it from a file.
+bool produce(int pipe_fd) {
+	size_t total = total_kib * 1024;
+	size_t block_size = block_kib * 1024;
+
+	if(!splice_file.empty()) {
+		int file_fd = -1;
+		size_t written = 0;
+		while(written < total) {
+			// Start from the beginning of the file again whenever we reach the end
+			if(file_fd < 0) {
+				file_fd = open(splice_file.c_str(), O_RDONLY);
+				if(file_fd < 0) {
+					perror("pipebench: open");
+					return false;
+				}
+			}
+			ssize_t nwrote = splice(file_fd, pipe_fd, std::min(block_size, total - written));
+			if(nwrote < 0) {
+				perror("pipebench: splice");
+				return false;
+			}
+			if(nwrote == 0) {
+				close(file_fd);
+				file_fd = -1;
+				continue;
+			}
+			written += nwrote;
+		}
+		close(file_fd);
+		return true;
+	}
+
+	std::vector<uint8_t> buffer(block_size, 'A');
+	size_t written = 0;
+	while(written < total) {
+		ssize_t nwrote = write(pipe_fd, buffer.data(), std::min(block_size, total - written));
+		if(nwrote < 0) {
+			perror("pipebench: write");
+			return false;
+		}
+		written += nwrote;
+	}
+	return true;
+}
+
+// Reads from the pipe until it's closed, and returns the number of bytes read.
+size_t consume(int pipe_fd) {
+	std::vector<uint8_t> buffer(block_kib * 1024);
+	size_t total = 0;
+	ssize_t nread;
+	while((nread = read(pipe_fd, buffer.data(), buffer.size())) > 0)
+		total += nread;
+	return total;
+}
+
+int main(int argc, char** argv) {
+	Duck::Args args;
+	args.add_named(total_kib, "t", "total", "The total amount of data to send, in KiB.");
+	args.add_named(block_kib, "b", "block", "The amount of data to send with each write, in KiB.");
+	args.add_named(pipe_kib, "p", "pipe-size", "The size to set the pipe's buffer to, in KiB.");
+	args.add_named(splice_file, "f", "file", "Splice the data from this file instead of writing it from memory.");
+	args.parse(argc, argv);
+
+	if(!total_kib || !block_kib) {
+		fprintf(stderr, "pipebench: The total and block sizes must be greater than zero.\n");
+		return EXIT_FAILURE;
+	}
+
+	int fds[2];
+	if(pipe(fds) < 0) {
+		perror("pipebench: pipe");
+		return EXIT_FAILURE;
+	}
+
+	if(pipe_kib && fcntl(fds[1], F_SETPIPE_SZ, (int) (pipe_kib * 1024)) < 0) {
+		perror("pipebench: fcntl");
+		return EXIT_FAILURE;
+	}
+	printf("Pipe size: %d KiB\n", fcntl(fds[1], F_GETPIPE_SZ) / 1024);
+
+	auto start_time = Duck::Time::now();
+
+	pid_t child = fork();
+	if(child < 0) {
+		perror("pipebench: fork");
+		return EXIT_FAILURE;
+	}
+
+	if(child == 0) {
+		close(fds[1]);
+		size_t total = consume(fds[0]);
+		exit(total == total_kib * 1024 ? EXIT_SUCCESS : EXIT_FAILURE);
+	}
+
+	close(fds[0]);
+	bool success = produce(fds[1]);
+	close(fds[1]);
+
+	int status = EXIT_FAILURE;
+	waitpid(child, &status, 0);
+	auto elapsed = (Duck::Time::now() - start_time).millis();
+
+	if(!success || status != EXIT_SUCCESS) {
+		fprintf(stderr, "pipebench: Not all of the data made it through the pipe.\n");
+		return EXIT_FAILURE;
+	}
+
+	if(!elapsed)
+		elapsed = 1;
+	printf("Moved %lu KiB in %ld ms (%lu KiB/s)\n", total_kib, elapsed, (unsigned long) (total_kib * 1000 / elapsed));
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,11 @@
+/* SPDX-License-Identifier: GPL-3.0-or-later */
+/* Copyright © 2016-2023 Byteduck */
+
+// A program that writes all cached disk writes back to the disk.
+
+#include <unistd.h>
+
+int main() {
+	sync();
+	return 0;
+}
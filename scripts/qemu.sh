@@ -48,6 +48,10 @@ elif "$DUCKOS_QEMU" --display help | grep -iq cocoa; then
 	DUCKOS_QEMU_DISPLAY="--display cocoa"
 fi
 
+if [ -z "$DUCKOS_QEMU_CPUS" ]; then
+	DUCKOS_QEMU_CPUS="1"
+fi
+
 if [ -z "$DUCKOS_KERNEL_ARGS" ]; then
   DUCKOS_KERNEL_ARGS="$@"
 fi
@@ -58,6 +62,7 @@ DUCKOS_QEMU_ARGS="
 	-kernel kernel/duckk32
 	-drive file=$DUCKOS_IMAGE,cache=directsync,format=raw,id=disk,if=ide
 	-m 512M
+	-smp $DUCKOS_QEMU_CPUS
 	-serial stdio
 	-device ac97
 	$DUCKOS_QEMU_DISPLAY
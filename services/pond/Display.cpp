@@ -30,6 +30,7 @@
 #include <kernel/device/VGADevice.h>
 #include <sys/input.h>
 #include <libgraphics/Memory.h>
+#include <algorithm>
 
 using namespace Gfx;
 using Duck::Log, Duck::Config, Duck::ResultRet;
@@ -71,6 +72,9 @@ Display::Display(): _dimensions({0, 0, 0, 0}) {
 		_buffer_mode = BufferMode::Double;
 
 	_framebuffer = {buffer, _dimensions.width, _dimensions.height};
+	_damage_columns = (_dimensions.width + DAMAGE_TILE_SIZE - 1) / DAMAGE_TILE_SIZE;
+	_damage_rows = (_dimensions.height + DAMAGE_TILE_SIZE - 1) / DAMAGE_TILE_SIZE;
+	_damage_tiles.resize(_damage_columns * _damage_rows, {0, 0, 0, 0});
 	Log::info("Display opened and mapped (", _dimensions.width, " x ", _dimensions.height, ")");
 
 	if((_keyboard_fd = open("/dev/input/keyboard", O_RDONLY | O_CLOEXEC)) < 0)
@@ -160,8 +164,45 @@ void Display::remove_window(Window* window) {
 }
 
 void Display::invalidate(const Gfx::Rect& rect) {
-	if(!rect.empty())
-		invalid_areas.push_back(rect);
+	auto area = rect.overlapping_area(_dimensions);
+	if(area.width <= 0 || area.height <= 0)
+		return;
+
+	//Keep track of the damaged part of each tile, so that the number of areas to repaint is bounded by the tiles
+	int first_column = area.x / DAMAGE_TILE_SIZE;
+	int last_column = (area.x + area.width - 1) / DAMAGE_TILE_SIZE;
+	int first_row = area.y / DAMAGE_TILE_SIZE;
+	int last_row = (area.y + area.height - 1) / DAMAGE_TILE_SIZE;
+	for(int row = first_row; row <= last_row; row++) {
+		for(int column = first_column; column <= last_column; column++) {
+			int index = row * _damage_columns + column;
+			auto& tile = _damage_tiles[index];
+			auto tile_area = area.overlapping_area({column * DAMAGE_TILE_SIZE, row * DAMAGE_TILE_SIZE, DAMAGE_TILE_SIZE, DAMAGE_TILE_SIZE});
+			if(tile.width) {
+				tile = tile.combine(tile_area);
+			} else {
+				tile = tile_area;
+				_damaged_tiles.push_back(index);
+			}
+		}
+	}
+}
+
+std::vector<Gfx::Rect> Display::collect_damage() {
+	//Go through the tiles in order, so that neighboring tiles in a row with the same damaged rows can be merged
+	std::sort(_damaged_tiles.begin(), _damaged_tiles.end());
+	std::vector<Gfx::Rect> rects;
+	for(auto index : _damaged_tiles) {
+		auto& tile = _damage_tiles[index];
+		auto* last = rects.empty() ? nullptr : &rects.back();
+		if(last && last->y == tile.y && last->height == tile.height && last->x + last->width == tile.x)
+			last->width += tile.width;
+		else
+			rects.push_back(tile);
+		tile = {0, 0, 0, 0};
+	}
+	_damaged_tiles.clear();
+	return rects;
 }
 
 //#define DEBUG_REPAINT_PERF
@@ -171,7 +212,7 @@ void Display::repaint() {
 	gettimeofday(&t0, nullptr);
 #endif
 
-	if(!invalid_areas.empty())
+	if(!_damaged_tiles.empty())
 		display_buffer_dirty = true;
 	else
 		return;
@@ -182,75 +223,73 @@ void Display::repaint() {
 	gettimeofday(&paint_time, NULL);
 
 	auto& fb = _buffer_mode == BufferMode::Single ? _framebuffer : _root_window->framebuffer();
-
-	//Combine areas that overlap
-	auto it = invalid_areas.begin();
-	while(it != invalid_areas.end()) {
-		bool remove_area = false;
-		for(auto & other_area : invalid_areas) {
-			if(&*it != &other_area && it->collides(other_area)) {
-				other_area = it->combine(other_area);
-				remove_area = true;
-				break;
-			}
-		}
-		if(remove_area)
-			invalid_areas.erase(it);
-		else
-			it++;
-	}
+	auto damage = collect_damage();
 
 	//If double buffering, combine the invalid areas together to calculate the portion of the framebuffer to be redrawn
 	if(_buffer_mode == BufferMode::Double) {
 		//If the invalid buffer area is empty (has an x of -1), initialize it to the first invalid area
 		if(_invalid_buffer_area.x == -1)
-			_invalid_buffer_area = invalid_areas[0];
-		for(auto& area : invalid_areas)
+			_invalid_buffer_area = damage[0];
+		for(auto& area : damage)
 			_invalid_buffer_area = _invalid_buffer_area.combine(area);
 	}
 
-	for(auto& area : invalid_areas) {
-		// Fill the invalid area with the background.
+	//Figure out what part of the damage each window needs to draw, from front to back. Anything behind an opaque
+	//window is hidden, so it's taken out of the damage that the windows behind it (and the background) will draw.
+	Gfx::Region uncovered;
+	for(auto& area : damage)
+		uncovered.add(area);
+	std::vector<Gfx::Region> window_areas(_windows.size());
+	for(size_t i = _windows.size(); i-- > 0 && !uncovered.empty();) {
+		auto window = _windows[i];
+		//Don't bother with the mouse window or hidden windows, we draw it separately so it's always on top
+		if(window == _mouse_window || window->hidden())
+			continue;
+
+		//If the window is being resized, only draw it where it was before, since the client hasn't redrawn it yet
+		auto window_old_rect = window->old_absolute_shadow_rect();
+		auto window_draw_rect = window->absolute_shadow_rect();
+		if(!window_old_rect.empty())
+			window_draw_rect = window_draw_rect.overlapping_area(window_old_rect);
+		window_areas[i] = uncovered.intersected(window_draw_rect);
+		if(!window->uses_alpha() && window_old_rect.empty())
+			uncovered.subtract(window->absolute_rect());
+	}
+
+	// Fill whatever isn't covered by an opaque window with the background.
+	for(auto& area : uncovered.rects())
 		fb.copy(_background_framebuffer, area, area.position());
 
-		// See if each window overlaps the invalid area.
-		for(auto window : _windows) {
-			//Don't bother with the mouse window or hidden windows, we draw it separately so it's always on top
-			if(window == _mouse_window || window->hidden())
-				continue;
-
-			auto window_old_rect = window->old_absolute_shadow_rect();
-			auto window_shabs = window->absolute_shadow_rect();
-			auto window_collision_rect = window_old_rect.empty() ? window_shabs : window_old_rect;
-			if(window_collision_rect.collides(area)) {
-				//If it does, redraw the intersection of the window in question and the invalid area
-				Gfx::Rect window_abs = window->absolute_rect();
-				Gfx::Rect overlap_abs = area.overlapping_area(window_abs);
-				auto transformed_overlap = overlap_abs.transform({-window_abs.x, -window_abs.y});
-				if(window->uses_alpha())
-					fb.copy_blitting(window->framebuffer(), transformed_overlap, overlap_abs.position());
-				else
-					fb.copy(window->framebuffer(), transformed_overlap, overlap_abs.position());
-
-				// Draw the shadow
-				if(window->has_shadow()) {
-					auto draw_shadow = [&](Gfx::Framebuffer& shadow_buffer, Rect rect) {
-						Gfx::Rect shadow_abs = area.overlapping_area(rect);
-						if(shadow_abs.empty())
-							return;
-						fb.copy_blitting(shadow_buffer, shadow_abs.transform(rect.position() * -1), shadow_abs.position());
-					};
-
-					auto shadow_size = window_abs.x - window_shabs.x;
-					draw_shadow(window->shadow_buffers()[0], window_shabs.inset(0, 0, window_shabs.height - shadow_size, 0));
-					draw_shadow(window->shadow_buffers()[1], window_shabs.inset(window_shabs.height - shadow_size, 0, 0, 0));
-					draw_shadow(window->shadow_buffers()[2], window_shabs.inset(shadow_size, window_shabs.width - shadow_size, shadow_size, 0));
-					draw_shadow(window->shadow_buffers()[3], window_shabs.inset(shadow_size, 0, shadow_size, window_shabs.width - shadow_size));
-				}
+	// Then draw the visible parts of each window from back to front.
+	for(size_t i = 0; i < _windows.size(); i++) {
+		auto window = _windows[i];
+		for(auto& area : window_areas[i].rects()) {
+			Gfx::Rect window_abs = window->absolute_rect();
+			Gfx::Rect overlap_abs = area.overlapping_area(window_abs);
+			auto transformed_overlap = overlap_abs.transform({-window_abs.x, -window_abs.y});
+			if(window->uses_alpha())
+				fb.copy_blitting(window->framebuffer(), transformed_overlap, overlap_abs.position());
+			else
+				fb.copy(window->framebuffer(), transformed_overlap, overlap_abs.position());
+
+			// Draw the shadow
+			if(window->has_shadow()) {
+				auto window_shabs = window->absolute_shadow_rect();
+				auto draw_shadow = [&](Gfx::Framebuffer& shadow_buffer, Rect rect) {
+					Gfx::Rect shadow_abs = area.overlapping_area(rect);
+					if(shadow_abs.empty())
+						return;
+					fb.copy_blitting(shadow_buffer, shadow_abs.transform(rect.position() * -1), shadow_abs.position());
+				};
+
+				auto shadow_size = window_abs.x - window_shabs.x;
+				draw_shadow(window->shadow_buffers()[0], window_shabs.inset(0, 0, window_shabs.height - shadow_size, 0));
+				draw_shadow(window->shadow_buffers()[1], window_shabs.inset(window_shabs.height - shadow_size, 0, 0, 0));
+				draw_shadow(window->shadow_buffers()[2], window_shabs.inset(shadow_size, window_shabs.width - shadow_size, shadow_size, 0));
+				draw_shadow(window->shadow_buffers()[3], window_shabs.inset(shadow_size, 0, shadow_size, window_shabs.width - shadow_size));
 			}
 		}
 	}
-	invalid_areas.resize(0);
 
 	//If we're resizing a window, draw the outline
 	if(_resize_window)
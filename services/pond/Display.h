@@ -27,6 +27,9 @@
 #include <libgraphics/Image.h>
 #include <sys/time.h>
 
+//The size of the tiles that damage to the screen is tracked in
+#define DAMAGE_TILE_SIZE 32
+
 class Window;
 class Mouse;
 class Display {
@@ -149,6 +152,11 @@ private:
 	 */
 	Gfx::Rect calculate_resize_rect();
 
+	/**
+	 * Collects the damaged areas of the screen into rects that don't overlap, and clears the damage.
+	 */
+	std::vector<Gfx::Rect> collect_damage();
+
 	int framebuffer_fd = 0; ///The file descriptor of the framebuffer.
 	Gfx::Framebuffer _framebuffer; ///The display framebuffer.
 	Gfx::Framebuffer _background_framebuffer; ///The framebuffer for the background.
@@ -156,7 +164,10 @@ private:
 	Gfx::Color _background_a = RGB(0,0,0); /// The first color of the wallpaper gradient.
 	Gfx::Color _background_b = RGB(0,0,0); /// The second color of the wallpaper gradient.
 	Gfx::Rect _dimensions; ///The dimensions of the display.
-	std::vector<Gfx::Rect> invalid_areas; ///The invalidated areas that need to be redrawn.
+	std::vector<Gfx::Rect> _damage_tiles; ///The damaged area inside of each tile of the screen, or an empty rect if there isn't any.
+	std::vector<int> _damaged_tiles; ///The indices of the tiles that have been damaged since the last repaint.
+	int _damage_columns = 0; ///The number of columns of damage tiles.
+	int _damage_rows = 0; ///The number of rows of damage tiles.
 	std::vector<Window*> _windows; ///The windows on the display.
 	Mouse* _mouse_window = nullptr; ///The window representing the mouse cursor.
 	Window* _prev_mouse_window = nullptr; ///The previous window that the mouse cursor was in.